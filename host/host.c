@@ -0,0 +1,900 @@
+// The firmware the display code runs on when it is built on a Linux host: the
+// libraries the .inf links, boot and runtime services with an in-memory
+// variable store, and a virtual clock. Nothing sleeps, Stall and CpuPause
+// just move the clock, so a test that waits five seconds finishes at once.
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/FrameBufferBltLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+
+// the values i915ovmf.dec assigns
+EFI_GUID gI915OvmfGuid = {0x557423a1, 0x63ab, 0x406c, {0xbe, 0x7e, 0x91, 0xcd, 0xbc, 0x08, 0xc4, 0x58}};
+EFI_GUID gI915ProfileTableGuid = {0x8f4cc864, 0xefa6, 0x40a4, {0xa3, 0x66, 0x4b, 0x8f, 0x49, 0x65, 0xed, 0x0e}};
+EFI_GUID gI915LogRingGuid = {0x6652c4ef, 0x0e46, 0x420e, {0xa3, 0xf9, 0xaa, 0xa4, 0xd6, 0xab, 0x7b, 0x53}};
+EFI_GUID gI915MmioTraceGuid = {0x1dcac417, 0xe23c, 0x434d, {0xa0, 0xee, 0xad, 0x17, 0x88, 0x6f, 0xcd, 0x2d}};
+EFI_GUID gI915CacheVariableGuid = {0x60e63966, 0xc204, 0x4aaf, {0xae, 0x64, 0xe5, 0x41, 0x2c, 0x29, 0xf3, 0xde}};
+EFI_GUID gI915HandoffTableGuid = {0x552fc6fa, 0xebda, 0x4929, {0x9d, 0xcc, 0xb8, 0x1b, 0x6f, 0x54, 0x3e, 0x5b}};
+
+int g_host_failures = 0;
+
+//
+// virtual clock
+//
+
+STATIC UINT64 g_now_ns = 0;
+
+UINT64 HostNowNs(VOID)
+{
+    return g_now_ns;
+}
+
+VOID HostSetNowNs(UINT64 ns)
+{
+    g_now_ns = ns;
+}
+
+VOID EFIAPI CpuPause(VOID)
+{
+    g_now_ns += 20;
+}
+
+VOID EFIAPI MemoryFence(VOID)
+{
+    __sync_synchronize();
+}
+
+VOID EFIAPI AsmWbinvd(VOID)
+{
+}
+
+// a 3 GHz invariant TSC
+UINT64 EFIAPI AsmReadTsc(VOID)
+{
+    return g_now_ns * 3;
+}
+
+STATIC UINTN g_counter_reads = 0;
+
+UINTN HostPerformanceCounterReads(VOID)
+{
+    return g_counter_reads;
+}
+
+UINT64 EFIAPI GetPerformanceCounter(VOID)
+{
+    g_counter_reads++;
+    return (UINT64)((unsigned __int128)g_now_ns * HOST_PM_TIMER_HZ / 1000000000ull) &
+           HOST_PM_TIMER_MASK;
+}
+
+UINT64 EFIAPI GetPerformanceCounterProperties(UINT64 *StartValue, UINT64 *EndValue)
+{
+    if (StartValue != NULL)
+    {
+        *StartValue = 0;
+    }
+    if (EndValue != NULL)
+    {
+        *EndValue = HOST_PM_TIMER_MASK;
+    }
+    return HOST_PM_TIMER_HZ;
+}
+
+UINT64 EFIAPI GetTimeInNanoSecond(UINT64 Ticks)
+{
+    return (UINT64)((unsigned __int128)Ticks * 1000000000ull / HOST_PM_TIMER_HZ);
+}
+
+UINTN EFIAPI MicroSecondDelay(UINTN MicroSeconds)
+{
+    g_now_ns += (UINT64)MicroSeconds * 1000;
+    return MicroSeconds;
+}
+
+UINTN EFIAPI NanoSecondDelay(UINTN NanoSeconds)
+{
+    g_now_ns += NanoSeconds;
+    return NanoSeconds;
+}
+
+//
+// BaseLib
+//
+
+UINT32 EFIAPI AsmCpuid(UINT32 Index, UINT32 *Eax, UINT32 *Ebx, UINT32 *Ecx, UINT32 *Edx)
+{
+    return AsmCpuidEx(Index, 0, Eax, Ebx, Ecx, Edx);
+}
+
+UINT32 EFIAPI AsmCpuidEx(UINT32 Index, UINT32 SubIndex, UINT32 *Eax, UINT32 *Ebx, UINT32 *Ecx, UINT32 *Edx)
+{
+    UINT32 a, b, c, d;
+    __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(Index), "c"(SubIndex));
+    if (Eax != NULL)
+        *Eax = a;
+    if (Ebx != NULL)
+        *Ebx = b;
+    if (Ecx != NULL)
+        *Ecx = c;
+    if (Edx != NULL)
+        *Edx = d;
+    return Index;
+}
+
+UINT64 EFIAPI AsmReadMsr64(UINT32 Index)
+{
+    return 0;
+}
+
+UINT64 EFIAPI AsmWriteMsr64(UINT32 Index, UINT64 Value)
+{
+    return Value;
+}
+
+UINT64 EFIAPI LShiftU64(UINT64 Operand, UINTN Count)
+{
+    return Operand << Count;
+}
+
+UINT64 EFIAPI RShiftU64(UINT64 Operand, UINTN Count)
+{
+    return Operand >> Count;
+}
+
+UINT64 EFIAPI MultU64x32(UINT64 Multiplicand, UINT32 Multiplier)
+{
+    return Multiplicand * Multiplier;
+}
+
+UINT64 EFIAPI MultU64x64(UINT64 Multiplicand, UINT64 Multiplier)
+{
+    return Multiplicand * Multiplier;
+}
+
+UINT64 EFIAPI DivU64x32(UINT64 Dividend, UINT32 Divisor)
+{
+    return Dividend / Divisor;
+}
+
+UINT64 EFIAPI DivU64x32Remainder(UINT64 Dividend, UINT32 Divisor, UINT32 *Remainder)
+{
+    if (Remainder != NULL)
+    {
+        *Remainder = (UINT32)(Dividend % Divisor);
+    }
+    return Dividend / Divisor;
+}
+
+UINT64 EFIAPI DivU64x64Remainder(UINT64 Dividend, UINT64 Divisor, UINT64 *Remainder)
+{
+    if (Remainder != NULL)
+    {
+        *Remainder = Dividend % Divisor;
+    }
+    return Dividend / Divisor;
+}
+
+INTN EFIAPI HighBitSet32(UINT32 Operand)
+{
+    return Operand == 0 ? -1 : 31 - __builtin_clz(Operand);
+}
+
+INTN EFIAPI HighBitSet64(UINT64 Operand)
+{
+    return Operand == 0 ? -1 : 63 - __builtin_clzll(Operand);
+}
+
+INTN EFIAPI LowBitSet32(UINT32 Operand)
+{
+    return Operand == 0 ? -1 : __builtin_ctz(Operand);
+}
+
+UINTN EFIAPI StrLen(CONST CHAR16 *String)
+{
+    UINTN n = 0;
+    while (String[n] != 0)
+    {
+        n++;
+    }
+    return n;
+}
+
+UINTN EFIAPI AsciiStrLen(CONST CHAR8 *String)
+{
+    return strlen(String);
+}
+
+INTN EFIAPI AsciiStrCmp(CONST CHAR8 *FirstString, CONST CHAR8 *SecondString)
+{
+    return strcmp(FirstString, SecondString);
+}
+
+RETURN_STATUS EFIAPI AsciiStrnCpyS(CHAR8 *Destination, UINTN DestMax, CONST CHAR8 *Source, UINTN Length)
+{
+    UINTN n = strnlen(Source, Length);
+    if (n >= DestMax)
+    {
+        return RETURN_BUFFER_TOO_SMALL;
+    }
+    memcpy(Destination, Source, n);
+    Destination[n] = 0;
+    return RETURN_SUCCESS;
+}
+
+UINT8 EFIAPI CalculateSum8(CONST UINT8 *Buffer, UINTN Length)
+{
+    UINT8 sum = 0;
+    while (Length-- > 0)
+    {
+        sum += *Buffer++;
+    }
+    return sum;
+}
+
+UINT8 EFIAPI CalculateCheckSum8(CONST UINT8 *Buffer, UINTN Length)
+{
+    return (UINT8)(0x100 - CalculateSum8(Buffer, Length));
+}
+
+UINT32 EFIAPI CalculateCrc32(VOID *Buffer, UINTN Length)
+{
+    CONST UINT8 *p = Buffer;
+    UINT32 crc = 0xFFFFFFFFu;
+    while (Length-- > 0)
+    {
+        crc ^= *p++;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+STATIC VOID (*g_cas_hook)(VOID) = NULL;
+
+VOID HostSetCompareExchangeHook(VOID (*Hook)(VOID))
+{
+    g_cas_hook = Hook;
+}
+
+UINT32 EFIAPI InterlockedCompareExchange32(volatile UINT32 *Value, UINT32 CompareValue, UINT32 ExchangeValue)
+{
+    VOID (*hook)(VOID) = g_cas_hook;
+
+    // whatever interrupts the caller between its read and the exchange
+    if (hook != NULL)
+    {
+        g_cas_hook = NULL;
+        hook();
+    }
+    return __sync_val_compare_and_swap(Value, CompareValue, ExchangeValue);
+}
+
+//
+// BaseMemoryLib
+//
+
+VOID *EFIAPI CopyMem(VOID *DestinationBuffer, CONST VOID *SourceBuffer, UINTN Length)
+{
+    return memmove(DestinationBuffer, SourceBuffer, Length);
+}
+
+VOID *EFIAPI SetMem(VOID *Buffer, UINTN Length, UINT8 Value)
+{
+    return memset(Buffer, Value, Length);
+}
+
+VOID *EFIAPI SetMem32(VOID *Buffer, UINTN Length, UINT32 Value)
+{
+    UINT32 *p = Buffer;
+    for (UINTN i = 0; i < Length / sizeof(*p); i++)
+    {
+        p[i] = Value;
+    }
+    return Buffer;
+}
+
+VOID *EFIAPI SetMem64(VOID *Buffer, UINTN Length, UINT64 Value)
+{
+    UINT64 *p = Buffer;
+    for (UINTN i = 0; i < Length / sizeof(*p); i++)
+    {
+        p[i] = Value;
+    }
+    return Buffer;
+}
+
+VOID *EFIAPI ZeroMem(VOID *Buffer, UINTN Length)
+{
+    return memset(Buffer, 0, Length);
+}
+
+INTN EFIAPI CompareMem(CONST VOID *DestinationBuffer, CONST VOID *SourceBuffer, UINTN Length)
+{
+    return memcmp(DestinationBuffer, SourceBuffer, Length);
+}
+
+BOOLEAN EFIAPI CompareGuid(CONST GUID *Guid1, CONST GUID *Guid2)
+{
+    return memcmp(Guid1, Guid2, sizeof(GUID)) == 0;
+}
+
+//
+// MemoryAllocationLib, pages are page aligned like the real allocator's
+//
+
+VOID *EFIAPI AllocatePages(UINTN Pages)
+{
+    VOID *p = aligned_alloc(EFI_PAGE_SIZE, EFI_PAGES_TO_SIZE(Pages));
+    if (p != NULL)
+    {
+        memset(p, 0xCC, EFI_PAGES_TO_SIZE(Pages));
+    }
+    return p;
+}
+
+VOID *EFIAPI AllocateReservedPages(UINTN Pages)
+{
+    return AllocatePages(Pages);
+}
+
+VOID *EFIAPI AllocateAlignedPages(UINTN Pages, UINTN Alignment)
+{
+    return aligned_alloc(MAX(Alignment, EFI_PAGE_SIZE), EFI_PAGES_TO_SIZE(Pages));
+}
+
+VOID *EFIAPI AllocateAlignedReservedPages(UINTN Pages, UINTN Alignment)
+{
+    return AllocateAlignedPages(Pages, Alignment);
+}
+
+VOID EFIAPI FreePages(VOID *Buffer, UINTN Pages)
+{
+    free(Buffer);
+}
+
+VOID EFIAPI FreeAlignedPages(VOID *Buffer, UINTN Pages)
+{
+    free(Buffer);
+}
+
+VOID *EFIAPI AllocatePool(UINTN AllocationSize)
+{
+    return malloc(AllocationSize);
+}
+
+VOID *EFIAPI AllocateZeroPool(UINTN AllocationSize)
+{
+    return calloc(1, AllocationSize);
+}
+
+VOID *EFIAPI AllocateCopyPool(UINTN AllocationSize, CONST VOID *Buffer)
+{
+    VOID *p = malloc(AllocationSize);
+    if (p != NULL)
+    {
+        memcpy(p, Buffer, AllocationSize);
+    }
+    return p;
+}
+
+VOID *EFIAPI AllocateReservedPool(UINTN AllocationSize)
+{
+    return malloc(AllocationSize);
+}
+
+VOID *EFIAPI AllocateReservedZeroPool(UINTN AllocationSize)
+{
+    return calloc(1, AllocationSize);
+}
+
+VOID EFIAPI FreePool(VOID *Buffer)
+{
+    free(Buffer);
+}
+
+//
+// PrintLib and DebugLib, the EDK2 format is translated spec by spec: %a and
+// %s both take a CHAR8 string here since the driver only prints ASCII, %r
+// prints the status code
+//
+
+UINTN EFIAPI AsciiVSPrint(CHAR8 *StartOfBuffer, UINTN BufferSize, CONST CHAR8 *FormatString, VA_LIST Marker)
+{
+    UINTN out = 0;
+    if (BufferSize == 0)
+    {
+        return 0;
+    }
+    for (CONST CHAR8 *f = FormatString; *f != 0 && out + 1 < BufferSize; f++)
+    {
+        if (*f != '%')
+        {
+            StartOfBuffer[out++] = *f;
+            continue;
+        }
+        char spec[32];
+        UINTN n = 0;
+        BOOLEAN wide = FALSE;
+        spec[n++] = '%';
+        for (f++; *f != 0 && strchr("-+ #0123456789.*", *f) != NULL && n < 20; f++)
+        {
+            spec[n++] = *f;
+        }
+        while (*f == 'l' || *f == 'L')
+        {
+            wide = TRUE;
+            f++;
+        }
+        if (*f == 0)
+        {
+            break;
+        }
+        char piece[256];
+        int precision = -1;
+        if (memchr(spec, '*', n) != NULL)
+        {
+            precision = va_arg(Marker, int);
+        }
+        switch (*f)
+        {
+        case 'a':
+        case 's':
+            spec[n++] = 's';
+            spec[n] = 0;
+            if (precision >= 0)
+                snprintf(piece, sizeof(piece), spec, precision, va_arg(Marker, const char *));
+            else
+                snprintf(piece, sizeof(piece), spec, va_arg(Marker, const char *));
+            break;
+        case 'r':
+            snprintf(piece, sizeof(piece), "status 0x%llx", (unsigned long long)va_arg(Marker, UINTN));
+            break;
+        case 'p':
+            snprintf(piece, sizeof(piece), "%p", va_arg(Marker, VOID *));
+            break;
+        case 'c':
+            snprintf(piece, sizeof(piece), "%c", (char)va_arg(Marker, int));
+            break;
+        case 'd':
+        case 'u':
+        case 'x':
+        case 'X':
+            if (wide)
+            {
+                spec[n++] = 'l';
+                spec[n++] = 'l';
+            }
+            spec[n++] = *f;
+            spec[n] = 0;
+            if (wide)
+                snprintf(piece, sizeof(piece), spec, va_arg(Marker, long long));
+            else
+                snprintf(piece, sizeof(piece), spec, va_arg(Marker, int));
+            break;
+        case '%':
+            strcpy(piece, "%");
+            break;
+        default:
+            snprintf(piece, sizeof(piece), "%%%c", *f);
+            break;
+        }
+        for (const char *p = piece; *p != 0 && out + 1 < BufferSize; p++)
+        {
+            StartOfBuffer[out++] = *p;
+        }
+    }
+    StartOfBuffer[out] = 0;
+    return out;
+}
+
+UINTN EFIAPI AsciiSPrint(CHAR8 *StartOfBuffer, UINTN BufferSize, CONST CHAR8 *FormatString, ...)
+{
+    VA_LIST Marker;
+    VA_START(Marker, FormatString);
+    UINTN n = AsciiVSPrint(StartOfBuffer, BufferSize, FormatString, Marker);
+    VA_END(Marker);
+    return n;
+}
+
+STATIC CHAR8 g_debug_output[0x40000];
+STATIC UINTN g_debug_length = 0;
+
+CONST CHAR8 *HostDebugOutput(VOID)
+{
+    return g_debug_output;
+}
+
+VOID HostClearDebugOutput(VOID)
+{
+    g_debug_length = 0;
+    g_debug_output[0] = '\0';
+}
+
+// kept for HostDebugOutput, and quiet unless I915_HOST_VERBOSE is set, the
+// tests only print failed checks
+VOID EFIAPI DebugPrint(UINTN ErrorLevel, CONST CHAR8 *Format, ...)
+{
+    STATIC int verbose = -1;
+    if (verbose < 0)
+    {
+        verbose = getenv("I915_HOST_VERBOSE") != NULL;
+    }
+    CHAR8 line[1024];
+    VA_LIST Marker;
+    VA_START(Marker, Format);
+    UINTN length = AsciiVSPrint(line, sizeof(line), Format, Marker);
+    VA_END(Marker);
+    if (g_debug_length + length < sizeof(g_debug_output))
+    {
+        memcpy(g_debug_output + g_debug_length, line, length + 1);
+        g_debug_length += length;
+    }
+    if (verbose)
+    {
+        fputs(line, stderr);
+    }
+}
+
+//
+// FrameBufferBltLib, the tests check registers and never look at pixels
+//
+
+RETURN_STATUS EFIAPI FrameBufferBltConfigure(VOID *FrameBuffer, EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *FrameBufferInfo,
+                                             FRAME_BUFFER_CONFIGURE *Configure, UINTN *ConfigureSize)
+{
+    if (Configure == NULL || *ConfigureSize < sizeof(UINT64))
+    {
+        *ConfigureSize = sizeof(UINT64);
+        return RETURN_BUFFER_TOO_SMALL;
+    }
+    return RETURN_SUCCESS;
+}
+
+RETURN_STATUS EFIAPI FrameBufferBlt(FRAME_BUFFER_CONFIGURE *Configure, EFI_GRAPHICS_OUTPUT_BLT_PIXEL *BltBuffer,
+                                    EFI_GRAPHICS_OUTPUT_BLT_OPERATION BltOperation, UINTN SourceX, UINTN SourceY,
+                                    UINTN DestinationX, UINTN DestinationY, UINTN Width, UINTN Height,
+                                    UINTN Delta)
+{
+    return RETURN_SUCCESS;
+}
+
+//
+// boot services
+//
+
+#define HOST_MAX_EVENTS 32
+#define HOST_MAX_TABLES 16
+#define HOST_MAX_VARIABLES 8
+
+typedef struct
+{
+    BOOLEAN Used;
+    UINT32 Type;
+    BOOLEAN ReadyToBoot;
+    EFI_EVENT_NOTIFY Notify;
+    VOID *Context;
+} HOST_EVENT;
+
+typedef struct
+{
+    EFI_GUID Guid;
+    VOID *Table;
+} HOST_TABLE;
+
+typedef struct
+{
+    CHAR16 Name[64];
+    EFI_GUID Guid;
+    UINT32 Attributes;
+    UINTN Size;
+    UINT8 *Data;
+} HOST_VARIABLE;
+
+STATIC EFI_TPL g_tpl = TPL_APPLICATION;
+STATIC HOST_EVENT g_events[HOST_MAX_EVENTS];
+STATIC HOST_TABLE g_tables[HOST_MAX_TABLES];
+STATIC HOST_VARIABLE g_variables[HOST_MAX_VARIABLES];
+STATIC UINTN g_variable_writes = 0;
+
+STATIC EFI_TPL EFIAPI HostRaiseTPL(EFI_TPL NewTpl)
+{
+    EFI_TPL old = g_tpl;
+    g_tpl = NewTpl;
+    return old;
+}
+
+STATIC VOID EFIAPI HostRestoreTPL(EFI_TPL OldTpl)
+{
+    g_tpl = OldTpl;
+}
+
+STATIC HOST_EVENT *HostNewEvent(UINT32 Type, EFI_EVENT_NOTIFY Notify, VOID *Context)
+{
+    for (UINTN i = 0; i < HOST_MAX_EVENTS; i++)
+    {
+        if (!g_events[i].Used)
+        {
+            g_events[i] = (HOST_EVENT){TRUE, Type, FALSE, Notify, Context};
+            return &g_events[i];
+        }
+    }
+    return NULL;
+}
+
+STATIC EFI_STATUS EFIAPI HostCreateEvent(UINT32 Type, EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction,
+                                         VOID *NotifyContext, EFI_EVENT *Event)
+{
+    HOST_EVENT *e = HostNewEvent(Type, NotifyFunction, NotifyContext);
+    if (e == NULL)
+    {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    *Event = e;
+    return EFI_SUCCESS;
+}
+
+// timers never fire on the host, a test calls the flush paths itself
+STATIC EFI_STATUS EFIAPI HostSetTimer(EFI_EVENT Event, EFI_TIMER_DELAY Type, UINT64 TriggerTime)
+{
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostSignalEvent(EFI_EVENT Event)
+{
+    HOST_EVENT *e = Event;
+    if (e->Notify != NULL)
+    {
+        e->Notify(Event, e->Context);
+    }
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostCloseEvent(EFI_EVENT Event)
+{
+    ((HOST_EVENT *)Event)->Used = FALSE;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostInstallProtocolInterface(EFI_HANDLE *Handle, EFI_GUID *Protocol,
+                                                      EFI_INTERFACE_TYPE InterfaceType, VOID *Interface)
+{
+    if (*Handle == NULL)
+    {
+        *Handle = calloc(1, 8);
+    }
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostUninstallProtocolInterface(EFI_HANDLE Handle, EFI_GUID *Protocol, VOID *Interface)
+{
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostStall(UINTN Microseconds)
+{
+    g_now_ns += (UINT64)Microseconds * 1000;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostInstallConfigurationTable(EFI_GUID *Guid, VOID *Table)
+{
+    HOST_TABLE *free_slot = NULL;
+    for (UINTN i = 0; i < HOST_MAX_TABLES; i++)
+    {
+        if (g_tables[i].Table != NULL && CompareGuid(&g_tables[i].Guid, Guid))
+        {
+            g_tables[i].Table = Table;
+            return EFI_SUCCESS;
+        }
+        if (g_tables[i].Table == NULL && free_slot == NULL)
+        {
+            free_slot = &g_tables[i];
+        }
+    }
+    if (Table == NULL)
+    {
+        return EFI_NOT_FOUND;
+    }
+    if (free_slot == NULL)
+    {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    free_slot->Guid = *Guid;
+    free_slot->Table = Table;
+    return EFI_SUCCESS;
+}
+
+STATIC VOID EFIAPI HostBsCopyMem(VOID *Destination, VOID *Source, UINTN Length)
+{
+    memmove(Destination, Source, Length);
+}
+
+STATIC VOID EFIAPI HostBsSetMem(VOID *Buffer, UINTN Size, UINT8 Value)
+{
+    memset(Buffer, Value, Size);
+}
+
+STATIC EFI_BOOT_SERVICES g_host_bs = {
+    .RaiseTPL = HostRaiseTPL,
+    .RestoreTPL = HostRestoreTPL,
+    .CreateEvent = HostCreateEvent,
+    .SetTimer = HostSetTimer,
+    .SignalEvent = HostSignalEvent,
+    .CloseEvent = HostCloseEvent,
+    .InstallProtocolInterface = HostInstallProtocolInterface,
+    .UninstallProtocolInterface = HostUninstallProtocolInterface,
+    .Stall = HostStall,
+    .InstallConfigurationTable = HostInstallConfigurationTable,
+    .CopyMem = HostBsCopyMem,
+    .SetMem = HostBsSetMem,
+};
+
+EFI_BOOT_SERVICES *gBS = &g_host_bs;
+
+EFI_STATUS EFIAPI EfiCreateEventReadyToBootEx(EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction,
+                                              VOID *NotifyContext, EFI_EVENT *ReadyToBootEvent)
+{
+    HOST_EVENT *e = HostNewEvent(EVT_NOTIFY_SIGNAL, NotifyFunction, NotifyContext);
+    if (e == NULL)
+    {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    e->ReadyToBoot = TRUE;
+    *ReadyToBootEvent = e;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI EfiGetSystemConfigurationTable(EFI_GUID *TableGuid, VOID **Table)
+{
+    *Table = HostGetConfigurationTable(TableGuid);
+    return *Table != NULL ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
+
+VOID HostSignalReadyToBoot(VOID)
+{
+    for (UINTN i = 0; i < HOST_MAX_EVENTS; i++)
+    {
+        if (g_events[i].Used && g_events[i].ReadyToBoot)
+        {
+            HostSignalEvent(&g_events[i]);
+        }
+    }
+}
+
+VOID *HostGetConfigurationTable(CONST EFI_GUID *Guid)
+{
+    for (UINTN i = 0; i < HOST_MAX_TABLES; i++)
+    {
+        if (g_tables[i].Table != NULL && CompareGuid(&g_tables[i].Guid, Guid))
+        {
+            return g_tables[i].Table;
+        }
+    }
+    return NULL;
+}
+
+//
+// runtime services, a volatile variable store that counts writes
+//
+
+STATIC HOST_VARIABLE *HostFindVariable(CONST CHAR16 *Name, CONST EFI_GUID *Guid)
+{
+    for (UINTN i = 0; i < HOST_MAX_VARIABLES; i++)
+    {
+        if (g_variables[i].Data != NULL && CompareGuid(&g_variables[i].Guid, Guid) &&
+            memcmp(g_variables[i].Name, Name, (StrLen(Name) + 1) * sizeof(CHAR16)) == 0)
+        {
+            return &g_variables[i];
+        }
+    }
+    return NULL;
+}
+
+STATIC EFI_STATUS EFIAPI HostGetVariable(CHAR16 *VariableName, EFI_GUID *VendorGuid, UINT32 *Attributes,
+                                         UINTN *DataSize, VOID *Data)
+{
+    HOST_VARIABLE *v = HostFindVariable(VariableName, VendorGuid);
+    if (v == NULL)
+    {
+        return EFI_NOT_FOUND;
+    }
+    if (Attributes != NULL)
+    {
+        *Attributes = v->Attributes;
+    }
+    if (*DataSize < v->Size)
+    {
+        *DataSize = v->Size;
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    memcpy(Data, v->Data, v->Size);
+    *DataSize = v->Size;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI HostSetVariable(CHAR16 *VariableName, EFI_GUID *VendorGuid, UINT32 Attributes,
+                                         UINTN DataSize, VOID *Data)
+{
+    HOST_VARIABLE *v = HostFindVariable(VariableName, VendorGuid);
+    UINTN len = StrLen(VariableName);
+    if (len >= ARRAY_SIZE(v->Name))
+    {
+        return EFI_INVALID_PARAMETER;
+    }
+    g_variable_writes++;
+    if (v != NULL)
+    {
+        free(v->Data);
+        v->Data = NULL;
+    }
+    if (DataSize == 0)
+    {
+        return v != NULL ? EFI_SUCCESS : EFI_NOT_FOUND;
+    }
+    for (UINTN i = 0; v == NULL && i < HOST_MAX_VARIABLES; i++)
+    {
+        if (g_variables[i].Data == NULL)
+        {
+            v = &g_variables[i];
+        }
+    }
+    if (v == NULL)
+    {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    memcpy(v->Name, VariableName, (len + 1) * sizeof(CHAR16));
+    v->Guid = *VendorGuid;
+    v->Attributes = Attributes;
+    v->Size = DataSize;
+    v->Data = malloc(DataSize);
+    memcpy(v->Data, Data, DataSize);
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_RUNTIME_SERVICES g_host_rt = {
+    .GetVariable = HostGetVariable,
+    .SetVariable = HostSetVariable,
+};
+
+EFI_RUNTIME_SERVICES *gRT = &g_host_rt;
+
+STATIC EFI_SYSTEM_TABLE g_host_st = {
+    .BootServices = &g_host_bs,
+    .RuntimeServices = &g_host_rt,
+};
+
+EFI_SYSTEM_TABLE *gST = &g_host_st;
+EFI_HANDLE gImageHandle = NULL;
+
+UINTN HostVariableWrites(VOID)
+{
+    return g_variable_writes;
+}
+
+VOID HostReset(VOID)
+{
+    g_now_ns = 0;
+    g_tpl = TPL_APPLICATION;
+    memset(g_events, 0, sizeof(g_events));
+    memset(g_tables, 0, sizeof(g_tables));
+    for (UINTN i = 0; i < HOST_MAX_VARIABLES; i++)
+    {
+        free(g_variables[i].Data);
+    }
+    memset(g_variables, 0, sizeof(g_variables));
+    g_variable_writes = 0;
+    HostClearDebugOutput();
+}
@@ -0,0 +1,64 @@
+// Helpers the host tests use to drive the fake firmware in host.c: a virtual
+// clock, the configuration tables and variables the driver published, and a
+// tiny check macro. Everything else the driver calls is implemented in host.c
+// with the EDK2 signature from the shim headers.
+#ifndef HOST_H
+#define HOST_H
+#include <Uefi.h>
+#include <stdio.h>
+
+// resets the clock, the variable store, the installed tables and the events
+VOID HostReset(VOID);
+
+// the virtual clock every Stall and CpuPause advances, in nanoseconds
+UINT64 HostNowNs(VOID);
+VOID HostSetNowNs(UINT64 ns);
+
+// the ACPI PM timer GetPerformanceCounter models, a 24 bit up counter
+#define HOST_PM_TIMER_HZ 3579545ull
+#define HOST_PM_TIMER_MASK 0xFFFFFFull
+// GetPerformanceCounter calls so far, each one a VM exit on real OVMF
+UINTN HostPerformanceCounterReads(VOID);
+
+VOID *HostGetConfigurationTable(CONST EFI_GUID *Guid);
+UINTN HostVariableWrites(VOID);
+VOID HostSignalReadyToBoot(VOID);
+
+// everything DebugPrint wrote since the last reset or clear
+CONST CHAR8 *HostDebugOutput(VOID);
+VOID HostClearDebugOutput(VOID);
+// Hook runs once, inside the next InterlockedCompareExchange32 and before the
+// exchange, as an event callback interrupting the caller there would.
+VOID HostSetCompareExchangeHook(VOID (*Hook)(VOID));
+
+extern int g_host_failures;
+
+#define HOST_CHECK(cond)                                                      \
+    do                                                                        \
+    {                                                                         \
+        if (!(cond))                                                          \
+        {                                                                     \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                   \
+            g_host_failures++;                                                \
+        }                                                                     \
+    } while (0)
+
+#define HOST_CHECK_EQ(a, b)                                                   \
+    do                                                                        \
+    {                                                                         \
+        UINT64 host_a_ = (UINT64)(a), host_b_ = (UINT64)(b);                  \
+        if (host_a_ != host_b_)                                               \
+        {                                                                     \
+            fprintf(stderr, "%s:%d: %s is 0x%llx, expected 0x%llx\n",         \
+                    __FILE__, __LINE__, #a, (unsigned long long)host_a_,      \
+                    (unsigned long long)host_b_);                             \
+            g_host_failures++;                                                \
+        }                                                                     \
+    } while (0)
+
+// what every test main returns
+#define HOST_RESULT(name)                                                     \
+    (fprintf(stderr, "%s: %s\n", name, g_host_failures ? "FAIL" : "ok"),      \
+     g_host_failures ? 1 : 0)
+#endif
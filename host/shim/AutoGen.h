@@ -0,0 +1,13 @@
+// What the EDK2 build generates for the driver and force-includes into every
+// source: the GUIDs the .inf lists.
+#ifndef HOST_AUTOGEN_H
+#define HOST_AUTOGEN_H
+#include <Uefi.h>
+
+extern EFI_GUID gI915OvmfGuid;
+extern EFI_GUID gI915ProfileTableGuid;
+extern EFI_GUID gI915LogRingGuid;
+extern EFI_GUID gI915MmioTraceGuid;
+extern EFI_GUID gI915CacheVariableGuid;
+extern EFI_GUID gI915HandoffTableGuid;
+#endif
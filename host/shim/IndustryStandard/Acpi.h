@@ -0,0 +1,35 @@
+#ifndef HOST_INDUSTRY_STANDARD_ACPI_H
+#define HOST_INDUSTRY_STANDARD_ACPI_H
+#include <Uefi.h>
+
+#pragma pack(1)
+typedef struct
+{
+    UINT32 Signature;
+    UINT32 Length;
+    UINT8 Revision;
+    UINT8 Checksum;
+    UINT8 OemId[6];
+    UINT64 OemTableId;
+    UINT32 OemRevision;
+    UINT32 CreatorId;
+    UINT32 CreatorRevision;
+} EFI_ACPI_DESCRIPTION_HEADER;
+
+typedef struct
+{
+    UINT8 Desc;
+    UINT16 Len;
+    UINT8 ResType;
+    UINT8 GenFlag;
+    UINT8 SpecificFlag;
+    UINT64 AddrSpaceGranularity;
+    UINT64 AddrRangeMin;
+    UINT64 AddrRangeMax;
+    UINT64 AddrTranslationOffset;
+    UINT64 AddrLen;
+} EFI_ACPI_ADDRESS_SPACE_DESCRIPTOR;
+#pragma pack()
+
+#define ACPI_ADDRESS_SPACE_TYPE_MEM 0x00
+#endif
@@ -0,0 +1,53 @@
+#ifndef HOST_INDUSTRY_STANDARD_PCI_H
+#define HOST_INDUSTRY_STANDARD_PCI_H
+#include <Uefi.h>
+
+#define PCI_VENDOR_ID_OFFSET 0x00
+#define PCI_CLASSCODE_OFFSET 0x09
+#define PCI_BASE_ADDRESSREG_OFFSET 0x10
+#define PCI_CLASS_DISPLAY 0x03
+#define PCI_CLASS_DISPLAY_VGA 0x00
+#define PCI_BAR_IDX0 0x00
+#define PCI_BAR_IDX1 0x01
+#define PCI_BAR_IDX2 0x02
+
+#pragma pack(1)
+typedef struct
+{
+    UINT16 VendorId;
+    UINT16 DeviceId;
+    UINT16 Command;
+    UINT16 Status;
+    UINT8 RevisionID;
+    UINT8 ClassCode[3];
+    UINT8 CacheLineSize;
+    UINT8 LatencyTimer;
+    UINT8 HeaderType;
+    UINT8 BIST;
+} PCI_DEVICE_INDEPENDENT_REGION;
+
+typedef struct
+{
+    UINT32 Bar[6];
+    UINT32 CISPtr;
+    UINT16 SubsystemVendorID;
+    UINT16 SubsystemID;
+    UINT32 ExpansionRomBar;
+    UINT8 CapabilityPtr;
+    UINT8 Reserved1[3];
+    UINT32 Reserved2;
+    UINT8 InterruptLine;
+    UINT8 InterruptPin;
+    UINT8 MinGnt;
+    UINT8 MaxLat;
+} PCI_DEVICE_HEADER_TYPE_REGION;
+
+typedef struct
+{
+    PCI_DEVICE_INDEPENDENT_REGION Hdr;
+    PCI_DEVICE_HEADER_TYPE_REGION Device;
+} PCI_TYPE00;
+#pragma pack()
+
+#define IS_PCI_DISPLAY(_p) ((_p)->Hdr.ClassCode[2] == PCI_CLASS_DISPLAY)
+#endif
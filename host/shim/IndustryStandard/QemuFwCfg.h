@@ -0,0 +1,10 @@
+#ifndef HOST_QEMU_FW_CFG_H
+#define HOST_QEMU_FW_CFG_H
+#include <Uefi.h>
+
+typedef UINT16 FIRMWARE_CONFIG_ITEM;
+
+#define QemuFwCfgItemSignature 0x0000
+#define QemuFwCfgItemInterfaceVersion 0x0001
+#define QemuFwCfgItemFileDir 0x0019
+#endif
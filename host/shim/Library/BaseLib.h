@@ -0,0 +1,30 @@
+#ifndef HOST_BASE_LIB_H
+#define HOST_BASE_LIB_H
+#include <Uefi.h>
+
+VOID EFIAPI CpuPause(VOID);
+VOID EFIAPI MemoryFence(VOID);
+VOID EFIAPI AsmWbinvd(VOID);
+UINT64 EFIAPI AsmReadTsc(VOID);
+UINT32 EFIAPI AsmCpuid(UINT32 Index, UINT32 *Eax, UINT32 *Ebx, UINT32 *Ecx, UINT32 *Edx);
+UINT32 EFIAPI AsmCpuidEx(UINT32 Index, UINT32 SubIndex, UINT32 *Eax, UINT32 *Ebx, UINT32 *Ecx, UINT32 *Edx);
+UINT64 EFIAPI AsmReadMsr64(UINT32 Index);
+UINT64 EFIAPI AsmWriteMsr64(UINT32 Index, UINT64 Value);
+UINT64 EFIAPI LShiftU64(UINT64 Operand, UINTN Count);
+UINT64 EFIAPI RShiftU64(UINT64 Operand, UINTN Count);
+UINT64 EFIAPI MultU64x32(UINT64 Multiplicand, UINT32 Multiplier);
+UINT64 EFIAPI MultU64x64(UINT64 Multiplicand, UINT64 Multiplier);
+UINT64 EFIAPI DivU64x32(UINT64 Dividend, UINT32 Divisor);
+UINT64 EFIAPI DivU64x32Remainder(UINT64 Dividend, UINT32 Divisor, UINT32 *Remainder);
+UINT64 EFIAPI DivU64x64Remainder(UINT64 Dividend, UINT64 Divisor, UINT64 *Remainder);
+INTN EFIAPI HighBitSet32(UINT32 Operand);
+INTN EFIAPI HighBitSet64(UINT64 Operand);
+INTN EFIAPI LowBitSet32(UINT32 Operand);
+UINTN EFIAPI StrLen(CONST CHAR16 *String);
+UINTN EFIAPI AsciiStrLen(CONST CHAR8 *String);
+INTN EFIAPI AsciiStrCmp(CONST CHAR8 *FirstString, CONST CHAR8 *SecondString);
+RETURN_STATUS EFIAPI AsciiStrnCpyS(CHAR8 *Destination, UINTN DestMax, CONST CHAR8 *Source, UINTN Length);
+UINT8 EFIAPI CalculateSum8(CONST UINT8 *Buffer, UINTN Length);
+UINT8 EFIAPI CalculateCheckSum8(CONST UINT8 *Buffer, UINTN Length);
+UINT32 EFIAPI CalculateCrc32(VOID *Buffer, UINTN Length);
+#endif
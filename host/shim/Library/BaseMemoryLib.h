@@ -0,0 +1,12 @@
+#ifndef HOST_BASE_MEMORY_LIB_H
+#define HOST_BASE_MEMORY_LIB_H
+#include <Uefi.h>
+
+VOID *EFIAPI CopyMem(VOID *DestinationBuffer, CONST VOID *SourceBuffer, UINTN Length);
+VOID *EFIAPI SetMem(VOID *Buffer, UINTN Length, UINT8 Value);
+VOID *EFIAPI SetMem32(VOID *Buffer, UINTN Length, UINT32 Value);
+VOID *EFIAPI SetMem64(VOID *Buffer, UINTN Length, UINT64 Value);
+VOID *EFIAPI ZeroMem(VOID *Buffer, UINTN Length);
+INTN EFIAPI CompareMem(CONST VOID *DestinationBuffer, CONST VOID *SourceBuffer, UINTN Length);
+BOOLEAN EFIAPI CompareGuid(CONST GUID *Guid1, CONST GUID *Guid2);
+#endif
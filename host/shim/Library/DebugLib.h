@@ -0,0 +1,9 @@
+#ifndef HOST_DEBUG_LIB_H
+#define HOST_DEBUG_LIB_H
+#include <Uefi.h>
+
+VOID EFIAPI DebugPrint(UINTN ErrorLevel, CONST CHAR8 *Format, ...);
+#define ASSERT(Expression)
+#define ASSERT_EFI_ERROR(StatusParameter)
+#define DEBUG(Expression)
+#endif
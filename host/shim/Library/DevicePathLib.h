@@ -0,0 +1,11 @@
+#ifndef HOST_DEVICE_PATH_LIB_H
+#define HOST_DEVICE_PATH_LIB_H
+#include <Protocol/DevicePath.h>
+
+EFI_DEVICE_PATH_PROTOCOL *EFIAPI AppendDevicePathNode(CONST EFI_DEVICE_PATH_PROTOCOL *DevicePath,
+                                                      CONST EFI_DEVICE_PATH_PROTOCOL *DevicePathNode);
+EFI_DEVICE_PATH_PROTOCOL *EFIAPI DuplicateDevicePath(CONST EFI_DEVICE_PATH_PROTOCOL *DevicePath);
+UINT16 EFIAPI SetDevicePathNodeLength(VOID *Node, UINTN Length);
+BOOLEAN EFIAPI IsDevicePathEnd(CONST VOID *Node);
+UINTN EFIAPI DevicePathNodeLength(CONST VOID *Node);
+#endif
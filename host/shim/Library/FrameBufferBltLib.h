@@ -0,0 +1,13 @@
+#ifndef HOST_FRAME_BUFFER_BLT_LIB_H
+#define HOST_FRAME_BUFFER_BLT_LIB_H
+#include <Protocol/GraphicsOutput.h>
+
+typedef struct FRAME_BUFFER_CONFIGURE FRAME_BUFFER_CONFIGURE;
+
+RETURN_STATUS EFIAPI FrameBufferBltConfigure(VOID *FrameBuffer, EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *FrameBufferInfo,
+                                             FRAME_BUFFER_CONFIGURE *Configure, UINTN *ConfigureSize);
+RETURN_STATUS EFIAPI FrameBufferBlt(FRAME_BUFFER_CONFIGURE *Configure, EFI_GRAPHICS_OUTPUT_BLT_PIXEL *BltBuffer,
+                                    EFI_GRAPHICS_OUTPUT_BLT_OPERATION BltOperation, UINTN SourceX, UINTN SourceY,
+                                    UINTN DestinationX, UINTN DestinationY, UINTN Width, UINTN Height,
+                                    UINTN Delta);
+#endif
@@ -0,0 +1,17 @@
+#ifndef HOST_MEMORY_ALLOCATION_LIB_H
+#define HOST_MEMORY_ALLOCATION_LIB_H
+#include <Uefi.h>
+
+VOID *EFIAPI AllocatePages(UINTN Pages);
+VOID *EFIAPI AllocateReservedPages(UINTN Pages);
+VOID *EFIAPI AllocateAlignedPages(UINTN Pages, UINTN Alignment);
+VOID *EFIAPI AllocateAlignedReservedPages(UINTN Pages, UINTN Alignment);
+VOID EFIAPI FreePages(VOID *Buffer, UINTN Pages);
+VOID EFIAPI FreeAlignedPages(VOID *Buffer, UINTN Pages);
+VOID *EFIAPI AllocatePool(UINTN AllocationSize);
+VOID *EFIAPI AllocateZeroPool(UINTN AllocationSize);
+VOID *EFIAPI AllocateCopyPool(UINTN AllocationSize, CONST VOID *Buffer);
+VOID *EFIAPI AllocateReservedPool(UINTN AllocationSize);
+VOID *EFIAPI AllocateReservedZeroPool(UINTN AllocationSize);
+VOID EFIAPI FreePool(VOID *Buffer);
+#endif
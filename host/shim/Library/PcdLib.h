@@ -0,0 +1,12 @@
+#ifndef HOST_PCD_LIB_H
+#define HOST_PCD_LIB_H
+#include <Uefi.h>
+
+//every PCD reads as its zero default on the host
+#define PcdGet8(TokenName) ((UINT8)0)
+#define PcdGet16(TokenName) ((UINT16)0)
+#define PcdGet32(TokenName) ((UINT32)0)
+#define PcdGet64(TokenName) ((UINT64)0)
+#define PcdGetBool(TokenName) FALSE
+#define FixedPcdGet32(TokenName) ((UINT32)0)
+#endif
@@ -0,0 +1,7 @@
+#ifndef HOST_PRINT_LIB_H
+#define HOST_PRINT_LIB_H
+#include <Uefi.h>
+
+UINTN EFIAPI AsciiSPrint(CHAR8 *StartOfBuffer, UINTN BufferSize, CONST CHAR8 *FormatString, ...);
+UINTN EFIAPI AsciiVSPrint(CHAR8 *StartOfBuffer, UINTN BufferSize, CONST CHAR8 *FormatString, VA_LIST Marker);
+#endif
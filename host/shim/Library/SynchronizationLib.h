@@ -0,0 +1,6 @@
+#ifndef HOST_SYNCHRONIZATION_LIB_H
+#define HOST_SYNCHRONIZATION_LIB_H
+#include <Uefi.h>
+
+UINT32 EFIAPI InterlockedCompareExchange32(volatile UINT32 *Value, UINT32 CompareValue, UINT32 ExchangeValue);
+#endif
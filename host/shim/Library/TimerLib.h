@@ -0,0 +1,10 @@
+#ifndef HOST_TIMER_LIB_H
+#define HOST_TIMER_LIB_H
+#include <Uefi.h>
+
+UINTN EFIAPI MicroSecondDelay(UINTN MicroSeconds);
+UINTN EFIAPI NanoSecondDelay(UINTN NanoSeconds);
+UINT64 EFIAPI GetPerformanceCounter(VOID);
+UINT64 EFIAPI GetPerformanceCounterProperties(UINT64 *StartValue, UINT64 *EndValue);
+UINT64 EFIAPI GetTimeInNanoSecond(UINT64 Ticks);
+#endif
@@ -0,0 +1,4 @@
+#ifndef HOST_UEFI_DRIVER_ENTRY_POINT_H
+#define HOST_UEFI_DRIVER_ENTRY_POINT_H
+#include <Uefi.h>
+#endif
@@ -0,0 +1,8 @@
+#ifndef HOST_UEFI_LIB_H
+#define HOST_UEFI_LIB_H
+#include <Uefi.h>
+
+EFI_STATUS EFIAPI EfiCreateEventReadyToBootEx(EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction,
+                                              VOID *NotifyContext, EFI_EVENT *ReadyToBootEvent);
+EFI_STATUS EFIAPI EfiGetSystemConfigurationTable(EFI_GUID *TableGuid, VOID **Table);
+#endif
@@ -0,0 +1,6 @@
+#ifndef HOST_UEFI_RUNTIME_SERVICES_TABLE_LIB_H
+#define HOST_UEFI_RUNTIME_SERVICES_TABLE_LIB_H
+#include <Uefi.h>
+
+extern EFI_RUNTIME_SERVICES *gRT;
+#endif
@@ -0,0 +1,39 @@
+#ifndef HOST_PROTOCOL_DEVICE_PATH_H
+#define HOST_PROTOCOL_DEVICE_PATH_H
+#include <Uefi.h>
+
+#pragma pack(1)
+typedef struct
+{
+    UINT8 Type;
+    UINT8 SubType;
+    UINT8 Length[2];
+} EFI_DEVICE_PATH_PROTOCOL;
+
+typedef struct
+{
+    EFI_DEVICE_PATH_PROTOCOL Header;
+    UINT32 ADR;
+} ACPI_ADR_DEVICE_PATH;
+
+typedef union
+{
+    EFI_DEVICE_PATH_PROTOCOL DevPath;
+    ACPI_ADR_DEVICE_PATH AcpiAdr;
+} EFI_DEV_PATH;
+#pragma pack()
+
+#define END_DEVICE_PATH_TYPE 0x7F
+#define END_ENTIRE_DEVICE_PATH_SUBTYPE 0xFF
+#define ACPI_DEVICE_PATH 0x02
+#define ACPI_ADR_DP 0x03
+#define ACPI_ADR_DISPLAY_TYPE_VGA 1
+#define ACPI_ADR_DISPLAY_TYPE_EXTERNAL_DIGITAL 3
+#define ACPI_DISPLAY_ADR(_DeviceIdScheme, _HeadId, _NonVgaOutput, _BiosCanDetect, _VendorInfo, _Type, _Port, \
+                         _Index)                                                                         \
+    ((UINT32)((((_DeviceIdScheme)&0x1) << 31) | (((_HeadId)&0x7) << 18) | (((_NonVgaOutput)&0x1) << 17) |   \
+              (((_BiosCanDetect)&0x1) << 16) | (((_VendorInfo)&0xf) << 12) | (((_Type)&0xf) << 8) |         \
+              (((_Port)&0xf) << 4) | ((_Index)&0xf)))
+
+extern EFI_GUID gEfiDevicePathProtocolGuid;
+#endif
@@ -0,0 +1,10 @@
+#ifndef HOST_PROTOCOL_DRIVER_SUPPORTED_EFI_VERSION_H
+#define HOST_PROTOCOL_DRIVER_SUPPORTED_EFI_VERSION_H
+#include <Uefi.h>
+
+typedef struct
+{
+    UINT32 Length;
+    UINT32 FirmwareVersion;
+} EFI_DRIVER_SUPPORTED_EFI_VERSION_PROTOCOL;
+#endif
@@ -0,0 +1,78 @@
+#ifndef HOST_PROTOCOL_PCI_IO_H
+#define HOST_PROTOCOL_PCI_IO_H
+#include <Uefi.h>
+
+#define EFI_PCI_IO_PASS_THROUGH_BAR 0xff
+#define EFI_PCI_IO_ATTRIBUTE_IO 0x0001
+#define EFI_PCI_IO_ATTRIBUTE_MEMORY 0x0002
+#define EFI_PCI_IO_ATTRIBUTE_BUS_MASTER 0x0004
+#define EFI_PCI_IO_ATTRIBUTE_VGA_MEMORY 0x0020
+#define EFI_PCI_IO_ATTRIBUTE_VGA_IO 0x0100
+#define EFI_PCI_DEVICE_ENABLE \
+    (EFI_PCI_IO_ATTRIBUTE_IO | EFI_PCI_IO_ATTRIBUTE_MEMORY | EFI_PCI_IO_ATTRIBUTE_BUS_MASTER)
+
+typedef enum
+{
+    EfiPciIoWidthUint8,
+    EfiPciIoWidthUint16,
+    EfiPciIoWidthUint32,
+    EfiPciIoWidthUint64,
+    EfiPciIoWidthFifoUint8,
+    EfiPciIoWidthFifoUint16,
+    EfiPciIoWidthFifoUint32,
+    EfiPciIoWidthFifoUint64,
+    EfiPciIoWidthFillUint8,
+    EfiPciIoWidthFillUint16,
+    EfiPciIoWidthFillUint32,
+    EfiPciIoWidthFillUint64
+} EFI_PCI_IO_PROTOCOL_WIDTH;
+
+#define PCI_BAR_IDX0 0x00
+#define PCI_BAR_IDX1 0x01
+#define PCI_BAR_IDX2 0x02
+
+typedef enum
+{
+    EfiPciIoAttributeOperationGet,
+    EfiPciIoAttributeOperationSet,
+    EfiPciIoAttributeOperationEnable,
+    EfiPciIoAttributeOperationDisable,
+    EfiPciIoAttributeOperationSupported
+} EFI_PCI_IO_PROTOCOL_ATTRIBUTE_OPERATION;
+
+typedef struct _EFI_PCI_IO_PROTOCOL EFI_PCI_IO_PROTOCOL;
+
+typedef EFI_STATUS(EFIAPI *EFI_PCI_IO_PROTOCOL_IO_MEM)(EFI_PCI_IO_PROTOCOL *This, EFI_PCI_IO_PROTOCOL_WIDTH Width,
+                                                      UINT8 BarIndex, UINT64 Offset, UINTN Count, VOID *Buffer);
+typedef EFI_STATUS(EFIAPI *EFI_PCI_IO_PROTOCOL_CONFIG)(EFI_PCI_IO_PROTOCOL *This, EFI_PCI_IO_PROTOCOL_WIDTH Width,
+                                                      UINT32 Offset, UINTN Count, VOID *Buffer);
+
+typedef struct
+{
+    EFI_PCI_IO_PROTOCOL_IO_MEM Read;
+    EFI_PCI_IO_PROTOCOL_IO_MEM Write;
+} EFI_PCI_IO_PROTOCOL_ACCESS;
+
+typedef struct
+{
+    EFI_PCI_IO_PROTOCOL_CONFIG Read;
+    EFI_PCI_IO_PROTOCOL_CONFIG Write;
+} EFI_PCI_IO_PROTOCOL_CONFIG_ACCESS;
+
+struct _EFI_PCI_IO_PROTOCOL
+{
+    EFI_PCI_IO_PROTOCOL_ACCESS Mem;
+    EFI_PCI_IO_PROTOCOL_ACCESS Io;
+    EFI_PCI_IO_PROTOCOL_CONFIG_ACCESS Pci;
+    EFI_STATUS(EFIAPI *GetLocation)(EFI_PCI_IO_PROTOCOL *This, UINTN *Segment, UINTN *Bus, UINTN *Device,
+                                    UINTN *Function);
+    EFI_STATUS(EFIAPI *Attributes)(EFI_PCI_IO_PROTOCOL *This, EFI_PCI_IO_PROTOCOL_ATTRIBUTE_OPERATION Operation,
+                                   UINT64 Attributes, UINT64 *Result);
+    EFI_STATUS(EFIAPI *GetBarAttributes)(EFI_PCI_IO_PROTOCOL *This, UINT8 BarIndex, UINT64 *Supports,
+                                         VOID **Resources);
+    UINT64 RomSize;
+    VOID *RomImage;
+};
+
+extern EFI_GUID gEfiPciIoProtocolGuid;
+#endif
@@ -0,0 +1,250 @@
+// The slice of the UEFI headers the display code needs, for building it on a
+// Linux host. Types and calling conventions match X64 EDK2, the boot and
+// runtime service tables only have the members the driver calls.
+#ifndef HOST_UEFI_H
+#define HOST_UEFI_H
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t UINT8;
+typedef int8_t INT8;
+typedef uint16_t UINT16;
+typedef int16_t INT16;
+typedef uint32_t UINT32;
+typedef int32_t INT32;
+typedef uint64_t UINT64;
+typedef int64_t INT64;
+typedef uintptr_t UINTN;
+typedef intptr_t INTN;
+typedef unsigned char BOOLEAN;
+typedef char CHAR8;
+typedef unsigned short CHAR16;
+typedef void VOID;
+typedef UINTN EFI_STATUS;
+typedef UINTN RETURN_STATUS;
+typedef VOID *EFI_HANDLE;
+typedef VOID *EFI_EVENT;
+typedef UINTN EFI_TPL;
+typedef UINT64 EFI_PHYSICAL_ADDRESS;
+typedef UINT64 PHYSICAL_ADDRESS;
+typedef struct
+{
+    UINT32 Data1;
+    UINT16 Data2;
+    UINT16 Data3;
+    UINT8 Data4[8];
+} EFI_GUID;
+typedef EFI_GUID GUID;
+
+#define TRUE ((BOOLEAN)1)
+#define FALSE ((BOOLEAN)0)
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST const
+#define STATIC static
+#define EFIAPI
+#define PACKED
+#define GLOBAL_REMOVE_IF_UNREFERENCED
+
+#define ENCODE_ERROR(a) ((UINTN)(0x8000000000000000ULL | (a)))
+#define EFI_ERROR(a) (((INTN)(a)) < 0)
+#define RETURN_ERROR(a) EFI_ERROR(a)
+#define EFI_SUCCESS 0
+#define EFI_LOAD_ERROR ENCODE_ERROR(1)
+#define EFI_INVALID_PARAMETER ENCODE_ERROR(2)
+#define EFI_UNSUPPORTED ENCODE_ERROR(3)
+#define EFI_BAD_BUFFER_SIZE ENCODE_ERROR(4)
+#define EFI_BUFFER_TOO_SMALL ENCODE_ERROR(5)
+#define EFI_NOT_READY ENCODE_ERROR(6)
+#define EFI_DEVICE_ERROR ENCODE_ERROR(7)
+#define EFI_WRITE_PROTECTED ENCODE_ERROR(8)
+#define EFI_OUT_OF_RESOURCES ENCODE_ERROR(9)
+#define EFI_VOLUME_CORRUPTED ENCODE_ERROR(10)
+#define EFI_NOT_FOUND ENCODE_ERROR(14)
+#define EFI_ACCESS_DENIED ENCODE_ERROR(15)
+#define EFI_NO_RESPONSE ENCODE_ERROR(16)
+#define EFI_PROTOCOL_ERROR ENCODE_ERROR(17)
+#define EFI_TIMEOUT ENCODE_ERROR(18)
+#define EFI_NOT_STARTED ENCODE_ERROR(19)
+#define EFI_ALREADY_STARTED ENCODE_ERROR(20)
+#define EFI_ABORTED ENCODE_ERROR(21)
+#define EFI_CRC_ERROR ENCODE_ERROR(27)
+#define RETURN_SUCCESS EFI_SUCCESS
+#define RETURN_INVALID_PARAMETER EFI_INVALID_PARAMETER
+#define RETURN_UNSUPPORTED EFI_UNSUPPORTED
+#define RETURN_BUFFER_TOO_SMALL EFI_BUFFER_TOO_SMALL
+#define RETURN_DEVICE_ERROR EFI_DEVICE_ERROR
+#define RETURN_OUT_OF_RESOURCES EFI_OUT_OF_RESOURCES
+#define RETURN_NOT_FOUND EFI_NOT_FOUND
+#define RETURN_PROTOCOL_ERROR EFI_PROTOCOL_ERROR
+#define RETURN_TIMEOUT EFI_TIMEOUT
+#define RETURN_ABORTED EFI_ABORTED
+
+#define VA_LIST va_list
+#define VA_START(Marker, Parameter) va_start(Marker, Parameter)
+#define VA_ARG(Marker, TYPE) va_arg(Marker, TYPE)
+#define VA_END(Marker) va_end(Marker)
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define OFFSET_OF(TYPE, Field) offsetof(TYPE, Field)
+#define BASE_CR(Record, TYPE, Field) ((TYPE *)((CHAR8 *)(Record)-OFFSET_OF(TYPE, Field)))
+#define CR(Record, TYPE, Field, TestSignature) BASE_CR(Record, TYPE, Field)
+#define SIGNATURE_16(A, B) ((A) | ((B) << 8))
+#define SIGNATURE_32(A, B, C, D) (SIGNATURE_16(A, B) | (SIGNATURE_16(C, D) << 16))
+#define SIGNATURE_64(A, B, C, D, E, F, G, H) \
+    (SIGNATURE_32(A, B, C, D) | ((UINT64)(SIGNATURE_32(E, F, G, H)) << 32))
+#define ALIGN_VALUE(Value, Alignment) ((Value) + (((Alignment) - (Value)) & ((Alignment)-1)))
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define ABS(a) (((a) < 0) ? (-(a)) : (a))
+#define MAX_UINTN ((UINTN)~0)
+#define MAX_UINT32 0xFFFFFFFFu
+#define MAX_UINT64 0xFFFFFFFFFFFFFFFFULL
+#define SIZE_4KB 0x1000
+#define SIZE_1MB 0x100000
+#define SIZE_2MB 0x200000
+#define SIZE_4GB 0x100000000ULL
+#define BASE_4GB 0x100000000ULL
+#define BIT0 0x00000001u
+#define BIT1 0x00000002u
+#define BIT2 0x00000004u
+#define BIT26 0x04000000u
+#define BIT31 0x80000000u
+
+#define EFI_PAGE_SIZE 0x1000
+#define EFI_PAGE_MASK 0xFFF
+#define EFI_PAGE_SHIFT 12
+#define EFI_SIZE_TO_PAGES(a) (((a) >> EFI_PAGE_SHIFT) + (((a)&EFI_PAGE_MASK) ? 1 : 0))
+#define EFI_PAGES_TO_SIZE(a) ((a) << EFI_PAGE_SHIFT)
+
+#define TPL_APPLICATION 4
+#define TPL_CALLBACK 8
+#define TPL_NOTIFY 16
+#define TPL_HIGH_LEVEL 31
+
+#define EFI_D_ERROR 0x80000000
+#define EFI_D_INFO 0x00000040
+#define EFI_D_WARN 0x00000002
+#define EFI_D_VERBOSE 0x00400000
+#define DEBUG_ERROR EFI_D_ERROR
+#define DEBUG_INFO EFI_D_INFO
+#define DEBUG_WARN EFI_D_WARN
+#define DEBUG_VERBOSE EFI_D_VERBOSE
+
+#define EFI_MEMORY_UC 0x0000000000000001ULL
+#define EFI_MEMORY_WC 0x0000000000000002ULL
+#define EFI_MEMORY_WT 0x0000000000000004ULL
+#define EFI_MEMORY_WB 0x0000000000000008ULL
+#define EFI_MEMORY_UCE 0x0000000000000010ULL
+#define EFI_MEMORY_RUNTIME 0x8000000000000000ULL
+#define EFI_MEMORY_CACHETYPE_MASK \
+    (EFI_MEMORY_UC | EFI_MEMORY_WC | EFI_MEMORY_WT | EFI_MEMORY_WB | EFI_MEMORY_UCE)
+
+#define EVT_TIMER 0x80000000
+#define EVT_NOTIFY_WAIT 0x00000100
+#define EVT_NOTIFY_SIGNAL 0x00000200
+#define EVT_SIGNAL_EXIT_BOOT_SERVICES 0x00000201
+
+#define EFI_VARIABLE_NON_VOLATILE 0x00000001
+#define EFI_VARIABLE_BOOTSERVICE_ACCESS 0x00000002
+#define EFI_VARIABLE_RUNTIME_ACCESS 0x00000004
+
+#define EFI_OPEN_PROTOCOL_GET_PROTOCOL 0x00000002
+#define EFI_OPEN_PROTOCOL_TEST_PROTOCOL 0x00000004
+#define EFI_OPEN_PROTOCOL_BY_CHILD_CONTROLLER 0x00000008
+#define EFI_OPEN_PROTOCOL_BY_DRIVER 0x00000010
+
+typedef enum
+{
+    EFI_NATIVE_INTERFACE
+} EFI_INTERFACE_TYPE;
+
+typedef enum
+{
+    TimerCancel,
+    TimerPeriodic,
+    TimerRelative
+} EFI_TIMER_DELAY;
+
+typedef enum
+{
+    AllocateAnyPages,
+    AllocateMaxAddress,
+    AllocateAddress
+} EFI_ALLOCATE_TYPE;
+
+typedef enum
+{
+    EfiReservedMemoryType,
+    EfiLoaderCode,
+    EfiLoaderData,
+    EfiBootServicesCode,
+    EfiBootServicesData,
+    EfiRuntimeServicesCode,
+    EfiRuntimeServicesData,
+    EfiConventionalMemory,
+    EfiUnusableMemory,
+    EfiACPIReclaimMemory,
+    EfiACPIMemoryNVS,
+    EfiMemoryMappedIO
+} EFI_MEMORY_TYPE;
+
+typedef VOID(EFIAPI *EFI_EVENT_NOTIFY)(EFI_EVENT Event, VOID *Context);
+
+typedef struct
+{
+    UINT64 Signature;
+    UINT32 Revision;
+    UINT32 HeaderSize;
+    UINT32 CRC32;
+    UINT32 Reserved;
+} EFI_TABLE_HEADER;
+
+typedef struct
+{
+    EFI_TABLE_HEADER Hdr;
+    EFI_TPL(EFIAPI *RaiseTPL)(EFI_TPL NewTpl);
+    VOID(EFIAPI *RestoreTPL)(EFI_TPL OldTpl);
+    EFI_STATUS(EFIAPI *AllocatePages)(EFI_ALLOCATE_TYPE Type, EFI_MEMORY_TYPE MemoryType, UINTN Pages,
+                                      EFI_PHYSICAL_ADDRESS *Memory);
+    EFI_STATUS(EFIAPI *FreePages)(EFI_PHYSICAL_ADDRESS Memory, UINTN Pages);
+    EFI_STATUS(EFIAPI *AllocatePool)(EFI_MEMORY_TYPE PoolType, UINTN Size, VOID **Buffer);
+    EFI_STATUS(EFIAPI *FreePool)(VOID *Buffer);
+    EFI_STATUS(EFIAPI *CreateEvent)(UINT32 Type, EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction,
+                                    VOID *NotifyContext, EFI_EVENT *Event);
+    EFI_STATUS(EFIAPI *SetTimer)(EFI_EVENT Event, EFI_TIMER_DELAY Type, UINT64 TriggerTime);
+    EFI_STATUS(EFIAPI *SignalEvent)(EFI_EVENT Event);
+    EFI_STATUS(EFIAPI *CloseEvent)(EFI_EVENT Event);
+    EFI_STATUS(EFIAPI *InstallProtocolInterface)(EFI_HANDLE *Handle, EFI_GUID *Protocol,
+                                                 EFI_INTERFACE_TYPE InterfaceType, VOID *Interface);
+    EFI_STATUS(EFIAPI *UninstallProtocolInterface)(EFI_HANDLE Handle, EFI_GUID *Protocol, VOID *Interface);
+    EFI_STATUS(EFIAPI *Stall)(UINTN Microseconds);
+    EFI_STATUS(EFIAPI *InstallConfigurationTable)(EFI_GUID *Guid, VOID *Table);
+    VOID(EFIAPI *CopyMem)(VOID *Destination, VOID *Source, UINTN Length);
+    VOID(EFIAPI *SetMem)(VOID *Buffer, UINTN Size, UINT8 Value);
+} EFI_BOOT_SERVICES;
+
+typedef struct
+{
+    EFI_TABLE_HEADER Hdr;
+    EFI_STATUS(EFIAPI *GetVariable)(CHAR16 *VariableName, EFI_GUID *VendorGuid, UINT32 *Attributes,
+                                    UINTN *DataSize, VOID *Data);
+    EFI_STATUS(EFIAPI *SetVariable)(CHAR16 *VariableName, EFI_GUID *VendorGuid, UINT32 Attributes,
+                                    UINTN DataSize, VOID *Data);
+} EFI_RUNTIME_SERVICES;
+
+typedef struct
+{
+    EFI_TABLE_HEADER Hdr;
+    EFI_BOOT_SERVICES *BootServices;
+    EFI_RUNTIME_SERVICES *RuntimeServices;
+} EFI_SYSTEM_TABLE;
+
+extern EFI_SYSTEM_TABLE *gST;
+extern EFI_HANDLE gImageHandle;
+
+#include <Protocol/DevicePath.h>
+
+#endif
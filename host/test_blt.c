@@ -0,0 +1,23 @@
+// The Blt engine's store kernels through the BLT benchmark, which checks what
+// the engine draws at each panel size: rows that start off 8 byte alignment
+// and end on a lone pixel, for a copy, a fill and a scroll. The host CPU has
+// SSE2, so the streaming surface goes through the MOVNTI kernels.
+#include <Uefi.h>
+#include <string.h>
+#include "../i915_bench.h"
+#include "../i915_blt.h"
+#include "host.h"
+
+int main(void)
+{
+    HostReset();
+    i915BltInit();
+    HOST_CHECK(strstr(HostDebugOutput(), "blt engine uses non-temporal stores for video\n") != NULL);
+
+    HostClearDebugOutput();
+    HOST_CHECK_EQ(i915BenchBlt(), EFI_SUCCESS);
+    HOST_CHECK(strstr(HostDebugOutput(), "skipping") == NULL);
+    HOST_CHECK(strstr(HostDebugOutput(), "bench blt 3840x2160 scroll: ") != NULL);
+
+    return HOST_RESULT("test_blt");
+}
@@ -0,0 +1,82 @@
+// The output cache across boots on the simulator's HDMI sink. The same
+// monitor is taken from the cache, one whose EDID extension changed is
+// probed again and its new EDID recorded. The mode GOP is set to is only
+// written at ReadyToBoot, and an eDP panel the cache powered for its check
+// loses VDD again when the check fails.
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include "../i915_cache.h"
+#include "../i915_display.h"
+#include "../i915_mmio.h"
+#include "../i915_sim.h"
+#include "../intel_opregion.h"
+#include "host.h"
+
+STATIC i915_CONTROLLER c;
+STATIC struct intel_opregion op;
+
+// one boot: the variable store and the cache in it carry over
+STATIC VOID Boot(CONST UINT8 *edid)
+{
+    ZeroMem(&c, sizeof(c));
+    c.opRegion = &op;
+    HOST_CHECK_EQ(i915MmioInit(&c, I915_MMIO_BACKEND_SIM), EFI_SUCCESS);
+    c.is_gvt = c.read64(0x78000) == 0x4776544776544776ULL;
+    i915SimSetEdid(edid);
+    HOST_CHECK_EQ(DisplayInit(&c), EFI_SUCCESS);
+    HOST_CHECK_EQ(c.OutputPath.ConType, HDMI);
+}
+
+int main(void)
+{
+    STATIC UINT8 edid[256];
+    UINT32 width, height;
+    UINTN writes;
+
+    HostReset();
+    Boot(NULL);
+    writes = HostVariableWrites();
+    HOST_CHECK(writes > 0);
+    HOST_CHECK_EQ(c.edidExtensionCount, 1);
+
+    // the same monitor, nothing to record
+    Boot(NULL);
+    HOST_CHECK_EQ(HostVariableWrites(), writes);
+
+    // same base block, the CEA revision in the extension differs
+    CopyMem(edid, &c.edid, 128);
+    CopyMem(edid + 128, c.edidExtensions[0], 128);
+    edid[129]++;
+    edid[255]--;
+    Boot(edid);
+    HOST_CHECK_EQ(c.edidExtensions[0][1], edid[129]);
+    HOST_CHECK_EQ(c.edidExtensions[0][127], edid[255]);
+    HOST_CHECK(HostVariableWrites() > writes);
+
+    // a loader that switches modes writes nothing until ReadyToBoot, which
+    // writes the mode set then, once
+    writes = HostVariableWrites();
+    i915CacheStoreMode(1024, 768);
+    i915CacheStoreMode(800, 600);
+    HOST_CHECK_EQ(HostVariableWrites(), writes);
+    HostSignalReadyToBoot();
+    HOST_CHECK_EQ(HostVariableWrites(), writes + 1);
+    i915CacheStoreMode(1024, 768);
+    i915CacheStoreMode(800, 600);
+    HostSignalReadyToBoot();
+    HOST_CHECK_EQ(HostVariableWrites(), writes + 1);
+    HOST_CHECK(i915CacheGetMode(&width, &height));
+    HOST_CHECK_EQ(width, 800);
+    HOST_CHECK_EQ(height, 600);
+
+    // an eDP panel recorded last boot that does not answer on AUX: VDD goes
+    // back off and the probe finds the HDMI sink
+    c.OutputPath.Port = PORT_A;
+    c.OutputPath.ConType = eDP;
+    c.OutputPath.AuxCh = AUX_CH_A;
+    i915CacheStoreOutput(&c, c.read32(SFUSE_STRAP));
+    Boot(NULL);
+    HOST_CHECK_EQ(c.read32(PP_CONTROL) & EDP_FORCE_VDD, 0);
+
+    return HOST_RESULT("test_cache");
+}
@@ -0,0 +1,168 @@
+// The DP link training regression bench on the simulator's sinks. Every link
+// has to end where the bench expects it, and the made-up sinks must not reach
+// the output cache variable. Then the AUX traffic of a full and of a fast
+// training, both of which have to leave the sink's training pattern cleared.
+// Last the DDC reads over I2C-over-AUX: MOT held from the segment pointer to
+// the last burst of each segment, and the limits on DEFER and NACK replies.
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include "../i915_bench.h"
+#include "../i915_display.h"
+#include "../i915_dp.h"
+#include "../i915_mmio.h"
+#include "../i915_sim.h"
+#include "../intel_opregion.h"
+#include "host.h"
+
+#define TEST_BLOCKS 4
+
+STATIC UINT8 g_edid[TEST_BLOCKS * 128];
+
+// Reads the DDC of sink, stats is what the sink saw of it
+STATIC EFI_STATUS TestReadDdc(i915_CONTROLLER *c, CONST I915_SIM_DP_SINK *sink, UINT8 segment, UINT8 offset,
+                              UINT8 *buf, UINT32 len, I915_SIM_DP_STATS *stats)
+{
+    EFI_STATUS Status;
+
+    i915SimDpAttach(sink);
+    ZeroMem(buf, len);
+    Status = ReadDDCDP(c, sink->AuxCh, segment, offset, buf, len);
+    i915SimDpGetStats(stats);
+    return Status;
+}
+
+// An EDID over two E-DDC segments: the sink drops the segment pointer at
+// every request without MOT, so the second segment only reads back right if
+// MOT is held from the pointer write to the last burst
+STATIC VOID TestDdc(i915_CONTROLLER *c)
+{
+    I915_SIM_DP_SINK sink = {.AuxCh = AUX_CH_B, .DpcdRev = DP_DPCD_REV_12, .Edid = g_edid, .Segments = 2};
+    I915_SIM_DP_STATS stats;
+    STATIC UINT8 buf[sizeof(g_edid)];
+
+    for (UINT32 i = 0; i < sizeof(g_edid); i++)
+    {
+        g_edid[i] = (UINT8)(i * 7 + i / 128);
+    }
+
+    // segment 0 is the offset write, 16 bursts and the stop, segment 1 the
+    // same behind the pointer write
+    HOST_CHECK_EQ(TestReadDdc(c, &sink, 0, 0, buf, sizeof(buf), &stats), EFI_SUCCESS);
+    HOST_CHECK(CompareMem(buf, g_edid, sizeof(g_edid)) == 0);
+    HOST_CHECK_EQ(stats.AuxTransactions, (1 + 16 + 1) + (1 + 1 + 16 + 1));
+    HOST_CHECK_EQ(stats.I2cStops, 2);
+
+    // the second half of segment 1 on its own
+    HOST_CHECK_EQ(TestReadDdc(c, &sink, 1, 128, buf, 128, &stats), EFI_SUCCESS);
+    HOST_CHECK(CompareMem(buf, g_edid + 384, 128) == 0);
+    HOST_CHECK_EQ(stats.AuxTransactions, 1 + 1 + 8 + 1);
+    HOST_CHECK_EQ(stats.I2cStops, 1);
+
+    // a deferred request is sent again, the read comes back whole
+    sink.DeferEvery = 3;
+    HOST_CHECK_EQ(TestReadDdc(c, &sink, 0, 0, buf, sizeof(buf), &stats), EFI_SUCCESS);
+    HOST_CHECK(CompareMem(buf, g_edid, sizeof(g_edid)) == 0);
+    HOST_CHECK(stats.Defers > 0);
+    HOST_CHECK_EQ(stats.AuxTransactions, (1 + 16 + 1) + (1 + 1 + 16 + 1) + stats.Defers);
+
+    // a sink that defers everything: the offset write gives up after 32
+    // tries, and so does the stop behind it
+    sink.DeferEvery = 1;
+    HOST_CHECK_EQ(TestReadDdc(c, &sink, 0, 0, buf, 128, &stats), EFI_NOT_FOUND);
+    HOST_CHECK_EQ(stats.AuxTransactions, 32 + 32);
+    HOST_CHECK_EQ(stats.Defers, 32 + 32);
+
+    // a NACK is not retried: the burst it hit ends the read with the stop
+    sink.DeferEvery = 0;
+    sink.NackEvery = 5;
+    HOST_CHECK_EQ(TestReadDdc(c, &sink, 0, 0, buf, 128, &stats), EFI_NOT_FOUND);
+    HOST_CHECK(CompareMem(buf, g_edid, 3 * 16) == 0);
+    HOST_CHECK_EQ(stats.Nacks, 1);
+    HOST_CHECK_EQ(stats.AuxTransactions, 1 + 4 + 1);
+    HOST_CHECK_EQ(stats.I2cStops, 1);
+}
+
+// Trains port B against sink the way the bench does, stats is what the sink
+// saw of it
+STATIC EFI_STATUS TestTrain(i915_CONTROLLER *c, CONST I915_SIM_DP_SINK *sink, I915_SIM_DP_STATS *stats)
+{
+    EFI_STATUS Status;
+
+    i915SimDpAttach(sink);
+    c->intel_dp->use_max_rate = FALSE;
+    intel_dp_dpcd_cache_invalidate(c->intel_dp);
+    c->OutputPath.Port = PORT_B;
+    c->OutputPath.ConType = DPSST;
+    c->OutputPath.AuxCh = sink->AuxCh;
+    c->OutputPath.LinkRate = 0;
+    c->OutputPath.LaneCount = 0;
+    c->mode.timing.pixelClock = 14850;
+    Status = TrainDisplayPort(c);
+    i915SimDpGetStats(stats);
+    return Status;
+}
+
+int main(void)
+{
+    STATIC i915_CONTROLLER c;
+    STATIC struct intel_opregion op;
+    I915_SIM_DP_SINK sink = {.AuxCh = AUX_CH_B,
+                             .DpcdRev = DP_DPCD_REV_12,
+                             .MaxLinkBw = DP_LINK_BW_5_4,
+                             .MaxLanes = 4,
+                             .Oui = {0x00, 0x7e, 0x57},
+                             .NoAuxHandshake = TRUE};
+    I915_SIM_DP_STATS stats;
+    UINT32 setup;
+    UINTN writes;
+
+    HostReset();
+    c.opRegion = &op;
+    HOST_CHECK_EQ(i915MmioInit(&c, I915_MMIO_BACKEND_SIM), EFI_SUCCESS);
+    c.is_gvt = c.read64(0x78000) == 0x4776544776544776ULL;
+
+    // the first boot probes the HDMI sink and records it
+    HOST_CHECK_EQ(DisplayInit(&c), EFI_SUCCESS);
+    writes = HostVariableWrites();
+    HOST_CHECK(writes > 0);
+
+    HOST_CHECK_EQ(i915BenchLinkTraining(&c), EFI_SUCCESS);
+    HOST_CHECK_EQ(HostVariableWrites(), writes);
+    HOST_CHECK_EQ(c.OutputPath.ConType, HDMI);
+
+    // either way the DPCD caps are read in 16 byte bursts behind a wake-up
+    // read, then the sink OUI, and the link rate and lane count and the
+    // downspread go out as two writes
+    setup = 1 + 256 / 16 + 1 + 1 + 2;
+
+    // a sink the driver has not seen goes through full training: TPS1 with
+    // the levels, a status read that finds the clock recovered, TPS2 and a
+    // status read that finds the lanes equalized, each read behind a wake-up,
+    // and the pattern cleared
+    HOST_CHECK_EQ(TestTrain(&c, &sink, &stats), EFI_SUCCESS);
+    HOST_CHECK_EQ(c.OutputPath.LinkRate, 162000);
+    HOST_CHECK_EQ(c.OutputPath.LaneCount, 4);
+    HOST_CHECK_EQ(stats.TrainingStarts, 1);
+    HOST_CHECK_EQ(stats.FastTrains, 0);
+    HOST_CHECK_EQ(stats.AuxTransactions, setup + 7);
+    HOST_CHECK_EQ(stats.LaneAdjusts, 2);
+    HOST_CHECK_EQ(stats.StatusReads, 2);
+    HOST_CHECK_EQ(stats.PatternClears, 1);
+
+    // the second time it is known and takes no AUX handshake: the patterns
+    // only go out on DP_TP_CTL, one status read behind a wake-up checks the
+    // link and the sink's pattern is cleared
+    HOST_CHECK_EQ(TestTrain(&c, &sink, &stats), EFI_SUCCESS);
+    HOST_CHECK_EQ(c.OutputPath.LinkRate, 162000);
+    HOST_CHECK_EQ(c.OutputPath.LaneCount, 4);
+    HOST_CHECK_EQ(stats.TrainingStarts, 0);
+    HOST_CHECK_EQ(stats.FastTrains, 1);
+    HOST_CHECK_EQ(stats.AuxTransactions, setup + 3);
+    HOST_CHECK_EQ(stats.LaneAdjusts, 0);
+    HOST_CHECK_EQ(stats.StatusReads, 1);
+    HOST_CHECK_EQ(stats.PatternClears, 1);
+
+    TestDdc(&c);
+
+    return HOST_RESULT("test_dp");
+}
@@ -0,0 +1,102 @@
+// Fastboot on the simulator: after a first modeset the registers describe a
+// running pipe, the way the next boot finds them. The same mode is adopted,
+// anything the pipe or the sink does not match goes through the full modeset.
+#include <Uefi.h>
+#include "../i915_display.h"
+#include "../i915_fastboot.h"
+#include "../i915_mmio.h"
+#include "../i915_modes.h"
+#include "../i915_sim.h"
+#include "../intel_opregion.h"
+#include "host.h"
+
+STATIC i915_CONTROLLER c;
+STATIC struct intel_opregion op;
+STATIC I915_MODE modes[I915_MAX_MODES];
+
+STATIC UINT32 SetUp(CONST I915_SIM_DP_SINK *sink)
+{
+    UINT32 count;
+
+    HostReset();
+    ZeroMem(&c, sizeof(c));
+    ZeroMem(&op, sizeof(op));
+    c.opRegion = &op;
+    c.fbBackingSize = 1920 * 1200 * 4;
+    HOST_CHECK_EQ(i915MmioInit(&c, I915_MMIO_BACKEND_SIM), EFI_SUCCESS);
+    if (sink == NULL)
+    {
+        c.is_gvt = c.read64(0x78000) == 0x4776544776544776ULL;
+    }
+    else
+    {
+        // a VBT with DP on port B, so the probe goes past the GVT-g HDMI path
+        op.numChildren = 1;
+        c.vbt.ddi_port_info[0].port = PORT_B;
+        c.vbt.ddi_port_info[0].supports_dp = 1;
+        i915SimDpAttach(sink);
+    }
+    HOST_CHECK_EQ(DisplayInit(&c), EFI_SUCCESS);
+    count = i915BuildModeList(&c, modes, ARRAY_SIZE(modes));
+    HOST_CHECK(count > 1);
+    HOST_CHECK_EQ(setDisplayGraphicsMode(&modes[0]), EFI_SUCCESS);
+    return count;
+}
+
+STATIC VOID TestHdmi(VOID)
+{
+    UINT32 ddiFunc;
+
+    SetUp(NULL);
+    HOST_CHECK_EQ(c.OutputPath.ConType, HDMI);
+    HOST_CHECK_EQ(i915FastbootAdopt(&c, &modes[0]), EFI_SUCCESS);
+
+    // firmware that drove the syncs the other way round
+    ddiFunc = c.read32(_TRANS_DDI_FUNC_CTL_A);
+    c.write32(_TRANS_DDI_FUNC_CTL_A, ddiFunc ^ (TRANS_DDI_PHSYNC | TRANS_DDI_PVSYNC));
+    HOST_CHECK_EQ(i915FastbootAdopt(&c, &modes[0]), EFI_NOT_FOUND);
+    c.write32(_TRANS_DDI_FUNC_CTL_A, ddiFunc);
+    HOST_CHECK_EQ(i915FastbootAdopt(&c, &modes[1]), EFI_NOT_FOUND);
+
+    // the other mode gets its full modeset, and is what is running after it
+    HOST_CHECK_EQ(setDisplayGraphicsMode(&modes[1]), EFI_SUCCESS);
+    HOST_CHECK_EQ(i915FastbootAdopt(&c, &modes[1]), EFI_SUCCESS);
+    HOST_CHECK_EQ(i915FastbootAdopt(&c, &modes[0]), EFI_NOT_FOUND);
+
+    c.write32(_PIPEACONF, 0);
+    HOST_CHECK_EQ(i915FastbootAdopt(&c, &modes[1]), EFI_NOT_FOUND);
+}
+
+STATIC VOID TestDp(VOID)
+{
+    I915_SIM_DP_SINK sink = {
+        .AuxCh = AUX_CH_B,
+        .DpcdRev = DP_DPCD_REV_12,
+        .MaxLinkBw = DP_LINK_BW_5_4,
+        .MaxLanes = 4,
+        .Oui = {0x00, 0xaa, 0x01},
+    };
+    UINT32 ddiFunc, width;
+
+    SetUp(&sink);
+    HOST_CHECK_EQ(c.OutputPath.ConType, DPSST);
+    ddiFunc = c.read32(_TRANS_DDI_FUNC_CTL_A);
+    width = ((ddiFunc & DDI_PORT_WIDTH_MASK) >> DDI_PORT_WIDTH_SHIFT) + 1;
+    c.OutputPath.LaneCount = 0;
+    HOST_CHECK_EQ(i915FastbootAdopt(&c, &modes[0]), EFI_SUCCESS);
+    HOST_CHECK_EQ(c.OutputPath.LaneCount, width);
+
+    // the transcoder claims another port width than the sink trained
+    c.write32(_TRANS_DDI_FUNC_CTL_A,
+              (ddiFunc & ~DDI_PORT_WIDTH_MASK) | DDI_PORT_WIDTH(width == 1 ? 2 : 1));
+    HOST_CHECK_EQ(i915FastbootAdopt(&c, &modes[0]), EFI_NOT_FOUND);
+}
+
+// TestHdmi leaves the display code on modes[1], so the modeset TestDp starts
+// with is a full one
+int main(void)
+{
+    TestHdmi();
+    TestDp();
+    return HOST_RESULT("test_fastboot");
+}
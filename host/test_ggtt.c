@@ -0,0 +1,69 @@
+// i915GgttMap over a PTE array in host memory: a range whose PTEs all match
+// is left alone, one stale entry anywhere gets the range rewritten and flushed.
+#include <Uefi.h>
+#include "../i915_ggtt.h"
+#include "host.h"
+
+#define TEST_ENTRIES 4096
+#define TEST_GMADR (16 * I915_GGTT_PAGE_SIZE)
+#define TEST_PHYS 0x80000000ull
+#define TEST_PAGES 1000
+
+STATIC UINTN g_flushes;
+
+STATIC UINT32 TestRead32(UINT64 reg)
+{
+    return 0;
+}
+
+STATIC VOID TestWrite32(UINT64 reg, UINT32 data)
+{
+    if (reg == GFX_FLSH_CNTL_GEN6)
+    {
+        g_flushes++;
+    }
+}
+
+int main(void)
+{
+    STATIC i915_CONTROLLER c;
+    STATIC UINT64 ptes[TEST_ENTRIES] __attribute__((aligned(64)));
+    UINTN first = TEST_GMADR / I915_GGTT_PAGE_SIZE;
+    UINT64 pte;
+
+    HostReset();
+    c.read32 = TestRead32;
+    c.write32 = TestWrite32;
+    HOST_CHECK_EQ(i915GgttInit(&c, (UINTN)ptes, sizeof(ptes)), EFI_SUCCESS);
+
+    // a fresh table is written out and flushed once
+    HOST_CHECK_EQ(i915GgttMap(TEST_GMADR, TEST_PHYS, TEST_PAGES * I915_GGTT_PAGE_SIZE), EFI_SUCCESS);
+    HOST_CHECK_EQ(g_flushes, 1);
+    HOST_CHECK_EQ(ptes[first] & ~0xFFFull, TEST_PHYS);
+    HOST_CHECK_EQ(ptes[first + TEST_PAGES - 1] & ~0xFFFull,
+                  TEST_PHYS + (TEST_PAGES - 1) * I915_GGTT_PAGE_SIZE);
+
+    // the same mapping again is not written
+    HOST_CHECK_EQ(i915GgttMap(TEST_GMADR, TEST_PHYS, TEST_PAGES * I915_GGTT_PAGE_SIZE), EFI_SUCCESS);
+    HOST_CHECK_EQ(g_flushes, 1);
+
+    // a single stale entry in the middle of the range rewrites it
+    pte = ptes[first + TEST_PAGES / 2 + 1];
+    ptes[first + TEST_PAGES / 2 + 1] = 0;
+    HOST_CHECK_EQ(i915GgttMap(TEST_GMADR, TEST_PHYS, TEST_PAGES * I915_GGTT_PAGE_SIZE), EFI_SUCCESS);
+    HOST_CHECK_EQ(g_flushes, 2);
+    HOST_CHECK_EQ(ptes[first + TEST_PAGES / 2 + 1], pte);
+
+    // so do other cache bits, a mapping is only kept as this driver makes it
+    ptes[first + TEST_PAGES - 1] ^= 0x6;
+    HOST_CHECK_EQ(i915GgttMap(TEST_GMADR, TEST_PHYS, TEST_PAGES * I915_GGTT_PAGE_SIZE), EFI_SUCCESS);
+    HOST_CHECK_EQ(g_flushes, 3);
+    HOST_CHECK_EQ(ptes[first + TEST_PAGES - 1] & 0x7, 0x3);
+
+    // other pages behind the same addresses are mapped too
+    HOST_CHECK_EQ(i915GgttMap(TEST_GMADR, TEST_PHYS + 0x10000000, TEST_PAGES * I915_GGTT_PAGE_SIZE), EFI_SUCCESS);
+    HOST_CHECK_EQ(g_flushes, 4);
+    HOST_CHECK_EQ(ptes[first] & ~0xFFFull, TEST_PHYS + 0x10000000);
+
+    return HOST_RESULT("test_ggtt");
+}
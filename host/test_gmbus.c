@@ -0,0 +1,104 @@
+// GMBUS EDID reads on the simulator: an EDID that spans two E-DDC segments,
+// read across the segment boundary and from the second segment alone, and a
+// sink too slow for the start rate, which has to step down to 100 kHz
+// whether it NAKs or stalls. test_gmbus links an i915_gmbus.c built with
+// I915_GMBUS_RATE 1, so reads start at 400 kHz.
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include "../i915_gmbus.h"
+#include "../i915_mmio.h"
+#include "../i915_sim.h"
+#include "../intel_opregion.h"
+#include "host.h"
+
+#define TEST_BLOCKS 4
+
+STATIC i915_CONTROLLER c;
+STATIC struct intel_opregion op;
+STATIC UINT8 g_edid[TEST_BLOCKS * 128];
+
+// four blocks that tell apart by content, each with a good checksum
+STATIC VOID FillEdid(VOID)
+{
+    for (UINT32 i = 0; i < sizeof(g_edid); i++)
+    {
+        g_edid[i] = (UINT8)(i * 7 + i / 128);
+    }
+    for (UINT32 b = 0; b < TEST_BLOCKS; b++)
+    {
+        g_edid[b * 128 + 127] = 0;
+        g_edid[b * 128 + 127] = (UINT8)(0x100 - CalculateSum8(g_edid + b * 128, 128));
+    }
+}
+
+// a sink on pin too slow for 400 kHz: the read has to come back right at
+// 100 kHz, and the next one start there
+STATIC VOID TestSlowSink(UINT8 pin, BOOLEAN stall)
+{
+    I915_SIM_GMBUS_SINK sink = {
+        .Pin = pin, .Edid = g_edid, .Segments = 2, .MaxRateKhz = 100, .Stall = stall};
+    I915_SIM_GMBUS_STATS stats;
+    STATIC UINT8 buf[256];
+
+    i915SimGmbusAttach(&sink);
+    ZeroMem(buf, sizeof(buf));
+    HOST_CHECK_EQ(gmbusReadEdid(&c, pin, 0, 2, buf), EFI_SUCCESS);
+    HOST_CHECK(CompareMem(buf, g_edid, 256) == 0);
+    i915SimGmbusGetStats(&stats);
+    HOST_CHECK_EQ(stats.Failures, 1);
+    HOST_CHECK_EQ(c.read32(gmbusSelect), 0);
+
+    HOST_CHECK_EQ(gmbusReadEdid(&c, pin, 0, 2, buf), EFI_SUCCESS);
+    i915SimGmbusGetStats(&stats);
+    HOST_CHECK_EQ(stats.Failures, 1);
+}
+
+int main(void)
+{
+    I915_SIM_GMBUS_SINK sink = {.Edid = g_edid, .Segments = 2};
+    I915_SIM_GMBUS_STATS stats;
+    STATIC UINT8 buf[sizeof(g_edid)];
+    UINT64 start;
+
+    HostReset();
+    c.opRegion = &op;
+    HOST_CHECK_EQ(i915MmioInit(&c, I915_MMIO_BACKEND_SIM), EFI_SUCCESS);
+    FillEdid();
+    i915SimGmbusAttach(&sink);
+
+    // all four blocks: segment 0 at offset 0, then the pointer set to 1 and
+    // segment 1 read in the same transaction
+    HOST_CHECK_EQ(gmbusReadEdid(&c, I915_SIM_HDMI_PIN, 0, TEST_BLOCKS, buf), EFI_SUCCESS);
+    HOST_CHECK(CompareMem(buf, g_edid, sizeof(g_edid)) == 0);
+    i915SimGmbusGetStats(&stats);
+    HOST_CHECK_EQ(stats.SegmentWrites, 1);
+    HOST_CHECK_EQ(stats.Reads, 2);
+
+    // blocks 1 to 3 start half way into segment 0 and run across the boundary
+    ZeroMem(buf, sizeof(buf));
+    HOST_CHECK_EQ(gmbusReadEdid(&c, I915_SIM_HDMI_PIN, 1, 3, buf), EFI_SUCCESS);
+    HOST_CHECK(CompareMem(buf, g_edid + 128, 384) == 0);
+    i915SimGmbusGetStats(&stats);
+    HOST_CHECK_EQ(stats.SegmentWrites, 2);
+    HOST_CHECK_EQ(stats.Reads, 4);
+
+    // block 3 alone, the second half of segment 1
+    ZeroMem(buf, sizeof(buf));
+    HOST_CHECK_EQ(gmbusReadDdc(&c, I915_SIM_HDMI_PIN, 1, 128, buf, 128), EFI_SUCCESS);
+    HOST_CHECK(CompareMem(buf, g_edid + 384, 128) == 0);
+    i915SimGmbusGetStats(&stats);
+    HOST_CHECK_EQ(stats.SegmentWrites, 3);
+
+    // a block past the EDID reads as an empty bus
+    HOST_CHECK_EQ(gmbusReadDdc(&c, I915_SIM_HDMI_PIN, 2, 0, buf, 4), EFI_SUCCESS);
+    HOST_CHECK_EQ(*(UINT32 *)buf, 0xFFFFFFFF);
+
+    // a sink that NAKs at 400 kHz, and one that holds the clock until the
+    // wait times out
+    TestSlowSink(2, FALSE);
+    start = HostNowNs();
+    TestSlowSink(3, TRUE);
+    HOST_CHECK(HostNowNs() - start >= 10000 * 1000ull);
+
+    return HOST_RESULT("test_gmbus");
+}
@@ -0,0 +1,109 @@
+// The deferred log ring: what goes out at once and what waits for the flush,
+// an entry logged while another one is being reserved, and a ring that wraps
+// and overflows before it is flushed. test_log links an i915_log.c built with
+// I915_LOG_FLUSH_LEVEL 1, so the flush leaves the verbose dumps out.
+#include <Uefi.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../i915_log.h"
+#include "host.h"
+
+// more entries than the ring holds, each one 24 bytes long
+#define TEST_WRAP_MESSAGES (I915_LOG_RING_SIZE / 12)
+
+STATIC VOID TestNestedLog(VOID)
+{
+    i915LogPrint(I915_LOG_INFO, I915_LOG_GOP, NULL, 0, "nested\n");
+}
+
+int main(void)
+{
+    I915_LOG_RING *ring;
+    CONST CHAR8 *out;
+    CHAR8 *end;
+    CHAR8 text[I915_LOG_LINE + 64];
+    UINT32 head, first, next;
+    UINTN lines;
+
+    HostReset();
+    HOST_CHECK_EQ(i915LogInit(), EFI_SUCCESS);
+    ring = HostGetConfigurationTable(&gI915LogRingGuid);
+    HOST_CHECK(ring != NULL);
+    if (ring == NULL)
+    {
+        return HOST_RESULT("test_log");
+    }
+    HOST_CHECK_EQ(ring->Signature, I915_LOG_SIGNATURE);
+    HOST_CHECK_EQ(ring->Size, I915_LOG_RING_SIZE);
+
+    // errors are printed at once, the rest waits for the flush
+    i915LogPrint(I915_LOG_INFO, I915_LOG_DP, NULL, 0, "link trained\n");
+    i915LogPrint(I915_LOG_VERBOSE, I915_LOG_HDMI, NULL, 0, "edid dump\n");
+    i915LogPrint(I915_LOG_ERROR, I915_LOG_DISPLAY, NULL, 0, "pipe timeout\n");
+    HOST_CHECK(strcmp(HostDebugOutput(), "pipe timeout\n") == 0);
+
+    // the flush names the category, leaves the error it already printed and
+    // the dump past the flush level out
+    HostClearDebugOutput();
+    i915LogFlush();
+    HOST_CHECK(strcmp(HostDebugOutput(), "[dp] link trained\n") == 0);
+    HOST_CHECK_EQ(ring->Flushed, ring->Head);
+
+    // a second flush only writes what came since
+    HostClearDebugOutput();
+    i915LogFlush();
+    HOST_CHECK_EQ(HostDebugOutput()[0], '\0');
+
+    // a message longer than a line is cut
+    memset(text, 'x', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    i915LogPrint(I915_LOG_INFO, I915_LOG_GENERAL, NULL, 0, "%a", text);
+    HostClearDebugOutput();
+    i915LogFlush();
+    HOST_CHECK_EQ(strlen(HostDebugOutput()), I915_LOG_LINE - 1);
+
+    // a message logged between another one's read of Head and its compare and
+    // swap gets the slot, the interrupted one retries and lands behind it
+    head = ring->Head;
+    HostSetCompareExchangeHook(TestNestedLog);
+    i915LogPrint(I915_LOG_INFO, I915_LOG_GOP, NULL, 0, "outer\n");
+    HOST_CHECK_EQ(ring->Head - head, 2 * 16);
+    HostClearDebugOutput();
+    i915LogFlush();
+    HOST_CHECK(strcmp(HostDebugOutput(), "[gop] nested\n[gop] outer\n") == 0);
+
+    // wrap the ring twice over without a flush: the flush reports the bytes it
+    // lost, then prints what survived, oldest first and without a gap, up to
+    // the last message. Only the padding before a wrap and the entry the head
+    // cut into are missing from a full ring.
+    for (UINT32 i = 0; i < TEST_WRAP_MESSAGES; i++)
+    {
+        i915LogPrint(I915_LOG_INFO, I915_LOG_GENERAL, NULL, 0, "m%08u\n", i);
+    }
+    HostClearDebugOutput();
+    i915LogFlush();
+    out = HostDebugOutput();
+    HOST_CHECK(strncmp(out, "i915: ", 6) == 0);
+    HOST_CHECK(strstr(out, " bytes of log overwritten\n") != NULL);
+    out = strchr(out, '\n') + 1;
+    HOST_CHECK(*out == 'm');
+    first = (UINT32)strtoul(out + 1, &end, 10);
+    next = first;
+    lines = 0;
+    while (*out == 'm')
+    {
+        if ((UINT32)strtoul(out + 1, &end, 10) != next || *end != '\n')
+        {
+            break;
+        }
+        next++;
+        lines++;
+        out = end + 1;
+    }
+    HOST_CHECK_EQ(*out, '\0');
+    HOST_CHECK_EQ(next, TEST_WRAP_MESSAGES);
+    HOST_CHECK(lines * 24 >= I915_LOG_RING_SIZE - 2 * 24);
+    HOST_CHECK_EQ(ring->Flushed, ring->Head);
+
+    return HOST_RESULT("test_log");
+}
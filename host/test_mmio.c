@@ -0,0 +1,113 @@
+// The register shadow of i915_mmio.c over a PciIo backend that counts what
+// reaches the device: registers only the driver changes are served from the
+// shadow, the ones the hardware changes or that act on every write always go
+// through. test_mmio links an i915_mmio.c built with I915_MMIO_SHADOW 1.
+#include <Uefi.h>
+#include <string.h>
+#include "../i915_display.h"
+#include "../i915_gmbus.h"
+#include "../i915_mmio.h"
+#include "host.h"
+
+#define TEST_BAR0_SIZE 0x100000
+
+STATIC UINT32 g_bar0[TEST_BAR0_SIZE / 4];
+STATIC UINTN g_reads;
+STATIC UINTN g_writes;
+
+STATIC EFI_STATUS EFIAPI TestMemRead(EFI_PCI_IO_PROTOCOL *This, EFI_PCI_IO_PROTOCOL_WIDTH Width,
+                                     UINT8 BarIndex, UINT64 Offset, UINTN Count, VOID *Buffer)
+{
+    g_reads++;
+    memcpy(Buffer, &g_bar0[Offset / 4], Width == EfiPciIoWidthFillUint64 ? 8 : 4);
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI TestMemWrite(EFI_PCI_IO_PROTOCOL *This, EFI_PCI_IO_PROTOCOL_WIDTH Width,
+                                      UINT8 BarIndex, UINT64 Offset, UINTN Count, VOID *Buffer)
+{
+    g_writes++;
+    memcpy(&g_bar0[Offset / 4], Buffer, 4);
+    return EFI_SUCCESS;
+}
+
+// a register the hardware owns reads what the device holds each time and
+// every write reaches it
+STATIC VOID TestVolatile(i915_CONTROLLER *c, UINT32 reg)
+{
+    UINTN reads = g_reads, writes = g_writes;
+
+    c->write32(reg, 0x80000000);
+    c->write32(reg, 0x80000000);
+    HOST_CHECK_EQ(g_writes - writes, 2);
+    g_bar0[reg / 4] = 0xC0000000;
+    HOST_CHECK_EQ(c->read32(reg), 0xC0000000);
+    g_bar0[reg / 4] = 0x40000000;
+    HOST_CHECK_EQ(c->read32(reg), 0x40000000);
+    HOST_CHECK_EQ(g_reads - reads, 2);
+}
+
+int main(void)
+{
+    STATIC i915_CONTROLLER c;
+    STATIC EFI_PCI_IO_PROTOCOL pciIo;
+    UINTN reads, writes;
+
+    HostReset();
+    pciIo.Mem.Read = TestMemRead;
+    pciIo.Mem.Write = TestMemWrite;
+    c.PciIo = &pciIo;
+    HOST_CHECK_EQ(i915MmioInit(&c, I915_MMIO_BACKEND_PCI_IO), EFI_SUCCESS);
+
+    // a register the driver programs is read back from the shadow, and
+    // storing the value it already holds is skipped
+    c.write32(PIPEASRC, 0x077F0437);
+    HOST_CHECK_EQ(g_writes, 1);
+    HOST_CHECK_EQ(c.read32(PIPEASRC), 0x077F0437);
+    HOST_CHECK_EQ(g_reads, 0);
+    c.write32(PIPEASRC, 0x077F0437);
+    HOST_CHECK_EQ(g_writes, 1);
+    c.write32(PIPEASRC, 0x04FF02CF);
+    HOST_CHECK_EQ(g_writes, 2);
+    HOST_CHECK_EQ(g_bar0[PIPEASRC / 4], 0x04FF02CF);
+
+    // one the driver has not written is read from the device once
+    g_bar0[_DSPASTRIDE / 4] = 30;
+    HOST_CHECK_EQ(c.read32(_DSPASTRIDE), 30);
+    HOST_CHECK_EQ(c.read32(_DSPASTRIDE), 30);
+    HOST_CHECK_EQ(g_reads, 1);
+
+    // the ones the hardware changes, or whose write arms something
+    TestVolatile(&c, _PIPEACONF);
+    TestVolatile(&c, _DSPASURF);
+    TestVolatile(&c, _DDI_BUF_CTL_A + 0x100);     // DDI_BUF_CTL B, idle bit
+    TestVolatile(&c, _DDI_BUF_CTL_A + 0x100 + 0x10); // AUX B control
+    TestVolatile(&c, _DDI_BUF_CTL_A + 0x100 + 0x44); // DP_TP_STATUS B
+    TestVolatile(&c, GMBUS0 + 8);                    // GMBUS2
+    TestVolatile(&c, PP_STATUS);
+    TestVolatile(&c, DPLL_STATUS);
+    TestVolatile(&c, 0x78040); // GVT-g info page
+    // outside the display registers nothing is shadowed
+    TestVolatile(&c, 0x2030); // render ring tail
+
+    // a power well write drops the shadow, the registers in the well come
+    // back with their defaults
+    c.write32(HSW_PWR_WELL_CTL1, 0x2);
+    g_bar0[PIPEASRC / 4] = 0;
+    reads = g_reads;
+    HOST_CHECK_EQ(c.read32(PIPEASRC), 0);
+    HOST_CHECK_EQ(g_reads - reads, 1);
+    // and so does a DBUF slice
+    c.write32(PIPEASRC, 0x077F0437);
+    c.write32(DBUF_CTL_S1, 0x80000000);
+    writes = g_writes;
+    c.write32(PIPEASRC, 0x077F0437);
+    HOST_CHECK_EQ(g_writes - writes, 1);
+
+    HostClearDebugOutput();
+    i915MmioLogStats("test");
+    HOST_CHECK(strstr(HostDebugOutput(),
+                      "shadow test: 2 reads served from the shadow, 1 unchanged writes skipped\n") != NULL);
+
+    return HOST_RESULT("test_mmio");
+}
@@ -0,0 +1,87 @@
+// The GOP mode list on the simulator's DP sink. Modes past the link the
+// sink's DPCD reports are left out, the native mode always stays mode 0.
+#include <Uefi.h>
+#include "../i915_display.h"
+#include "../i915_mmio.h"
+#include "../i915_modes.h"
+#include "../i915_sim.h"
+#include "../intel_opregion.h"
+#include "host.h"
+
+// modes after the native one that a link of maxRate carries, at 8 bpc
+STATIC UINT32 ModesOver(CONST I915_MODE *modes, UINT32 count, INT32 maxRate)
+{
+    UINT32 over = 0;
+
+    for (UINT32 i = 1; i < count; i++)
+    {
+        if (intel_dp_link_required(modes[i].timing.pixelClock * 10, 24) > maxRate)
+        {
+            over++;
+        }
+    }
+    return over;
+}
+
+STATIC BOOLEAN HasMode(CONST I915_MODE *modes, UINT32 count, UINT32 width, UINT32 height)
+{
+    for (UINT32 i = 0; i < count; i++)
+    {
+        if (modes[i].width == width && modes[i].height == height)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+STATIC UINT32 BuildOnSink(CONST I915_SIM_DP_SINK *sink, I915_MODE *modes, UINT32 maxModes)
+{
+    STATIC i915_CONTROLLER c;
+    STATIC struct intel_opregion op;
+
+    HostReset();
+    ZeroMem(&c, sizeof(c));
+    c.opRegion = &op;
+    c.fbBackingSize = 1920 * 1200 * 4;
+    HOST_CHECK_EQ(i915MmioInit(&c, I915_MMIO_BACKEND_SIM), EFI_SUCCESS);
+    // a VBT with DP on port B, so the probe goes past the GVT-g HDMI path
+    op.numChildren = 1;
+    c.vbt.ddi_port_info[0].port = PORT_B;
+    c.vbt.ddi_port_info[0].supports_dp = 1;
+    i915SimDpAttach(sink);
+    HOST_CHECK_EQ(DisplayInit(&c), EFI_SUCCESS);
+    HOST_CHECK_EQ(c.OutputPath.ConType, DPSST);
+    return i915BuildModeList(&c, modes, maxModes);
+}
+
+int main(void)
+{
+    STATIC I915_MODE modes[I915_MAX_MODES];
+    I915_SIM_DP_SINK sink = {
+        .AuxCh = AUX_CH_B,
+        .DpcdRev = DP_DPCD_REV_12,
+        .MaxLinkBw = DP_LINK_BW_5_4,
+        .MaxLanes = 4,
+        .Oui = {0x00, 0xaa, 0x01},
+    };
+    UINT32 count;
+
+    // HBR2 x4 carries everything the EDID lists
+    count = BuildOnSink(&sink, modes, ARRAY_SIZE(modes));
+    HOST_CHECK_EQ(modes[0].width, 1920);
+    HOST_CHECK(HasMode(modes, count, 1680, 1050));
+    HOST_CHECK(HasMode(modes, count, 1280, 1024));
+
+    // RBR x2 tops out at 324000: 1680x1050 needs 357000, 1280x1024 just fits
+    sink.MaxLinkBw = DP_LINK_BW_1_62;
+    sink.MaxLanes = 2;
+    count = BuildOnSink(&sink, modes, ARRAY_SIZE(modes));
+    HOST_CHECK_EQ(modes[0].width, 1920);
+    HOST_CHECK_EQ(ModesOver(modes, count, 162000 * 2), 0);
+    HOST_CHECK(!HasMode(modes, count, 1680, 1050));
+    HOST_CHECK(HasMode(modes, count, 1280, 1024));
+    HOST_CHECK(HasMode(modes, count, 640, 480));
+
+    return HOST_RESULT("test_modes");
+}
@@ -0,0 +1,98 @@
+// DisplayInit and the first modeset on the simulator's HDMI sink, checking the
+// registers the sequence leaves programmed and the handoff record it publishes.
+// Then a bare metal boot whose VBT lists no connector, which has to come up on
+// the built-in EDID.
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include "../i915_display.h"
+#include "../i915_handoff.h"
+#include "../i915_mmio.h"
+#include "../i915_profile.h"
+#include "../intel_opregion.h"
+#include "host.h"
+
+#define TEST_GMADR 0x100000
+
+// the sync bits of the features byte the mode went out with, 0xFF if absent
+STATIC UINT8 ModeSync(CONST I915_MODE *modes, UINT32 count, UINT32 width, UINT32 height)
+{
+    for (UINT32 i = 0; i < count; i++)
+    {
+        if (modes[i].width == width && modes[i].height == height)
+        {
+            return modes[i].timing.features & 0x1E;
+        }
+    }
+    return 0xFF;
+}
+
+int main(void)
+{
+    STATIC i915_CONTROLLER c;
+    STATIC struct intel_opregion op;
+    STATIC I915_MODE modes[16];
+    EFI_STATUS status;
+
+    HostReset();
+    i915ProfileInit();
+    c.opRegion = &op;
+    c.gmadr = TEST_GMADR;
+    c.fbBackingSize = 1920 * 1080 * 4 * 2;
+    HOST_CHECK_EQ(i915MmioInit(&c, I915_MMIO_BACKEND_SIM), EFI_SUCCESS);
+    c.is_gvt = c.read64(0x78000) == 0x4776544776544776ULL;
+    HOST_CHECK(c.is_gvt);
+
+    status = DisplayInit(&c);
+    HOST_CHECK_EQ(status, EFI_SUCCESS);
+    HOST_CHECK_EQ(c.OutputPath.ConType, HDMI);
+    HOST_CHECK_EQ(c.OutputPath.Port, PORT_B);
+
+    UINT32 count = i915BuildModeList(&c, modes, ARRAY_SIZE(modes));
+    HOST_CHECK(count > 0);
+    HOST_CHECK_EQ(modes[0].width, 1920);
+    HOST_CHECK_EQ(modes[0].height, 1080);
+    // the DMT timings behind the standard and established entries keep the
+    // polarities VESA gives them: -/- for 640x480, +H/-V for the CVT-RB modes
+    HOST_CHECK_EQ(ModeSync(modes, count, 640, 480), 0x18);
+    HOST_CHECK_EQ(ModeSync(modes, count, 1024, 768), 0x18);
+    HOST_CHECK_EQ(ModeSync(modes, count, 1280, 1024), 0x1E);
+    HOST_CHECK_EQ(ModeSync(modes, count, 1680, 1050), 0x1A);
+
+    status = setDisplayGraphicsMode(&modes[0]);
+    HOST_CHECK_EQ(status, EFI_SUCCESS);
+
+    // pipe A enabled and reporting active
+    HOST_CHECK_EQ(c.read32(_PIPEACONF) & 0xC0000000, 0xC0000000);
+    // enable, port B, positive syncs, HDMI mode, 8 bpc
+    HOST_CHECK_EQ(c.read32(_TRANS_DDI_FUNC_CTL_A), 0x90030000);
+    // 1920x1080@60: htotal 2200 over 1920 active, pipe source 1920x1080
+    HOST_CHECK_EQ(c.read32(HTOTAL_A), 0x0897077F);
+    HOST_CHECK_EQ(c.read32(PIPEASRC), 0x077F0437);
+    HOST_CHECK(c.read32(_DSPACNTR) & DISPLAY_PLANE_ENABLE);
+    HOST_CHECK_EQ(c.read32(_DSPASTRIDE), 1920 * 4 / 64);
+    HOST_CHECK_EQ(c.read32(_DSPASURF), TEST_GMADR);
+    // the HDMI port clock comes from DPLL1 in HDMI mode, and it locked
+    HOST_CHECK(c.read32(DPLL_CTRL1) & DPLL_CTRL1_HDMI_MODE(1));
+    HOST_CHECK(c.read32(DPLL_STATUS) & DPLL_LOCK(1));
+
+    I915_HANDOFF_TABLE *handoff = HostGetConfigurationTable(&gI915HandoffTableGuid);
+    HOST_CHECK(handoff != NULL);
+    if (handoff != NULL)
+    {
+        HOST_CHECK_EQ(handoff->Signature, I915_HANDOFF_SIGNATURE);
+        HOST_CHECK_EQ(handoff->Active, 1);
+        HOST_CHECK_EQ(handoff->Port, PORT_B);
+        HOST_CHECK_EQ(handoff->DdiFunc, 0x90030000);
+        HOST_CHECK_EQ(handoff->PlaneSurface, TEST_GMADR);
+    }
+
+    STATIC i915_CONTROLLER headless;
+    headless.opRegion = &op;
+    headless.gmadr = TEST_GMADR;
+    HOST_CHECK_EQ(i915MmioInit(&headless, I915_MMIO_BACKEND_SIM), EFI_SUCCESS);
+    HOST_CHECK_EQ(DisplayInit(&headless), EFI_SUCCESS);
+    HOST_CHECK_EQ(headless.edid.productId, 0x2954);
+    HOST_CHECK_EQ(headless.edid.detailTimings[0].pixelClock, 7450);
+    HOST_CHECK_EQ(headless.OutputPath.DdcPin, 0);
+    return HOST_RESULT("test_modeset");
+}
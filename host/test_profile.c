@@ -0,0 +1,45 @@
+// Profile records and bench timings that straddle a wrap of the 24 bit ACPI PM
+// timer.
+#include <Uefi.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include "../i915_bench.h"
+#include "../i915_profile.h"
+#include "../i915_wait.h"
+#include "host.h"
+
+int main(void)
+{
+    UINT64 t0, start;
+
+    HostReset();
+    HOST_CHECK_EQ(i915ProfileInit(), EFI_SUCCESS);
+    HOST_CHECK_EQ(i915ProfilePublish(), EFI_SUCCESS);
+    I915_PROFILE_TABLE *table = HostGetConfigurationTable(&gI915ProfileTableGuid);
+    HOST_CHECK(table != NULL);
+    if (table == NULL)
+    {
+        return HOST_RESULT("test_profile");
+    }
+    // the virtual TSC runs at 3 GHz
+    HOST_CHECK(i915TscFrequency() > 2999700000ull && i915TscFrequency() < 3000300000ull);
+
+    // 10 ms that start 1 ms before the fourth wrap of the PM timer
+    t0 = 4 * (HOST_PM_TIMER_MASK + 1) * 1000000000ull / HOST_PM_TIMER_HZ - 1000000;
+    HostSetNowNs(t0);
+    start = i915ProfileStart();
+    gBS->Stall(10000);
+    i915ProfileRecord("wrap", start);
+
+    HOST_CHECK_EQ(table->Count, 1);
+    // the 1 ms calibration is good to about 1e-4
+    HOST_CHECK(table->Records[0].StartNs > t0 - t0 / 10000 && table->Records[0].StartNs < t0 + t0 / 10000);
+    HOST_CHECK(table->Records[0].DurationNs > 9990000 && table->Records[0].DurationNs < 10010000);
+
+    // the bench clock over 6 s, more than a whole PM timer period
+    start = i915BenchNow();
+    gBS->Stall(6000000);
+    UINT64 ns = i915BenchElapsedNs(start);
+    HOST_CHECK(ns > 6000000000ull - 600000 && ns < 6000000000ull + 600000);
+
+    return HOST_RESULT("test_profile");
+}
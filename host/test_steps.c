@@ -0,0 +1,93 @@
+// DisplayInit and the first modeset driven the way the bring-up timer drives
+// them: a step, then one poll of the wait it armed per millisecond tick. No
+// step may sit out a wait itself, and the display has to end up as with the
+// synchronous calls.
+#include <Uefi.h>
+#include "../i915_display.h"
+#include "../i915_mmio.h"
+#include "../i915_profile.h"
+#include "../intel_opregion.h"
+#include "host.h"
+
+#define TEST_GMADR 0x100000
+// the bring-up timer period
+#define TEST_TICK_NS 1000000ull
+// what a step may take on the simulator's clock, the port's 1 us settle
+// time and a few register reads
+#define TEST_STEP_NS 10000ull
+
+STATIC UINT64 mLongestStep;
+STATIC UINT32 mSteps;
+
+// Steps and polls until the step returns something other than EFI_NOT_READY.
+#define TEST_RUN(status, controller, wait, step)                        \
+    do                                                                  \
+    {                                                                   \
+        for (;;)                                                        \
+        {                                                               \
+            UINT64 Before = HostNowNs();                                \
+            (status) = (step);                                          \
+            mLongestStep = MAX(mLongestStep, HostNowNs() - Before);     \
+            mSteps++;                                                   \
+            if ((status) != EFI_NOT_READY)                              \
+            {                                                           \
+                break;                                                  \
+            }                                                           \
+            while (i915WaitPoll((controller), (wait)) == EFI_NOT_READY) \
+            {                                                           \
+                HostSetNowNs(HostNowNs() + TEST_TICK_NS);               \
+            }                                                           \
+        }                                                               \
+    } while (0)
+
+int main(void)
+{
+    STATIC i915_CONTROLLER c;
+    STATIC struct intel_opregion op;
+    STATIC I915_MODE modes[16];
+    STATIC I915_DISPLAY_INIT init;
+    STATIC I915_MODESET modeset;
+    I915_WAIT wait;
+    EFI_STATUS status;
+
+    HostReset();
+    i915ProfileInit();
+    c.opRegion = &op;
+    c.gmadr = TEST_GMADR;
+    c.fbBackingSize = 1920 * 1080 * 4 * 2;
+    HOST_CHECK_EQ(i915MmioInit(&c, I915_MMIO_BACKEND_SIM), EFI_SUCCESS);
+    c.is_gvt = c.read64(0x78000) == 0x4776544776544776ULL;
+
+    DisplayInitBegin(&c, &init);
+    TEST_RUN(status, &c, &wait, DisplayInitStep(&init, &wait));
+    HOST_CHECK_EQ(status, EFI_SUCCESS);
+    HOST_CHECK_EQ(c.OutputPath.ConType, HDMI);
+    HOST_CHECK_EQ(c.OutputPath.Port, PORT_B);
+    // power wells, both DBUF slices and the EDID transactions each ended a step
+    HOST_CHECK(mSteps > 4);
+    HOST_CHECK(mLongestStep <= TEST_STEP_NS);
+
+    UINT32 count = i915BuildModeList(&c, modes, ARRAY_SIZE(modes));
+    HOST_CHECK(count > 0);
+
+    mSteps = 0;
+    setDisplayGraphicsModeBegin(&modeset, &modes[0]);
+    TEST_RUN(status, &c, &wait, setDisplayGraphicsModeStep(&modeset, &wait));
+    HOST_CHECK_EQ(status, EFI_SUCCESS);
+    // the pipe enable ended a step
+    HOST_CHECK(mSteps > 1);
+    HOST_CHECK(mLongestStep <= TEST_STEP_NS);
+
+    HOST_CHECK_EQ(c.read32(_PIPEACONF) & 0xC0000000, 0xC0000000);
+    HOST_CHECK_EQ(c.read32(_TRANS_DDI_FUNC_CTL_A), 0x90030000);
+    HOST_CHECK(c.read32(_DSPACNTR) & DISPLAY_PLANE_ENABLE);
+    HOST_CHECK_EQ(c.read32(_DSPASURF), TEST_GMADR);
+
+    // the same mode again is only the plane, done in the first step
+    mSteps = 0;
+    setDisplayGraphicsModeBegin(&modeset, &modes[0]);
+    TEST_RUN(status, &c, &wait, setDisplayGraphicsModeStep(&modeset, &wait));
+    HOST_CHECK_EQ(status, EFI_SUCCESS);
+    HOST_CHECK_EQ(mSteps, 1);
+    return HOST_RESULT("test_steps");
+}
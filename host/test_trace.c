@@ -0,0 +1,62 @@
+// A register trace recorded over DisplayInit and the first modeset on the
+// simulator, then replayed into a reset simulator: every read has to come back
+// as recorded. The published table is left in build/test_trace.bin for the
+// check target to feed to trace_replay.
+#include <Uefi.h>
+#include "../i915_display.h"
+#include "../i915_mmio.h"
+#include "../i915_sim.h"
+#include "../i915_trace.h"
+#include "../intel_opregion.h"
+#include "host.h"
+
+int main(void)
+{
+    STATIC i915_CONTROLLER c;
+    STATIC struct intel_opregion op;
+    STATIC I915_MODE modes[16];
+    I915_TRACE *trace;
+    UINT32 count;
+    FILE *file;
+
+    HostReset();
+    c.opRegion = &op;
+    c.gmadr = 0x100000;
+    c.fbBackingSize = 1920 * 1080 * 4 * 2;
+    HOST_CHECK_EQ(i915MmioInit(&c, I915_MMIO_BACKEND_SIM), EFI_SUCCESS);
+    HOST_CHECK_EQ(i915TraceAttach(&c), EFI_SUCCESS);
+    c.is_gvt = c.read64(0x78000) == 0x4776544776544776ULL;
+    HOST_CHECK_EQ(DisplayInit(&c), EFI_SUCCESS);
+    count = i915BuildModeList(&c, modes, ARRAY_SIZE(modes));
+    HOST_CHECK(count > 0);
+    HOST_CHECK_EQ(setDisplayGraphicsMode(&modes[0]), EFI_SUCCESS);
+
+    HOST_CHECK_EQ(i915TracePublish(), EFI_SUCCESS);
+    trace = HostGetConfigurationTable(&gI915MmioTraceGuid);
+    HOST_CHECK(trace != NULL);
+    if (trace == NULL)
+    {
+        return HOST_RESULT("test_trace");
+    }
+    HOST_CHECK_EQ(trace->Signature, I915_TRACE_SIGNATURE);
+    HOST_CHECK(trace->Count > 100);
+    HOST_CHECK_EQ(trace->Dropped, 0);
+
+    i915SimReset();
+    HOST_CHECK_EQ(i915TraceReplay(trace), 0);
+    // a device that read back something else is reported
+    trace->Records[trace->Count - 1].RegOp = I915_TRACE_READ32 << 24 | SFUSE_STRAP;
+    trace->Records[trace->Count - 1].Value = 0;
+    i915SimReset();
+    HOST_CHECK_EQ(i915TraceReplay(trace), 1);
+    trace->Count--;
+
+    file = fopen("build/test_trace.bin", "wb");
+    HOST_CHECK(file != NULL);
+    if (file != NULL)
+    {
+        HOST_CHECK_EQ(fwrite(trace, sizeof(*trace) + trace->Count * sizeof(I915_TRACE_RECORD), 1, file), 1);
+        fclose(file);
+    }
+    return HOST_RESULT("test_trace");
+}
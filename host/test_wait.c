@@ -0,0 +1,142 @@
+// Register waits that straddle a wrap of the 24 bit ACPI PM timer, which
+// happens every 4.7 s of uptime. The waits run on the TSC and leave the PM
+// timer alone once the TSC rate is known. Also the wait on several registers
+// under one deadline that the connector probe uses, and the polled waits the
+// bring-up steps through.
+#include <Uefi.h>
+#include "../i915_wait.h"
+#include "host.h"
+
+// the status register turns ready once the clock passes g_ready_ns
+#define TEST_STATUS_REG 0x1000
+#define TEST_STATUS_REG2 0x1100
+#define TEST_READY (1u << 0)
+
+STATIC UINT64 g_ready_ns;
+STATIC UINT64 g_ready2_ns;
+
+STATIC UINT32 TestRead32(UINT64 reg)
+{
+    return HostNowNs() >= (reg == TEST_STATUS_REG2 ? g_ready2_ns : g_ready_ns) ? TEST_READY : 0;
+}
+
+STATIC VOID TestWrite32(UINT64 reg, UINT32 data)
+{
+}
+
+// the first ns at which the PM timer reads ticks
+STATIC UINT64 TestNsAtTick(UINT64 ticks)
+{
+    return (ticks * 1000000000ull + HOST_PM_TIMER_HZ - 1) / HOST_PM_TIMER_HZ;
+}
+
+int main(void)
+{
+    STATIC i915_CONTROLLER c;
+    CONST UINT64 regs[] = {TEST_STATUS_REG, TEST_STATUS_REG2};
+    UINT32 last[2];
+    EFI_STATUS status;
+    UINT64 t0;
+    UINTN reads;
+
+    HostReset();
+    c.read32 = TestRead32;
+    c.write32 = TestWrite32;
+
+    HOST_CHECK_EQ(i915CounterTicks(HOST_PM_TIMER_MASK - 2, 5), 8);
+    HOST_CHECK_EQ(i915CounterTicks(5, 5), 0);
+
+    // ready 2 ms in, 16 ticks before the wrap at the start
+    t0 = TestNsAtTick(HOST_PM_TIMER_MASK - 16);
+    HostSetNowNs(t0);
+    g_ready_ns = t0 + 2000000;
+    status = i915WaitForRegister(&c, I915_WAIT_PANEL, TEST_STATUS_REG, TEST_READY, TEST_READY, 10000, NULL);
+    HOST_CHECK_EQ(status, EFI_SUCCESS);
+    HOST_CHECK(HostNowNs() >= g_ready_ns);
+
+    // the TSC rate is known now, polling does not touch the PM timer
+    reads = HostPerformanceCounterReads();
+    g_ready_ns = HostNowNs() + 500000;
+    status = i915WaitForRegister(&c, I915_WAIT_PANEL, TEST_STATUS_REG, TEST_READY, TEST_READY, 10000, NULL);
+    HOST_CHECK_EQ(status, EFI_SUCCESS);
+    HOST_CHECK_EQ(HostPerformanceCounterReads(), reads);
+
+    // never ready, the 2 ms timeout is still measured across the wrap
+    t0 = TestNsAtTick(HOST_PM_TIMER_MASK + 1 - 16) + 5 * TestNsAtTick(HOST_PM_TIMER_MASK + 1);
+    HostSetNowNs(t0);
+    g_ready_ns = MAX_UINT64;
+    status = i915WaitForRegister(&c, I915_WAIT_PANEL, TEST_STATUS_REG, TEST_READY, TEST_READY, 2000, NULL);
+    HOST_CHECK_EQ(status, EFI_TIMEOUT);
+    HOST_CHECK(HostNowNs() - t0 >= 2000000);
+    HOST_CHECK(HostNowNs() - t0 < 4000000);
+
+    // a wait longer than a whole timer period still runs its full timeout
+    t0 = HostNowNs();
+    status = i915WaitForRegister(&c, I915_WAIT_PANEL, TEST_STATUS_REG, TEST_READY, TEST_READY, 6000000, NULL);
+    HOST_CHECK_EQ(status, EFI_TIMEOUT);
+    HOST_CHECK(HostNowNs() - t0 >= 6000000000ull);
+    HOST_CHECK(HostNowNs() - t0 < 6010000000ull);
+
+    // several registers: the wait ends once the last one is ready and reports
+    // each register's final read, a timeout what each one read last
+    t0 = HostNowNs();
+    g_ready_ns = t0 + 100000;
+    g_ready2_ns = t0 + 1000000;
+    status = i915WaitForRegisters(&c, I915_WAIT_AUX, regs, 2, TEST_READY, TEST_READY, 10000, last);
+    HOST_CHECK_EQ(status, EFI_SUCCESS);
+    HOST_CHECK(HostNowNs() >= g_ready2_ns);
+    HOST_CHECK_EQ(last[0], TEST_READY);
+    HOST_CHECK_EQ(last[1], TEST_READY);
+    t0 = HostNowNs();
+    g_ready2_ns = MAX_UINT64;
+    status = i915WaitForRegisters(&c, I915_WAIT_AUX, regs, 2, TEST_READY, TEST_READY, 2000, last);
+    HOST_CHECK_EQ(status, EFI_TIMEOUT);
+    HOST_CHECK_EQ(last[0], TEST_READY);
+    HOST_CHECK_EQ(last[1], 0);
+    HOST_CHECK_EQ(i915WaitForRegisters(&c, I915_WAIT_AUX, regs, 0, TEST_READY, TEST_READY, 2000, last),
+                  EFI_INVALID_PARAMETER);
+
+    // a polled wait reads once per call and never stalls
+    {
+        I915_WAIT wait;
+        UINTN polls = 0;
+
+        t0 = HostNowNs();
+        g_ready_ns = t0 + 300000;
+        i915WaitBegin(&wait, I915_WAIT_PANEL, TEST_STATUS_REG, TEST_READY, TEST_READY, 10000);
+        while ((status = i915WaitPoll(&c, &wait)) == EFI_NOT_READY)
+        {
+            HOST_CHECK(HostNowNs() < g_ready_ns);
+            HostSetNowNs(HostNowNs() + 100000);
+            polls++;
+        }
+        HOST_CHECK_EQ(status, EFI_SUCCESS);
+        HOST_CHECK_EQ(polls, 3);
+        HOST_CHECK_EQ(wait.lastValue, TEST_READY);
+        HOST_CHECK_EQ(i915WaitComplete(&c, &wait), EFI_SUCCESS);
+
+        g_ready_ns = MAX_UINT64;
+        i915WaitBegin(&wait, I915_WAIT_PANEL, TEST_STATUS_REG, TEST_READY, TEST_READY, 1000);
+        HOST_CHECK_EQ(i915WaitPoll(&c, &wait), EFI_NOT_READY);
+        HostSetNowNs(HostNowNs() + 1100000);
+        HOST_CHECK_EQ(i915WaitPoll(&c, &wait), EFI_TIMEOUT);
+
+        // completing sits out only what is left of the timeout or delay
+        t0 = HostNowNs();
+        i915WaitBegin(&wait, I915_WAIT_PANEL, TEST_STATUS_REG, TEST_READY, TEST_READY, 2000);
+        HostSetNowNs(t0 + 1500000);
+        HOST_CHECK_EQ(i915WaitComplete(&c, &wait), EFI_TIMEOUT);
+        HOST_CHECK(HostNowNs() - t0 >= 2000000);
+        HOST_CHECK(HostNowNs() - t0 < 3000000);
+
+        t0 = HostNowNs();
+        i915WaitDelay(&wait, 500);
+        HOST_CHECK_EQ(i915WaitPoll(&c, &wait), EFI_NOT_READY);
+        HostSetNowNs(t0 + 200000);
+        HOST_CHECK_EQ(i915WaitComplete(&c, &wait), EFI_SUCCESS);
+        HOST_CHECK(HostNowNs() - t0 >= 500000);
+        HOST_CHECK(HostNowNs() - t0 < 510000);
+    }
+
+    return HOST_RESULT("test_wait");
+}
@@ -0,0 +1,114 @@
+// Offline analysis of a register trace dumped from a guest: the I915_TRACE
+// table the driver publishes under gI915MmioTraceGuid, saved as raw bytes.
+// Prints what i915TraceAnalyse finds and replays the trace against the
+// simulator.
+//
+//   trace_replay [-d] trace.bin
+//
+// -d attaches the simulated DP sink on AUX B for the replay, without it the
+// simulator has the GVT-g HDMI sink only. Exits 0 when every read matched, 1
+// when some differed and 2 when the file is not a usable trace.
+#include <Uefi.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../i915_display.h"
+#include "../i915_sim.h"
+#include "../i915_trace.h"
+#include "../intel_opregion.h"
+#include "host.h"
+
+STATIC I915_TRACE *LoadTrace(CONST char *path)
+{
+    FILE *file = fopen(path, "rb");
+    I915_TRACE header;
+    I915_TRACE *trace;
+    size_t size;
+
+    if (file == NULL)
+    {
+        perror(path);
+        return NULL;
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.Signature != I915_TRACE_SIGNATURE)
+    {
+        fprintf(stderr, "%s: no trace signature\n", path);
+        fclose(file);
+        return NULL;
+    }
+    // Length is the buffer the driver allocated, only Count records are used
+    size = sizeof(header) + (size_t)header.Count * sizeof(I915_TRACE_RECORD);
+    if (header.Count > (header.Length - sizeof(header)) / sizeof(I915_TRACE_RECORD) ||
+        (trace = malloc(size)) == NULL)
+    {
+        fprintf(stderr, "%s: %u records do not fit a %u byte trace\n", path, header.Count, header.Length);
+        fclose(file);
+        return NULL;
+    }
+    memcpy(trace, &header, sizeof(header));
+    if (fread(trace->Records, sizeof(I915_TRACE_RECORD), header.Count, file) != header.Count)
+    {
+        fprintf(stderr, "%s: truncated after the header\n", path);
+        free(trace);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    return trace;
+}
+
+int main(int argc, char **argv)
+{
+    I915_SIM_DP_SINK sink = {
+        .AuxCh = AUX_CH_B,
+        .DpcdRev = DP_DPCD_REV_12,
+        .MaxLinkBw = DP_LINK_BW_5_4,
+        .MaxLanes = 4,
+    };
+    BOOLEAN dp = FALSE;
+    CONST char *path = NULL;
+    I915_TRACE *trace;
+    UINT32 mismatches;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-d") == 0)
+        {
+            dp = TRUE;
+        }
+        else if (path == NULL && argv[i][0] != '-')
+        {
+            path = argv[i];
+        }
+        else
+        {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL)
+    {
+        fprintf(stderr, "usage: %s [-d] trace.bin\n", argv[0]);
+        return 2;
+    }
+    // the analysis goes out through the driver's debug output
+    setenv("I915_HOST_VERBOSE", "1", 1);
+    trace = LoadTrace(path);
+    if (trace == NULL)
+    {
+        return 2;
+    }
+    HostReset();
+    printf("%s: %u accesses, %u dropped, TSC at %llu Hz\n", path, trace->Count, trace->Dropped,
+           (unsigned long long)trace->TscFrequency);
+    fflush(stdout);
+    i915TraceAnalyse(trace);
+    i915SimReset();
+    if (dp)
+    {
+        i915SimDpAttach(&sink);
+    }
+    mismatches = i915TraceReplay(trace);
+    printf("%s: %u of %u accesses read differently on the simulator\n", path, mismatches, trace->Count);
+    free(trace);
+    return mismatches ? 1 : 0;
+}
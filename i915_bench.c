@@ -0,0 +1,347 @@
+#include <Uefi.h>
+#include "i915_bench.h"
+#include "i915_blt.h"
+#include "i915_cache.h"
+#include "i915_debug.h"
+#include "i915_display.h"
+#include "i915_sim.h"
+#include "i915_wait.h"
+#include "intel_opregion.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/FrameBufferBltLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+//TSC based, the PM timer behind the performance counter wraps every 4.7 s
+UINT64 i915BenchNow(VOID)
+{
+    return AsmReadTsc();
+}
+
+UINT64 i915BenchElapsedNs(UINT64 start)
+{
+    return i915TscToNs(AsmReadTsc() - start);
+}
+
+//Fills a width x height surface with a solid color the way a full-screen
+//VideoFill would and logs the average time per fill and the throughput.
+VOID i915BenchFill(CONST CHAR8 *label, EFI_PHYSICAL_ADDRESS base, UINTN pitch,
+                   UINT32 width, UINT32 height, UINTN iterations)
+{
+    UINTN i, y;
+    UINT64 start, ns, bytes;
+
+    if (iterations == 0)
+    {
+        return;
+    }
+    start = i915BenchNow();
+    for (i = 0; i < iterations; i++)
+    {
+        for (y = 0; y < height; y++)
+        {
+            SetMem32((VOID *)(UINTN)(base + y * pitch), width * 4,
+                     (i & 1) ? 0x00000000u : 0x00202020u);
+        }
+    }
+    ns = i915BenchElapsedNs(start) / iterations;
+    bytes = (UINT64)width * height * 4;
+    PRINT_DEBUG(EFI_D_ERROR, "bench %a: %ux%u fill %lu us, %lu MB/s\n", label,
+                width, height, ns / 1000, ns ? bytes * 1000 / ns : 0);
+}
+
+STATIC CONST struct
+{
+    UINT32 width;
+    UINT32 height;
+} g_bench_sizes[] = {
+    {1280, 720},
+    {1920, 1080},
+    {2560, 1440},
+    {3840, 2160},
+};
+
+#define BENCH_BLT_ITERATIONS 4
+
+//Times one full-screen operation through FrameBufferBltLib or the driver Blt
+//engine and returns the average in nanoseconds.
+STATIC UINT64 i915BenchBltOp(FRAME_BUFFER_CONFIGURE *lib, I915_BLT_SURFACE *surface,
+                             EFI_GRAPHICS_OUTPUT_BLT_PIXEL *buffer,
+                             EFI_GRAPHICS_OUTPUT_BLT_OPERATION op, UINT32 width, UINT32 height)
+{
+    UINTN i;
+    UINT64 start;
+    //video-to-video is measured as a 16 line scroll, like a text console
+    UINTN sy = op == EfiBltVideoToVideo ? 16 : 0;
+    UINTN h = height - sy;
+
+    start = i915BenchNow();
+    for (i = 0; i < BENCH_BLT_ITERATIONS; i++)
+    {
+        if (lib != NULL)
+        {
+            FrameBufferBlt(lib, buffer, op, 0, sy, 0, 0, width, h, 0);
+        }
+        else
+        {
+            i915Blt(surface, buffer, op, 0, sy, 0, 0, width, h, 0);
+        }
+    }
+    return i915BenchElapsedNs(start) / BENCH_BLT_ITERATIONS;
+}
+
+#define BENCH_BLT_CHECK_ROWS 4
+
+//Draws into a rectangle one pixel in from each edge through the engine. On
+//the even widths above every row starts off 8 byte alignment and, after the
+//first pixel, ends on a lone one. Each operation is checked pixel by pixel
+//against a plain loop, the pixels around the rectangle have to be untouched.
+STATIC BOOLEAN i915BenchBltCheck(I915_BLT_SURFACE *surface, EFI_GRAPHICS_OUTPUT_BLT_PIXEL *buffer)
+{
+    STATIC CONST CHAR8 *names[] = {"buffer-to-video", "fill", "scroll"};
+    UINT32 *video = (UINT32 *)surface->Base;
+    UINT32 *source = (UINT32 *)buffer;
+    UINT32 *expected;
+    UINTN stride = surface->Pitch / sizeof(UINT32);
+    UINTN width = surface->Width - 2;
+    UINTN bytes = stride * (BENCH_BLT_CHECK_ROWS + 2) * sizeof(UINT32);
+    UINT32 fill = 0x00123456u;
+    BOOLEAN ok = TRUE;
+    UINTN i, x, y;
+
+    expected = AllocatePool(bytes);
+    if (expected == NULL)
+    {
+        return FALSE;
+    }
+    for (i = 0; i < width * BENCH_BLT_CHECK_ROWS; i++)
+    {
+        source[i] = (UINT32)i * 0x01010101u + 0x00030507u;
+    }
+    SetMem32(video, bytes, 0xDEADBEEFu);
+    SetMem32(expected, bytes, 0xDEADBEEFu);
+
+    for (i = 0; i < ARRAY_SIZE(names) && ok; i++)
+    {
+        switch (i)
+        {
+        case 0:
+            i915Blt(surface, buffer, EfiBltBufferToVideo, 0, 0, 1, 1, width, BENCH_BLT_CHECK_ROWS, 0);
+            break;
+        case 1:
+            i915Blt(surface, (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)&fill, EfiBltVideoFill, 0, 0, 1, 1, width,
+                    BENCH_BLT_CHECK_ROWS, 0);
+            break;
+        default:
+            //back to the picture, then up by one row; the last row stays
+            i915Blt(surface, buffer, EfiBltBufferToVideo, 0, 0, 1, 1, width, BENCH_BLT_CHECK_ROWS, 0);
+            i915Blt(surface, NULL, EfiBltVideoToVideo, 1, 2, 1, 1, width, BENCH_BLT_CHECK_ROWS - 1, 0);
+            break;
+        }
+        for (y = 0; y < BENCH_BLT_CHECK_ROWS; y++)
+        {
+            UINTN row = i == 0 ? y : MIN(y + 1, BENCH_BLT_CHECK_ROWS - 1);
+
+            for (x = 0; x < width; x++)
+            {
+                expected[(y + 1) * stride + 1 + x] = i == 1 ? fill : source[row * width + x];
+            }
+        }
+        if (CompareMem(video, expected, bytes) != 0)
+        {
+            PRINT_ERROR("bench blt %ux%u %a: engine drew a wrong pixel\n", surface->Width, surface->Height,
+                        names[i]);
+            ok = FALSE;
+        }
+    }
+    FreePool(expected);
+    return ok;
+}
+
+//Compares FrameBufferBltLib against the driver Blt engine on system-RAM
+//surfaces of the common panel sizes. The engine surface is marked streaming
+//so the same kernels as for the aperture are measured, and what they draw
+//is checked. Returns EFI_DEVICE_ERROR if a check fails.
+EFI_STATUS i915BenchBlt(VOID)
+{
+    STATIC CONST EFI_GRAPHICS_OUTPUT_BLT_OPERATION ops[] = {
+        EfiBltVideoFill, EfiBltBufferToVideo, EfiBltVideoToBltBuffer, EfiBltVideoToVideo};
+    STATIC CONST CHAR8 *names[] = {"fill", "buffer-to-video", "video-to-buffer", "scroll"};
+    EFI_GRAPHICS_OUTPUT_MODE_INFORMATION info;
+    I915_BLT_SURFACE surface;
+    FRAME_BUFFER_CONFIGURE *lib;
+    UINTN libSize;
+    UINTN i, j, bytes;
+    UINT8 *video;
+    EFI_GRAPHICS_OUTPUT_BLT_PIXEL *buffer;
+    UINT64 libNs, engineNs;
+    EFI_STATUS Result = EFI_SUCCESS;
+
+    for (i = 0; i < ARRAY_SIZE(g_bench_sizes); i++)
+    {
+        ZeroMem(&info, sizeof(info));
+        info.HorizontalResolution = g_bench_sizes[i].width;
+        info.VerticalResolution = g_bench_sizes[i].height;
+        info.PixelsPerScanLine = g_bench_sizes[i].width;
+        info.PixelFormat = PixelBlueGreenRedReserved8BitPerColor;
+        bytes = (UINTN)info.PixelsPerScanLine * info.VerticalResolution * 4;
+
+        video = AllocatePages(EFI_SIZE_TO_PAGES(bytes));
+        buffer = AllocatePages(EFI_SIZE_TO_PAGES(bytes));
+        lib = NULL;
+        libSize = 0;
+        if (video == NULL || buffer == NULL ||
+            FrameBufferBltConfigure(video, &info, NULL, &libSize) != RETURN_BUFFER_TOO_SMALL ||
+            (lib = AllocatePool(libSize)) == NULL ||
+            EFI_ERROR(FrameBufferBltConfigure(video, &info, lib, &libSize)))
+        {
+            PRINT_DEBUG(EFI_D_ERROR, "bench blt: skipping %ux%u\n",
+                        info.HorizontalResolution, info.VerticalResolution);
+            goto Next;
+        }
+        SetMem32(buffer, bytes, 0x00406080u);
+        i915BltSurfaceInit(&surface, video, &info, TRUE);
+
+        for (j = 0; j < ARRAY_SIZE(ops); j++)
+        {
+            libNs = i915BenchBltOp(lib, NULL, buffer, ops[j],
+                                   info.HorizontalResolution, info.VerticalResolution);
+            engineNs = i915BenchBltOp(NULL, &surface, buffer, ops[j],
+                                      info.HorizontalResolution, info.VerticalResolution);
+            PRINT_DEBUG(EFI_D_ERROR, "bench blt %ux%u %a: lib %lu us, engine %lu us\n",
+                        info.HorizontalResolution, info.VerticalResolution, names[j],
+                        libNs / 1000, engineNs / 1000);
+        }
+        if (!i915BenchBltCheck(&surface, buffer))
+        {
+            Result = EFI_DEVICE_ERROR;
+        }
+
+    Next:
+        if (lib != NULL)
+        {
+            FreePool(lib);
+        }
+        if (buffer != NULL)
+        {
+            FreePages(buffer, EFI_SIZE_TO_PAGES(bytes));
+        }
+        if (video != NULL)
+        {
+            FreePages(video, EFI_SIZE_TO_PAGES(bytes));
+        }
+    }
+    return Result;
+}
+
+//a 1920x1080 60 Hz mode, in 10 kHz units
+#define BENCH_LINK_PIXEL_CLOCK 14850
+
+//Simulated DP sinks and the link training has to end up with for the mode
+//above: the widest link at the lowest rate the sink can carry it on, or
+//what the fallback from a link that does not lock leads to.
+STATIC CONST struct
+{
+    CONST CHAR8 *name;
+    I915_SIM_DP_SINK sink;
+    UINT32 linkRate;
+    UINT8 laneCount;
+} g_bench_links[] = {
+    {"hbr2 x4", {.DpcdRev = DP_DPCD_REV_12, .MaxLinkBw = DP_LINK_BW_5_4, .MaxLanes = 4}, 162000, 4},
+    {"levels 2/1 stepwise",
+     {.DpcdRev = DP_DPCD_REV_12, .MaxLinkBw = DP_LINK_BW_5_4, .MaxLanes = 4, .Vswing = 2, .PreEmphasis = 1,
+      .AdjustStep = TRUE},
+     162000, 4},
+    {"hbr x2", {.DpcdRev = DP_DPCD_REV_12, .MaxLinkBw = DP_LINK_BW_2_7, .MaxLanes = 2}, 270000, 2},
+    {"lanes 2-3 dead", {.DpcdRev = DP_DPCD_REV_12, .MaxLinkBw = DP_LINK_BW_5_4, .MaxLanes = 4, .DeadLanes = 0xC},
+     540000, 2},
+    //the fallback ends below what the mode needs, so the cache has to refuse it
+    {"hbr x2 locks at rbr only",
+     {.DpcdRev = DP_DPCD_REV_12, .MaxLinkBw = DP_LINK_BW_2_7, .MaxLanes = 2, .MaxWorkingRate = 162000},
+     162000, 2},
+    {"defers and nacks",
+     {.DpcdRev = DP_DPCD_REV_12, .MaxLinkBw = DP_LINK_BW_5_4, .MaxLanes = 4, .DeferEvery = 3, .NackEvery = 7},
+     162000, 4},
+    {"no aux handshake",
+     {.DpcdRev = DP_DPCD_REV_12, .MaxLinkBw = DP_LINK_BW_5_4, .MaxLanes = 4, .NoAuxHandshake = TRUE},
+     162000, 4},
+};
+
+//Trains a link against each simulated sink twice, the second time as a known
+//sink, and logs the AUX traffic and time it took. A link that does not end
+//up where g_bench_links says is an error. Only meaningful on the simulator
+//backend: port B and the output path are left as the last training set
+//them, the controller's mode and DP state are restored. The trainings reach
+//the link cache in memory only, the variable is not written.
+EFI_STATUS i915BenchLinkTraining(i915_CONTROLLER *controller)
+{
+    STATIC CONST CHAR8 *runs[] = {"first", "again"};
+    struct intel_dp savedDp;
+    I915_SIM_DP_SINK savedSink;
+    I915_SIM_DP_STATS stats;
+    BOOLEAN sinkAttached;
+    EFI_STATUS Status;
+    EFI_STATUS Result = EFI_SUCCESS;
+    UINT64 start, ns;
+
+    if (controller->intel_dp == NULL)
+    {
+        return EFI_NOT_READY;
+    }
+    savedDp = *controller->intel_dp;
+    sinkAttached = i915SimDpGetSink(&savedSink);
+    i915CacheHold();
+    for (UINTN i = 0; i < ARRAY_SIZE(g_bench_links); i++)
+    {
+        I915_SIM_DP_SINK sink = g_bench_links[i].sink;
+
+        sink.AuxCh = AUX_CH_B;
+        //a sink of its own for the link cache
+        sink.Oui[0] = 0x00;
+        sink.Oui[1] = 0xbe;
+        sink.Oui[2] = (UINT8)i;
+        for (UINTN run = 0; run < ARRAY_SIZE(runs); run++)
+        {
+            struct intel_dp *intel_dp = controller->intel_dp;
+            I915_MODE savedMode = controller->mode;
+            UINT8 savedPath[sizeof(controller->OutputPath)];
+
+            CopyMem(savedPath, &controller->OutputPath, sizeof(savedPath));
+
+            i915SimDpAttach(&sink);
+            intel_dp->use_max_rate = FALSE;
+            intel_dp_dpcd_cache_invalidate(intel_dp);
+            controller->OutputPath.Port = PORT_B;
+            controller->OutputPath.ConType = DPSST;
+            controller->OutputPath.AuxCh = sink.AuxCh;
+            controller->OutputPath.LinkRate = 0;
+            controller->OutputPath.LaneCount = 0;
+            controller->mode.timing.pixelClock = BENCH_LINK_PIXEL_CLOCK;
+
+            start = i915BenchNow();
+            Status = TrainDisplayPort(controller);
+            ns = i915BenchElapsedNs(start);
+            i915SimDpGetStats(&stats);
+            PRINT_DEBUG(EFI_D_ERROR,
+                        "bench dp %a, %a: %u, %d x%u, %u trainings, %u adjusts, %u status reads, "
+                        "%u fast, %u aux (%u deferred, %u nacked), %lu us\n",
+                        g_bench_links[i].name, runs[run], Status, intel_dp->link_rate, intel_dp->lane_count,
+                        stats.TrainingStarts, stats.LaneAdjusts, stats.StatusReads, stats.FastTrains,
+                        stats.AuxTransactions, stats.Defers, stats.Nacks, ns / 1000);
+            if (EFI_ERROR(Status) || intel_dp->link_rate != (int)g_bench_links[i].linkRate ||
+                intel_dp->lane_count != g_bench_links[i].laneCount)
+            {
+                PRINT_ERROR("bench dp %a, %a: trained at %d x%u, expected %u x%u\n", g_bench_links[i].name,
+                            runs[run], intel_dp->link_rate, intel_dp->lane_count, g_bench_links[i].linkRate,
+                            g_bench_links[i].laneCount);
+                Result = EFI_DEVICE_ERROR;
+            }
+            controller->mode = savedMode;
+            CopyMem(&controller->OutputPath, savedPath, sizeof(savedPath));
+        }
+    }
+    *controller->intel_dp = savedDp;
+    i915SimDpAttach(sinkAttached ? &savedSink : NULL);
+    i915CacheRelease();
+    return Result;
+}
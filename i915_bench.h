@@ -0,0 +1,13 @@
+#ifndef i915_BENCHH
+#define i915_BENCHH
+#include <Uefi.h>
+#include "i915_controller.h"
+#include "i915_reg.h"
+
+UINT64 i915BenchNow(VOID);
+UINT64 i915BenchElapsedNs(UINT64 start);
+VOID i915BenchFill(CONST CHAR8 *label, EFI_PHYSICAL_ADDRESS base, UINTN pitch,
+                   UINT32 width, UINT32 height, UINTN iterations);
+EFI_STATUS i915BenchBlt(VOID);
+EFI_STATUS i915BenchLinkTraining(i915_CONTROLLER *controller);
+#endif
@@ -0,0 +1,321 @@
+#include <Uefi.h>
+#include "i915_blt.h"
+#include "i915_debug.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+//The DSC builds everything with -mno-sse, so there are no vector kernels
+//here. The fast path uses MOVNTI, the SSE2 non-temporal store from a general
+//purpose register. It needs no XMM state and skips the read-for-ownership and
+//cache pollution on aperture writes.
+#if defined(__GNUC__) && defined(MDE_CPU_X64)
+#define I915_BLT_HAVE_MOVNTI 1
+#else
+#define I915_BLT_HAVE_MOVNTI 0
+#endif
+
+#define I915_BLT_ROW(Surface, y) ((Surface)->Base + ((Surface)->Origin + (y)) * (Surface)->Pitch)
+
+typedef VOID (*I915_BLT_FILL_ROW)(VOID *Destination, UINTN Pixels, UINT32 Color);
+typedef VOID (*I915_BLT_COPY_ROW)(VOID *Destination, CONST VOID *Source, UINTN Bytes);
+
+STATIC VOID i915BltFillRowWide(VOID *Destination, UINTN Pixels, UINT32 Color)
+{
+    UINT32 *d32 = Destination;
+    UINT64 *d64;
+    UINT64 pattern = ((UINT64)Color << 32) | Color;
+
+    if (((UINTN)d32 & 7) != 0 && Pixels != 0)
+    {
+        *d32++ = Color;
+        Pixels--;
+    }
+    d64 = (UINT64 *)d32;
+    for (; Pixels >= 8; Pixels -= 8, d64 += 4)
+    {
+        d64[0] = pattern;
+        d64[1] = pattern;
+        d64[2] = pattern;
+        d64[3] = pattern;
+    }
+    for (; Pixels >= 2; Pixels -= 2)
+    {
+        *d64++ = pattern;
+    }
+    if (Pixels != 0)
+    {
+        *(UINT32 *)d64 = Color;
+    }
+}
+
+STATIC VOID i915BltCopyRowWide(VOID *Destination, CONST VOID *Source, UINTN Bytes)
+{
+    CopyMem(Destination, Source, Bytes);
+}
+
+#if I915_BLT_HAVE_MOVNTI
+STATIC VOID i915BltFillRowStream(VOID *Destination, UINTN Pixels, UINT32 Color)
+{
+    UINT32 *d32 = Destination;
+    UINT64 *d64;
+    UINT64 pattern = ((UINT64)Color << 32) | Color;
+
+    if (((UINTN)d32 & 7) != 0 && Pixels != 0)
+    {
+        *d32++ = Color;
+        Pixels--;
+    }
+    d64 = (UINT64 *)d32;
+    for (; Pixels >= 8; Pixels -= 8, d64 += 4)
+    {
+        __asm__ __volatile__("movnti %1, %0" : "=m"(d64[0]) : "r"(pattern));
+        __asm__ __volatile__("movnti %1, %0" : "=m"(d64[1]) : "r"(pattern));
+        __asm__ __volatile__("movnti %1, %0" : "=m"(d64[2]) : "r"(pattern));
+        __asm__ __volatile__("movnti %1, %0" : "=m"(d64[3]) : "r"(pattern));
+    }
+    for (; Pixels >= 2; Pixels -= 2, d64++)
+    {
+        __asm__ __volatile__("movnti %1, %0" : "=m"(*d64) : "r"(pattern));
+    }
+    if (Pixels != 0)
+    {
+        *(UINT32 *)d64 = Color;
+    }
+}
+
+//Rows never overlap here, callers that may overlap use CopyMem.
+STATIC VOID i915BltCopyRowStream(VOID *Destination, CONST VOID *Source, UINTN Bytes)
+{
+    UINT8 *d = Destination;
+    CONST UINT8 *s = Source;
+    UINT64 v0, v1, v2, v3;
+
+    if (((UINTN)d & 7) != 0 && Bytes >= 4)
+    {
+        *(UINT32 *)d = *(CONST UINT32 *)s;
+        d += 4;
+        s += 4;
+        Bytes -= 4;
+    }
+    for (; Bytes >= 32; Bytes -= 32, d += 32, s += 32)
+    {
+        v0 = ((CONST UINT64 *)s)[0];
+        v1 = ((CONST UINT64 *)s)[1];
+        v2 = ((CONST UINT64 *)s)[2];
+        v3 = ((CONST UINT64 *)s)[3];
+        __asm__ __volatile__("movnti %1, %0" : "=m"(((UINT64 *)d)[0]) : "r"(v0));
+        __asm__ __volatile__("movnti %1, %0" : "=m"(((UINT64 *)d)[1]) : "r"(v1));
+        __asm__ __volatile__("movnti %1, %0" : "=m"(((UINT64 *)d)[2]) : "r"(v2));
+        __asm__ __volatile__("movnti %1, %0" : "=m"(((UINT64 *)d)[3]) : "r"(v3));
+    }
+    for (; Bytes >= 8; Bytes -= 8, d += 8, s += 8)
+    {
+        v0 = *(CONST UINT64 *)s;
+        __asm__ __volatile__("movnti %1, %0" : "=m"(*(UINT64 *)d) : "r"(v0));
+    }
+    if (Bytes != 0)
+    {
+        CopyMem(d, s, Bytes);
+    }
+}
+#endif
+
+STATIC I915_BLT_FILL_ROW g_fill_row_video = i915BltFillRowWide;
+STATIC I915_BLT_COPY_ROW g_copy_row_video = i915BltCopyRowWide;
+STATIC BOOLEAN g_streaming_stores = FALSE;
+
+//Picks the row kernels for streaming surfaces from CPUID.
+VOID i915BltInit(VOID)
+{
+#if I915_BLT_HAVE_MOVNTI
+    UINT32 Edx = 0;
+
+    AsmCpuid(1, NULL, NULL, NULL, &Edx);
+    if (Edx & BIT26)
+    {
+        g_fill_row_video = i915BltFillRowStream;
+        g_copy_row_video = i915BltCopyRowStream;
+        g_streaming_stores = TRUE;
+    }
+#endif
+    PRINT_DEBUG(EFI_D_ERROR, "blt engine uses %a stores for video\n",
+                g_streaming_stores ? "non-temporal" : "cached 64-bit");
+}
+
+VOID i915BltSurfaceInit(I915_BLT_SURFACE *Surface, VOID *Base,
+                        EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *Info, BOOLEAN Streaming)
+{
+    Surface->Base = Base;
+    Surface->Pitch = Info->PixelsPerScanLine * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+    Surface->Width = Info->HorizontalResolution;
+    Surface->Height = Info->VerticalResolution;
+    Surface->Origin = 0;
+    Surface->Streaming = Streaming;
+}
+
+VOID i915BltFlushStores(VOID)
+{
+#if I915_BLT_HAVE_MOVNTI
+    if (g_streaming_stores)
+    {
+        __asm__ __volatile__("sfence" ::: "memory");
+    }
+#endif
+}
+
+//Copies Bytes into video memory with the store kernel picked for the CPU.
+//The caller issues i915BltFlushStores once it is done with the batch.
+VOID i915BltCopyToVideo(VOID *Destination, CONST VOID *Source, UINTN Bytes)
+{
+    g_copy_row_video(Destination, Source, Bytes);
+}
+
+//Fills Bytes of memory with a 32-bit pattern using the video store kernel.
+//The caller issues i915BltFlushStores once it is done with the batch.
+VOID i915BltFillVideo(VOID *Destination, UINTN Bytes, UINT32 Value)
+{
+    g_fill_row_video(Destination, Bytes / sizeof(UINT32), Value);
+}
+
+//Same contract and checks as FrameBufferBlt, for the BGRX layout this driver
+//always scans out, so no per-pixel conversion is ever needed.
+EFI_STATUS i915Blt(I915_BLT_SURFACE *Surface, EFI_GRAPHICS_OUTPUT_BLT_PIXEL *BltBuffer,
+                   EFI_GRAPHICS_OUTPUT_BLT_OPERATION BltOperation,
+                   UINTN SourceX, UINTN SourceY, UINTN DestinationX, UINTN DestinationY,
+                   UINTN Width, UINTN Height, UINTN Delta)
+{
+    I915_BLT_FILL_ROW FillRow;
+    I915_BLT_COPY_ROW CopyRow;
+    UINT8 *Source;
+    UINT8 *Destination;
+    UINTN RowBytes;
+    UINTN Index;
+    UINT32 Color;
+
+    if (Surface == NULL || Surface->Base == NULL ||
+        (UINTN)BltOperation >= EfiGraphicsOutputBltOperationMax)
+    {
+        return EFI_INVALID_PARAMETER;
+    }
+    //a video to video copy leaves BltBuffer unused, the console scrolls with NULL
+    if (BltBuffer == NULL && BltOperation != EfiBltVideoToVideo)
+    {
+        return EFI_INVALID_PARAMETER;
+    }
+    if (Width == 0 || Height == 0)
+    {
+        return EFI_INVALID_PARAMETER;
+    }
+    if (Delta == 0)
+    {
+        Delta = Width * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+    }
+    if (BltOperation == EfiBltVideoToBltBuffer || BltOperation == EfiBltVideoToVideo)
+    {
+        if (SourceX > Surface->Width || Width > Surface->Width - SourceX ||
+            SourceY > Surface->Height || Height > Surface->Height - SourceY)
+        {
+            return EFI_INVALID_PARAMETER;
+        }
+    }
+    if (BltOperation != EfiBltVideoToBltBuffer)
+    {
+        if (DestinationX > Surface->Width || Width > Surface->Width - DestinationX ||
+            DestinationY > Surface->Height || Height > Surface->Height - DestinationY)
+        {
+            return EFI_INVALID_PARAMETER;
+        }
+    }
+
+    FillRow = Surface->Streaming ? g_fill_row_video : i915BltFillRowWide;
+    CopyRow = Surface->Streaming ? g_copy_row_video : i915BltCopyRowWide;
+    RowBytes = Width * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+
+    switch (BltOperation)
+    {
+    case EfiBltVideoFill:
+        //the reserved byte is not part of the pixel, FrameBufferBlt drops it too
+        Color = *(UINT32 *)BltBuffer & 0x00FFFFFFu;
+        Destination = I915_BLT_ROW(Surface, DestinationY) +
+                      DestinationX * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+        for (Index = 0; Index < Height; Index++)
+        {
+            FillRow(Destination, Width, Color);
+            Destination += Surface->Pitch;
+        }
+        break;
+
+    case EfiBltBufferToVideo:
+        Source = (UINT8 *)BltBuffer + SourceY * Delta +
+                 SourceX * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+        Destination = I915_BLT_ROW(Surface, DestinationY) +
+                      DestinationX * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+        for (Index = 0; Index < Height; Index++)
+        {
+            CopyRow(Destination, Source, RowBytes);
+            Source += Delta;
+            Destination += Surface->Pitch;
+        }
+        break;
+
+    case EfiBltVideoToBltBuffer:
+        //the caller reads this right back, keep it in the cache
+        Source = I915_BLT_ROW(Surface, SourceY) +
+                 SourceX * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+        Destination = (UINT8 *)BltBuffer + DestinationY * Delta +
+                      DestinationX * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+        for (Index = 0; Index < Height; Index++)
+        {
+            CopyMem(Destination, Source, RowBytes);
+            Source += Surface->Pitch;
+            Destination += Delta;
+        }
+        break;
+
+    case EfiBltVideoToVideo:
+        Source = I915_BLT_ROW(Surface, SourceY) +
+                 SourceX * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+        Destination = I915_BLT_ROW(Surface, DestinationY) +
+                      DestinationX * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+        if (SourceY == DestinationY)
+        {
+            //rows may overlap sideways, let CopyMem sort out the direction
+            for (Index = 0; Index < Height; Index++)
+            {
+                CopyMem(Destination, Source, RowBytes);
+                Source += Surface->Pitch;
+                Destination += Surface->Pitch;
+            }
+            break;
+        }
+        if (DestinationY > SourceY)
+        {
+            //scrolling down, walk bottom-up so unread rows are not clobbered
+            Source += (Height - 1) * Surface->Pitch;
+            Destination += (Height - 1) * Surface->Pitch;
+            for (Index = 0; Index < Height; Index++)
+            {
+                CopyRow(Destination, Source, RowBytes);
+                Source -= Surface->Pitch;
+                Destination -= Surface->Pitch;
+            }
+            break;
+        }
+        for (Index = 0; Index < Height; Index++)
+        {
+            CopyRow(Destination, Source, RowBytes);
+            Source += Surface->Pitch;
+            Destination += Surface->Pitch;
+        }
+        break;
+
+    default:
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (Surface->Streaming)
+    {
+        i915BltFlushStores();
+    }
+    return EFI_SUCCESS;
+}
@@ -0,0 +1,30 @@
+#ifndef i915_BLTH
+#define i915_BLTH
+#include <Uefi.h>
+#include <Protocol/GraphicsOutput.h>
+#include "i915_reg.h"
+
+//A 32bpp BGRX surface the Blt engine draws into. Streaming surfaces are
+//written with non-temporal stores where the CPU has them, which is what the
+//GTT aperture wants; system-RAM surfaces keep normal cached stores.
+typedef struct
+{
+    UINT8 *Base;
+    UINTN Pitch;
+    UINT32 Width;
+    UINT32 Height;
+    UINTN Origin; //first framebuffer row of the visible window
+    BOOLEAN Streaming;
+} I915_BLT_SURFACE;
+
+VOID i915BltInit(VOID);
+VOID i915BltSurfaceInit(I915_BLT_SURFACE *Surface, VOID *Base,
+                        EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *Info, BOOLEAN Streaming);
+EFI_STATUS i915Blt(I915_BLT_SURFACE *Surface, EFI_GRAPHICS_OUTPUT_BLT_PIXEL *BltBuffer,
+                   EFI_GRAPHICS_OUTPUT_BLT_OPERATION BltOperation,
+                   UINTN SourceX, UINTN SourceY, UINTN DestinationX, UINTN DestinationY,
+                   UINTN Width, UINTN Height, UINTN Delta);
+VOID i915BltCopyToVideo(VOID *Destination, CONST VOID *Source, UINTN Bytes);
+VOID i915BltFillVideo(VOID *Destination, UINTN Bytes, UINT32 Value);
+VOID i915BltFlushStores(VOID);
+#endif
@@ -0,0 +1,322 @@
+#define I915_LOG_CATEGORY I915_LOG_DISPLAY
+#include "i915_cache.h"
+#include "i915_display.h"
+#include <Library/BaseMemoryLib.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+
+#if I915_EDID_CACHE
+//EDID bytes the sink check compares: header, vendor, product, serial and
+//manufacture date, then the extension count and the checksum that end every
+//block
+#define I915_CACHE_ID_BYTES 18
+#define I915_CACHE_EXTENSIONS_OFFSET 126
+#define I915_CACHE_CHECKSUM_OFFSET 127
+
+STATIC I915_CACHE g_cache;
+STATIC BOOLEAN g_cache_loaded = FALSE;
+STATIC I915_CACHE g_cache_held;
+STATIC BOOLEAN g_cache_hold = FALSE;
+//the mode the variable holds, set modes are only written at ReadyToBoot
+STATIC UINT32 g_cache_saved_width = 0;
+STATIC UINT32 g_cache_saved_height = 0;
+STATIC EFI_EVENT g_cache_ready_to_boot = NULL;
+
+STATIC VOID i915CacheLoad(VOID)
+{
+    UINTN size = sizeof(g_cache);
+    EFI_STATUS Status;
+
+    if (g_cache_loaded)
+    {
+        return;
+    }
+    g_cache_loaded = TRUE;
+    Status = gRT->GetVariable(I915_CACHE_VARIABLE, &gI915CacheVariableGuid, NULL, &size, &g_cache);
+    if (EFI_ERROR(Status) || size != sizeof(g_cache) || g_cache.Signature != I915_CACHE_SIGNATURE ||
+        g_cache.Version != I915_CACHE_VERSION || g_cache.Size != sizeof(g_cache))
+    {
+        PRINT_DEBUG(EFI_D_ERROR, "cache: no usable output cache (%u)\n", Status);
+        ZeroMem(&g_cache, sizeof(g_cache));
+    }
+    g_cache_saved_width = g_cache.ModeWidth;
+    g_cache_saved_height = g_cache.ModeHeight;
+}
+
+STATIC VOID i915CacheSave(VOID)
+{
+    EFI_STATUS Status;
+
+    g_cache.Signature = I915_CACHE_SIGNATURE;
+    g_cache.Version = I915_CACHE_VERSION;
+    g_cache.Size = sizeof(g_cache);
+    if (g_cache_hold)
+    {
+        return;
+    }
+    Status = gRT->SetVariable(I915_CACHE_VARIABLE, &gI915CacheVariableGuid,
+                              EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+                              sizeof(g_cache), &g_cache);
+    PRINT_DEBUG(EFI_D_ERROR, "cache: output cache written (%u)\n", Status);
+    g_cache_saved_width = g_cache.ModeWidth;
+    g_cache_saved_height = g_cache.ModeHeight;
+}
+
+//Reads from EDID block block on, at offset within it.
+STATIC EFI_STATUS i915CacheReadDdc(i915_CONTROLLER *controller, UINT32 block, UINT8 offset, UINT8 *buf,
+                                   UINT32 len)
+{
+    UINT8 segment = (UINT8)(block / 2);
+
+    offset += (UINT8)((block % 2) * 128);
+    if (g_cache.ConType == HDMI || g_cache.ConType == DVI)
+    {
+        return gmbusReadDdc(controller, (UINT8)g_cache.DdcPin, segment, offset, buf, len);
+    }
+    return ReadDDCDP(controller, (UINT8)g_cache.AuxCh, segment, offset, buf, len);
+}
+
+//The sink is taken to be the cached one if the ID bytes, the extension count
+//and the checksum of every cached block of its EDID are unchanged, a few
+//dozen bytes on the bus instead of every block.
+STATIC BOOLEAN i915CacheSinkMatches(i915_CONTROLLER *controller)
+{
+    UINT32 extensions = MIN(g_cache.ExtensionCount, (UINT32)I915_EDID_MAX_EXTENSIONS);
+    UINT8 id[I915_CACHE_ID_BYTES];
+    UINT8 tail[2];
+    UINT8 checksum;
+
+    if (EFI_ERROR(i915CacheReadDdc(controller, 0, 0, id, sizeof(id))) ||
+        EFI_ERROR(i915CacheReadDdc(controller, 0, I915_CACHE_EXTENSIONS_OFFSET, tail, sizeof(tail))) ||
+        CompareMem(id, &g_cache.Edid, sizeof(id)) != 0 || tail[0] != g_cache.Edid.numExtensions ||
+        tail[1] != g_cache.Edid.checksum)
+    {
+        return FALSE;
+    }
+    for (UINT32 i = 0; i < extensions; i++)
+    {
+        if (EFI_ERROR(i915CacheReadDdc(controller, i + 1, I915_CACHE_CHECKSUM_OFFSET, &checksum, 1)) ||
+            checksum != g_cache.Extensions[i][I915_CACHE_CHECKSUM_OFFSET])
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+#endif
+
+//Takes the output path and EDID from the cache if the sink on the cached
+//connector still matches, so the full probe can be skipped.
+EFI_STATUS i915CacheRestoreOutput(i915_CONTROLLER *controller, UINT32 strap)
+{
+#if I915_EDID_CACHE
+    i915CacheLoad();
+    if (g_cache.Signature == 0 || g_cache.Strap != strap || g_cache.IsGvt != controller->is_gvt)
+    {
+        return EFI_NOT_FOUND;
+    }
+    if (g_cache.ConType == eDP)
+    {
+        //the panel has to be powered before its AUX channel answers
+        SetupPPS(controller);
+        EnablePanelVdd(controller);
+    }
+    if (!i915CacheSinkMatches(controller))
+    {
+        PRINT_DEBUG(EFI_D_ERROR, "cache: sink on port %c changed, probing\n", 'A' + g_cache.Port);
+        if (g_cache.ConType == eDP)
+        {
+            //the probe powers the panel again if it still wants it
+            DisablePanelVdd(controller);
+        }
+        return EFI_NOT_FOUND;
+    }
+    controller->OutputPath.Port = g_cache.Port;
+    controller->OutputPath.ConType = (ConnectorType)g_cache.ConType;
+    controller->OutputPath.AuxCh = g_cache.AuxCh;
+    controller->OutputPath.DdcPin = (UINT8)g_cache.DdcPin;
+    controller->OutputPath.DPLL = 1;
+    controller->edid = g_cache.Edid;
+    controller->edidExtensionCount = MIN(g_cache.ExtensionCount, (UINT32)I915_EDID_MAX_EXTENSIONS);
+    CopyMem(controller->edidExtensions, g_cache.Extensions, sizeof(g_cache.Extensions));
+    PRINT_DEBUG(EFI_D_ERROR, "cache: using the cached sink on port %c, connector %d\n",
+                'A' + g_cache.Port, g_cache.ConType);
+    return EFI_SUCCESS;
+#else
+    return EFI_UNSUPPORTED;
+#endif
+}
+
+//Records the output setOutputPath probed. The variable is only written when
+//something changed, a VM that boots on the same monitor never writes it.
+VOID i915CacheStoreOutput(i915_CONTROLLER *controller, UINT32 strap)
+{
+#if I915_EDID_CACHE
+    I915_CACHE cache;
+
+    if ((controller->OutputPath.ConType == HDMI || controller->OutputPath.ConType == DVI) &&
+        controller->OutputPath.DdcPin == 0)
+    {
+        //the fallback EDID, there is no sink to check it against
+        return;
+    }
+    i915CacheLoad();
+    cache = g_cache;
+    cache.Strap = strap;
+    cache.IsGvt = controller->is_gvt;
+    cache.Port = controller->OutputPath.Port;
+    cache.ConType = controller->OutputPath.ConType;
+    cache.AuxCh = controller->OutputPath.AuxCh;
+    cache.DdcPin = controller->OutputPath.DdcPin;
+    cache.ExtensionCount = controller->edidExtensionCount;
+    cache.Edid = controller->edid;
+    CopyMem(cache.Extensions, controller->edidExtensions, sizeof(cache.Extensions));
+    if (CompareMem(&cache.Strap, &g_cache.Strap, sizeof(cache) - OFFSET_OF(I915_CACHE, Strap)) == 0 &&
+        g_cache.Signature != 0)
+    {
+        return;
+    }
+    if (cache.Edid.checksum != g_cache.Edid.checksum || cache.Port != g_cache.Port)
+    {
+        //a mode picked on another sink means nothing here
+        cache.ModeWidth = 0;
+        cache.ModeHeight = 0;
+    }
+    g_cache = cache;
+    i915CacheSave();
+#endif
+}
+
+BOOLEAN i915CacheGetMode(UINT32 *width, UINT32 *height)
+{
+#if I915_EDID_CACHE
+    if (g_cache.Signature == 0 || g_cache.ModeWidth == 0)
+    {
+        return FALSE;
+    }
+    *width = g_cache.ModeWidth;
+    *height = g_cache.ModeHeight;
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+#if I915_EDID_CACHE
+STATIC VOID EFIAPI i915CacheReadyToBoot(IN EFI_EVENT Event, IN VOID *Context)
+{
+    if (g_cache.Signature != 0 &&
+        (g_cache.ModeWidth != g_cache_saved_width || g_cache.ModeHeight != g_cache_saved_height))
+    {
+        i915CacheSave();
+    }
+}
+#endif
+
+//Remembers the mode GOP was last set to, for the next boot to start in. Only
+//the mode set at ReadyToBoot reaches the variable, a loader that switches
+//modes on every boot would otherwise write flash each time.
+VOID i915CacheStoreMode(UINT32 width, UINT32 height)
+{
+#if I915_EDID_CACHE
+    if (g_cache.Signature == 0)
+    {
+        return;
+    }
+    g_cache.ModeWidth = width;
+    g_cache.ModeHeight = height;
+    if (g_cache_ready_to_boot == NULL)
+    {
+        EfiCreateEventReadyToBootEx(TPL_CALLBACK, i915CacheReadyToBoot, NULL, &g_cache_ready_to_boot);
+    }
+#endif
+}
+
+#if I915_EDID_CACHE
+STATIC BOOLEAN i915CacheLinkMatches(CONST I915_CACHE_LINK *link, i915_CONTROLLER *controller, CONST UINT8 *oui)
+{
+    return link->LinkRate != 0 && CompareMem(link->Oui, oui, sizeof(link->Oui)) == 0 &&
+           CompareMem(link->EdidId, (UINT8 *)&controller->edid + I915_CACHE_EDID_ID_OFFSET,
+                      sizeof(link->EdidId)) == 0;
+}
+#endif
+
+//Looks up the link the sink on the current output last trained at.
+BOOLEAN i915CacheGetLink(i915_CONTROLLER *controller, CONST UINT8 *oui, I915_CACHE_LINK *link)
+{
+#if I915_EDID_CACHE
+    i915CacheLoad();
+    for (UINT32 i = 0; i < I915_CACHE_LINK_ENTRIES; i++)
+    {
+        if (i915CacheLinkMatches(&g_cache.Links[i], controller, oui))
+        {
+            *link = g_cache.Links[i];
+            return TRUE;
+        }
+    }
+    return FALSE;
+#else
+    return FALSE;
+#endif
+}
+
+//Remembers a successful training. The entry moves to the front, and the
+//variable is only written when the sink trained differently than last time.
+VOID i915CacheStoreLink(i915_CONTROLLER *controller, CONST UINT8 *oui, UINT32 linkRate, UINT8 laneCount,
+                        CONST UINT8 *trainSet)
+{
+#if I915_EDID_CACHE
+    I915_CACHE_LINK link;
+    UINT32 i;
+
+    i915CacheLoad();
+    if (g_cache.Signature == 0)
+    {
+        //no output record to hang the link on
+        return;
+    }
+    ZeroMem(&link, sizeof(link));
+    CopyMem(link.Oui, oui, sizeof(link.Oui));
+    CopyMem(link.EdidId, (UINT8 *)&controller->edid + I915_CACHE_EDID_ID_OFFSET, sizeof(link.EdidId));
+    link.LinkRate = linkRate;
+    link.LaneCount = laneCount;
+    CopyMem(link.TrainSet, trainSet, sizeof(link.TrainSet));
+    if (CompareMem(&g_cache.Links[0], &link, sizeof(link)) == 0)
+    {
+        return;
+    }
+    for (i = 0; i < I915_CACHE_LINK_ENTRIES - 1; i++)
+    {
+        if (i915CacheLinkMatches(&g_cache.Links[i], controller, oui))
+        {
+            break;
+        }
+    }
+    CopyMem(&g_cache.Links[1], &g_cache.Links[0], i * sizeof(link));
+    g_cache.Links[0] = link;
+    i915CacheSave();
+#endif
+}
+
+//From here on the cache only changes in memory, the variable is left alone.
+//For the bench, which trains made-up sinks that must not reach the next boot.
+VOID i915CacheHold(VOID)
+{
+#if I915_EDID_CACHE
+    i915CacheLoad();
+    g_cache_held = g_cache;
+    g_cache_hold = TRUE;
+#endif
+}
+
+//Drops what changed since i915CacheHold.
+VOID i915CacheRelease(VOID)
+{
+#if I915_EDID_CACHE
+    if (g_cache_hold)
+    {
+        g_cache = g_cache_held;
+        g_cache_hold = FALSE;
+    }
+#endif
+}
@@ -0,0 +1,59 @@
+#ifndef i915_CACHEH
+#define i915_CACHEH
+#include <Uefi.h>
+#include "i915_controller.h"
+
+#define I915_CACHE_SIGNATURE SIGNATURE_32('I', 'C', 'A', 'C')
+//bumped whenever I915_CACHE changes, an older variable is then ignored
+#define I915_CACHE_VERSION 2
+#define I915_CACHE_VARIABLE L"I915OutputCache"
+//DP sinks whose link training is remembered, the oldest entry is replaced
+#define I915_CACHE_LINK_ENTRIES 4
+//EDID bytes that tell sinks apart: vendor, product and serial number
+#define I915_CACHE_EDID_ID_OFFSET 8
+#define I915_CACHE_EDID_ID_BYTES 8
+
+//The link a DP sink last trained at, keyed by its DPCD sink OUI and EDID
+//serial. LinkRate 0 marks an unused entry.
+typedef struct
+{
+    UINT8 Oui[3];
+    UINT8 LaneCount;
+    UINT8 EdidId[I915_CACHE_EDID_ID_BYTES];
+    UINT32 LinkRate;
+    UINT8 TrainSet[4]; //DP_TRAINING_LANEx_SET, vswing and pre-emphasis per lane
+} I915_CACHE_LINK;
+
+//What the last boot found on the output, kept in a non-volatile variable
+//under gI915CacheVariableGuid. It is only trusted while the straps and the
+//connector match and the sink still returns the same EDID ID, extension
+//count and block checksums.
+typedef struct
+{
+    UINT32 Signature;
+    UINT32 Version;
+    UINT32 Size;
+    UINT32 Strap; //SFUSE_STRAP, a port that came or went shows up here
+    UINT32 IsGvt;
+    UINT32 Port;
+    UINT32 ConType;
+    UINT32 AuxCh;
+    UINT32 DdcPin;
+    UINT32 ModeWidth; //mode set at the last ReadyToBoot, 0 if there was none
+    UINT32 ModeHeight;
+    UINT32 ExtensionCount;
+    EDID Edid;
+    UINT8 Extensions[I915_EDID_MAX_EXTENSIONS][128];
+    I915_CACHE_LINK Links[I915_CACHE_LINK_ENTRIES]; //most recently trained first
+} I915_CACHE;
+
+EFI_STATUS i915CacheRestoreOutput(i915_CONTROLLER *controller, UINT32 strap);
+VOID i915CacheStoreOutput(i915_CONTROLLER *controller, UINT32 strap);
+BOOLEAN i915CacheGetMode(UINT32 *width, UINT32 *height);
+VOID i915CacheStoreMode(UINT32 width, UINT32 height);
+BOOLEAN i915CacheGetLink(i915_CONTROLLER *controller, CONST UINT8 *oui, I915_CACHE_LINK *link);
+VOID i915CacheStoreLink(i915_CONTROLLER *controller, CONST UINT8 *oui, UINT32 linkRate, UINT8 laneCount,
+                        CONST UINT8 *trainSet);
+VOID i915CacheHold(VOID);
+VOID i915CacheRelease(VOID);
+#endif
@@ -146,6 +146,27 @@ struct intel_opregion
 };
 
 #pragma pack(1)
+typedef struct
+{
+	UINT16 pixelClock;
+	UINT8 horzActive;
+	UINT8 horzBlank;
+	UINT8 horzActiveBlankMsb;
+	UINT8 vertActive;
+	UINT8 vertBlank;
+	UINT8 vertActiveBlankMsb;
+	UINT8 horzSyncOffset;
+	UINT8 horzSyncPulse;
+	UINT8 vertSync;
+	UINT8 syncMsb;
+	UINT8 dimensionWidth;
+	UINT8 dimensionHeight;
+	UINT8 dimensionMsb;
+	UINT8 horzBorder;
+	UINT8 vertBorder;
+	UINT8 features;
+} EDID_DETAILED_TIMING;
+
 typedef struct
 {
 	UINT8 magic[8];
@@ -170,30 +191,24 @@ typedef struct
 		UINT8 resolution;
 		UINT8 frequency;
 	} standardTimings[8];
-	struct
-	{
-		UINT16 pixelClock;
-		UINT8 horzActive;
-		UINT8 horzBlank;
-		UINT8 horzActiveBlankMsb;
-		UINT8 vertActive;
-		UINT8 vertBlank;
-		UINT8 vertActiveBlankMsb;
-		UINT8 horzSyncOffset;
-		UINT8 horzSyncPulse;
-		UINT8 vertSync;
-		UINT8 syncMsb;
-		UINT8 dimensionWidth;
-		UINT8 dimensionHeight;
-		UINT8 dimensionMsb;
-		UINT8 horzBorder;
-		UINT8 vertBorder;
-		UINT8 features;
-	} detailTimings[4];
+	EDID_DETAILED_TIMING detailTimings[4];
 	UINT8 numExtensions;
 	UINT8 checksum;
 } EDID;
 #pragma pack()
+
+//EDID blocks after the base block the driver keeps, for the CEA-861 timings
+#define I915_EDID_MAX_EXTENSIONS 3
+
+//One GOP mode: the timing driven on the wire and the width x height the
+//plane scans out of it. The plane is smaller than the timing for modes
+//shown centered inside a fixed panel timing.
+typedef struct
+{
+	EDID_DETAILED_TIMING timing;
+	UINT32 width;
+	UINT32 height;
+} I915_MODE;
 /*
  * The child device config, aka the display device data structure, provides a
  * description of a port and its configuration on the platform.
@@ -428,12 +443,16 @@ typedef struct
 	EFI_GRAPHICS_OUTPUT_PROTOCOL GraphicsOutput;
 	EFI_DEVICE_PATH_PROTOCOL *GopDevicePath;
 	EDID edid;
+	UINT8 edidExtensions[I915_EDID_MAX_EXTENSIONS][128];
+	UINT32 edidExtensionCount;
+	I915_MODE mode; //mode being programmed or last programmed
 	EFI_PHYSICAL_ADDRESS FbBase;
 	UINT32 stride;
 	UINT32 gmadr;
 	UINT32 is_gvt;
 	UINT8 generation;
 	UINTN fbsize;
+	UINTN fbBackingSize; //bytes of aperture backed by the GGTT at gmadr
 	void (*write32)(UINT64 reg, UINT32 data);
 	UINT32 rawclk_freq;
 	UINT32(*read32)
@@ -445,6 +464,7 @@ typedef struct
 	{
 		UINT32 Port;
 		UINT32 AuxCh;
+		UINT8 DdcPin; //GMBUS pin the HDMI EDID came from, 0 for the fallback
 		ConnectorType ConType;
 		UINT8 DPLL;
 		UINT32 LinkRate;
@@ -1,9 +1,30 @@
+#ifndef i915_DEBUGH
+#define i915_DEBUGH
 #include <Library/DebugLib.h>
+#include "i915_log.h"
 
 #ifndef DEBUG_LINE_NUMBER
 #define DEBUG_LINE_NUMBER __LINE__
 #endif
 
+//a source file can tag its messages by defining this before any include
+#ifndef I915_LOG_CATEGORY
+#define I915_LOG_CATEGORY I915_LOG_GENERAL
+#endif
+
+#if I915_LOG_DEFERRED
+//PRINT_DEBUG only goes into the ring, which is written to the debug port
+//later. ERR_LEVEL is kept for the callers, every one of them passes
+//EFI_D_ERROR whatever the message is, so the macro decides the level.
+#ifndef PRINT_DEBUG
+#define PRINT_DEBUG(ERR_LEVEL, ...) \
+    i915LogPrint(I915_LOG_INFO, I915_LOG_CATEGORY, __func__, DEBUG_LINE_NUMBER, __VA_ARGS__)
+#endif
+#define PRINT_VERBOSE(...) \
+    i915LogPrint(I915_LOG_VERBOSE, I915_LOG_CATEGORY, __func__, DEBUG_LINE_NUMBER, __VA_ARGS__)
+#define PRINT_ERROR(...) \
+    i915LogPrint(I915_LOG_ERROR, I915_LOG_CATEGORY, __func__, DEBUG_LINE_NUMBER, __VA_ARGS__)
+#else
 #ifndef PRINT_DEBUG
 #ifndef MDEPKG_NDEBUG
 //%a is used instead of %s due to specific implementations in edk2. Mainly ASCII vs unicode.
@@ -21,4 +42,8 @@
         DebugPrint(ERR_LEVEL, __VA_ARGS__);      \
     } while (0)
 #endif
-#endif
\ No newline at end of file
+#endif
+#define PRINT_VERBOSE(...) PRINT_DEBUG(EFI_D_ERROR, __VA_ARGS__)
+#define PRINT_ERROR(...) PRINT_DEBUG(EFI_D_ERROR, __VA_ARGS__)
+#endif
+#endif
@@ -1,8 +1,16 @@
+#define I915_LOG_CATEGORY I915_LOG_DISPLAY
 #include <Uefi.h>
 #include <Library/UefiBootServicesTableLib.h>
+#include <Library/BaseMemoryLib.h>
 
 #include "i915_display.h"
 #include "intel_opregion.h"
+#include "i915_wait.h"
+#include "i915_profile.h"
+#include "i915_probe.h"
+#include "i915_cache.h"
+#include "i915_fastboot.h"
+#include "i915_handoff.h"
 static i915_CONTROLLER *controller;
 STATIC UINT8 edid_fallback[] = {
     // generic 1280x720
@@ -19,7 +27,9 @@ STATIC UINT8 edid_fallback[] = {
     // 0,255,255,255,255,255,255,0,6,179,192,39,141,30,0,0,49,26,1,3,128,60,34,120,42,83,165,167,86,82,156,38,17,80,84,191,239,0,209,192,179,0,149,0,129,128,129,64,129,192,113,79,1,1,2,58,128,24,113,56,45,64,88,44,69,0,86,80,33,0,0,30,0,0,0,255,0,71,67,76,77,84,74,48,48,55,56,50,49,10,0,0,0,253,0,50,75,24,83,17,0,10,32,32,32,32,32,32,0,0,0,252,0,65,83,85,83,32,86,90,50,55,57,10,32,32,1,153,2,3,34,113,79,1,2,3,17,18,19,4,20,5,14,15,29,30,31,144,35,9,23,7,131,1,0,0,101,3,12,0,32,0,140,10,208,138,32,224,45,16,16,62,150,0,86,80,33,0,0,24,1,29,0,114,81,208,30,32,110,40,85,0,86,80,33,0,0,30,1,29,0,188,82,208,30,32,184,40,85,64,86,80,33,0,0,30,140,10,208,144,32,64,49,32,12,64,85,0,86,80,33,0,0,24,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,237
 };
 
-STATIC INTN g_already_set = 0;
+//timing currently on the wire, as it was requested
+STATIC EDID_DETAILED_TIMING g_active_timing;
+STATIC BOOLEAN g_timing_active = FALSE;
 
 EFI_STATUS SetupClocks()
 {
@@ -173,6 +183,26 @@ EFI_STATUS ConfigureTransMSAMISC()
                                  TRANS_MSA_8_BPC); // Sets MSA MISC FIelds for DP
     return EFI_SUCCESS;
 }
+//TRANS_DDI sync polarity bits for timing. EDID only gives polarities for
+//digital separate sync, anything else is driven positive.
+UINT32 TransDDISyncFlags(CONST EDID_DETAILED_TIMING *timing)
+{
+    UINT8 features = timing->features;
+    UINT32 flags = 0;
+    if ((features & 0x18) != 0x18)
+    {
+        return TRANS_DDI_PHSYNC | TRANS_DDI_PVSYNC;
+    }
+    if (features & 0x2)
+    {
+        flags |= TRANS_DDI_PHSYNC;
+    }
+    if (features & 0x4)
+    {
+        flags |= TRANS_DDI_PVSYNC;
+    }
+    return flags;
+}
 EFI_STATUS ConfigureTransDDI()
 {
     UINT32 port = controller->OutputPath.Port;
@@ -182,20 +212,20 @@ EFI_STATUS ConfigureTransDDI()
     case HDMI:
         controller->write32(_TRANS_DDI_FUNC_CTL_A,
                             (TRANS_DDI_FUNC_ENABLE | TRANS_DDI_SELECT_PORT(port) |
-                             TRANS_DDI_PHSYNC | TRANS_DDI_PVSYNC | TRANS_DDI_BPC_8 |
+                             TransDDISyncFlags(&controller->mode.timing) | TRANS_DDI_BPC_8 |
                              TRANS_DDI_MODE_SELECT_HDMI));
         break;
     case eDP:
         controller->write32(_TRANS_DDI_FUNC_CTL_EDP,
                             (TRANS_DDI_FUNC_ENABLE | TRANS_DDI_SELECT_PORT(port) |
-                             TRANS_DDI_BPC_8 |
+                             TransDDISyncFlags(&controller->mode.timing) | TRANS_DDI_BPC_8 |
                              TRANS_DDI_MODE_SELECT_DP_SST | ((controller->OutputPath.LaneCount - 1) << 1)));
         break;
     default:
         controller->write32(_TRANS_DDI_FUNC_CTL_A,
                             (TRANS_DDI_FUNC_ENABLE | TRANS_DDI_SELECT_PORT(port) |
-                             TRANS_DDI_PHSYNC | TRANS_DDI_PVSYNC | TRANS_DDI_BPC_8 |
-                             TRANS_DDI_MODE_SELECT_DP_SST));
+                             TransDDISyncFlags(&controller->mode.timing) | TRANS_DDI_BPC_8 |
+                             TRANS_DDI_MODE_SELECT_DP_SST | ((controller->OutputPath.LaneCount - 1) << 1)));
         break;
     }
     PRINT_DEBUG(EFI_D_ERROR, "REG TransDDI: %08x\n", controller->read32(_TRANS_DDI_FUNC_CTL_EDP));
@@ -289,20 +319,16 @@ EFI_STATUS EnableDDI()
 }
 EFI_STATUS SetupAndEnablePlane()
 {
-    UINT32 horz_active =
-        controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzActive |
-        ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION]
-                      .horzActiveBlankMsb >>
-                  4)
-         << 8);
-    UINT32 vert_active =
-        controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertActive |
-        ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertActiveBlankMsb >> 4) << 8);
+    UINT32 horz_active = controller->mode.width;
+    UINT32 vert_active = controller->mode.height;
+    // modes smaller than the timing are centered in it
+    UINT32 horz_pos = (i915TimingWidth(&controller->mode.timing) - horz_active) / 2;
+    UINT32 vert_pos = (i915TimingHeight(&controller->mode.timing) - vert_active) / 2;
     // plane
     UINT32 stride = (horz_active * 4 + 63) & -64;
     controller->stride = stride;
     controller->write32(_DSPAOFFSET, 0);
-    controller->write32(_DSPAPOS, 0);
+    controller->write32(_DSPAPOS, (vert_pos << 16) | horz_pos);
     controller->write32(_DSPASTRIDE, stride >> 6);
     controller->write32(_DSPASIZE, (horz_active - 1) | ((vert_active - 1) << 16));
     controller->write32(_DSPACNTR, DISPLAY_PLANE_ENABLE |
@@ -321,6 +347,14 @@ EFI_STATUS SetupAndEnablePlane()
                 controller->read32(_DSPACNTR), controller->FbBase);
     return EFI_SUCCESS;
 }
+//Scans the plane out from row y of the framebuffer. Takes effect at the next
+//vblank, the surface write is what arms the double-buffered plane registers.
+EFI_STATUS setDisplayPanOffset(UINT32 y)
+{
+    controller->write32(_DSPAOFFSET, y << 16);
+    controller->write32(_DSPASURF, controller->gmadr);
+    return EFI_SUCCESS;
+}
 static BOOLEAN isCurrentPortPresent(enum port port, UINT32 found)
 {
     switch (port)
@@ -338,122 +372,240 @@ static BOOLEAN isCurrentPortPresent(enum port port, UINT32 found)
         return false;
     }
 }
-static EFI_STATUS setOutputPath(i915_CONTROLLER *controller, UINT32 found)
+//the eDP code keeps a pointer to this past setOutputPath
+STATIC struct intel_dp g_intel_dp;
+
+enum
+{
+    EDID_READ_BASE,
+    EDID_READ_EXTENSIONS,
+};
+
+STATIC VOID readEdidBusBegin(I915_EDID_READ *read, UINT32 first, UINT32 count, UINT8 *buf)
 {
-    EFI_STATUS Status = EFI_SUCCESS;
+    if (read->dp)
+    {
+        intel_dp_read_edid_begin(&read->aux, read->pin, first, count, buf);
+    }
+    else
+    {
+        gmbusReadEdidBegin(&read->gmbus, read->pin, first, count, buf);
+    }
+}
+
+STATIC EFI_STATUS readEdidBusStep(I915_EDID_READ *read, I915_WAIT *wait)
+{
+    return read->dp ? intel_dp_read_ddc_step(controller, &read->aux, wait)
+                    : gmbusReadStep(controller, &read->gmbus, wait);
+}
+
+STATIC VOID readEdidBegin(I915_EDID_READ *read, BOOLEAN dp, UINT8 pin, EDID *result)
+{
+    PRINT_DEBUG(EFI_D_ERROR, dp ? "trying DP aux %d\n" : "trying pin %d\n", pin);
+    read->dp = dp;
+    read->pin = pin;
+    read->result = result;
+    read->phase = EDID_READ_BASE;
+    read->extensions = 0;
+    controller->edidExtensionCount = 0;
+    readEdidBusBegin(read, 0, 1, (UINT8 *)result);
+}
+
+//Block 0 has to read back with the EDID header, extensions that fail to read
+//are left out.
+STATIC EFI_STATUS readEdidStep(I915_EDID_READ *read, I915_WAIT *wait)
+{
+    EFI_STATUS Status = readEdidBusStep(read, wait);
+
+    if (Status == EFI_NOT_READY)
+    {
+        return Status;
+    }
+    if (read->phase == EDID_READ_BASE)
+    {
+        if (EFI_ERROR(Status))
+        {
+            return EFI_NOT_FOUND;
+        }
+        i915LogHexDump(I915_LOG_CATEGORY, read->result, 128);
+        if (*(UINT64 *)read->result->magic != 0x00FFFFFFFFFFFF00uLL)
+        {
+            return EFI_NOT_FOUND;
+        }
+        if (read->result->numExtensions > 0)
+        {
+            //all extensions in one go, a transaction per E-DDC segment
+            read->extensions = MIN((UINT32)read->result->numExtensions, (UINT32)I915_EDID_MAX_EXTENSIONS);
+            read->phase = EDID_READ_EXTENSIONS;
+            readEdidBusBegin(read, 1, read->extensions, controller->edidExtensions[0]);
+            return readEdidStep(read, wait);
+        }
+    }
+    else if (!EFI_ERROR(Status))
+    {
+        controller->edidExtensionCount = read->extensions;
+    }
+    if (read->dp)
+    {
+        controller->OutputPath.AuxCh = read->pin;
+    }
+    else
+    {
+        intel_hdmi_select_timing(read->result);
+    }
+    return EFI_SUCCESS;
+}
 
+//Fills in the candidates for the output probe. On GVT-g it is every GMBUS pin
+//behind port B, otherwise the VBT child devices whose port strapped present.
+STATIC VOID listOutputCandidates(I915_DISPLAY_INIT *init)
+{
+    ZeroMem(init->candidates, sizeof(init->candidates));
+    init->count = 0;
     if (controller->is_gvt)
     {
         PRINT_DEBUG(EFI_D_ERROR, "Gvt-g Detected. Trying HDMI with all GMBUS Pins\n");
 
-        EDID *result;
         controller->OutputPath.ConType = HDMI;
         controller->OutputPath.DPLL = 1;
 
         controller->OutputPath.Port = PORT_B;
-        for (int i = 1; i <= 6; i++)
+        for (UINT8 pin = 1; pin <= 6; pin++)
         {
-            Status = ReadEDIDHDMI(result, controller, i);
-            if (!Status)
-            {
-                controller->edid = *result;
-                return Status;
-            }
-            else
-            {
-                Status = ConvertFallbackEDIDToHDMIEDID(result, controller, edid_fallback);
-                if (!Status)
-                {
-                    controller->edid = *result;
-                    return Status;
-                }
-            }
+            init->candidates[init->count].port = PORT_B;
+            init->candidates[init->count].hdmi = TRUE;
+            init->candidates[init->count].ddcPin = pin;
+            init->count++;
         }
-        return EFI_NOT_FOUND;
+        return;
     }
-    for (int i = 0; i < controller->opRegion->numChildren; i++)
-    {
-        EDID *result;
 
+    for (int i = 0; i < controller->opRegion->numChildren && init->count < I915_PROBE_MAX; i++)
+    {
         struct ddi_vbt_port_info ddi_port_info = controller->vbt.ddi_port_info[i];
+        I915_PROBE_CANDIDATE *candidate = &init->candidates[init->count];
 
         PRINT_DEBUG(EFI_D_ERROR,
                     "Port %c VBT info: DVI:%d HDMI:%d DP:%d eDP:%d\n",
                     port_name(ddi_port_info.port), ddi_port_info.supports_dvi,
                     ddi_port_info.supports_hdmi, ddi_port_info.supports_dp, ddi_port_info.supports_edp);
-        // UINT32* port = &controller->OutputPath.Port;
-        if (!isCurrentPortPresent(ddi_port_info.port, found))
+        if (!isCurrentPortPresent(ddi_port_info.port, init->found))
         {
             PRINT_DEBUG(EFI_D_ERROR, "Port not connected\n");
             continue;
         }
         PRINT_DEBUG(EFI_D_ERROR, "Port Is Connected!\n");
 
-        if (ddi_port_info.supports_dp || ddi_port_info.supports_edp)
+        candidate->port = ddi_port_info.port;
+        candidate->dp = ddi_port_info.supports_dp || ddi_port_info.supports_edp;
+        candidate->edp = ddi_port_info.supports_edp;
+        candidate->hdmi = ddi_port_info.supports_dvi || ddi_port_info.supports_hdmi;
+        candidate->ddcPin = ddi_port_info.alternate_ddc_pin;
+        if (candidate->dp)
         {
-	    struct intel_dp intel_dp = {};
-	    intel_dp.controller = controller;
-	    controller->intel_dp = &intel_dp;
-            if (ddi_port_info.supports_edp)
-            {
-                Status = SetupPPS(controller);
-            }
-
-            enum aux_ch portAux = intel_bios_port_aux_ch(controller, ddi_port_info.port);
-            PRINT_DEBUG(EFI_D_ERROR, "Port is DP/EdP. Aux_ch is %d \n", portAux);
-
-            Status = ReadEDIDDP(result, controller, portAux);
-            PRINT_DEBUG(EFI_D_ERROR, "ReadEDIDDP returned %d \n", Status);
-
-            if (!Status)
-            {
+            candidate->auxCh = intel_bios_port_aux_ch(controller, ddi_port_info.port);
+            PRINT_DEBUG(EFI_D_ERROR, "Port is DP/EdP. Aux_ch is %d \n", candidate->auxCh);
+        }
+        if (candidate->edp)
+        {
+            //the panel has to be powered before its AUX channel answers a probe
+            SetupPPS(controller);
+            EnablePanelVdd(controller);
+        }
+        init->count++;
+    }
+}
 
-                controller->OutputPath.ConType = ddi_port_info.port == PORT_A ? eDP : DPSST;
-                controller->OutputPath.DPLL = 1;
-                controller->edid = *result;
-                controller->OutputPath.Port = ddi_port_info.port;
-                PRINT_DEBUG(EFI_D_ERROR, "DUsing Connector Mode: %d, On Port %d", controller->OutputPath.ConType, controller->OutputPath.Port);
+//Starts the EDID read of the next sink that answered the probe. VBT order
+//decides between sinks, and DP goes ahead of HDMI on one port. Returns
+//EFI_NOT_FOUND once no sink is left.
+STATIC EFI_STATUS nextOutputCandidate(I915_DISPLAY_INIT *init)
+{
+    for (; init->index < init->count; init->index++, init->hdmi = FALSE)
+    {
+        I915_PROBE_CANDIDATE *candidate = &init->candidates[init->index];
 
-                return Status;
-            }
+        if (!init->hdmi && candidate->dpPresent)
+        {
+            readEdidBegin(&init->edid, TRUE, candidate->auxCh, &init->result);
+            return EFI_SUCCESS;
         }
-        if (ddi_port_info.supports_dvi || ddi_port_info.supports_hdmi)
+        init->hdmi = TRUE;
+        if (candidate->hdmiPresent)
         {
-            PRINT_DEBUG(EFI_D_ERROR, "Port is HDMI. GMBUS Pin is %d \n", ddi_port_info.alternate_ddc_pin);
-
-            Status = ReadEDIDHDMI(result, controller, ddi_port_info.alternate_ddc_pin);
-            PRINT_DEBUG(EFI_D_ERROR, "ReadEDIDHDMI returned %d \n", Status);
+            PRINT_DEBUG(EFI_D_ERROR, "Port is HDMI. GMBUS Pin is %d \n", candidate->ddcPin);
+            readEdidBegin(&init->edid, FALSE, candidate->ddcPin, &init->result);
+            return EFI_SUCCESS;
+        }
+    }
+    return EFI_NOT_FOUND;
+}
 
-            if (!Status)
-            {
-                controller->OutputPath.ConType = HDMI;
-                controller->OutputPath.DPLL = 1;
-                controller->edid = *result;
+//Moves past the sink whose EDID did not read.
+STATIC VOID skipOutputCandidate(I915_DISPLAY_INIT *init)
+{
+    if (init->hdmi)
+    {
+        init->index++;
+    }
+    init->hdmi = !init->hdmi;
+}
 
-                controller->OutputPath.Port = ddi_port_info.port;
-                PRINT_DEBUG(EFI_D_ERROR, "HUsing Connector Mode: %d, On Port %d", controller->OutputPath.ConType, controller->OutputPath.Port);
+//Takes the sink whose EDID just read back as the output.
+STATIC VOID useOutputCandidate(I915_DISPLAY_INIT *init)
+{
+    if (controller->is_gvt)
+    {
+        controller->OutputPath.DdcPin = init->edid.pin;
+        controller->edid = init->result;
+        return;
+    }
+    I915_PROBE_CANDIDATE *candidate = &init->candidates[init->index];
 
-                return Status;
-            }
-        }
+    if (init->edid.dp)
+    {
+        controller->OutputPath.ConType = candidate->port == PORT_A ? eDP : DPSST;
     }
+    else
+    {
+        controller->OutputPath.ConType = HDMI;
+        controller->OutputPath.DdcPin = candidate->ddcPin;
+    }
+    controller->OutputPath.DPLL = 1;
+    controller->edid = init->result;
+    controller->OutputPath.Port = candidate->port;
+    PRINT_DEBUG(EFI_D_ERROR, "%cUsing Connector Mode: %d, On Port %d", init->edid.dp ? 'D' : 'H',
+                controller->OutputPath.ConType, controller->OutputPath.Port);
+}
+
+//Without a sink that answers the built-in EDID is used, so a headless boot
+//or one whose connector went undetected still gets a GOP. GVT-g converts it
+//for its HDMI output, bare metal keeps the output path as it is.
+STATIC EFI_STATUS noOutputCandidate(I915_DISPLAY_INIT *init)
+{
     /*
     DDI_BUF_CTL_A bit 0 detects presence of DP for DDIA/eDP
     SFUSE_STRAP FOR REST
 
     */
-    //TODO: Dynamicly get these
-    /*  controller->OutputPath.ConType = HDMI;
-    controller->OutputPath.DPLL = 1;
-
-    controller->OutputPath.Port = PORT_B;  */
-
-    return Status;
+    controller->OutputPath.DdcPin = 0;
+    controller->edidExtensionCount = 0;
+    if (!controller->is_gvt)
+    {
+        CopyMem(&controller->edid, edid_fallback, sizeof(controller->edid));
+        return EFI_SUCCESS;
+    }
+    if (!EFI_ERROR(ConvertFallbackEDIDToHDMIEDID(&init->result, controller, edid_fallback)))
+    {
+        controller->edid = init->result;
+        return EFI_SUCCESS;
+    }
+    return EFI_NOT_FOUND;
 }
 
 static void PrintReg(UINT64 reg, const char *name)
 {
-    PRINT_DEBUG(EFI_D_ERROR, "Reg %a(%08x), val: %08x\n", name, reg, controller->read32(reg));
+    PRINT_VERBOSE("Reg %a(%08x), val: %08x\n", name, reg, controller->read32(reg));
 }
 static void PrintAllRegs()
 {
@@ -491,322 +643,541 @@ static void PrintAllRegs()
                 controller->OutputPath.LinkRate, controller->OutputPath.LaneCount,
                 controller->OutputPath.Port, controller->OutputPath.ConType, controller->OutputPath.DPLL);
 }
-EFI_STATUS setDisplayGraphicsMode(UINT32 ModeNumber)
+//Takes the plane, pipe, transcoder and port down in the reverse order of the
+//enable sequence, so the next modeset starts from an idle link.
+STATIC EFI_STATUS DisableOutput()
 {
-    EFI_STATUS status;
-    PRINT_DEBUG(EFI_D_ERROR, "set mode %u\n", ModeNumber);
-    if (g_already_set > 1)
+    UINT32 port = controller->OutputPath.Port;
+    UINT64 pipeconf = _PIPEACONF;
+    UINT64 ddi_func = _TRANS_DDI_FUNC_CTL_A;
+    if (controller->OutputPath.ConType == eDP)
     {
-        PRINT_DEBUG(EFI_D_ERROR, "mode already set\n");
-        goto error;
+        pipeconf = _PIPEEDPCONF;
+        ddi_func = _TRANS_DDI_FUNC_CTL_EDP;
     }
 
-    controller->write32(_PIPEACONF, 0);
-    controller->write32(_PIPEEDPCONF, 0);
+    controller->write32(_DSPACNTR, 0);
+    controller->write32(_DSPASURF, controller->gmadr);
+    controller->write32(pipeconf, controller->read32(pipeconf) & ~PIPECONF_ENABLE);
+    if (i915WaitForRegister(controller, I915_WAIT_PIPE, pipeconf,
+                            I965_PIPECONF_ACTIVE, 0, 100000, NULL) != EFI_SUCCESS)
+    {
+        PRINT_ERROR("failed to disable PIPE\n");
+    }
+    controller->write32(ddi_func, 0);
+    if (controller->OutputPath.ConType != HDMI)
+    {
+        controller->write32(DP_TP_CTL(port), 0);
+    }
+    controller->write32(DDI_BUF_CTL(port),
+                        controller->read32(DDI_BUF_CTL(port)) & ~DDI_BUF_CTL_ENABLE);
+    i915WaitForRegister(controller, I915_WAIT_DDI_IDLE, DDI_BUF_CTL(port),
+                        DDI_BUF_IS_IDLE, DDI_BUF_IS_IDLE, 16, NULL);
+    if (controller->OutputPath.ConType != eDP)
+    {
+        controller->write32(_TRANS_CLK_SEL_A, TRANS_CLK_SEL_DISABLED);
+    }
+    return EFI_SUCCESS;
+}
+enum
+{
+    MODESET_START,
+    MODESET_TRAIN,
+    MODESET_PIPE,
+    MODESET_PIPE_ACTIVE,
+    MODESET_DONE,
+};
 
-    status = SetupClocks();
+VOID setDisplayGraphicsModeBegin(I915_MODESET *modeset, CONST I915_MODE *Mode)
+{
+    ZeroMem(modeset, sizeof(*modeset));
+    modeset->mode = *Mode;
+    modeset->phase = MODESET_START;
+}
 
-    CHECK_STATUS_ERROR(status);
+//One stretch of setDisplayGraphicsMode up to its next wait, DP link training
+//or the pipe coming up. Returns EFI_NOT_READY with the wait armed, call again
+//once it is over; any other status is what setDisplayGraphicsMode returns.
+EFI_STATUS setDisplayGraphicsModeStep(I915_MODESET *modeset, I915_WAIT *wait)
+{
+    CONST I915_MODE *Mode = &modeset->mode;
+    EFI_STATUS status;
+    UINT64 reg;
 
-    status = SetupDDIBuffer();
+    switch (modeset->phase)
+    {
+    case MODESET_START:
+        modeset->start = i915ProfileStart();
+        PRINT_DEBUG(EFI_D_ERROR, "set mode %ux%u\n", Mode->width, Mode->height);
+        modeset->phase = MODESET_DONE;
+        if (g_timing_active &&
+            CompareMem(&g_active_timing, &Mode->timing, sizeof(g_active_timing)) == 0)
+        {
+            // same timing on the wire, only the plane changes and the link stays trained
+            controller->mode.width = Mode->width;
+            controller->mode.height = Mode->height;
+            status = SetupAndEnablePlane();
+            CHECK_STATUS_ERROR(status);
+            status = i915GraphicsFramebufferConfigure(controller);
+            CHECK_STATUS_ERROR(status);
+            i915HandoffUpdate(controller, TRUE);
+            i915ProfileRecord("setDisplayGraphicsMode plane", modeset->start);
+            return EFI_SUCCESS;
+        }
+        if (!g_timing_active && i915FastbootAdopt(controller, Mode) == EFI_SUCCESS)
+        {
+            // the host firmware left the pipe running this timing, keep it and
+            // only point the plane at our framebuffer
+            controller->mode = *Mode;
+            status = SetupAndEnablePlane();
+            CHECK_STATUS_ERROR(status);
+            status = i915GraphicsFramebufferConfigure(controller);
+            CHECK_STATUS_ERROR(status);
+            g_active_timing = Mode->timing;
+            g_timing_active = TRUE;
+            i915HandoffUpdate(controller, TRUE);
+            i915ProfileRecord("setDisplayGraphicsMode adopted", modeset->start);
+            return EFI_SUCCESS;
+        }
+        if (g_timing_active)
+        {
+            I915_PROFILE_CALL(status, DisableOutput);
+            g_timing_active = FALSE;
+        }
+        // the OS must not take over a pipe we are about to tear down, even if
+        // the modeset below fails
+        i915HandoffUpdate(controller, FALSE);
+        controller->mode = *Mode;
 
-    CHECK_STATUS_ERROR(status);
+        controller->write32(_PIPEACONF, 0);
+        controller->write32(_PIPEEDPCONF, 0);
 
-    // intel_hdmi_prepare(encoder, pipe_config);set
-    // hdmi_reg=DDI_BUF_CTL(port)
+        I915_PROFILE_CALL(status, SetupClocks);
 
-    // it's Type C
-    // icl_enable_phy_clock_gating(dig_port);
-    // Train Displayport
+        CHECK_STATUS_ERROR(status);
 
-    if (controller->OutputPath.ConType == eDP || controller->OutputPath.ConType == DPSST)
-    {
-        PRINT_DEBUG(EFI_D_ERROR, "PP_CTL:  %08x, PP_STAT  %08x \n", controller->read32(PP_CONTROL), controller->read32(PP_STATUS));
+        I915_PROFILE_CALL(status, SetupDDIBuffer);
+
+        CHECK_STATUS_ERROR(status);
+
+        // intel_hdmi_prepare(encoder, pipe_config);set
+        // hdmi_reg=DDI_BUF_CTL(port)
 
-        status = TrainDisplayPort(controller);
+        // it's Type C
+        // icl_enable_phy_clock_gating(dig_port);
+        // Train Displayport
+
+        if (controller->OutputPath.ConType == eDP || controller->OutputPath.ConType == DPSST)
+        {
+            PRINT_DEBUG(EFI_D_ERROR, "PP_CTL:  %08x, PP_STAT  %08x \n", controller->read32(PP_CONTROL), controller->read32(PP_STATUS));
+
+            modeset->stageStart = i915ProfileStart();
+            intel_dp_train_begin(&modeset->train);
+            modeset->phase = MODESET_TRAIN;
+        }
+        else
+        {
+            modeset->phase = MODESET_PIPE;
+        }
+        return setDisplayGraphicsModeStep(modeset, wait);
+
+    case MODESET_TRAIN:
+        status = intel_dp_train_step(controller, &modeset->train, wait);
+        if (status == EFI_NOT_READY)
+        {
+            return status;
+        }
+        i915ProfileRecord("TrainDisplayPort", modeset->stageStart);
         PRINT_DEBUG(EFI_D_ERROR, "progressed to line %d, status is %u\n",
                     __LINE__, status);
+        modeset->phase = MODESET_DONE;
         if (status != EFI_SUCCESS)
         {
             goto error;
         }
-    }
-    //  status = SetupClocks();
+        modeset->phase = MODESET_PIPE;
+        return setDisplayGraphicsModeStep(modeset, wait);
 
-    status = SetupIBoost();
+    case MODESET_PIPE:
+        modeset->phase = MODESET_DONE;
+        //  status = SetupClocks();
 
-    CHECK_STATUS_ERROR(status);
+        I915_PROFILE_CALL(status, SetupIBoost);
 
-    status = MapTranscoderDDI();
+        CHECK_STATUS_ERROR(status);
 
-    CHECK_STATUS_ERROR(status);
+        I915_PROFILE_CALL(status, MapTranscoderDDI);
 
-    // we got here
+        CHECK_STATUS_ERROR(status);
 
-    // intel_dig_port->set_infoframes(encoder,
-    //			       crtc_state->has_infoframe,
-    //			       crtc_state, conn_state);
+        // we got here
 
-    // if (intel_crtc_has_dp_encoder(pipe_config))
-    //	intel_dp_set_m_n(pipe_config, M1_N1);
+        // intel_dig_port->set_infoframes(encoder,
+        //			       crtc_state->has_infoframe,
+        //			       crtc_state, conn_state);
 
-    // program PIPE_A
-    status = SetupTranscoderAndPipe();
+        // if (intel_crtc_has_dp_encoder(pipe_config))
+        //	intel_dp_set_m_n(pipe_config, M1_N1);
 
-    CHECK_STATUS_ERROR(status);
+        // program PIPE_A
+        I915_PROFILE_CALL(status, SetupTranscoderAndPipe);
 
-    status = ConfigurePipeGamma();
+        CHECK_STATUS_ERROR(status);
 
-    CHECK_STATUS_ERROR(status);
+        I915_PROFILE_CALL(status, ConfigurePipeGamma);
 
-    // bad setup causes hanging when enabling trans / pipe, but what is it?
-    // we got here
-    // ddi
-    PRINT_DEBUG(EFI_D_ERROR, "before DDI\n");
-    status = ConfigureTransMSAMISC();
+        CHECK_STATUS_ERROR(status);
 
-    CHECK_STATUS_ERROR(status);
-    status = ConfigureTransDDI();
+        // bad setup causes hanging when enabling trans / pipe, but what is it?
+        // we got here
+        // ddi
+        PRINT_DEBUG(EFI_D_ERROR, "before DDI\n");
+        I915_PROFILE_CALL(status, ConfigureTransMSAMISC);
 
-    if (status != EFI_SUCCESS)
-    {
-        goto error;
-    }
-    PRINT_DEBUG(EFI_D_ERROR, "after DDI\n");
-    //g_SystemTable->RuntimeServices->ResetSystem(EfiResetShutdown,0,0,NULL);
-    //return EFI_UNSUPPORTED;
+        CHECK_STATUS_ERROR(status);
+        I915_PROFILE_CALL(status, ConfigureTransDDI);
 
-    //test: could be Windows hanging, it's not
-    //g_SystemTable->RuntimeServices->ResetSystem(EfiResetShutdown,0,0,NULL);
-    //we failed here
-    //return EFI_UNSUPPORTED;
+        if (status != EFI_SUCCESS)
+        {
+            goto error;
+        }
+        PRINT_DEBUG(EFI_D_ERROR, "after DDI\n");
+        //g_SystemTable->RuntimeServices->ResetSystem(EfiResetShutdown,0,0,NULL);
+        //return EFI_UNSUPPORTED;
 
-    status = EnablePipe();
+        //test: could be Windows hanging, it's not
+        //g_SystemTable->RuntimeServices->ResetSystem(EfiResetShutdown,0,0,NULL);
+        //we failed here
+        //return EFI_UNSUPPORTED;
 
-    if (status != EFI_SUCCESS)
-    {
-        goto error;
-    }
-    UINTN TimeOut = 0;
-    UINT64 reg = _PIPEACONF;
-    if (controller->OutputPath.ConType == eDP)
-    {
-        reg = _PIPEEDPCONF;
-    }
-    for (TimeOut = 0; TimeOut <= 100; TimeOut++)
-    {
+        I915_PROFILE_CALL(status, EnablePipe);
 
-        if (controller->read32(reg) & I965_PIPECONF_ACTIVE)
+        if (status != EFI_SUCCESS)
+        {
+            goto error;
+        }
+        reg = _PIPEACONF;
+        if (controller->OutputPath.ConType == eDP)
+        {
+            reg = _PIPEEDPCONF;
+        }
+        modeset->stageStart = i915ProfileStart();
+        i915WaitBegin(wait, I915_WAIT_PIPE, reg, I965_PIPECONF_ACTIVE,
+                      I965_PIPECONF_ACTIVE, 100000);
+        modeset->phase = MODESET_PIPE_ACTIVE;
+        return EFI_NOT_READY;
+
+    case MODESET_PIPE_ACTIVE:
+        modeset->phase = MODESET_DONE;
+        if (wait->status == EFI_SUCCESS)
         {
             PRINT_DEBUG(EFI_D_ERROR, "pipe enabled\n");
-            break;
         }
-        gBS->Stall(1000);
-    }
-    if (TimeOut > 100)
-    {
-        PRINT_DEBUG(EFI_D_ERROR, "failed to enable PIPE\n");
-    }
-    status = EnableDDI();
-    PRINT_DEBUG(EFI_D_ERROR, "progressed to line %d, status is%u\n",
-                __LINE__, status);
-    if (status != EFI_SUCCESS)
-    {
-        goto error;
-    }
+        else
+        {
+            PRINT_ERROR("failed to enable PIPE\n");
+        }
+        i915ProfileRecord("pipe active", modeset->stageStart);
+        I915_PROFILE_CALL(status, EnableDDI);
+        PRINT_DEBUG(EFI_D_ERROR, "progressed to line %d, status is%u\n",
+                    __LINE__, status);
+        if (status != EFI_SUCCESS)
+        {
+            goto error;
+        }
 
-    status = SetupAndEnablePlane();
+        I915_PROFILE_CALL(status, SetupAndEnablePlane);
 
-    if (status != EFI_SUCCESS)
-    {
-        goto error;
-    }
-    status = i915GraphicsFramebufferConfigure(controller);
+        if (status != EFI_SUCCESS)
+        {
+            goto error;
+        }
+        status = i915GraphicsFramebufferConfigure(controller);
 
-    if (status != EFI_SUCCESS)
-    {
-        goto error;
-    }
-    status = RETURN_ABORTED;
+        if (status != EFI_SUCCESS)
+        {
+            goto error;
+        }
+        status = RETURN_ABORTED;
 
-    controller->write32(PP_CONTROL, 7);
-    PrintAllRegs();
+        controller->write32(PP_CONTROL, 7);
+        PrintAllRegs();
 
-    g_already_set++;
-    return EFI_SUCCESS;
+        g_active_timing = Mode->timing;
+        g_timing_active = TRUE;
+        i915HandoffUpdate(controller, TRUE);
+        i915ProfileRecord("setDisplayGraphicsMode", modeset->start);
+        return EFI_SUCCESS;
+
+    default:
+        return EFI_ABORTED;
+    }
 
 error:
     PRINT_DEBUG(EFI_D_ERROR, "exiting with error");
     return status;
 }
 
-EFI_STATUS DisplayInit(i915_CONTROLLER *iController)
+EFI_STATUS setDisplayGraphicsMode(CONST I915_MODE *Mode)
 {
-    EFI_STATUS Status;
-    UINTN TimeOut = 0;
-    controller = iController;
-    /* 1. Enable PCH reset handshake. */
-    // intel_pch_reset_handshake(dev_priv, !HAS_PCH_NOP(dev_priv));
-    controller->write32(HSW_NDE_RSTWRN_OPT,
-                        controller->read32(HSW_NDE_RSTWRN_OPT) |
-                            RESET_PCH_HANDSHAKE_ENABLE);
-
-    // DOESN'T APPLY
-    ///* 2-3. */
-    // icl_combo_phys_init(dev_priv);
-
-    // if (resume && dev_priv->csr.dmc_payload)
-    //	intel_csr_load_program(dev_priv);
-
-    // power well enable, we are requesting these to be enabled
-    //#define   SKL_PW_CTL_IDX_PW_2			15
-    //#define   SKL_PW_CTL_IDX_PW_1			14
-    //#define   SKL_PW_CTL_IDX_DDI_D			4
-    //#define   SKL_PW_CTL_IDX_DDI_C			3
-    //#define   SKL_PW_CTL_IDX_DDI_B			2
-    //#define   SKL_PW_CTL_IDX_DDI_A_E		1
-    //#define   SKL_PW_CTL_IDX_MISC_IO		0
-    controller->write32(HSW_PWR_WELL_CTL1,
-                        controller->read32(HSW_PWR_WELL_CTL1) | 0xA00002AAu);
-    UINT32 stat;
-    for (TimeOut = 0; TimeOut <= 5; TimeOut++)
-    {
-        UINT32 stat = controller->read32(HSW_PWR_WELL_CTL1);
-        if (stat & 0x50000155u)
-        {
-            PRINT_DEBUG(EFI_D_ERROR, "power well enabled %08x\n", stat);
-            break;
-        }
-        gBS->Stall(1);
-    }
-    if (TimeOut > 5)
+    I915_MODESET modeset;
+    I915_WAIT wait;
+    EFI_STATUS status;
+
+    setDisplayGraphicsModeBegin(&modeset, Mode);
+    while ((status = setDisplayGraphicsModeStep(&modeset, &wait)) == EFI_NOT_READY)
     {
-        PRINT_DEBUG(EFI_D_ERROR, "power well enabling timed out %08x\n",
-                    stat);
+        i915WaitComplete(controller, &wait);
     }
+    return status;
+}
 
-    // SetupPPS();
-    // //Turn panel on/off to ensure it is properly reset and ready to recieve data.
-    // PRINT_DEBUG(EFI_D_ERROR, "PP_CTL:  %08x, PP_STAT  %08x \n", controller->read32(PP_CONTROL), controller->read32(PP_STATUS));
-
-    // controller->write32(PP_CONTROL, 8);
-    // controller->write32(PP_CONTROL, 0);
-    // controller->write32(PP_CONTROL, 8);
-    // controller->write32(PP_CONTROL, 0);
-    // controller->write32(PP_CONTROL, 67);
-    // PRINT_DEBUG(EFI_D_ERROR, "PP_CTL:  %08x, PP_STAT  %08x \n", controller->read32(PP_CONTROL), controller->read32(PP_STATUS));
+enum
+{
+    DISPLAY_INIT_POWER_WELLS,
+    DISPLAY_INIT_DBUF,
+    DISPLAY_INIT_DBUF_S2,
+    DISPLAY_INIT_MBUS,
+    DISPLAY_INIT_PROBE,
+    DISPLAY_INIT_EDID,
+    DISPLAY_INIT_EDID_READ,
+    DISPLAY_INIT_OUTPUT,
+    DISPLAY_INIT_DONE,
+};
 
-    // gBS->Stall(500000);
-    // PRINT_DEBUG(EFI_D_ERROR, "PP_CTL:  %08x, PP_STAT  %08x \n", controller->read32(PP_CONTROL), controller->read32(PP_STATUS));
-    //controller->write32(PP_CONTROL, 103);
-    // disable VGA
-    UINT32 vgaword = controller->read32(VGACNTRL);
-    controller->write32(VGACNTRL, (vgaword & ~VGA_2X_MODE) | VGA_DISP_DISABLE);
+VOID DisplayInitBegin(i915_CONTROLLER *iController, I915_DISPLAY_INIT *init)
+{
+    controller = iController;
+    ZeroMem(init, sizeof(*init));
+    init->phase = DISPLAY_INIT_POWER_WELLS;
+}
 
-    ///* 5. Enable CDCLK. */
-    // icl_init_cdclk(dev_priv);
-    // 080002a1 on test machine
-    PRINT_DEBUG(EFI_D_ERROR, "CDCLK = %08x\n", controller->read32(CDCLK_CTL)); //there seems no need to do so
+//One stretch of DisplayInit up to its next register wait. Returns
+//EFI_NOT_READY with the wait armed, call again once it is over; any other
+//status is where DisplayInit ends up.
+EFI_STATUS DisplayInitStep(I915_DISPLAY_INIT *init, I915_WAIT *wait)
+{
+    EFI_STATUS Status;
 
-    ///* 6. Enable DBUF. */
-    // icl_dbuf_enable(dev_priv);
-    controller->write32(DBUF_CTL_S1,
-                        controller->read32(DBUF_CTL_S1) | DBUF_POWER_REQUEST);
-    controller->write32(DBUF_CTL_S2,
-                        controller->read32(DBUF_CTL_S2) | DBUF_POWER_REQUEST);
-    controller->read32(DBUF_CTL_S2);
-    for (UINT32 counter = 0;; counter++)
+    switch (init->phase)
     {
-        if (counter > 2)
+    case DISPLAY_INIT_POWER_WELLS:
+        /* 1. Enable PCH reset handshake. */
+        // intel_pch_reset_handshake(dev_priv, !HAS_PCH_NOP(dev_priv));
+        controller->write32(HSW_NDE_RSTWRN_OPT,
+                            controller->read32(HSW_NDE_RSTWRN_OPT) |
+                                RESET_PCH_HANDSHAKE_ENABLE);
+
+        // DOESN'T APPLY
+        ///* 2-3. */
+        // icl_combo_phys_init(dev_priv);
+
+        // if (resume && dev_priv->csr.dmc_payload)
+        //	intel_csr_load_program(dev_priv);
+
+        // power well enable, we are requesting these to be enabled
+        //#define   SKL_PW_CTL_IDX_PW_2			15
+        //#define   SKL_PW_CTL_IDX_PW_1			14
+        //#define   SKL_PW_CTL_IDX_DDI_D			4
+        //#define   SKL_PW_CTL_IDX_DDI_C			3
+        //#define   SKL_PW_CTL_IDX_DDI_B			2
+        //#define   SKL_PW_CTL_IDX_DDI_A_E		1
+        //#define   SKL_PW_CTL_IDX_MISC_IO		0
+        controller->write32(HSW_PWR_WELL_CTL1,
+                            controller->read32(HSW_PWR_WELL_CTL1) | 0xA00002AAu);
+        i915WaitBeginAny(wait, I915_WAIT_POWER_WELL, HSW_PWR_WELL_CTL1, 0x50000155u, 1000);
+        init->phase = DISPLAY_INIT_DBUF;
+        return EFI_NOT_READY;
+
+    case DISPLAY_INIT_DBUF:
+        if (wait->status == EFI_SUCCESS)
         {
-            PRINT_DEBUG(EFI_D_ERROR, "DBUF timeout\n");
-            break;
+            PRINT_DEBUG(EFI_D_ERROR, "power well enabled %08x\n", wait->lastValue);
         }
-        if (controller->read32(DBUF_CTL_S1) & controller->read32(DBUF_CTL_S2) &
-            DBUF_POWER_STATE)
+        else
         {
-            PRINT_DEBUG(EFI_D_ERROR, "DBUF good\n");
-            break;
-        }
-        gBS->Stall(10);
-    }
-
-    ///* 7. Setup MBUS. */
-    // icl_mbus_init(dev_priv);
-    controller->write32(MBUS_ABOX_CTL, MBUS_ABOX_BT_CREDIT_POOL1(16) |
-                                           MBUS_ABOX_BT_CREDIT_POOL2(16) |
-                                           MBUS_ABOX_B_CREDIT(1) |
-                                           MBUS_ABOX_BW_CREDIT(1));
-
-    // set up display buffer
-    // the value is from host
-    PRINT_DEBUG(EFI_D_ERROR, "_PLANE_BUF_CFG_1_A = %08x\n",
-                controller->read32(_PLANE_BUF_CFG_1_A));
-    controller->write32(_PLANE_BUF_CFG_1_A, 0x035b0000);
-    PRINT_DEBUG(EFI_D_ERROR, "_PLANE_BUF_CFG_1_A = %08x (after)\n",
-                controller->read32(_PLANE_BUF_CFG_1_A));
-
-    // initialize output
-    // need workaround: always initialize DDI
-    // intel_dig_port->hdmi.hdmi_reg = DDI_BUF_CTL(port);
-    // intel_ddi_init(PORT_A);
-    UINT32 found = controller->read32(SFUSE_STRAP);
-    PRINT_DEBUG(EFI_D_ERROR, "SFUSE_STRAP = %08x\n", found);
-    Status = setOutputPath(controller, found);
-    if (EFI_ERROR(Status))
-    {
-        PRINT_DEBUG(EFI_D_ERROR, "failed to Set OutputPath\n");
-        return Status;
-    }
-    // UINT32* port = &controller->OutputPath.Port;
-    /*         UINT32* port = &(controller->OutputPath.Port);
+            PRINT_ERROR("power well enabling timed out %08x\n",
+                        wait->lastValue);
+        }
 
-    *port = PORT_A;
-    if (found & SFUSE_STRAP_DDIB_DETECTED)
-    {
-        *port = PORT_B; //intel_ddi_init(PORT_B);
-    }
-    else if (found & SFUSE_STRAP_DDIC_DETECTED)
-    {
-        *port = PORT_C; //intel_ddi_init(PORT_C);
-    }
-    else if (found & SFUSE_STRAP_DDID_DETECTED)
-    {
-        *port = PORT_D; //intel_ddi_init(PORT_D);
-    } */
-    // if (found & SFUSE_STRAP_DDIF_DETECTED)
-    //	intel_ddi_init(dev_priv, PORT_F);
+        // disable VGA
+        UINT32 vgaword = controller->read32(VGACNTRL);
+        controller->write32(VGACNTRL, (vgaword & ~VGA_2X_MODE) | VGA_DISP_DISABLE);
+
+        ///* 5. Enable CDCLK. */
+        // icl_init_cdclk(dev_priv);
+        // 080002a1 on test machine
+        PRINT_DEBUG(EFI_D_ERROR, "CDCLK = %08x\n", controller->read32(CDCLK_CTL)); //there seems no need to do so
+
+        ///* 6. Enable DBUF. */
+        // icl_dbuf_enable(dev_priv);
+        controller->write32(DBUF_CTL_S1,
+                            controller->read32(DBUF_CTL_S1) | DBUF_POWER_REQUEST);
+        controller->write32(DBUF_CTL_S2,
+                            controller->read32(DBUF_CTL_S2) | DBUF_POWER_REQUEST);
+        controller->read32(DBUF_CTL_S2);
+        i915WaitBegin(wait, I915_WAIT_DBUF, DBUF_CTL_S1, DBUF_POWER_STATE, DBUF_POWER_STATE, 30);
+        init->phase = DISPLAY_INIT_DBUF_S2;
+        return EFI_NOT_READY;
+
+    case DISPLAY_INIT_DBUF_S2:
+        init->phase = DISPLAY_INIT_MBUS;
+        if (wait->status == EFI_SUCCESS)
+        {
+            i915WaitBegin(wait, I915_WAIT_DBUF, DBUF_CTL_S2, DBUF_POWER_STATE, DBUF_POWER_STATE, 30);
+            return EFI_NOT_READY;
+        }
+        return DisplayInitStep(init, wait);
 
-    // reset GMBUS
-    // intel_i2c_reset(dev_priv);
-    controller->write32(GMBUS0, 0);
-    controller->write32(GMBUS4, 0);
+    case DISPLAY_INIT_MBUS:
+        if (wait->status == EFI_SUCCESS)
+        {
+            PRINT_DEBUG(EFI_D_ERROR, "DBUF good\n");
+        }
+        else
+        {
+            PRINT_ERROR("DBUF timeout\n");
+        }
 
-    // query EDID and initialize the mode
-    // it somehow fails on real hardware
-    // Verified functional on i7-10710U
-    // Status = ReadEDID(&controller->edid);
-    if (*(UINT64 *)controller->edid.magic != 0x00FFFFFFFFFFFF00uLL)
-    {
-        for (UINT32 i = 0; i < 128; i++)
+        ///* 7. Setup MBUS. */
+        // icl_mbus_init(dev_priv);
+        controller->write32(MBUS_ABOX_CTL, MBUS_ABOX_BT_CREDIT_POOL1(16) |
+                                               MBUS_ABOX_BT_CREDIT_POOL2(16) |
+                                               MBUS_ABOX_B_CREDIT(1) |
+                                               MBUS_ABOX_BW_CREDIT(1));
+
+        // set up display buffer
+        // the value is from host
+        PRINT_DEBUG(EFI_D_ERROR, "_PLANE_BUF_CFG_1_A = %08x\n",
+                    controller->read32(_PLANE_BUF_CFG_1_A));
+        controller->write32(_PLANE_BUF_CFG_1_A, 0x035b0000);
+        PRINT_DEBUG(EFI_D_ERROR, "_PLANE_BUF_CFG_1_A = %08x (after)\n",
+                    controller->read32(_PLANE_BUF_CFG_1_A));
+
+        // initialize output
+        // need workaround: always initialize DDI
+        // intel_dig_port->hdmi.hdmi_reg = DDI_BUF_CTL(port);
+        // intel_ddi_init(PORT_A);
+        init->found = controller->read32(SFUSE_STRAP);
+        PRINT_DEBUG(EFI_D_ERROR, "SFUSE_STRAP = %08x\n", init->found);
+
+        init->profileStart = i915ProfileStart();
+        ZeroMem(&g_intel_dp, sizeof(g_intel_dp));
+        g_intel_dp.controller = controller;
+        controller->intel_dp = &g_intel_dp;
+        // a new connect, nothing read from the previous sink's DPCD is kept
+        intel_dp_dpcd_cache_invalidate(&g_intel_dp);
+        //a sink the cache vouches for skips the probe
+        if (!EFI_ERROR(i915CacheRestoreOutput(controller, init->found)))
         {
-            ((UINT8 *)&controller->edid)[i] = edid_fallback[i];
+            i915ProfileRecord("setOutputPath", init->profileStart);
+            init->phase = DISPLAY_INIT_OUTPUT;
+            return DisplayInitStep(init, wait);
         }
-    }
-    /*  if (EFI_ERROR(Status))
-    {
-        PRINT_DEBUG(EFI_D_ERROR,"failed to read EDID\n");
-        
-    } */
-    PRINT_DEBUG(EFI_D_ERROR, "got EDID:\n");
-    for (UINT32 i = 0; i < 16; i++)
-    {
-        for (UINT32 j = 0; j < 8; j++)
+        listOutputCandidates(init);
+#if I915_PROBE_PARALLEL
+        i915ProbeBegin(&init->probe, init->candidates, init->count);
+#else
+        //without parallel probing every sink the VBT names counts as present
+        //and gets a full EDID read
+        for (UINT32 i = 0; i < init->count; i++)
+        {
+            init->candidates[i].dpPresent = init->candidates[i].dp;
+            init->candidates[i].hdmiPresent = init->candidates[i].hdmi;
+        }
+#endif
+        init->phase = DISPLAY_INIT_PROBE;
+        return DisplayInitStep(init, wait);
+
+    case DISPLAY_INIT_PROBE:
+#if I915_PROBE_PARALLEL
+        Status = i915ProbeStep(controller, &init->probe, wait);
+        if (Status == EFI_NOT_READY)
+        {
+            return Status;
+        }
+#endif
+        init->index = 0;
+        init->hdmi = FALSE;
+        init->phase = DISPLAY_INIT_EDID;
+        return DisplayInitStep(init, wait);
+
+    case DISPLAY_INIT_EDID:
+        if (EFI_ERROR(nextOutputCandidate(init)))
+        {
+            Status = noOutputCandidate(init);
+            i915ProfileRecord("setOutputPath", init->profileStart);
+            if (EFI_ERROR(Status))
+            {
+                PRINT_ERROR("failed to Set OutputPath\n");
+                init->phase = DISPLAY_INIT_DONE;
+                return Status;
+            }
+            init->phase = DISPLAY_INIT_OUTPUT;
+            return DisplayInitStep(init, wait);
+        }
+        init->phase = DISPLAY_INIT_EDID_READ;
+        return DisplayInitStep(init, wait);
+
+    case DISPLAY_INIT_EDID_READ:
+        Status = readEdidStep(&init->edid, wait);
+        if (Status == EFI_NOT_READY)
+        {
+            return Status;
+        }
+        PRINT_DEBUG(EFI_D_ERROR, init->edid.dp ? "ReadEDIDDP returned %d \n" : "ReadEDIDHDMI returned %d \n",
+                    Status);
+        if (EFI_ERROR(Status))
         {
-            DebugPrint(EFI_D_ERROR, "%02x ",
-                       ((UINT8 *)(&controller->edid))[i * 8 + j]);
+            //the next sink is a fresh transaction, let other work in first
+            skipOutputCandidate(init);
+            init->phase = DISPLAY_INIT_EDID;
+            i915WaitDelay(wait, 0);
+            return EFI_NOT_READY;
         }
-        DebugPrint(EFI_D_ERROR, "\n");
+        useOutputCandidate(init);
+        //anything probed goes back into the cache
+        i915CacheStoreOutput(controller, init->found);
+        i915ProfileRecord("setOutputPath", init->profileStart);
+        init->phase = DISPLAY_INIT_OUTPUT;
+        return DisplayInitStep(init, wait);
+
+    case DISPLAY_INIT_OUTPUT:
+        // reset GMBUS
+        // intel_i2c_reset(dev_priv);
+        controller->write32(GMBUS0, 0);
+        controller->write32(GMBUS4, 0);
+
+        // query EDID and initialize the mode
+        // it somehow fails on real hardware
+        // Verified functional on i7-10710U
+        if (*(UINT64 *)controller->edid.magic != 0x00FFFFFFFFFFFF00uLL)
+        {
+            for (UINT32 i = 0; i < 128; i++)
+            {
+                ((UINT8 *)&controller->edid)[i] = edid_fallback[i];
+            }
+        }
+        PRINT_DEBUG(EFI_D_ERROR, "got EDID:\n");
+        i915LogHexDump(I915_LOG_CATEGORY, &controller->edid, 128);
+        init->phase = DISPLAY_INIT_DONE;
+        return EFI_SUCCESS;
+
+    default:
+        return EFI_SUCCESS;
     }
-    return EFI_SUCCESS;
+}
+
+EFI_STATUS DisplayInit(i915_CONTROLLER *iController)
+{
+    I915_DISPLAY_INIT init;
+    I915_WAIT wait;
+    EFI_STATUS Status;
+
+    DisplayInitBegin(iController, &init);
+    while ((Status = DisplayInitStep(&init, &wait)) == EFI_NOT_READY)
+    {
+        i915WaitComplete(controller, &wait);
+    }
+    return Status;
 }
@@ -10,6 +10,9 @@
 #include "i915_hdmi.h"
 #include "i915_reg.h"
 #include "i915_gop.h"
+#include "i915_modes.h"
+#include "i915_probe.h"
+#include "i915_wait.h"
 
 #define VGACNTRL (0x71400)
 #define VGA_DISP_DISABLE (1 << 31)
@@ -396,9 +399,54 @@
 
 /* DPLL cfg */
 
+//An EDID read, block 0 and then its extensions, over AUX or GMBUS.
+typedef struct
+{
+    BOOLEAN dp;
+    UINT8 pin;
+    EDID *result;
+    UINT32 phase;
+    UINT32 extensions;
+    I915_GMBUS_READ gmbus;
+    I915_DP_DDC_READ aux;
+} I915_EDID_READ;
+
+//DisplayInit taken apart at its register waits, see DisplayInitStep.
+typedef struct
+{
+    UINT32 phase;
+    UINT32 found;
+    BOOLEAN dbufGood;
+    UINT64 profileStart;
+    I915_PROBE_CANDIDATE candidates[I915_PROBE_MAX];
+    UINT32 count;
+    UINT32 index;   //candidate whose EDID is read
+    BOOLEAN hdmi;   //on its HDMI side, DP has had its turn
+    I915_PROBE probe;
+    I915_EDID_READ edid;
+    EDID result;
+} I915_DISPLAY_INIT;
+
+VOID DisplayInitBegin(i915_CONTROLLER *iController, I915_DISPLAY_INIT *init);
+EFI_STATUS DisplayInitStep(I915_DISPLAY_INIT *init, I915_WAIT *wait);
 EFI_STATUS DisplayInit(i915_CONTROLLER *iController);
 
+//setDisplayGraphicsMode taken apart at DP link training and the pipe
+//enable, see setDisplayGraphicsModeStep.
+typedef struct
+{
+    I915_MODE mode;
+    UINT32 phase;
+    UINT64 start;
+    UINT64 stageStart;
+    I915_DP_TRAIN train;
+} I915_MODESET;
+
+VOID setDisplayGraphicsModeBegin(I915_MODESET *modeset, CONST I915_MODE *Mode);
+EFI_STATUS setDisplayGraphicsModeStep(I915_MODESET *modeset, I915_WAIT *wait);
 EFI_STATUS setDisplayGraphicsMode(
-    UINT32 ModeNumber);
+    CONST I915_MODE *Mode);
 EFI_STATUS TrainDisplayPort(i915_CONTROLLER *controller);
+EFI_STATUS setDisplayPanOffset(UINT32 y);
+UINT32 TransDDISyncFlags(CONST EDID_DETAILED_TIMING *timing);
 #endif
\ No newline at end of file
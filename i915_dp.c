@@ -1,3 +1,5 @@
+#define I915_LOG_CATEGORY I915_LOG_DP
+#include "i915_cache.h"
 #include "i915_controller.h"
 #include "i915_debug.h"
 #include "i915_gmbus.h"
@@ -5,7 +7,9 @@
 #include "i915_dp.h"
 #include "i915_hdmi.h"
 #include "i915_reg.h"
+#include "i915_wait.h"
 #include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 
 /* Cedartrail */
@@ -76,173 +80,6 @@ static int max(int in1, int in2)
  */
 #define clamp_t(type, val, lo, hi) min_t(type, max_t(type, val, lo), hi)
 
-EFI_STATUS ReadEDIDDP(EDID *result, i915_CONTROLLER *controller, UINT8 pin)
-{
-
-	UINT32 *p = (UINT32 *)result;
-	edp_panel_vdd_on(controller->intel_dp);
-
-	PRINT_DEBUG(EFI_D_ERROR, "trying DP aux %d\n", pin);
-	// aux message header is 3-4 bytes: ctrl8 addr16 len8
-	// the data is big endian
-	// len is receive buffer size-1
-	// i2c init
-	UINT32 send_ctl =
-		(DP_AUX_CH_CTL_SEND_BUSY | DP_AUX_CH_CTL_DONE |
-		 DP_AUX_CH_CTL_TIME_OUT_ERROR | DP_AUX_CH_CTL_TIME_OUT_MAX |
-		 DP_AUX_CH_CTL_RECEIVE_ERROR | (3 << DP_AUX_CH_CTL_MESSAGE_SIZE_SHIFT) |
-		 DP_AUX_CH_CTL_FW_SYNC_PULSE_SKL(32) |
-		 DP_AUX_CH_CTL_SYNC_PULSE_SKL(32));
-	/* Must try at least 3 times according to DP spec, WHICH WE DON'T CARE */
-	controller->write32(_DPA_AUX_CH_DATA1 + (pin << 8),
-						((AUX_I2C_MOT | AUX_I2C_WRITE) << 28) | (0x50 << 8) |
-							0);
-	controller->write32(_DPA_AUX_CH_CTL + (pin << 8), send_ctl);
-	UINT32 aux_status;
-	UINT32 counter = 0;
-	for (;;)
-	{
-		aux_status = controller->read32(_DPA_AUX_CH_CTL + (pin << 8));
-		if (!(aux_status & DP_AUX_CH_CTL_SEND_BUSY))
-		{
-			break;
-		}
-		counter += 1;
-		if (counter >= 1500)
-		{
-			PRINT_DEBUG(EFI_D_ERROR, "DP AUX channel timeout");
-			break;
-		}
-		gBS->Stall(10);
-	}
-	controller->write32(_DPA_AUX_CH_CTL + (pin << 8),
-						aux_status | DP_AUX_CH_CTL_DONE |
-							DP_AUX_CH_CTL_TIME_OUT_ERROR |
-							DP_AUX_CH_CTL_RECEIVE_ERROR);
-	// i2c send 1 byte
-	send_ctl =
-		(DP_AUX_CH_CTL_SEND_BUSY | DP_AUX_CH_CTL_DONE |
-		 DP_AUX_CH_CTL_TIME_OUT_ERROR | DP_AUX_CH_CTL_TIME_OUT_MAX |
-		 DP_AUX_CH_CTL_RECEIVE_ERROR | (5 << DP_AUX_CH_CTL_MESSAGE_SIZE_SHIFT) |
-		 DP_AUX_CH_CTL_FW_SYNC_PULSE_SKL(32) |
-		 DP_AUX_CH_CTL_SYNC_PULSE_SKL(32));
-	controller->write32(_DPA_AUX_CH_DATA1 + (pin << 8),
-						(AUX_I2C_WRITE << 28) | (0x50 << 8) | 0);
-	controller->write32(_DPA_AUX_CH_DATA2 + (pin << 8), 0);
-	controller->write32(_DPA_AUX_CH_CTL + (pin << 8), send_ctl);
-	counter = 0;
-	for (;;)
-	{
-		aux_status = controller->read32(_DPA_AUX_CH_CTL + (pin << 8));
-		if (!(aux_status & DP_AUX_CH_CTL_SEND_BUSY))
-		{
-			break;
-		}
-		counter += 1;
-		if (counter >= 1500)
-		{
-			PRINT_DEBUG(EFI_D_ERROR, "DP AUX channel timeout");
-			break;
-		}
-		gBS->Stall(10);
-	}
-	controller->write32(_DPA_AUX_CH_CTL + (pin << 8),
-						aux_status | DP_AUX_CH_CTL_DONE |
-							DP_AUX_CH_CTL_TIME_OUT_ERROR |
-							DP_AUX_CH_CTL_RECEIVE_ERROR);
-	if (aux_status &
-		(DP_AUX_CH_CTL_TIME_OUT_ERROR | DP_AUX_CH_CTL_RECEIVE_ERROR))
-	{
-		return EFI_NOT_FOUND;
-	}
-	// i2c read 1 byte * 128
-	PRINT_DEBUG(EFI_D_ERROR, "reading DP aux %d\n", pin);
-	// aux message header is 3-4 bytes: ctrl8 addr16 len8
-	// the data is big endian
-	// len is receive buffer size-1
-	// i2c init
-	send_ctl =
-		(DP_AUX_CH_CTL_SEND_BUSY | DP_AUX_CH_CTL_DONE |
-		 DP_AUX_CH_CTL_TIME_OUT_ERROR | DP_AUX_CH_CTL_TIME_OUT_MAX |
-		 DP_AUX_CH_CTL_RECEIVE_ERROR | (3 << DP_AUX_CH_CTL_MESSAGE_SIZE_SHIFT) |
-		 DP_AUX_CH_CTL_FW_SYNC_PULSE_SKL(32) |
-		 DP_AUX_CH_CTL_SYNC_PULSE_SKL(32));
-	/* Must try at least 3 times according to DP spec, WHICH WE DON'T CARE */
-	controller->write32(_DPA_AUX_CH_DATA1 + (pin << 8),
-						((AUX_I2C_MOT | AUX_I2C_READ) << 28) | (0x50 << 8) | 0);
-	controller->write32(_DPA_AUX_CH_CTL + (pin << 8), send_ctl);
-	counter = 0;
-	for (;;)
-	{
-		aux_status = controller->read32(_DPA_AUX_CH_CTL + (pin << 8));
-		if (!(aux_status & DP_AUX_CH_CTL_SEND_BUSY))
-		{
-			break;
-		}
-		counter += 1;
-		if (counter >= 1500)
-		{
-			PRINT_DEBUG(EFI_D_ERROR, "DP AUX channel timeout");
-			break;
-		}
-		gBS->Stall(10);
-	}
-	controller->write32(_DPA_AUX_CH_CTL + (pin << 8),
-						aux_status | DP_AUX_CH_CTL_DONE |
-							DP_AUX_CH_CTL_TIME_OUT_ERROR |
-							DP_AUX_CH_CTL_RECEIVE_ERROR);
-	UINT32 i = 0;
-	for (i = 0; i < 128; i++)
-	{
-		send_ctl = (DP_AUX_CH_CTL_SEND_BUSY | DP_AUX_CH_CTL_DONE |
-					DP_AUX_CH_CTL_TIME_OUT_ERROR | DP_AUX_CH_CTL_TIME_OUT_MAX |
-					DP_AUX_CH_CTL_RECEIVE_ERROR |
-					(4 << DP_AUX_CH_CTL_MESSAGE_SIZE_SHIFT) |
-					DP_AUX_CH_CTL_FW_SYNC_PULSE_SKL(32) |
-					DP_AUX_CH_CTL_SYNC_PULSE_SKL(32));
-		controller->write32(_DPA_AUX_CH_DATA1 + (pin << 8),
-							(AUX_I2C_READ << 28) | (0x50 << 8) | 0);
-		controller->write32(_DPA_AUX_CH_CTL + (pin << 8), send_ctl);
-		counter = 0;
-		for (;;)
-		{
-			aux_status = controller->read32(_DPA_AUX_CH_CTL + (pin << 8));
-			if (!(aux_status & DP_AUX_CH_CTL_SEND_BUSY))
-			{
-				break;
-			}
-			counter += 1;
-			if (counter >= 1500)
-			{
-				PRINT_DEBUG(EFI_D_ERROR, "DP AUX channel timeout");
-				break;
-			}
-			gBS->Stall(10);
-		}
-		controller->write32(_DPA_AUX_CH_CTL + (pin << 8),
-							aux_status | DP_AUX_CH_CTL_DONE |
-								DP_AUX_CH_CTL_TIME_OUT_ERROR |
-								DP_AUX_CH_CTL_RECEIVE_ERROR);
-		UINT32 word = controller->read32(_DPA_AUX_CH_DATA1 + (pin << 8));
-		((UINT8 *)p)[i] = (word >> 16) & 0xff;
-	}
-	for (UINT32 i = 0; i < 16; i++)
-	{
-		for (UINT32 j = 0; j < 8; j++)
-		{
-			DebugPrint(EFI_D_ERROR, "%02x ", ((UINT8 *)(p))[i * 8 + j]);
-		}
-		DebugPrint(EFI_D_ERROR, "\n");
-	}
-	if (i >= 128 && *(UINT64 *)result->magic == 0x00FFFFFFFFFFFF00uLL)
-	{
-		controller->OutputPath.AuxCh = pin;
-		return EFI_SUCCESS;
-	}
-
-	return EFI_NOT_FOUND;
-}
-
 static int cnp_rawclk(i915_CONTROLLER *controller)
 {
 	int divider, fraction;
@@ -531,6 +368,15 @@ intel_pps_readout_hw_state(struct intel_dp *intel_dp, struct edp_power_seq *seq)
 	//}
 }
 
+/* PPS delays the panel was brought up with, for the fastboot readout */
+void intel_pps_readout(i915_CONTROLLER *controller, struct edp_power_seq *seq)
+{
+	struct intel_dp *intel_dp = controller->intel_dp;
+
+	intel_dp->controller = controller;
+	intel_pps_readout_hw_state(intel_dp, seq);
+}
+
 static void
 intel_pps_dump_state(const char *state_name, const struct edp_power_seq *seq)
 {
@@ -776,32 +622,27 @@ EFI_STATUS SetupClockeDP(i915_CONTROLLER *controller)
 	controller->write32(LCPLL2_CTL, controller->read32(LCPLL2_CTL) & ~(LCPLL_PLL_ENABLE));
 	controller->write32(LCPLL1_CTL, controller->read32(LCPLL1_CTL) & ~(LCPLL_PLL_ENABLE));
 	val = controller->read32(DPLL_CTRL1);
-	for (UINT32 counter = 0;; counter++)
+	if (i915WaitForRegister(controller, I915_WAIT_DPLL, DPLL_STATUS, DPLL_LOCK(id),
+							DPLL_LOCK(id), 5000, NULL) == EFI_SUCCESS)
 	{
-		if (controller->read32(DPLL_STATUS) & DPLL_LOCK(id))
-		{
-			PRINT_DEBUG(EFI_D_ERROR, "DPLL %d locked\n", id);
-			break;
-		}
-		if (counter > 500)
-		{
-			PRINT_DEBUG(EFI_D_ERROR, "DPLL %d not locked\n", id);
-			break;
-		}
-		gBS->Stall(10);
+		PRINT_DEBUG(EFI_D_ERROR, "DPLL %d locked\n", id);
+	}
+	else
+	{
+		PRINT_ERROR("DPLL %d not locked\n", id);
 	}
 	//it's clock id!
 	//how's port clock comptued?
 	UINT64 clock_khz = controller->OutputPath.LinkRate;
 	PRINT_DEBUG(EFI_D_ERROR, "Link Rate: %u\n", clock_khz);
 	UINT32 linkrate = DPLL_CTRL1_LINK_RATE_810;
-	if (clock_khz >> 1 >= 135000)
+	if (clock_khz >> 1 >= 270000)
 	{
-		linkrate = DPLL_CTRL1_LINK_RATE_1350;
+		linkrate = DPLL_CTRL1_LINK_RATE_2700;
 	}
-	else if (clock_khz >> 1 >= 270000)
+	else if (clock_khz >> 1 >= 135000)
 	{
-		linkrate = DPLL_CTRL1_LINK_RATE_2700;
+		linkrate = DPLL_CTRL1_LINK_RATE_1350;
 	}
 	//hack: anything else hangs
 	// UINT32 id = DPLL_CTRL1_LINK_RATE_1350;
@@ -825,19 +666,14 @@ EFI_STATUS SetupClockeDP(i915_CONTROLLER *controller)
 	controller->write32(LCPLL2_CTL, controller->read32(LCPLL2_CTL) | LCPLL_PLL_ENABLE);
 	controller->write32(LCPLL1_CTL, controller->read32(LCPLL1_CTL) | LCPLL_PLL_ENABLE);
 
-	for (UINT32 counter = 0;; counter++)
+	if (i915WaitForRegister(controller, I915_WAIT_DPLL, DPLL_STATUS, DPLL_LOCK(id),
+							DPLL_LOCK(id), 5000, NULL) == EFI_SUCCESS)
 	{
-		if (controller->read32(DPLL_STATUS) & DPLL_LOCK(id))
-		{
-			PRINT_DEBUG(EFI_D_ERROR, "DPLL %d locked\n", id);
-			break;
-		}
-		if (counter > 500)
-		{
-			PRINT_DEBUG(EFI_D_ERROR, "DPLL %d not locked\n", id);
-			break;
-		}
-		gBS->Stall(10);
+		PRINT_DEBUG(EFI_D_ERROR, "DPLL %d locked\n", id);
+	}
+	else
+	{
+		PRINT_ERROR("DPLL %d not locked\n", id);
 	}
 
 	//intel_encoders_pre_enable(crtc, pipe_config, old_state);
@@ -1086,9 +922,8 @@ intel_dp_aux_wait_done(i915_CONTROLLER *controller)
 	UINT32 status;
 	BOOLEAN done;
 
-#define C (((status = controller->read32(ch_ctl)) & DP_AUX_CH_CTL_SEND_BUSY) == 0)
-	gBS->Stall(10 * 1000);
-	done = C;
+	done = i915WaitForRegister(controller, I915_WAIT_AUX, ch_ctl, DP_AUX_CH_CTL_SEND_BUSY, 0,
+							   timeout_ms * 1000, &status) == EFI_SUCCESS;
 	/* 	done = wait_event_timeout(i915->gmbus_wait_queue, C,
 				  msecs_to_jiffies_timeout(timeout_ms)); */
 
@@ -1096,10 +931,8 @@ intel_dp_aux_wait_done(i915_CONTROLLER *controller)
 	//trace_i915_reg_rw(FALSE, ch_ctl, status, sizeof(status), TRUE);
 
 	if (!done)
-		PRINT_DEBUG(EFI_D_ERROR,
-					"%s: did not complete or timeout within %ums (status 0x%08x)\n",
+		PRINT_ERROR("%s: did not complete or timeout within %ums (status 0x%08x)\n",
 					pin, timeout_ms, status);
-#undef C
 
 	return status;
 }
@@ -1164,15 +997,8 @@ static EFI_STATUS intel_wait_for_register(i915_CONTROLLER *controller,
 										  u32 value,
 										  unsigned int timeout_ms)
 {
-	for (int i = 0; i < timeout_ms; i++)
-	{
-		if ((controller->read32(reg) & mask) == value)
-		{
-			return EFI_SUCCESS;
-		}
-		gBS->Stall(1000);
-	}
-	return EFI_TIMEOUT;
+	return i915WaitForRegister(controller, I915_WAIT_PANEL, reg, mask, value,
+							   timeout_ms * 1000, NULL);
 }
 #define PP_READY (1 << 30)
 #define PP_SEQUENCE_NONE (0 << 28)
@@ -1191,13 +1017,13 @@ static EFI_STATUS intel_wait_for_register(i915_CONTROLLER *controller,
 #define PP_SEQUENCE_STATE_ON_S1_2 (0xa << 0)
 #define PP_SEQUENCE_STATE_ON_S1_3 (0xb << 0)
 #define PP_SEQUENCE_STATE_RESET (0xf << 0)
-#define IDLE_ON_MASK (PP_ON | PP_SEQUENCE_MASK | 0 | PP_SEQUENCE_STATE_MASK)
-#define IDLE_ON_VALUE (PP_ON | PP_SEQUENCE_NONE | 0 | PP_SEQUENCE_STATE_ON_IDLE)
+#define IDLE_ON_MASK (PP_STATUS_ON | PP_SEQUENCE_MASK | 0 | PP_SEQUENCE_STATE_MASK)
+#define IDLE_ON_VALUE (PP_STATUS_ON | PP_SEQUENCE_NONE | 0 | PP_SEQUENCE_STATE_ON_IDLE)
 
-#define IDLE_OFF_MASK (PP_ON | PP_SEQUENCE_MASK | 0 | 0)
+#define IDLE_OFF_MASK (PP_STATUS_ON | PP_SEQUENCE_MASK | 0 | 0)
 #define IDLE_OFF_VALUE (0 | PP_SEQUENCE_NONE | 0 | 0)
 
-#define IDLE_CYCLE_MASK (PP_ON | PP_SEQUENCE_MASK | PP_CYCLE_DELAY_ACTIVE | PP_SEQUENCE_STATE_MASK)
+#define IDLE_CYCLE_MASK (PP_STATUS_ON | PP_SEQUENCE_MASK | PP_CYCLE_DELAY_ACTIVE | PP_SEQUENCE_STATE_MASK)
 #define IDLE_CYCLE_VALUE (0 | PP_SEQUENCE_NONE | 0 | PP_SEQUENCE_STATE_OFF_IDLE)
 static void
 wait_panel_status(struct intel_dp *intel_dp,
@@ -1222,7 +1048,7 @@ wait_panel_status(struct intel_dp *intel_dp,
 	if (intel_wait_for_register(intel_dp->controller,
 								PP_STATUS, mask, value,
 								5000))
-		PRINT_DEBUG(EFI_D_ERROR, "Panel status timeout: status %08x control %08x\n",
+		PRINT_ERROR("Panel status timeout: status %08x control %08x\n",
 					intel_dp->controller->read32(PP_STATUS),
 					intel_dp->controller->read32(PP_CONTROL));
 
@@ -1288,7 +1114,7 @@ static bool edp_have_panel_power(i915_CONTROLLER *controller)
 	// 	intel_dp->pps_pipe == INVALID_PIPE)
 	// 	return false;
 
-	return (controller->read32(PP_STATUS) & PP_ON) != 0;
+	return (controller->read32(PP_STATUS) & PP_STATUS_ON) != 0;
 }
 
 // static bool edp_have_panel_vdd(i915_CONTROLLER *controller)
@@ -1357,6 +1183,29 @@ static bool edp_panel_vdd_on(struct intel_dp *intel_dp)
 
 	return true;
 }
+//The eDP AUX channel only answers with panel VDD up. Callers turn it on
+//before the first AUX transfer to the panel, the EDID read included.
+EFI_STATUS EnablePanelVdd(i915_CONTROLLER *controller)
+{
+	if (controller->intel_dp == NULL)
+		return EFI_NOT_READY;
+	edp_panel_vdd_on(controller->intel_dp);
+	return EFI_SUCCESS;
+}
+//Drops the VDD force EnablePanelVdd set, for a panel that turned out not to
+//be the output. The panel's own power is left as it is.
+EFI_STATUS DisablePanelVdd(i915_CONTROLLER *controller)
+{
+	u32 pp;
+
+	if (controller->intel_dp == NULL)
+		return EFI_NOT_READY;
+	PRINT_DEBUG(EFI_D_ERROR, "Turning eDP VDD off\n");
+	pp = ironlake_get_pp_control(controller);
+	pp &= ~EDP_FORCE_VDD;
+	controller->write32(PP_CONTROL, pp);
+	return EFI_SUCCESS;
+}
 static void edp_panel_on(struct intel_dp *intel_dp)
 {
 	//	struct drm_i915_private *dev_priv = dp_to_i915(intel_dp);
@@ -1423,6 +1272,7 @@ intel_dp_aux_xfer(i915_CONTROLLER *controller,
 	int try, clock = 0;
 	UINT32 val;
 	UINT32 status;
+	BOOLEAN busy;
 	//	BOOLEAN vdd;
 	UINT32 pin = controller->OutputPath.AuxCh;
 	ch_ctl = _DPA_AUX_CH_CTL + (pin << 8);
@@ -1458,17 +1308,12 @@ intel_dp_aux_xfer(i915_CONTROLLER *controller,
 	intel_dp_check_edp(intel_dp); */
 
 	/* Try to wait for any previous AUX channel activity */
-	for (try = 0; try < 3; try++)
-	{
-		status = controller->read32(ch_ctl);
-		if ((status & DP_AUX_CH_CTL_SEND_BUSY) == 0)
-			break;
-		gBS->Stall(1000);
-	}
+	busy = i915WaitForRegister(controller, I915_WAIT_AUX, ch_ctl, DP_AUX_CH_CTL_SEND_BUSY, 0,
+							   3000, &status) != EFI_SUCCESS;
 	/* just trace the final value */
 	//trace_i915_reg_rw(FALSE, ch_ctl, status, sizeof(status), TRUE);
 
-	if (try == 3)
+	if (busy)
 	{
 		/* 		const UINT32 status = controller->read32(_DPA_AUX_CH_CTL + (pin << 8));	 */
 
@@ -1553,7 +1398,7 @@ done:
 	 */
 	if (status & DP_AUX_CH_CTL_RECEIVE_ERROR)
 	{
-		PRINT_DEBUG(EFI_D_ERROR, "%s: receive error (status 0x%08x)\n",
+		PRINT_ERROR("%s: receive error (status 0x%08x)\n",
 					pin, status);
 		ret = -EIO;
 		goto out;
@@ -1563,7 +1408,7 @@ done:
 	 * "normal" -- don't fill the kernel log with these */
 	if (status & DP_AUX_CH_CTL_TIME_OUT_ERROR)
 	{
-		PRINT_DEBUG(EFI_D_ERROR, "%s: timeout (status 0x%08x)\n",
+		PRINT_ERROR("%s: timeout (status 0x%08x)\n",
 					pin, status);
 		ret = -ETIMEDOUT;
 		goto out;
@@ -1699,6 +1544,278 @@ static INT32 intel_dp_aux_transfer(i915_CONTROLLER *controller, struct drm_dp_au
  */
 #define AUX_RETRY_INTERVAL 500 /* us */
 
+/*
+ * I2C-over-AUX for the EDID. A read request returns at most 16 bytes, all
+ * the five data registers hold next to the reply byte. Unlike
+ * intel_dp_aux_xfer this addresses the channel directly and leaves panel
+ * VDD alone, so it works before OutputPath is known.
+ */
+#define DP_I2C_BURST 16
+#define DP_I2C_EDID_ADDR 0x50
+#define DP_I2C_SEGMENT_ADDR 0x30
+#define DP_EDID_BLOCK 128
+#define DP_DDC_SEGMENT_SIZE 256
+
+/* the I2C requests of a DDC read, see intel_dp_read_ddc_step */
+enum
+{
+	DP_DDC_START,	/* nothing on the wire yet */
+	DP_DDC_SEGMENT, /* the E-DDC segment pointer, with MOT */
+	DP_DDC_OFFSET,	/* the offset in the segment, with MOT */
+	DP_DDC_DATA,	/* a burst of data, with MOT */
+	DP_DDC_STOP,	/* the bare address without MOT that ends it */
+	DP_DDC_DONE,
+};
+
+/* Writes the request in read->txbuf to the channel and arms wait for it. */
+static void intel_dp_aux_send(i915_CONTROLLER *controller, I915_DP_DDC_READ *read, I915_WAIT *wait)
+{
+	UINT64 ch_ctl = _DPA_AUX_CH_CTL + ((UINT64)read->aux_ch << 8);
+	UINT64 ch_data = _DPA_AUX_CH_DATA1 + ((UINT64)read->aux_ch << 8);
+	int i;
+
+	for (i = 0; i < read->send_bytes; i += 4)
+		controller->write32(ch_data + i, intel_dp_pack_aux(read->txbuf + i, read->send_bytes - i));
+	controller->write32(ch_ctl, skl_get_aux_send_ctl(read->send_bytes, 0));
+	i915WaitBegin(wait, I915_WAIT_AUX, ch_ctl, DP_AUX_CH_CTL_SEND_BUSY, 0, 10000);
+	read->resend = FALSE;
+}
+
+/*
+ * Starts one I2C-over-AUX request. size 0 sends the bare address, which
+ * without MOT ends the I2C transaction with a stop.
+ */
+static void intel_dp_i2c_request(i915_CONTROLLER *controller, I915_DP_DDC_READ *read,
+								 UINT8 request, UINT8 addr, UINT8 *buffer, UINT32 size,
+								 I915_WAIT *wait)
+{
+	read->write = (request & ~DP_AUX_I2C_MOT) == DP_AUX_I2C_WRITE;
+	read->buffer = buffer;
+	read->size = size;
+	read->txbuf[0] = request << 4;
+	read->txbuf[1] = 0;
+	read->txbuf[2] = addr;
+	read->txbuf[3] = size - 1;
+	read->send_bytes = size == 0 ? BARE_ADDRESS_SIZE : HEADER_SIZE;
+	read->recv_size = read->write ? 2 : size + 1;
+	if (read->write && size > 0)
+	{
+		memcpy(read->txbuf + HEADER_SIZE, buffer, size);
+		read->send_bytes += size;
+	}
+	read->tries = 0;
+	read->retries = 0;
+	intel_dp_aux_send(controller, read, wait);
+}
+
+/*
+ * Takes the reply to the request on the wire once wait is over. AUX errors
+ * are retried, at least 3 times according to DP spec, and AUX and I2C
+ * defers after AUX_RETRY_INTERVAL. A NACK from either side fails the
+ * request. Returns the bytes moved, which for a read can be fewer than
+ * asked, a negative errno, or -EAGAIN with wait armed for the retry.
+ */
+static int intel_dp_i2c_reply(i915_CONTROLLER *controller, I915_DP_DDC_READ *read, I915_WAIT *wait)
+{
+	UINT64 ch_ctl = _DPA_AUX_CH_CTL + ((UINT64)read->aux_ch << 8);
+	UINT64 ch_data = _DPA_AUX_CH_DATA1 + ((UINT64)read->aux_ch << 8);
+	UINT32 status = wait->lastValue;
+	UINT8 rxbuf[20];
+	int i, recv_bytes;
+	UINT8 reply;
+
+	if (read->resend)
+	{
+		intel_dp_aux_send(controller, read, wait);
+		return -EAGAIN;
+	}
+	controller->write32(ch_ctl, status | DP_AUX_CH_CTL_DONE |
+									DP_AUX_CH_CTL_TIME_OUT_ERROR |
+									DP_AUX_CH_CTL_RECEIVE_ERROR);
+	if ((status & (DP_AUX_CH_CTL_TIME_OUT_ERROR | DP_AUX_CH_CTL_RECEIVE_ERROR)) ||
+		!(status & DP_AUX_CH_CTL_DONE))
+	{
+		if (++read->tries < 5)
+		{
+			/* timeouts already took the 400us the spec wants between tries */
+			if (!(status & DP_AUX_CH_CTL_TIME_OUT_ERROR) && (status & DP_AUX_CH_CTL_RECEIVE_ERROR))
+			{
+				i915WaitDelay(wait, 500);
+				read->resend = TRUE;
+			}
+			else
+				intel_dp_aux_send(controller, read, wait);
+			return -EAGAIN;
+		}
+	}
+	if ((status & (DP_AUX_CH_CTL_SEND_BUSY | DP_AUX_CH_CTL_DONE | DP_AUX_CH_CTL_TIME_OUT_ERROR |
+				   DP_AUX_CH_CTL_RECEIVE_ERROR)) != DP_AUX_CH_CTL_DONE)
+		return -ETIMEDOUT;
+
+	recv_bytes = (status & DP_AUX_CH_CTL_MESSAGE_SIZE_MASK) >> DP_AUX_CH_CTL_MESSAGE_SIZE_SHIFT;
+	if (recv_bytes == 0 || recv_bytes > 20)
+		return -EBUSY;
+	if (recv_bytes > read->recv_size)
+		recv_bytes = read->recv_size;
+	for (i = 0; i < recv_bytes; i += 4)
+		intel_dp_unpack_aux(controller->read32(ch_data + i), rxbuf + i, recv_bytes - i);
+
+	reply = rxbuf[0] >> 4;
+	if ((reply & DP_AUX_NATIVE_REPLY_MASK) == DP_AUX_NATIVE_REPLY_NACK ||
+		(reply & DP_AUX_I2C_REPLY_MASK) == DP_AUX_I2C_REPLY_NACK)
+		return -EIO;
+	if ((reply & DP_AUX_NATIVE_REPLY_MASK) == DP_AUX_NATIVE_REPLY_DEFER ||
+		(reply & DP_AUX_I2C_REPLY_MASK) == DP_AUX_I2C_REPLY_DEFER)
+	{
+		if (++read->retries >= 32)
+			return -EBUSY;
+		read->tries = 0;
+		i915WaitDelay(wait, AUX_RETRY_INTERVAL);
+		read->resend = TRUE;
+		return -EAGAIN;
+	}
+	if (read->write)
+		/* a short write reports how many bytes made it */
+		return recv_bytes > 1 ? clamp_t(int, rxbuf[1], 0, read->size) : (int)read->size;
+	memcpy(read->buffer, rxbuf + 1, recv_bytes - 1);
+	return recv_bytes - 1;
+}
+
+/* Puts the request for phase on the wire. */
+static void intel_dp_ddc_request(i915_CONTROLLER *controller, I915_DP_DDC_READ *read, UINT32 phase,
+								 I915_WAIT *wait)
+{
+	UINT32 pos = read->start + read->done;
+
+	read->phase = phase;
+	switch (phase)
+	{
+	case DP_DDC_SEGMENT:
+		read->byte = (UINT8)(pos / DP_DDC_SEGMENT_SIZE);
+		intel_dp_i2c_request(controller, read, DP_AUX_I2C_MOT | DP_AUX_I2C_WRITE,
+							 DP_I2C_SEGMENT_ADDR, &read->byte, 1, wait);
+		break;
+	case DP_DDC_OFFSET:
+		read->byte = (UINT8)(pos % DP_DDC_SEGMENT_SIZE);
+		intel_dp_i2c_request(controller, read, DP_AUX_I2C_MOT | DP_AUX_I2C_WRITE,
+							 DP_I2C_EDID_ADDR, &read->byte, 1, wait);
+		break;
+	case DP_DDC_DATA:
+		intel_dp_i2c_request(controller, read, DP_AUX_I2C_MOT | DP_AUX_I2C_READ, DP_I2C_EDID_ADDR,
+							 read->buf + read->done, MIN(read->end - read->done, DP_I2C_BURST), wait);
+		break;
+	default:
+		intel_dp_i2c_request(controller, read, DP_AUX_I2C_READ, DP_I2C_EDID_ADDR, NULL, 0, wait);
+		break;
+	}
+}
+
+/* Sets read up for len bytes from offset in E-DDC segment segment. */
+void intel_dp_read_ddc_begin(I915_DP_DDC_READ *read, UINT8 aux_ch, UINT8 segment, UINT8 offset,
+							 UINT8 *buf, UINT32 len)
+{
+	ZeroMem(read, sizeof(*read));
+	read->aux_ch = aux_ch;
+	read->start = (UINT32)segment * DP_DDC_SEGMENT_SIZE + offset;
+	read->buf = buf;
+	read->len = len;
+	read->status = EFI_SUCCESS;
+	if (len == 0)
+		read->phase = DP_DDC_DONE;
+}
+
+/* Sets read up for count EDID blocks from block first on. */
+void intel_dp_read_edid_begin(I915_DP_DDC_READ *read, UINT8 aux_ch, UINT32 first, UINT32 count,
+							  UINT8 *buf)
+{
+	intel_dp_read_ddc_begin(read, aux_ch, 0, 0, buf, count * DP_EDID_BLOCK);
+	read->start = first * DP_EDID_BLOCK;
+}
+
+/*
+ * Runs read up to its next AUX wait. Returns EFI_NOT_READY with wait armed,
+ * the caller polls or completes it and calls again, until the read is over.
+ * Each E-DDC segment is a transaction of its own: the segment pointer and
+ * the offset go out with MOT set, the data follows in 16 byte bursts and a
+ * bare address without MOT ends it.
+ */
+EFI_STATUS intel_dp_read_ddc_step(i915_CONTROLLER *controller, I915_DP_DDC_READ *read,
+								  I915_WAIT *wait)
+{
+	UINT32 pos;
+	int ret;
+
+	switch (read->phase)
+	{
+	case DP_DDC_START:
+		pos = read->start + read->done;
+		read->end = read->done + MIN(read->len - read->done,
+									 DP_DDC_SEGMENT_SIZE - pos % DP_DDC_SEGMENT_SIZE);
+		intel_dp_ddc_request(controller, read,
+							 pos >= DP_DDC_SEGMENT_SIZE ? DP_DDC_SEGMENT : DP_DDC_OFFSET, wait);
+		return EFI_NOT_READY;
+	case DP_DDC_DONE:
+		return read->status;
+	}
+	ret = intel_dp_i2c_reply(controller, read, wait);
+	if (ret == -EAGAIN)
+		return EFI_NOT_READY;
+	switch (read->phase)
+	{
+	case DP_DDC_SEGMENT:
+	case DP_DDC_OFFSET:
+		if (ret == 1)
+		{
+			intel_dp_ddc_request(controller, read, read->phase + 1, wait);
+			return EFI_NOT_READY;
+		}
+		break;
+	case DP_DDC_DATA:
+		if (ret > 0)
+		{
+			read->done += ret;
+			if (read->done < read->end)
+			{
+				intel_dp_ddc_request(controller, read, DP_DDC_DATA, wait);
+				return EFI_NOT_READY;
+			}
+		}
+		break;
+	default:
+		/* the stop went out, the transaction is over either way */
+		if (read->done < read->end)
+		{
+			PRINT_DEBUG(EFI_D_ERROR, "DP aux %d: DDC read stopped at %u of %u bytes (%d)\n",
+						read->aux_ch, read->done, read->len, read->ret);
+			read->status = EFI_NOT_FOUND;
+		}
+		else if (read->done < read->len)
+		{
+			read->phase = DP_DDC_START;
+			return intel_dp_read_ddc_step(controller, read, wait);
+		}
+		read->phase = DP_DDC_DONE;
+		return read->status;
+	}
+	read->ret = ret;
+	intel_dp_ddc_request(controller, read, DP_DDC_STOP, wait);
+	return EFI_NOT_READY;
+}
+
+/* Reads len bytes of the EDID from offset in E-DDC segment segment. */
+EFI_STATUS ReadDDCDP(i915_CONTROLLER *controller, UINT8 pin, UINT8 segment, UINT8 offset, UINT8 *buf,
+					 UINT32 len)
+{
+	I915_DP_DDC_READ read;
+	I915_WAIT wait;
+	EFI_STATUS Status;
+
+	intel_dp_read_ddc_begin(&read, pin, segment, offset, buf, len);
+	while ((Status = intel_dp_read_ddc_step(controller, &read, &wait)) == EFI_NOT_READY)
+		i915WaitComplete(controller, &wait);
+	return Status;
+}
+
 static RETURN_STATUS drm_dp_dpcd_access(UINT8 request,
 										unsigned int offset, void *buffer, UINT32 size, i915_CONTROLLER *controller)
 {
@@ -1706,7 +1823,7 @@ static RETURN_STATUS drm_dp_dpcd_access(UINT8 request,
 	unsigned int retry, native_reply;
 	RETURN_STATUS err = 0, ret = 0;
 
-	// memset(&msg, 0, sizeof(msg)); //Not Defined
+	ZeroMem(&msg, sizeof(msg));
 	msg.address = offset;
 	msg.request = request;
 	msg.buffer = buffer;
@@ -1749,12 +1866,78 @@ static RETURN_STATUS drm_dp_dpcd_access(UINT8 request,
 			err = ret;
 	}
 
-	PRINT_DEBUG(EFI_D_ERROR, "Too many retries, giving up. First error: %d\n", err);
+	PRINT_ERROR("Too many retries, giving up. First error: %d\n", err);
 	ret = err;
 
 unlock:
 	return ret;
 }
+struct dpcd_cache_range
+{
+	unsigned int base;
+	UINT32 size;
+	UINT32 cache_offset;
+};
+static const struct dpcd_cache_range dpcd_cache_ranges[] = {
+	/* receiver capability field */
+	{DP_DPCD_REV, 0x100, 0},
+	/* eDP general capabilities, eDP panels only */
+	{DP_EDP_DPCD_REV, DP_DPCD_CACHE_BURST, 0x100},
+	/* extended receiver capabilities, if DP_EXTENDED_RECEIVER_CAP_FIELD_PRESENT */
+	{DP_DP13_DPCD_REV, DP_DPCD_CACHE_BURST, 0x100 + DP_DPCD_CACHE_BURST},
+};
+
+static UINT32 dpcd_cache_bursts(UINT32 cache_offset, UINT32 size)
+{
+	UINT32 first = cache_offset / DP_DPCD_CACHE_BURST;
+	UINT32 last = (cache_offset + size - 1) / DP_DPCD_CACHE_BURST;
+
+	return ((1u << (last - first + 1)) - 1) << first;
+}
+
+/* Returns the cached copy of offset..offset+size, NULL if not all of it is cached. */
+static UINT8 *intel_dp_dpcd_cache_lookup(struct intel_dp *intel_dp,
+										 unsigned int offset, UINT32 size)
+{
+	for (int i = 0; i < ARRAY_SIZE(dpcd_cache_ranges); i++)
+	{
+		const struct dpcd_cache_range *range = &dpcd_cache_ranges[i];
+		UINT32 cache_offset;
+
+		if (size == 0 || offset < range->base || offset + size > range->base + range->size)
+			continue;
+		cache_offset = range->cache_offset + offset - range->base;
+		if ((intel_dp->dpcd_cache_valid & dpcd_cache_bursts(cache_offset, size)) !=
+			dpcd_cache_bursts(cache_offset, size))
+			return NULL;
+		return intel_dp->dpcd_cache + cache_offset;
+	}
+	return NULL;
+}
+
+/* A write may change what the sink reports, the bursts it touches are read again */
+static void intel_dp_dpcd_cache_drop(struct intel_dp *intel_dp,
+									 unsigned int offset, UINT32 size)
+{
+	for (int i = 0; i < ARRAY_SIZE(dpcd_cache_ranges); i++)
+	{
+		const struct dpcd_cache_range *range = &dpcd_cache_ranges[i];
+		unsigned int start = MAX(offset, range->base);
+		unsigned int end = MIN(offset + size, range->base + range->size);
+
+		if (start < end)
+			intel_dp->dpcd_cache_valid &=
+				~dpcd_cache_bursts(range->cache_offset + start - range->base, end - start);
+	}
+}
+
+/* Forget everything read from the sink, for a new connect */
+void intel_dp_dpcd_cache_invalidate(struct intel_dp *intel_dp)
+{
+	intel_dp->dpcd_cache_valid = 0;
+	intel_dp->dpcd_cache_filled = FALSE;
+}
+
 /**
  * drm_dp_dpcd_read() - read a series of bytes from the DPCD
  * @aux: DisplayPort AUX channel (SST or MST)
@@ -1772,8 +1955,16 @@ unlock:
 INT32 drm_dp_dpcd_read(unsigned int offset,
 					   void *buffer, UINT32 size, i915_CONTROLLER *controller)
 {
+	struct intel_dp *intel_dp = controller->intel_dp;
+	UINT8 *cached = intel_dp ? intel_dp_dpcd_cache_lookup(intel_dp, offset, size) : NULL;
 	int ret;
 
+	if (cached)
+	{
+		CopyMem(buffer, cached, size);
+		return size;
+	}
+
 	/*
 	 * HP ZR24w corrupts the first DPCD access after entering power save
 	 * mode. Eg. on a read, the entire buffer will be filled with the same
@@ -1802,6 +1993,65 @@ INT32 drm_dp_dpcd_read(unsigned int offset,
 out:
 	return ret;
 }
+/*
+ * Reads the DPCD capability fields into memory, one AUX transaction per 16
+ * bytes instead of one per register access. Later reads of them are served
+ * from the cache until the sink is connected again. Bursts the sink did not
+ * answer stay uncached and are read from the sink when asked for.
+ */
+static void intel_dp_dpcd_cache_fill(struct intel_dp *intel_dp)
+{
+	i915_CONTROLLER *controller = intel_dp->controller;
+
+	if (intel_dp->dpcd_cache_filled)
+		return;
+	intel_dp->dpcd_cache_filled = TRUE;
+	/* the throw away read of drm_dp_dpcd_read, once for all the bursts */
+	drm_dp_dpcd_access(DP_AUX_NATIVE_READ, DP_DPCD_REV, intel_dp->dpcd_cache, 1, controller);
+	for (int i = 0; i < ARRAY_SIZE(dpcd_cache_ranges); i++)
+	{
+		const struct dpcd_cache_range *range = &dpcd_cache_ranges[i];
+
+		if (range->base == DP_EDP_DPCD_REV && controller->OutputPath.ConType != eDP)
+			continue;
+		if (range->base == DP_DP13_DPCD_REV &&
+			!(intel_dp->dpcd_cache[DP_TRAINING_AUX_RD_INTERVAL] & DP_EXTENDED_RECEIVER_CAP_FIELD_PRESENT))
+			continue;
+		for (UINT32 done = 0; done < range->size; done += DP_DPCD_CACHE_BURST)
+		{
+			UINT32 cache_offset = range->cache_offset + done;
+
+			if (drm_dp_dpcd_access(DP_AUX_NATIVE_READ, range->base + done,
+								   intel_dp->dpcd_cache + cache_offset,
+								   DP_DPCD_CACHE_BURST, controller) != DP_DPCD_CACHE_BURST)
+			{
+				PRINT_DEBUG(EFI_D_ERROR, "DPCD %05x not cached\n", range->base + done);
+				ZeroMem(intel_dp->dpcd_cache + cache_offset, DP_DPCD_CACHE_BURST);
+				continue;
+			}
+			intel_dp->dpcd_cache_valid |= dpcd_cache_bursts(cache_offset, DP_DPCD_CACHE_BURST);
+		}
+	}
+	PRINT_DEBUG(EFI_D_ERROR, "DPCD rev %x, max rate %x, max lanes %x, extended %d\n",
+				intel_dp->dpcd_cache[DP_DPCD_REV], intel_dp->dpcd_cache[DP_MAX_LINK_RATE],
+				intel_dp->dpcd_cache[DP_MAX_LANE_COUNT],
+				(intel_dp->dpcd_cache[DP_TRAINING_AUX_RD_INTERVAL] & DP_EXTENDED_RECEIVER_CAP_FIELD_PRESENT) != 0);
+}
+
+/*
+ * One receiver capability byte. A DP 1.3 sink reports its real capabilities
+ * in the extended field, the one at 0x000 may be held back for old sources.
+ */
+static UINT8 intel_dp_dpcd_cap(struct intel_dp *intel_dp, unsigned int offset)
+{
+	UINT8 *ext = NULL;
+
+	/* the training interval keeps its meaning from the base field */
+	if (offset < DP_DPCD_CACHE_BURST && offset != DP_TRAINING_AUX_RD_INTERVAL)
+		ext = intel_dp_dpcd_cache_lookup(intel_dp, DP_DP13_DPCD_REV + offset, 1);
+	return ext ? *ext : intel_dp->dpcd_cache[offset];
+}
+
 BOOLEAN
 intel_dp_get_link_status(UINT8 link_status[DP_LINK_STATUS_SIZE], i915_CONTROLLER *controller)
 {
@@ -1982,6 +2232,8 @@ INT32 drm_dp_dpcd_write(unsigned int offset,
 {
 	int ret;
 
+	if (controller->intel_dp)
+		intel_dp_dpcd_cache_drop(controller->intel_dp, offset, size);
 	//if (aux->is_remote)
 	//	ret = drm_dp_mst_dpcd_write(aux, offset, buffer, size);
 	//else
@@ -2177,9 +2429,10 @@ static BOOLEAN
 intel_dp_reset_link_train(struct intel_dp *intel_dp,
 						  UINT8 dp_train_pat, i915_CONTROLLER *controller)
 {
+	/* a known sink starts at the levels it trained at last time */
 	for (int i = 0; i < 4; i++)
 	{
-		intel_dp->train_set[i] = 0;
+		intel_dp->train_set[i] = intel_dp->use_cached_train ? intel_dp->cached_train_set[i] : 0;
 	}
 	intel_dp_set_signal_levels(intel_dp);
 	return intel_dp_set_link_train(intel_dp, dp_train_pat);
@@ -2190,18 +2443,33 @@ UINT8 drm_dp_link_rate_to_bw_code(int link_rate)
 	/* Spec says link_bw = link_rate / 0.27Gbps */
 	return link_rate / 27000;
 }
+/* Index of the rate in DP_SUPPORTED_LINK_RATES, what DP_LINK_RATE_SET takes */
+static UINT8 intel_dp_rate_select(struct intel_dp *intel_dp, int rate)
+{
+	const UINT8 *rates = intel_dp->dpcd_cache + DP_SUPPORTED_LINK_RATES;
+
+	for (int i = 0; i < DP_MAX_SUPPORTED_RATES; i++)
+	{
+		if ((rates[2 * i] | (rates[2 * i + 1] << 8)) * 200 / 10 == rate)
+			return i;
+	}
+	return 0;
+}
 void intel_dp_compute_rate(struct intel_dp *intel_dp, int port_clock,
 						   UINT8 *link_bw, UINT8 *rate_select)
 {
 	/* eDP 1.4 rate select method. */
-	/* 	if (intel_dp->use_rate_select) {
+	if (intel_dp->use_rate_select)
+	{
 		*link_bw = 0;
 		*rate_select =
 			intel_dp_rate_select(intel_dp, port_clock);
-	} else { */
-	*link_bw = drm_dp_link_rate_to_bw_code(port_clock);
-	*rate_select = 0;
-	//	}
+	}
+	else
+	{
+		*link_bw = drm_dp_link_rate_to_bw_code(port_clock);
+		*rate_select = 0;
+	}
 }
 static BOOLEAN intel_dp_link_max_vswing_reached(struct intel_dp *intel_dp)
 {
@@ -2214,32 +2482,44 @@ static BOOLEAN intel_dp_link_max_vswing_reached(struct intel_dp *intel_dp)
 
 	return TRUE;
 }
+/* DP_TRAINING_AUX_RD_INTERVAL in ms, 0 for the spec defaults */
+static int dp_training_rd_interval_ms(struct intel_dp *intel_dp)
+{
+	int rd_interval = intel_dp->dpcd_cache[DP_TRAINING_AUX_RD_INTERVAL] &
+					  DP_TRAINING_AUX_RD_MASK;
+
+	if (rd_interval > 4)
+		PRINT_DEBUG(EFI_D_ERROR, "AUX interval %d, out of range (max 4)\n",
+					rd_interval);
+	return MIN(rd_interval, 4) * 4;
+}
+/* in us, how long the sink gets before its clock recovery status is read */
+static UINT32 drm_dp_link_train_clock_recovery_delay(struct intel_dp *intel_dp)
+{
+	int rd_interval = dp_training_rd_interval_ms(intel_dp);
+
+	if (rd_interval == 0 || intel_dp_dpcd_cap(intel_dp, DP_DPCD_REV) >= DP_DPCD_REV_14)
+		return 100;
+	return rd_interval * 1000;
+}
+/* in us, how long the sink gets before its channel EQ status is read */
+static UINT32 drm_dp_link_train_channel_eq_delay(struct intel_dp *intel_dp)
+{
+	int rd_interval = dp_training_rd_interval_ms(intel_dp);
+
+	if (rd_interval == 0)
+		return 400;
+	return rd_interval * 1000;
+}
 #define DP_PLL_FREQ_270MHZ (0 << 16)
 #define DP_PLL_FREQ_162MHZ (1 << 16)
 #define DP_PLL_FREQ_MASK (3 << 16)
-/* Enable corresponding port and start training pattern 1 */
-static BOOLEAN
-intel_dp_link_training_clock_recovery(struct intel_dp *intel_dp)
+/* Tell the sink the link rate and lane count it is about to be trained at */
+static void
+intel_dp_write_link_config(struct intel_dp *intel_dp, UINT8 link_bw, UINT8 rate_select)
 {
 	i915_CONTROLLER *controller = intel_dp->controller;
-	//struct drm_i915_private *i915 = dp_to_i915(intel_dp);
-	UINT8 voltage;
-	int voltage_tries, cr_tries, max_cr_tries;
-	BOOLEAN max_vswing_reached = FALSE;
 	UINT8 link_config[2];
-	UINT8 link_bw, rate_select;
-	intel_dp_compute_rate(intel_dp, intel_dp->link_rate,
-						  &link_bw, &rate_select);
-	/* if (intel_dp->prepare_link_retrain)
-		intel_dp->prepare_link_retrain(intel_dp);
- */
-	/* if ((controller->read32(0x64000) & DP_PLL_FREQ_MASK) == DP_PLL_FREQ_162MHZ)
-			intel_dp_compute_rate(intel_dp, 162000,
-			      &link_bw, &rate_select);
-		else
-			intel_dp_compute_rate(intel_dp, 270000,
-			      &link_bw, &rate_select); */
-	//WHAT RATE IS PLUGGED IN? Port Clock
 
 	if (link_bw)
 		PRINT_DEBUG(EFI_D_ERROR, "Using LINK_BW_SET value %u\n", link_bw);
@@ -2261,6 +2541,31 @@ intel_dp_link_training_clock_recovery(struct intel_dp *intel_dp)
 	link_config[0] = 0;
 	link_config[1] = DP_SET_ANSI_8B10B;
 	drm_dp_dpcd_write(DP_DOWNSPREAD_CTRL, link_config, 2, controller);
+}
+/*
+ * Enable corresponding port and start training pattern 1. FALSE if the sink
+ * could not be set up for it.
+ */
+static BOOLEAN
+intel_dp_clock_recovery_start(struct intel_dp *intel_dp, I915_DP_TRAIN *train)
+{
+	i915_CONTROLLER *controller = intel_dp->controller;
+	//struct drm_i915_private *i915 = dp_to_i915(intel_dp);
+	UINT8 link_bw, rate_select;
+	intel_dp_compute_rate(intel_dp, intel_dp->link_rate,
+						  &link_bw, &rate_select);
+	/* if (intel_dp->prepare_link_retrain)
+		intel_dp->prepare_link_retrain(intel_dp);
+ */
+	/* if ((controller->read32(0x64000) & DP_PLL_FREQ_MASK) == DP_PLL_FREQ_162MHZ)
+			intel_dp_compute_rate(intel_dp, 162000,
+			      &link_bw, &rate_select);
+		else
+			intel_dp_compute_rate(intel_dp, 270000,
+			      &link_bw, &rate_select); */
+	//WHAT RATE IS PLUGGED IN? Port Clock
+
+	intel_dp_write_link_config(intel_dp, link_bw, rate_select);
 
 	//intel_dp->DP |= DP_PORT_EN;
 
@@ -2270,8 +2575,8 @@ intel_dp_link_training_clock_recovery(struct intel_dp *intel_dp)
 									   DP_LINK_SCRAMBLING_DISABLE,
 								   controller))
 	{
-		PRINT_DEBUG(EFI_D_ERROR, "failed to enable link training\n");
-		return TRUE;
+		PRINT_ERROR("failed to enable link training\n");
+		return FALSE;
 	}
 
 	/*
@@ -2282,67 +2587,78 @@ intel_dp_link_training_clock_recovery(struct intel_dp *intel_dp)
 	 * define a limit and created the possibility of an infinite loop
 	 * we want to prevent any sync from triggering that corner case.
 	 */
-	//	if (intel_dp->dpcd[DP_DPCD_REV] >= DP_DPCD_REV_14)
-	//		max_cr_tries = 10;
-	//	else
-	max_cr_tries = 80;
+	if (intel_dp_dpcd_cap(intel_dp, DP_DPCD_REV) >= DP_DPCD_REV_14)
+		train->max_tries = 10;
+	else
+		train->max_tries = 80;
+
+	train->tries = 0;
+	train->voltage_tries = 1;
+	train->max_vswing_reached = FALSE;
+	return TRUE;
+}
+/*
+ * One clock recovery iteration, run once the sink had its read interval.
+ * 1 when the lanes locked, 0 to go again, -1 when clock recovery failed.
+ */
+static int
+intel_dp_clock_recovery_iterate(struct intel_dp *intel_dp, I915_DP_TRAIN *train)
+{
+	i915_CONTROLLER *controller = intel_dp->controller;
+	UINT8 link_status[DP_LINK_STATUS_SIZE];
+	UINT8 voltage;
 
-	voltage_tries = 1;
-	for (cr_tries = 0; cr_tries < max_cr_tries; ++cr_tries)
+	if (!intel_dp_get_link_status(link_status, controller))
 	{
-		UINT8 link_status[DP_LINK_STATUS_SIZE];
-		gBS->Stall(600);
-		//drm_dp_link_train_clock_recovery_delay(intel_dp->dpcd);
+		PRINT_ERROR("failed to get link status\n");
+		return -1;
+	}
 
-		if (!intel_dp_get_link_status(link_status, controller))
-		{
-			PRINT_DEBUG(EFI_D_ERROR, "failed to get link status\n");
-			return FALSE;
-		}
+	if (drm_dp_clock_recovery_ok(link_status, intel_dp->lane_count))
+	{
+		PRINT_DEBUG(EFI_D_ERROR, "clock recovery OK\n");
+		return 1;
+	}
 
-		if (drm_dp_clock_recovery_ok(link_status, intel_dp->lane_count))
-		{
-			PRINT_DEBUG(EFI_D_ERROR, "clock recovery OK\n");
-			return TRUE;
-		}
+	if (train->voltage_tries == 5)
+	{
+		PRINT_DEBUG(EFI_D_ERROR,
+					"Same voltage tried 5 times\n");
+		return -1;
+	}
 
-		if (voltage_tries == 5)
-		{
-			PRINT_DEBUG(EFI_D_ERROR,
-						"Same voltage tried 5 times\n");
-			return FALSE;
-		}
+	if (train->max_vswing_reached)
+	{
+		PRINT_DEBUG(EFI_D_ERROR, "Max Voltage Swing reached\n");
+		return -1;
+	}
 
-		if (max_vswing_reached)
-		{
-			PRINT_DEBUG(EFI_D_ERROR, "Max Voltage Swing reached\n");
-			return FALSE;
-		}
+	voltage = intel_dp->train_set[0] & DP_TRAIN_VOLTAGE_SWING_MASK;
+	PRINT_DEBUG(EFI_D_ERROR,
+				"Voltage used: %08x\n", voltage);
+	/* Update training set as requested by target */
+	intel_dp_get_adjust_train(intel_dp, link_status);
+	if (!intel_dp_update_link_train(intel_dp))
+	{
+		PRINT_ERROR("failed to update link training\n");
+		return -1;
+	}
 
-		voltage = intel_dp->train_set[0] & DP_TRAIN_VOLTAGE_SWING_MASK;
-		PRINT_DEBUG(EFI_D_ERROR,
-					"Voltage used: %08x\n", voltage);
-		/* Update training set as requested by target */
-		intel_dp_get_adjust_train(intel_dp, link_status);
-		if (!intel_dp_update_link_train(intel_dp))
-		{
-			PRINT_DEBUG(EFI_D_ERROR,
-						"failed to update link training\n");
-			return FALSE;
-		}
+	if ((intel_dp->train_set[0] & DP_TRAIN_VOLTAGE_SWING_MASK) ==
+		voltage)
+		++train->voltage_tries;
+	else
+		train->voltage_tries = 1;
 
-		if ((intel_dp->train_set[0] & DP_TRAIN_VOLTAGE_SWING_MASK) ==
-			voltage)
-			++voltage_tries;
-		else
-			voltage_tries = 1;
+	if (intel_dp_link_max_vswing_reached(intel_dp))
+		train->max_vswing_reached = TRUE;
 
-		if (intel_dp_link_max_vswing_reached(intel_dp))
-			max_vswing_reached = TRUE;
+	if (++train->tries == train->max_tries)
+	{
+		PRINT_ERROR("Failed clock recovery %d times, giving up!\n", train->max_tries);
+		return -1;
 	}
-	PRINT_DEBUG(EFI_D_ERROR,
-				"Failed clock recovery %d times, giving up!\n", max_cr_tries);
-	return FALSE;
+	return 0;
 }
 /*
  * Pick training pattern for channel equalization. Training pattern 4 for HBR3
@@ -2416,14 +2732,31 @@ BOOLEAN drm_dp_channel_eq_ok(const UINT8 link_status[DP_LINK_STATUS_SIZE],
 	}
 	return TRUE;
 }
+/*
+ * Lane count of a link trained before the driver started, 0 unless the sink
+ * still reports clock recovery and channel equalization on all its lanes.
+ */
+int intel_dp_readout_lane_count(i915_CONTROLLER *controller)
+{
+	UINT8 lane_count = 0;
+	UINT8 link_status[DP_LINK_STATUS_SIZE];
+
+	if (drm_dp_dpcd_read(DP_LANE_COUNT_SET, &lane_count, 1, controller) != 1)
+		return 0;
+	lane_count &= DP_LANE_COUNT_MASK;
+	if (lane_count == 0 || lane_count > 4 ||
+		!intel_dp_get_link_status(link_status, controller) ||
+		!drm_dp_clock_recovery_ok(link_status, lane_count) ||
+		!drm_dp_channel_eq_ok(link_status, lane_count))
+		return 0;
+	return lane_count;
+}
+/* Switches the sink to the channel equalization pattern */
 static BOOLEAN
-intel_dp_link_training_channel_equalization(struct intel_dp *intel_dp)
+intel_dp_channel_equalization_start(struct intel_dp *intel_dp, I915_DP_TRAIN *train)
 {
 	//struct drm_i915_private *i915 = dp_to_i915(intel_dp);
-	int tries;
 	UINT32 training_pattern;
-	UINT8 link_status[DP_LINK_STATUS_SIZE];
-	BOOLEAN channel_eq = FALSE;
 
 	training_pattern = intel_dp_training_pattern(intel_dp);
 	/* Scrambling is disabled for TPS2/3 and enabled for TPS4 */
@@ -2434,72 +2767,126 @@ intel_dp_link_training_channel_equalization(struct intel_dp *intel_dp)
 	if (!intel_dp_set_link_train(intel_dp,
 								 training_pattern))
 	{
-		PRINT_DEBUG(EFI_D_ERROR, "failed to start channel equalization\n");
+		PRINT_ERROR("failed to start channel equalization\n");
 		return FALSE;
 	}
+	train->tries = 0;
+	return TRUE;
+}
+/*
+ * One channel equalization iteration, run once the sink had its read
+ * interval. 1 when the lanes are equalized, 0 to go again, -1 when channel
+ * equalization failed. The link is idled once it is over either way.
+ */
+static int
+intel_dp_channel_equalization_iterate(struct intel_dp *intel_dp, I915_DP_TRAIN *train)
+{
+	UINT8 link_status[DP_LINK_STATUS_SIZE];
+	UINT32 DP;
+	int ret = 0;
 
-	for (tries = 0; tries < 5; tries++)
+	if (!intel_dp_get_link_status(link_status, intel_dp->controller))
 	{
-		gBS->Stall(600);
-		//drm_dp_link_train_channel_eq_delay(intel_dp->dpcd);
-		if (!intel_dp_get_link_status(link_status, intel_dp->controller))
-		{
-			PRINT_DEBUG(EFI_D_ERROR,
-						"failed to get link status\n");
-			break;
-		}
-		PRINT_DEBUG(EFI_D_ERROR, "Read Link Status 0: %x\n", link_status[0]);
-		PRINT_DEBUG(EFI_D_ERROR, "Read Link Status 1: %x\n", link_status[1]);
-		PRINT_DEBUG(EFI_D_ERROR, "Read Link Status 2: %x\n", link_status[2]);
-		PRINT_DEBUG(EFI_D_ERROR, "Read Link Status 3: %x\n", link_status[3]);
-		PRINT_DEBUG(EFI_D_ERROR, "Read Link Status 4: %x\n", link_status[4]);
-		PRINT_DEBUG(EFI_D_ERROR, "Read Link Status 5: %x\n", link_status[5]);
-
-		/* Make sure clock is still ok */
-		if (!drm_dp_clock_recovery_ok(link_status,
-									  intel_dp->lane_count))
-		{
-			//intel_dp_dump_link_status(link_status);
-			PRINT_DEBUG(EFI_D_ERROR,
-						"Clock recovery check failed, cannot continue channel equalization\n");
-			break;
-		}
+		PRINT_ERROR("failed to get link status\n");
+		ret = -1;
+		goto idle;
+	}
+	PRINT_DEBUG(EFI_D_ERROR, "Read Link Status 0: %x\n", link_status[0]);
+	PRINT_DEBUG(EFI_D_ERROR, "Read Link Status 1: %x\n", link_status[1]);
+	PRINT_DEBUG(EFI_D_ERROR, "Read Link Status 2: %x\n", link_status[2]);
+	PRINT_DEBUG(EFI_D_ERROR, "Read Link Status 3: %x\n", link_status[3]);
+	PRINT_DEBUG(EFI_D_ERROR, "Read Link Status 4: %x\n", link_status[4]);
+	PRINT_DEBUG(EFI_D_ERROR, "Read Link Status 5: %x\n", link_status[5]);
 
-		if (drm_dp_channel_eq_ok(link_status,
-								 intel_dp->lane_count))
-		{
-			channel_eq = TRUE;
-			PRINT_DEBUG(EFI_D_ERROR, "Channel EQ done. DP Training "
-									 "successful\n");
-			break;
-		}
+	/* Make sure clock is still ok */
+	if (!drm_dp_clock_recovery_ok(link_status,
+								  intel_dp->lane_count))
+	{
+		//intel_dp_dump_link_status(link_status);
+		PRINT_ERROR("Clock recovery check failed, cannot continue channel equalization\n");
+		ret = -1;
+		goto idle;
+	}
 
-		/* Update training set as requested by target */
-		intel_dp_get_adjust_train(intel_dp, link_status);
-		if (!intel_dp_update_link_train(intel_dp))
-		{
-			PRINT_DEBUG(EFI_D_ERROR,
-						"failed to update link training\n");
-			break;
-		}
+	if (drm_dp_channel_eq_ok(link_status,
+							 intel_dp->lane_count))
+	{
+		PRINT_DEBUG(EFI_D_ERROR, "Channel EQ done. DP Training "
+								 "successful\n");
+		ret = 1;
+		goto idle;
 	}
 
-	/* Try 5 times, else fail and try at lower BW */
-	if (tries == 5)
+	/* Update training set as requested by target */
+	intel_dp_get_adjust_train(intel_dp, link_status);
+	if (!intel_dp_update_link_train(intel_dp))
 	{
-		//intel_dp_dump_link_status(link_status);
-		PRINT_DEBUG(EFI_D_ERROR,
-					"Channel equalization failed 5 times\n");
+		PRINT_ERROR("failed to update link training\n");
+		ret = -1;
+		goto idle;
 	}
 
-	UINT32 DP = intel_dp->controller->read32(DP_TP_CTL(intel_dp->controller->OutputPath.Port));
+	/* Try 5 times, else fail and try at lower BW */
+	if (++train->tries < 5)
+		return 0;
+	//intel_dp_dump_link_status(link_status);
+	PRINT_ERROR("Channel equalization failed 5 times\n");
+	ret = -1;
+
+idle:
+	DP = intel_dp->controller->read32(DP_TP_CTL(intel_dp->controller->OutputPath.Port));
 
 	DP &= ~DP_LINK_TRAIN_MASK_CPT;
 
 	DP |= DP_TP_CTL_LINK_TRAIN_IDLE;
 
 	intel_dp->controller->write32(DP_TP_CTL(intel_dp->controller->OutputPath.Port), DP);
-	return channel_eq;
+	return ret;
+}
+/* How long each pattern is sent for when training without AUX handshake */
+#define DP_FAST_TRAIN_PATTERN_US 500
+/*
+ * Fast link training for sinks with DP_NO_AUX_HANDSHAKE_LINK_TRAINING: the
+ * source sends TPS1 and then TPS2 at the cached levels for a fixed time and
+ * the sink locks on its own, no adjust requests go back and forth. The link
+ * status is read once at the end, a link that did not come up goes through
+ * full training. This starts TPS1, FALSE if the sink needs full training.
+ */
+static BOOLEAN
+intel_dp_fast_link_train_start(struct intel_dp *intel_dp)
+{
+	UINT8 link_bw, rate_select;
+
+	if (!intel_dp->use_cached_train || !intel_dp->no_aux_handshake)
+		return FALSE;
+
+	intel_dp_compute_rate(intel_dp, intel_dp->link_rate,
+						  &link_bw, &rate_select);
+	intel_dp_write_link_config(intel_dp, link_bw, rate_select);
+	for (int i = 0; i < 4; i++)
+	{
+		intel_dp->train_set[i] = intel_dp->cached_train_set[i];
+	}
+	intel_dp_set_signal_levels(intel_dp);
+
+	intel_dp_program_link_training_pattern(intel_dp, DP_TRAINING_PATTERN_1);
+	return TRUE;
+}
+/* Whether the link came up once both patterns had their time */
+static BOOLEAN
+intel_dp_fast_link_train_check(struct intel_dp *intel_dp)
+{
+	UINT8 link_status[DP_LINK_STATUS_SIZE];
+
+	if (!intel_dp_get_link_status(link_status, intel_dp->controller) ||
+		!drm_dp_clock_recovery_ok(link_status, intel_dp->lane_count) ||
+		!drm_dp_channel_eq_ok(link_status, intel_dp->lane_count))
+	{
+		PRINT_DEBUG(EFI_D_ERROR, "Fast link training failed, doing full training\n");
+		return FALSE;
+	}
+	PRINT_DEBUG(EFI_D_ERROR, "Fast link training successful\n");
+	return TRUE;
 }
 static int intersect_rates(const int *source_rates, int source_len,
 						   const int *sink_rates, int sink_len,
@@ -2552,7 +2939,7 @@ static BOOLEAN intel_dp_can_link_train_fallback_for_edp(struct intel_dp *intel_d
 		intel_dp->attached_connector->panel.fixed_mode; */
 	int mode_rate, max_rate;
 
-	mode_rate = intel_dp_link_required(intel_dp->controller->edid.detailTimings[DETAIL_TIME_SELCTION].pixelClock * 10, 24);
+	mode_rate = intel_dp_link_required(intel_dp->controller->mode.timing.pixelClock * 10, 24);
 	max_rate = intel_dp_max_data_rate(link_rate, lane_count);
 	PRINT_DEBUG(EFI_D_ERROR, "Mode: %u, Max:%u\n", mode_rate, max_rate);
 	if (mode_rate > max_rate)
@@ -2712,13 +3099,39 @@ intel_dp_set_source_rates(struct intel_dp *intel_dp)
 	intel_dp->num_source_rates = size;
 }
 
-/* update sink rates from dpcd. We don't read the dpcd(Should we?) So manually adding the 324000 sink rate */
+/* update sink rates from the cached DPCD */
 static void intel_dp_set_sink_rates(struct intel_dp *intel_dp)
 {
 	static const int dp_rates[] = {
 		162000, 270000, 540000, 810000};
+	const UINT8 *edp_rev = intel_dp_dpcd_cache_lookup(intel_dp, DP_EDP_DPCD_REV, 1);
 	int i, max_rate;
 
+	intel_dp->use_rate_select = FALSE;
+	intel_dp->num_sink_rates = 0;
+	if (edp_rev && *edp_rev >= DP_EDP_14)
+	{
+		const UINT8 *rates = intel_dp->dpcd_cache + DP_SUPPORTED_LINK_RATES;
+
+		for (i = 0; i < DP_MAX_SUPPORTED_RATES; i++)
+		{
+			/* Value read multiplied by 200kHz gives the per-lane link rate in kHz */
+			int rate = (rates[2 * i] | (rates[2 * i + 1] << 8)) * 200 / 10;
+
+			if (rate == 0)
+				break;
+			/* SetupClockeDP only programs the RBR, HBR and HBR2 frequencies */
+			if (rate != 162000 && rate != 270000 && rate != 540000)
+				continue;
+			intel_dp->sink_rates[intel_dp->num_sink_rates++] = rate;
+		}
+		if (intel_dp->num_sink_rates > 0)
+		{
+			intel_dp->use_rate_select = TRUE;
+			return;
+		}
+	}
+
 	/* if (drm_dp_has_quirk(&intel_dp->desc, 0,
 			     DP_DPCD_QUIRK_CAN_DO_MAX_LINK_RATE_3_24_GBPS)) { */
 	/* Needed, e.g., for Apple MBP 2017, 15 inch eDP Retina panel
@@ -2730,7 +3143,10 @@ static void intel_dp_set_sink_rates(struct intel_dp *intel_dp)
 	return;
 	} */
 
-	max_rate = dp_rates[3];
+	/* a sink whose DPCD could not be read gets every rate, as before */
+	max_rate = intel_dp_dpcd_cap(intel_dp, DP_MAX_LINK_RATE) * 27000;
+	if (max_rate == 0)
+		max_rate = dp_rates[3];
 
 	for (i = 0; i < ARRAY_SIZE(dp_rates); i++)
 	{
@@ -2776,7 +3192,7 @@ intel_dp_compute_link_config_wide(struct intel_dp *intel_dp,
 		//int output_bpp = intel_dp_output_bpp(pipe_config->output_format, bpp);
 		int output_bpp = bpp;
 
-		mode_rate = intel_dp_link_required(intel_dp->controller->edid.detailTimings[DETAIL_TIME_SELCTION].pixelClock * 10,
+		mode_rate = intel_dp_link_required(intel_dp->controller->mode.timing.pixelClock * 10,
 										   output_bpp);
 
 		for (clock = limits->min_clock; clock <= limits->max_clock; clock++)
@@ -2842,7 +3258,7 @@ static EFI_STATUS i915_dp_get_link_config(struct intel_dp *intel_dp)
 	PRINT_DEBUG(EFI_D_ERROR, "DP link computation with max lane count %d max rate %d max bpp %d pixel clock %dKHz\n",
 				limits.max_lane_count,
 				intel_dp->common_rates[limits.max_clock],
-				limits.max_bpp, intel_dp->controller->edid.detailTimings[DETAIL_TIME_SELCTION].pixelClock * 10);
+				limits.max_bpp, intel_dp->controller->mode.timing.pixelClock * 10);
 
 	/*
 	 * Optimize for slow and wide for everything, because there are some
@@ -2852,54 +3268,24 @@ static EFI_STATUS i915_dp_get_link_config(struct intel_dp *intel_dp)
 	return ret;
 }
 
-EFI_STATUS _TrainDisplayPort(struct intel_dp *intel_dp)
-{
-	UINT32 port = intel_dp->controller->OutputPath.Port;
-	UINT32 val = intel_dp->controller->read32(DP_TP_CTL(port));
-	val &= ~(DP_TP_CTL_ENABLE);
-	// val |= DP_TP_CTL_MODE_SST;
-	// val |= DP_TP_CTL_LINK_TRAIN_PAT1;
-	//val |= DP_TP_CTL_ENHANCED_FRAME_ENABLE;
-	intel_dp->controller->write32(DP_TP_CTL(port), val);
-	val = intel_dp->controller->read32(DDI_BUF_CTL(port));
-	val &= ~(DDI_PORT_WIDTH_MASK | DDI_BUF_CTL_ENABLE);
-	//val |= DDI_BUF_TRANS_SELECT(0);
-	//val |= DDI_A_4_LANES;
-	val |= DDI_PORT_WIDTH(intel_dp->lane_count);
-	intel_dp->controller->write32(DDI_BUF_CTL(port), val);
-
-	gBS->Stall(600);
-	val = intel_dp->controller->read32(DP_TP_CTL(port));
-	val |= DP_TP_CTL_ENABLE;
-	intel_dp->controller->write32(DP_TP_CTL(port), val);
-
-	val = intel_dp->controller->read32(DDI_BUF_CTL(port));
-	val |= DDI_BUF_CTL_ENABLE;
-
-	intel_dp->controller->write32(DDI_BUF_CTL(port), val);
-	if (!intel_dp_link_training_clock_recovery(intel_dp))
-		goto failure_handling;
-	if (!intel_dp_link_training_channel_equalization(intel_dp))
-		goto failure_handling;
-	intel_dp_set_link_train(intel_dp,
-							DP_TRAINING_PATTERN_DISABLE);
-	UINT32 DP = intel_dp->controller->read32(DP_TP_CTL(port));
-
-	DP &= ~DP_LINK_TRAIN_MASK_CPT;
-
-	DP |= DP_TP_CTL_LINK_TRAIN_NORMAL;
-
-	intel_dp->controller->write32(DP_TP_CTL(port), DP);
-	PRINT_DEBUG(EFI_D_ERROR, "Link Rate: %d, lane count: %d\n",
-				intel_dp->controller->OutputPath.LinkRate, intel_dp->lane_count);
-	intel_dp->controller->OutputPath.LinkRate = intel_dp->link_rate;
-	intel_dp->controller->OutputPath.LaneCount = intel_dp->lane_count;
-
-	return EFI_SUCCESS;
-failure_handling:
-	PRINT_DEBUG(EFI_D_ERROR,
-				" Link Training failed at link rate = %d, lane count = %d\n",
+/*
+ * Picks the link configuration to train at next after training failed,
+ * FALSE once there is none left.
+ */
+static BOOLEAN intel_dp_train_fallback(struct intel_dp *intel_dp)
+{
+	PRINT_ERROR(" Link Training failed at link rate = %d, lane count = %d\n",
 				intel_dp->link_rate, intel_dp->lane_count);
+	if (intel_dp->use_cached_train)
+	{
+		/* the sink no longer trains where it used to, start over from scratch */
+		intel_dp->use_cached_train = FALSE;
+		i915_dp_get_link_config(intel_dp);
+		intel_dp->controller->OutputPath.LinkRate = intel_dp->link_rate;
+		intel_dp->controller->OutputPath.LaneCount = intel_dp->lane_count;
+		SetupClockeDP(intel_dp->controller);
+		return TRUE;
+	}
 	if (!intel_dp_get_link_train_fallback_values(intel_dp,
 												 intel_dp->link_rate,
 												 intel_dp->lane_count))
@@ -2909,64 +3295,335 @@ failure_handling:
 		SetupClockeDP(intel_dp->controller);
 
 		/* Schedule a Hotplug Uevent to userspace to start modeset */
-		return _TrainDisplayPort(intel_dp);
+		return TRUE;
 	}
 	else if (intel_dp->use_max_rate)
 	{
 		i915_dp_get_link_config(intel_dp);
-		return _TrainDisplayPort(intel_dp);
+		return TRUE;
 	}
-	return EFI_ABORTED;
+	return FALSE;
 }
 
-EFI_STATUS TrainDisplayPort(i915_CONTROLLER *controller)
+/*
+ * Highest data rate, in intel_dp_max_data_rate units, the sink's DPCD lets
+ * the link carry at a rate the source also drives. Reads the DPCD into the
+ * cache TrainDisplayPort uses. Returns 0 if the sink did not answer, then
+ * the cache is dropped again so training reads it once the panel is on.
+ */
+int intel_dp_sink_max_data_rate(i915_CONTROLLER *controller)
 {
-	UINT32 port = controller->OutputPath.Port;
-	UINT32 val = 0;
-	EFI_STATUS status = EFI_SUCCESS;
-	val |= DP_TP_CTL_ENABLE;
-	val |= DP_TP_CTL_MODE_SST;
-	val |= DP_TP_CTL_LINK_TRAIN_PAT1;
-	val |= DP_TP_CTL_ENHANCED_FRAME_ENABLE;
-	controller->write32(DP_TP_CTL(port), val);
-	val = DDI_BUF_CTL_ENABLE;
-
-	val |= DDI_BUF_TRANS_SELECT(0);
-	val |= DDI_A_4_LANES;
-	val |= DDI_PORT_WIDTH(4);
-	controller->write32(DDI_BUF_CTL(port), val);
-	gBS->Stall(500);
-
 	struct intel_dp *intel_dp = controller->intel_dp;
-	intel_dp->controller = controller;
-	intel_dp->max_link_lane_count = 4;
-	edp_panel_on(intel_dp);
-	// intel_dp->lane_count = 2;
-	// if ((controller->read32(0x64000) & DP_PLL_FREQ_MASK) == DP_PLL_FREQ_162MHZ)
-	// 	intel_dp->link_rate = 162000;
-	// else
-	// 	intel_dp->link_rate = 270000;
+	int lanes;
 
+	if (intel_dp == NULL)
+		return 0;
+	intel_dp->controller = controller;
+	intel_dp_dpcd_cache_fill(intel_dp);
+	if (intel_dp_dpcd_cache_lookup(intel_dp, DP_DPCD_REV, 1) == NULL)
+	{
+		intel_dp_dpcd_cache_invalidate(intel_dp);
+		return 0;
+	}
+	lanes = intel_dp_dpcd_cap(intel_dp, DP_MAX_LANE_COUNT) & DP_MAX_LANE_COUNT_MASK;
+	if (lanes == 0 || lanes > 4)
+		lanes = 4;
 	intel_dp_set_source_rates(intel_dp);
-
 	intel_dp_set_sink_rates(intel_dp);
-
 	intel_dp_set_common_rates(intel_dp);
-	i915_dp_get_link_config(intel_dp);
-	status = _TrainDisplayPort(intel_dp);
-	UINT8 count = 0;
-	while (!intel_dp_can_link_train_fallback_for_edp(intel_dp, intel_dp->link_rate, intel_dp->lane_count) && count < 4)
+	return intel_dp_max_data_rate(intel_dp_max_common_rate(intel_dp), lanes);
+}
+
+/*
+ * Start from the link rate, lane count and levels the sink last trained at,
+ * as long as they are still possible and carry the mode. The clock is set
+ * up again if the rate differs from the one SetupClocks programmed.
+ */
+static void intel_dp_use_cached_link(struct intel_dp *intel_dp)
+{
+	i915_CONTROLLER *controller = intel_dp->controller;
+	UINT8 downspread = 0;
+	I915_CACHE_LINK link;
+
+	intel_dp->use_cached_train = FALSE;
+	intel_dp->no_aux_handshake = FALSE;
+	if (drm_dp_dpcd_read(DP_SINK_OUI, intel_dp->sink_oui,
+						 sizeof(intel_dp->sink_oui), controller) != sizeof(intel_dp->sink_oui))
+	{
+		ZeroMem(intel_dp->sink_oui, sizeof(intel_dp->sink_oui));
+	}
+	if (drm_dp_dpcd_read(DP_MAX_DOWNSPREAD, &downspread, 1, controller) == 1)
+		intel_dp->no_aux_handshake = (downspread & DP_NO_AUX_HANDSHAKE_LINK_TRAINING) != 0;
+
+	if (!i915CacheGetLink(controller, intel_dp->sink_oui, &link))
+		return;
+	if (intel_dp_rate_index(intel_dp->common_rates, intel_dp->num_common_rates,
+							link.LinkRate) < 0 ||
+		link.LaneCount == 0 || link.LaneCount > intel_dp->max_link_lane_count ||
+		!intel_dp_can_link_train_fallback_for_edp(intel_dp, link.LinkRate, link.LaneCount))
+	{
+		PRINT_DEBUG(EFI_D_ERROR, "Cached link %d x%u does not fit, ignoring it\n",
+					link.LinkRate, link.LaneCount);
+		return;
+	}
+	PRINT_DEBUG(EFI_D_ERROR, "Using cached link %d x%u, no AUX handshake: %d\n",
+				link.LinkRate, link.LaneCount, intel_dp->no_aux_handshake);
+	intel_dp->link_rate = link.LinkRate;
+	intel_dp->lane_count = link.LaneCount;
+	for (int i = 0; i < 4; i++)
 	{
-		PRINT_DEBUG(EFI_D_ERROR, "Higher rate than configured, Trying Lower Pixel Clock\n");
-		controller->edid.detailTimings[DETAIL_TIME_SELCTION].pixelClock >>= 1;
-		count++;
+		intel_dp->cached_train_set[i] = link.TrainSet[i];
 	}
-	if ((count == 4) && (!intel_dp_can_link_train_fallback_for_edp(intel_dp, intel_dp->link_rate, intel_dp->lane_count)))
+	intel_dp->use_cached_train = TRUE;
+	if (controller->OutputPath.LinkRate != (UINT32)link.LinkRate)
 	{
-		PRINT_DEBUG(EFI_D_ERROR, "Error: Higher rate than configured\n");
+		controller->OutputPath.LinkRate = link.LinkRate;
+		controller->OutputPath.LaneCount = link.LaneCount;
+		SetupClockeDP(controller);
+	}
+}
+
+enum
+{
+	DP_TRAIN_START,
+	DP_TRAIN_SETUP,
+	DP_TRAIN_ATTEMPT,
+	DP_TRAIN_ENABLE,
+	DP_TRAIN_FAST_TPS2,
+	DP_TRAIN_FAST_CHECK,
+	DP_TRAIN_CR_START,
+	DP_TRAIN_CR,
+	DP_TRAIN_EQ_START,
+	DP_TRAIN_EQ,
+	DP_TRAIN_LINKED,
+	DP_TRAIN_FAILED,
+	DP_TRAIN_FINISH,
+	DP_TRAIN_DONE,
+};
+
+void intel_dp_train_begin(I915_DP_TRAIN *train)
+{
+	ZeroMem(train, sizeof(*train));
+	train->phase = DP_TRAIN_START;
+}
+
+/*
+ * TrainDisplayPort up to its next delay: the settle times around enabling
+ * the port, each fast training pattern and each clock recovery or channel
+ * EQ iteration. Returns EFI_NOT_READY with the wait armed, call again once
+ * it is over; any other status is what TrainDisplayPort returns.
+ */
+EFI_STATUS intel_dp_train_step(i915_CONTROLLER *controller, I915_DP_TRAIN *train,
+							   I915_WAIT *wait)
+{
+	struct intel_dp *intel_dp = controller->intel_dp;
+	UINT32 port = controller->OutputPath.Port;
+	UINT32 val = 0;
+	int ret;
+
+	switch (train->phase)
+	{
+	case DP_TRAIN_START:
+		val |= DP_TP_CTL_ENABLE;
+		val |= DP_TP_CTL_MODE_SST;
+		val |= DP_TP_CTL_LINK_TRAIN_PAT1;
+		val |= DP_TP_CTL_ENHANCED_FRAME_ENABLE;
+		controller->write32(DP_TP_CTL(port), val);
+		val = DDI_BUF_CTL_ENABLE;
+
+		val |= DDI_BUF_TRANS_SELECT(0);
+		val |= DDI_A_4_LANES;
+		val |= DDI_PORT_WIDTH(4);
+		controller->write32(DDI_BUF_CTL(port), val);
+		i915WaitDelay(wait, 500);
+		train->phase = DP_TRAIN_SETUP;
+		return EFI_NOT_READY;
+
+	case DP_TRAIN_SETUP:
+		intel_dp->controller = controller;
+		edp_panel_on(intel_dp);
+		intel_dp_dpcd_cache_fill(intel_dp);
+		intel_dp->max_link_lane_count = intel_dp_dpcd_cap(intel_dp, DP_MAX_LANE_COUNT) & DP_MAX_LANE_COUNT_MASK;
+		if (intel_dp->max_link_lane_count == 0 || intel_dp->max_link_lane_count > 4)
+			intel_dp->max_link_lane_count = 4;
+		// intel_dp->lane_count = 2;
+		// if ((controller->read32(0x64000) & DP_PLL_FREQ_MASK) == DP_PLL_FREQ_162MHZ)
+		// 	intel_dp->link_rate = 162000;
+		// else
+		// 	intel_dp->link_rate = 270000;
+
+		intel_dp_set_source_rates(intel_dp);
+
+		intel_dp_set_sink_rates(intel_dp);
+
+		intel_dp_set_common_rates(intel_dp);
+		i915_dp_get_link_config(intel_dp);
+		intel_dp_use_cached_link(intel_dp);
+		train->phase = DP_TRAIN_ATTEMPT;
+		return intel_dp_train_step(controller, train, wait);
+
+	case DP_TRAIN_ATTEMPT:
+		/* one go at the current link rate and lane count */
+		val = controller->read32(DP_TP_CTL(port));
+		val &= ~(DP_TP_CTL_ENABLE);
+		// val |= DP_TP_CTL_MODE_SST;
+		// val |= DP_TP_CTL_LINK_TRAIN_PAT1;
+		//val |= DP_TP_CTL_ENHANCED_FRAME_ENABLE;
+		controller->write32(DP_TP_CTL(port), val);
+		val = controller->read32(DDI_BUF_CTL(port));
+		val &= ~(DDI_PORT_WIDTH_MASK | DDI_BUF_CTL_ENABLE);
+		//val |= DDI_BUF_TRANS_SELECT(0);
+		//val |= DDI_A_4_LANES;
+		val |= DDI_PORT_WIDTH(intel_dp->lane_count);
+		controller->write32(DDI_BUF_CTL(port), val);
+		i915WaitDelay(wait, 600);
+		train->phase = DP_TRAIN_ENABLE;
+		return EFI_NOT_READY;
+
+	case DP_TRAIN_ENABLE:
+		val = controller->read32(DP_TP_CTL(port));
+		val |= DP_TP_CTL_ENABLE;
+		controller->write32(DP_TP_CTL(port), val);
+
+		val = controller->read32(DDI_BUF_CTL(port));
+		val |= DDI_BUF_CTL_ENABLE;
+
+		controller->write32(DDI_BUF_CTL(port), val);
+		if (intel_dp_fast_link_train_start(intel_dp))
+		{
+			i915WaitDelay(wait, DP_FAST_TRAIN_PATTERN_US);
+			train->phase = DP_TRAIN_FAST_TPS2;
+			return EFI_NOT_READY;
+		}
+		train->phase = DP_TRAIN_CR_START;
+		return intel_dp_train_step(controller, train, wait);
 
-		status = EFI_UNSUPPORTED;
+	case DP_TRAIN_FAST_TPS2:
+		intel_dp_program_link_training_pattern(intel_dp, DP_TRAINING_PATTERN_2);
+		i915WaitDelay(wait, DP_FAST_TRAIN_PATTERN_US);
+		train->phase = DP_TRAIN_FAST_CHECK;
+		return EFI_NOT_READY;
+
+	case DP_TRAIN_FAST_CHECK:
+		if (!intel_dp_fast_link_train_check(intel_dp))
+		{
+			train->phase = DP_TRAIN_CR_START;
+			return intel_dp_train_step(controller, train, wait);
+		}
+		/* the patterns only went out on DP_TP_CTL, clear the sink's too */
+		intel_dp_set_link_train(intel_dp, DP_TRAINING_PATTERN_DISABLE);
+		train->phase = DP_TRAIN_LINKED;
+		return intel_dp_train_step(controller, train, wait);
+
+	case DP_TRAIN_CR_START:
+		/* a sink that did not take pattern 1 still gets a go at EQ */
+		if (!intel_dp_clock_recovery_start(intel_dp, train))
+		{
+			train->phase = DP_TRAIN_EQ_START;
+			return intel_dp_train_step(controller, train, wait);
+		}
+		i915WaitDelay(wait, drm_dp_link_train_clock_recovery_delay(intel_dp));
+		train->phase = DP_TRAIN_CR;
+		return EFI_NOT_READY;
+
+	case DP_TRAIN_CR:
+		ret = intel_dp_clock_recovery_iterate(intel_dp, train);
+		if (ret == 0)
+		{
+			i915WaitDelay(wait, drm_dp_link_train_clock_recovery_delay(intel_dp));
+			return EFI_NOT_READY;
+		}
+		train->phase = ret > 0 ? DP_TRAIN_EQ_START : DP_TRAIN_FAILED;
+		return intel_dp_train_step(controller, train, wait);
+
+	case DP_TRAIN_EQ_START:
+		if (!intel_dp_channel_equalization_start(intel_dp, train))
+		{
+			train->phase = DP_TRAIN_FAILED;
+			return intel_dp_train_step(controller, train, wait);
+		}
+		i915WaitDelay(wait, drm_dp_link_train_channel_eq_delay(intel_dp));
+		train->phase = DP_TRAIN_EQ;
+		return EFI_NOT_READY;
+
+	case DP_TRAIN_EQ:
+		ret = intel_dp_channel_equalization_iterate(intel_dp, train);
+		if (ret == 0)
+		{
+			i915WaitDelay(wait, drm_dp_link_train_channel_eq_delay(intel_dp));
+			return EFI_NOT_READY;
+		}
+		if (ret < 0)
+		{
+			train->phase = DP_TRAIN_FAILED;
+			return intel_dp_train_step(controller, train, wait);
+		}
+		intel_dp_set_link_train(intel_dp,
+								DP_TRAINING_PATTERN_DISABLE);
+		train->phase = DP_TRAIN_LINKED;
+		return intel_dp_train_step(controller, train, wait);
+
+	case DP_TRAIN_LINKED:
+		val = controller->read32(DP_TP_CTL(port));
+
+		val &= ~DP_LINK_TRAIN_MASK_CPT;
+
+		val |= DP_TP_CTL_LINK_TRAIN_NORMAL;
+
+		controller->write32(DP_TP_CTL(port), val);
+		PRINT_DEBUG(EFI_D_ERROR, "Link Rate: %d, lane count: %d\n",
+					controller->OutputPath.LinkRate, intel_dp->lane_count);
+		controller->OutputPath.LinkRate = intel_dp->link_rate;
+		controller->OutputPath.LaneCount = intel_dp->lane_count;
+		i915CacheStoreLink(controller, intel_dp->sink_oui, intel_dp->link_rate,
+						   intel_dp->lane_count, intel_dp->train_set);
+		train->status = EFI_SUCCESS;
+		train->phase = DP_TRAIN_FINISH;
+		return intel_dp_train_step(controller, train, wait);
+
+	case DP_TRAIN_FAILED:
+		if (intel_dp_train_fallback(intel_dp))
+		{
+			train->phase = DP_TRAIN_ATTEMPT;
+			return intel_dp_train_step(controller, train, wait);
+		}
+		train->status = EFI_ABORTED;
+		train->phase = DP_TRAIN_FINISH;
+		return intel_dp_train_step(controller, train, wait);
+
+	case DP_TRAIN_FINISH:
+	{
+		UINT8 count = 0;
+		while (!intel_dp_can_link_train_fallback_for_edp(intel_dp, intel_dp->link_rate, intel_dp->lane_count) && count < 4)
+		{
+			PRINT_DEBUG(EFI_D_ERROR, "Higher rate than configured, Trying Lower Pixel Clock\n");
+			controller->mode.timing.pixelClock >>= 1;
+			count++;
+		}
+		if ((count == 4) && (!intel_dp_can_link_train_fallback_for_edp(intel_dp, intel_dp->link_rate, intel_dp->lane_count)))
+		{
+			PRINT_ERROR("Error: Higher rate than configured\n");
+
+			train->status = EFI_UNSUPPORTED;
+		}
+		train->phase = DP_TRAIN_DONE;
+		return train->status;
 	}
+
+	default:
+		return train->status;
+	}
+}
+
+EFI_STATUS TrainDisplayPort(i915_CONTROLLER *controller)
+{
+	I915_DP_TRAIN train;
+	I915_WAIT wait;
+	EFI_STATUS status;
+
+	intel_dp_train_begin(&train);
+	while ((status = intel_dp_train_step(controller, &train, &wait)) == EFI_NOT_READY)
+		i915WaitComplete(controller, &wait);
 	return status;
 }
 /* Transfer unit size for display port - 1, default is 0x3f (for TU size 64) */
@@ -3101,26 +3758,26 @@ void intel_link_compute_m_n(UINT16 bits_per_pixel, int nlanes,
 
 EFI_STATUS SetupTranscoderAndPipeDP(i915_CONTROLLER *controller)
 {
-	UINT32 horz_active = controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzActive |
-						 ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzActiveBlankMsb >> 4) << 8);
-	UINT32 horz_blank = controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzBlank |
-						((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzActiveBlankMsb & 0xF) << 8);
-	UINT32 horz_sync_offset = controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzSyncOffset | ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].syncMsb >> 6) << 8);
-	UINT32 horz_sync_pulse = controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzSyncPulse |
-							 (((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].syncMsb >> 4) & 0x3) << 8);
+	UINT32 horz_active = controller->mode.timing.horzActive |
+						 ((UINT32)(controller->mode.timing.horzActiveBlankMsb >> 4) << 8);
+	UINT32 horz_blank = controller->mode.timing.horzBlank |
+						((UINT32)(controller->mode.timing.horzActiveBlankMsb & 0xF) << 8);
+	UINT32 horz_sync_offset = controller->mode.timing.horzSyncOffset | ((UINT32)(controller->mode.timing.syncMsb >> 6) << 8);
+	UINT32 horz_sync_pulse = controller->mode.timing.horzSyncPulse |
+							 (((UINT32)(controller->mode.timing.syncMsb >> 4) & 0x3) << 8);
 
 	UINT32 horizontal_active = horz_active;
 	UINT32 horizontal_syncStart = horz_active + horz_sync_offset;
 	UINT32 horizontal_syncEnd = horz_active + horz_sync_offset + horz_sync_pulse;
 	UINT32 horizontal_total = horz_active + horz_blank;
 
-	UINT32 vert_active = controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertActive |
-						 ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertActiveBlankMsb >> 4) << 8);
-	UINT32 vert_blank = controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertBlank |
-						((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertActiveBlankMsb & 0xF) << 8);
-	UINT32 vert_sync_offset = (controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertSync >> 4) | (((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].syncMsb >> 2) & 0x3)
+	UINT32 vert_active = controller->mode.timing.vertActive |
+						 ((UINT32)(controller->mode.timing.vertActiveBlankMsb >> 4) << 8);
+	UINT32 vert_blank = controller->mode.timing.vertBlank |
+						((UINT32)(controller->mode.timing.vertActiveBlankMsb & 0xF) << 8);
+	UINT32 vert_sync_offset = (controller->mode.timing.vertSync >> 4) | (((UINT32)(controller->mode.timing.syncMsb >> 2) & 0x3)
 																									  << 4);
-	UINT32 vert_sync_pulse = (controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertSync & 0xF) | ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].syncMsb & 0x3) << 4);
+	UINT32 vert_sync_pulse = (controller->mode.timing.vertSync & 0xF) | ((UINT32)(controller->mode.timing.syncMsb & 0x3) << 4);
 
 	UINT32 vertical_active = vert_active;
 	UINT32 vertical_syncStart = vert_active + vert_sync_offset;
@@ -3152,7 +3809,7 @@ EFI_STATUS SetupTranscoderAndPipeDP(i915_CONTROLLER *controller)
 	controller->write32(PIPEASRC, ((horizontal_active - 1) << 16) | (vertical_active - 1));
 	struct intel_link_m_n m_n = {0};
 
-	intel_link_compute_m_n(24, controller->OutputPath.LaneCount, controller->edid.detailTimings[DETAIL_TIME_SELCTION].pixelClock * 10, controller->OutputPath.LinkRate, &m_n, FALSE, FALSE);
+	intel_link_compute_m_n(24, controller->OutputPath.LaneCount, controller->mode.timing.pixelClock * 10, controller->OutputPath.LinkRate, &m_n, FALSE, FALSE);
 	controller->write32(PIPEA_DATA_M1,
 						TU_SIZE(m_n.tu) | m_n.gmch_m);
 	controller->write32(PIPEA_DATA_N1,
@@ -3176,26 +3833,26 @@ EFI_STATUS SetupTranscoderAndPipeDP(i915_CONTROLLER *controller)
 }
 EFI_STATUS SetupTranscoderAndPipeEDP(i915_CONTROLLER *controller)
 {
-	UINT32 horz_active = controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzActive |
-						 ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzActiveBlankMsb >> 4) << 8);
-	UINT32 horz_blank = controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzBlank |
-						((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzActiveBlankMsb & 0xF) << 8);
-	UINT32 horz_sync_offset = controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzSyncOffset | ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].syncMsb >> 6) << 8);
-	UINT32 horz_sync_pulse = controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzSyncPulse |
-							 (((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].syncMsb >> 4) & 0x3) << 8);
+	UINT32 horz_active = controller->mode.timing.horzActive |
+						 ((UINT32)(controller->mode.timing.horzActiveBlankMsb >> 4) << 8);
+	UINT32 horz_blank = controller->mode.timing.horzBlank |
+						((UINT32)(controller->mode.timing.horzActiveBlankMsb & 0xF) << 8);
+	UINT32 horz_sync_offset = controller->mode.timing.horzSyncOffset | ((UINT32)(controller->mode.timing.syncMsb >> 6) << 8);
+	UINT32 horz_sync_pulse = controller->mode.timing.horzSyncPulse |
+							 (((UINT32)(controller->mode.timing.syncMsb >> 4) & 0x3) << 8);
 
 	UINT32 horizontal_active = horz_active;
 	UINT32 horizontal_syncStart = horz_active + horz_sync_offset;
 	UINT32 horizontal_syncEnd = horz_active + horz_sync_offset + horz_sync_pulse;
 	UINT32 horizontal_total = horz_active + horz_blank;
 
-	UINT32 vert_active = controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertActive |
-						 ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertActiveBlankMsb >> 4) << 8);
-	UINT32 vert_blank = controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertBlank |
-						((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertActiveBlankMsb & 0xF) << 8);
-	UINT32 vert_sync_offset = (controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertSync >> 4) | (((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].syncMsb >> 2) & 0x3)
+	UINT32 vert_active = controller->mode.timing.vertActive |
+						 ((UINT32)(controller->mode.timing.vertActiveBlankMsb >> 4) << 8);
+	UINT32 vert_blank = controller->mode.timing.vertBlank |
+						((UINT32)(controller->mode.timing.vertActiveBlankMsb & 0xF) << 8);
+	UINT32 vert_sync_offset = (controller->mode.timing.vertSync >> 4) | (((UINT32)(controller->mode.timing.syncMsb >> 2) & 0x3)
 																									  << 4);
-	UINT32 vert_sync_pulse = (controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertSync & 0xF) | ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].syncMsb & 0x3) << 4);
+	UINT32 vert_sync_pulse = (controller->mode.timing.vertSync & 0xF) | ((UINT32)(controller->mode.timing.syncMsb & 0x3) << 4);
 
 	UINT32 vertical_active = vert_active;
 	UINT32 vertical_syncStart = vert_active + vert_sync_offset;
@@ -3231,7 +3888,7 @@ EFI_STATUS SetupTranscoderAndPipeEDP(i915_CONTROLLER *controller)
         controller->write32(0x6f044, 0x00080000); */
 	struct intel_link_m_n m_n = {0};
 	//struct intel_link_m_n *m_n= &m_n
-	intel_link_compute_m_n(24, controller->OutputPath.LaneCount, controller->edid.detailTimings[DETAIL_TIME_SELCTION].pixelClock * 10, controller->OutputPath.LinkRate, &m_n, FALSE, FALSE);
+	intel_link_compute_m_n(24, controller->OutputPath.LaneCount, controller->mode.timing.pixelClock * 10, controller->OutputPath.LinkRate, &m_n, FALSE, FALSE);
 	PRINT_DEBUG(EFI_D_ERROR, "progressed to dpline %d\n",
 				__LINE__);
 	PRINT_DEBUG(EFI_D_ERROR, "PIPEEDP_DATA_M1 (%x) = %08x\n", PIPEEDP_DATA_M1, TU_SIZE(m_n.tu) | m_n.gmch_m);
@@ -1,5 +1,6 @@
 #ifndef i915_DPH
 #define i915_DPH
+#include "i915_wait.h"
 #define PP_ON (0xC7208)
 #define PP_OFF (0xC720C)
 #define PANEL_UNLOCK_REGS (0xabcd << 16)
@@ -14,6 +15,8 @@
 #define PP_DIVISOR 0x61210 /* Cedartrail */
 #define PP_STATUS (0xC7200)
 #define PP_CONTROL (0xC7204)
+//PP_ON above is the on delay register, this is the power on bit of PP_STATUS
+#define PP_STATUS_ON (1u << 31)
 //#define BUILD_BUG_ON_ZERO(e) ((int)(sizeof(struct { int:(-!!(e)); })))
 
 /*
@@ -1373,6 +1376,14 @@ struct link_config_limits
 	int min_bpp, max_bpp;
 };
 
+/*
+ * DPCD capability fields kept in memory: the receiver capability field, the
+ * eDP general capabilities and the DP 1.3 extended receiver capabilities,
+ * back to back. They are read in AUX sized bursts once per connect.
+ */
+#define DP_DPCD_CACHE_BURST 16
+#define DP_DPCD_CACHE_SIZE (0x100 + 2 * DP_DPCD_CACHE_BURST)
+
 struct intel_dp
 {
 	UINT8 lane_count;
@@ -1395,6 +1406,19 @@ struct intel_dp
 	int max_link_lane_count;
 	/* Max rate for the current link */
 	int max_link_rate;
+	/* DP_SINK_OUI, keys the cached link parameters */
+	UINT8 sink_oui[3];
+	/* DP_MAX_DOWNSPREAD advertises DP_NO_AUX_HANDSHAKE_LINK_TRAINING */
+	bool no_aux_handshake;
+	/* start training from the cached train_set instead of level 0 */
+	bool use_cached_train;
+	UINT8 cached_train_set[4];
+	/* see intel_dp_dpcd_cache_fill, one valid bit per burst */
+	UINT8 dpcd_cache[DP_DPCD_CACHE_SIZE];
+	UINT32 dpcd_cache_valid;
+	bool dpcd_cache_filled;
+	/* eDP 1.4 DP_SUPPORTED_LINK_RATES, the rate goes to DP_LINK_RATE_SET */
+	bool use_rate_select;
 	int panel_power_up_delay;
 	int panel_power_down_delay;
 	int panel_power_cycle_delay;
@@ -1407,12 +1431,70 @@ struct intel_dp
 	//ktime_t panel_power_off_time;
 	struct edp_power_seq pps_delays;
 };
+/*
+ * A DDC read over I2C-over-AUX taken apart at its AUX waits, so the caller
+ * can return in between. start is the byte address in the E-DDC space,
+ * segment times 256 plus offset.
+ */
+typedef struct
+{
+	UINT8 aux_ch;
+	UINT8 *buf;
+	UINT32 start;
+	UINT32 len;
+	UINT32 done;
+	/* where the transaction in the current segment ends */
+	UINT32 end;
+	UINT32 phase;
+	EFI_STATUS status;
+	/* the request on the wire and the tries it took so far */
+	UINT8 txbuf[20];
+	int send_bytes;
+	int recv_size;
+	bool write;
+	UINT8 *buffer;
+	UINT32 size;
+	UINT8 byte;
+	unsigned int tries;
+	unsigned int retries;
+	bool resend;
+	int ret;
+} I915_DP_DDC_READ;
+/* Link training taken apart at its delays, see intel_dp_train_step() */
+typedef struct
+{
+	UINT32 phase;
+	EFI_STATUS status;
+	/* clock recovery or channel EQ iterations so far */
+	int tries;
+	int max_tries;
+	int voltage_tries;
+	bool max_vswing_reached;
+} I915_DP_TRAIN;
+
 EFI_STATUS SetupClockeDP(i915_CONTROLLER *controller);
 EFI_STATUS SetupClockDP(i915_CONTROLLER *controller);
 EFI_STATUS SetupDDIBufferDP(i915_CONTROLLER *controller);
 EFI_STATUS SetupTranscoderAndPipeEDP(i915_CONTROLLER *controller);
 EFI_STATUS SetupTranscoderAndPipeDP(i915_CONTROLLER *controller);
 void intel_dp_pps_init(i915_CONTROLLER *controller);
-EFI_STATUS ReadEDIDDP(EDID *result, i915_CONTROLLER *controller, UINT8 pin);
+void intel_dp_read_ddc_begin(I915_DP_DDC_READ *read, UINT8 aux_ch, UINT8 segment, UINT8 offset,
+							 UINT8 *buf, UINT32 len);
+void intel_dp_read_edid_begin(I915_DP_DDC_READ *read, UINT8 aux_ch, UINT32 first, UINT32 count,
+							  UINT8 *buf);
+EFI_STATUS intel_dp_read_ddc_step(i915_CONTROLLER *controller, I915_DP_DDC_READ *read,
+								  I915_WAIT *wait);
+void intel_dp_train_begin(I915_DP_TRAIN *train);
+EFI_STATUS intel_dp_train_step(i915_CONTROLLER *controller, I915_DP_TRAIN *train,
+							   I915_WAIT *wait);
+EFI_STATUS ReadDDCDP(i915_CONTROLLER *controller, UINT8 pin, UINT8 segment, UINT8 offset, UINT8 *buf, UINT32 len);
 EFI_STATUS SetupPPS(i915_CONTROLLER *controller);
+EFI_STATUS EnablePanelVdd(i915_CONTROLLER *controller);
+EFI_STATUS DisablePanelVdd(i915_CONTROLLER *controller);
+void intel_dp_dpcd_cache_invalidate(struct intel_dp *intel_dp);
+int intel_dp_max_data_rate(int max_link_clock, int max_lanes);
+INT32 intel_dp_link_required(int pixel_clock, int bpp);
+int intel_dp_readout_lane_count(i915_CONTROLLER *controller);
+int intel_dp_sink_max_data_rate(i915_CONTROLLER *controller);
+void intel_pps_readout(i915_CONTROLLER *controller, struct edp_power_seq *seq);
 #endif
\ No newline at end of file
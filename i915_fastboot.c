@@ -0,0 +1,326 @@
+#define I915_LOG_CATEGORY I915_LOG_DISPLAY
+#include "i915_fastboot.h"
+#include "i915_display.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+//the eDP transcoder's registers sit at the same offsets from 0x6F000 as
+//transcoder A's from 0x60000, its PIPECONF included
+#define I915_FASTBOOT_EDP_OFFSET (HTOTAL_EDP - HTOTAL_A)
+//the two 13 bit fields of a transcoder timing register
+#define I915_FASTBOOT_TIMING_MASK 0x1FFF1FFF
+//the DPLL_CTRL1 bits of one DPLL, shifted down from id * 6
+#define I915_FASTBOOT_CTRL1_BITS 0x3F
+//WRPLL reference clock in kHz
+#define I915_FASTBOOT_WRPLL_REF 24000
+
+//enable register of each DPLL, bit 31 as for LCPLL_PLL_ENABLE
+STATIC CONST UINT64 g_dpll_enable[] = {LCPLL1_CTL, LCPLL2_CTL, WRPLL_CTL1, WRPLL_CTL2};
+//DPLL0 is the CDCLK PLL and has no CFGCR of its own
+STATIC CONST UINT64 g_dpll_cfgcr1[] = {0, _DPLL1_CFGCR1, _DPLL2_CFGCR1, _DPLL3_CFGCR1};
+STATIC CONST UINT64 g_dpll_cfgcr2[] = {0, _DPLL1_CFGCR2, _DPLL2_CFGCR2, _DPLL3_CFGCR2};
+
+//Port clock of a DPLL in DP mode, the link rate its DPLL_CTRL1 field selects.
+STATIC UINT32 i915HwStateLinkClock(UINT32 ctrl1)
+{
+    switch ((ctrl1 & DPLL_CTRL1_LINK_RATE_MASK(0)) >> DPLL_CTRL1_LINK_RATE_SHIFT(0))
+    {
+    case DPLL_CTRL1_LINK_RATE_810:
+        return 162000;
+    case DPLL_CTRL1_LINK_RATE_1080:
+        return 216000;
+    case DPLL_CTRL1_LINK_RATE_1350:
+        return 270000;
+    case DPLL_CTRL1_LINK_RATE_1620:
+        return 324000;
+    case DPLL_CTRL1_LINK_RATE_2160:
+        return 432000;
+    case DPLL_CTRL1_LINK_RATE_2700:
+        return 540000;
+    default:
+        return 0;
+    }
+}
+
+//Port clock of a DPLL in HDMI mode: the DCO frequency over the P, Q and K
+//dividers and the AFE's factor of five.
+STATIC UINT32 i915HwStateWrpllClock(UINT32 cfgcr1, UINT32 cfgcr2)
+{
+    UINT32 p0, p1, p2;
+    UINT64 dco;
+
+    switch (cfgcr2 & DPLL_CFGCR2_PDIV_MASK)
+    {
+    case DPLL_CFGCR2_PDIV_1:
+        p0 = 1;
+        break;
+    case DPLL_CFGCR2_PDIV_2:
+        p0 = 2;
+        break;
+    case DPLL_CFGCR2_PDIV_3:
+        p0 = 3;
+        break;
+    case DPLL_CFGCR2_PDIV_7:
+        p0 = 7;
+        break;
+    default:
+        return 0;
+    }
+    p1 = (cfgcr2 & DPLL_CFGCR2_QDIV_MODE(1)) ? (cfgcr2 & DPLL_CFGCR2_QDIV_RATIO_MASK) >> 8 : 1;
+    switch (cfgcr2 & DPLL_CFGCR2_KDIV_MASK)
+    {
+    case DPLL_CFGCR2_KDIV_5:
+        p2 = 5;
+        break;
+    case DPLL_CFGCR2_KDIV_2:
+        p2 = 2;
+        break;
+    case DPLL_CFGCR2_KDIV_3:
+        p2 = 3;
+        break;
+    default:
+        p2 = 1;
+        break;
+    }
+    if (p1 == 0)
+    {
+        return 0;
+    }
+    dco = (UINT64)(cfgcr1 & DPLL_CFGCR1_DCO_INTEGER_MASK) * I915_FASTBOOT_WRPLL_REF;
+    dco += DivU64x32((UINT64)((cfgcr1 & DPLL_CFGCR1_DCO_FRACTION_MASK) >> 9) * I915_FASTBOOT_WRPLL_REF, 0x8000);
+    return (UINT32)DivU64x32(dco, p0 * p1 * p2 * 5);
+}
+
+//Reads back the display state of controller->OutputPath, whoever programmed
+//it. The clocks are worked out the way i915's fastboot readout does.
+VOID i915ReadHwState(i915_CONTROLLER *controller, I915_HW_STATE *state)
+{
+    UINT32 port = controller->OutputPath.Port;
+    UINT64 trans = controller->OutputPath.ConType == eDP ? I915_FASTBOOT_EDP_OFFSET : 0;
+    UINT32 ctrl2;
+
+    ZeroMem(state, sizeof(*state));
+    state->PipeConf = controller->read32(_PIPEACONF + trans);
+    state->DdiFunc = controller->read32(_TRANS_DDI_FUNC_CTL_A + trans);
+    state->ClockSel = controller->read32(_TRANS_CLK_SEL_A);
+    state->DdiBuf = controller->read32(DDI_BUF_CTL(port));
+    state->DpTpCtl = controller->read32(DP_TP_CTL(port));
+    state->HTotal = controller->read32(HTOTAL_A + trans);
+    state->HBlank = controller->read32(HBLANK_A + trans);
+    state->HSync = controller->read32(HSYNC_A + trans);
+    state->VTotal = controller->read32(VTOTAL_A + trans);
+    state->VBlank = controller->read32(VBLANK_A + trans);
+    state->VSync = controller->read32(VSYNC_A + trans);
+    state->PipeSrc = controller->read32(PIPEASRC);
+    state->LinkM = controller->read32(PIPEA_LINK_M1 + trans);
+    state->LinkN = controller->read32(PIPEA_LINK_N1 + trans);
+    state->PlaneCtl = controller->read32(_DSPACNTR);
+    state->PlaneSurf = controller->read32(_DSPASURF);
+    state->PlaneStride = controller->read32(_DSPASTRIDE);
+    state->PlaneSize = controller->read32(_DSPASIZE);
+    state->PlanePos = controller->read32(_DSPAPOS);
+
+    state->Dpll = -1;
+    ctrl2 = controller->read32(DPLL_CTRL2);
+    if (!(ctrl2 & DPLL_CTRL2_DDI_CLK_OFF(port)) && (ctrl2 & DPLL_CTRL2_DDI_SEL_OVERRIDE(port)))
+    {
+        UINT32 id = (ctrl2 & DPLL_CTRL2_DDI_CLK_SEL_MASK(port)) >> DPLL_CTRL2_DDI_CLK_SEL_SHIFT(port);
+
+        state->Dpll = (INT32)id;
+        state->DpllLocked = (controller->read32(g_dpll_enable[id]) & LCPLL_PLL_ENABLE) &&
+                            (controller->read32(DPLL_STATUS) & DPLL_LOCK(id));
+        state->DpllCtrl1 = (controller->read32(DPLL_CTRL1) >> (id * 6)) & I915_FASTBOOT_CTRL1_BITS;
+        if (id != 0)
+        {
+            state->DpllCfgcr1 = controller->read32(g_dpll_cfgcr1[id]);
+            state->DpllCfgcr2 = controller->read32(g_dpll_cfgcr2[id]);
+        }
+        state->PortClock = (state->DpllCtrl1 & DPLL_CTRL1_HDMI_MODE(0))
+                               ? i915HwStateWrpllClock(state->DpllCfgcr1, state->DpllCfgcr2)
+                               : i915HwStateLinkClock(state->DpllCtrl1);
+    }
+
+    if ((state->DdiFunc & TRANS_DDI_MODE_SELECT_MASK) == TRANS_DDI_MODE_SELECT_DP_SST)
+    {
+        state->LaneCount = ((state->DdiFunc & DDI_PORT_WIDTH_MASK) >> DDI_PORT_WIDTH_SHIFT) + 1;
+        if (state->LinkN != 0)
+        {
+            state->DotClock = (UINT32)DivU64x32(MultU64x32(state->LinkM, state->PortClock), state->LinkN);
+        }
+    }
+    else
+    {
+        //8 bpc TMDS runs at the pixel clock
+        state->DotClock = state->PortClock;
+    }
+
+    if (controller->OutputPath.ConType == eDP)
+    {
+        state->PpStatus = controller->read32(PP_STATUS);
+        state->PpControl = controller->read32(PP_CONTROL);
+        if (controller->intel_dp != NULL)
+        {
+            intel_pps_readout(controller, &state->Pps);
+        }
+    }
+    PRINT_DEBUG(EFI_D_ERROR,
+                "fastboot: pipe %08x, transcoder %08x, port %08x, DPLL %d locked %d at %u kHz, "
+                "dot clock %u kHz, source %08x, plane %08x\n",
+                state->PipeConf, state->DdiFunc, state->DdiBuf, state->Dpll, state->DpllLocked,
+                state->PortClock, state->DotClock, state->PipeSrc, state->PlaneCtl);
+}
+
+#if I915_FASTBOOT
+//i915's fuzzy clock check, clocks within about 5% of each other drive the
+//same mode and the sink is already locked to the one on the wire
+STATIC BOOLEAN i915FastbootClockMatches(UINT32 clock1, UINT32 clock2)
+{
+    UINT32 diff = clock1 > clock2 ? clock1 - clock2 : clock2 - clock1;
+
+    if (clock1 == 0 || clock2 == 0)
+    {
+        return FALSE;
+    }
+    return (UINT64)(diff + clock1 + clock2) * 100 / (clock1 + clock2) < 105;
+}
+
+//The transcoder timing registers as SetupTranscoderAndPipe* program them.
+STATIC VOID i915FastbootTimings(CONST EDID_DETAILED_TIMING *timing, I915_HW_STATE *expected)
+{
+    UINT32 hactive = i915TimingWidth(timing);
+    UINT32 hblank = timing->horzBlank | ((UINT32)(timing->horzActiveBlankMsb & 0xF) << 8);
+    UINT32 hsyncOffset = timing->horzSyncOffset | ((UINT32)(timing->syncMsb >> 6) << 8);
+    UINT32 hsyncPulse = timing->horzSyncPulse | (((UINT32)(timing->syncMsb >> 4) & 0x3) << 8);
+    UINT32 vactive = i915TimingHeight(timing);
+    UINT32 vblank = timing->vertBlank | ((UINT32)(timing->vertActiveBlankMsb & 0xF) << 8);
+    UINT32 vsyncOffset = (timing->vertSync >> 4) | (((UINT32)(timing->syncMsb >> 2) & 0x3) << 4);
+    UINT32 vsyncPulse = (timing->vertSync & 0xF) | ((UINT32)(timing->syncMsb & 0x3) << 4);
+
+    expected->HTotal = (hactive - 1) | ((hactive + hblank - 1) << 16);
+    expected->HBlank = expected->HTotal;
+    expected->HSync = (hactive + hsyncOffset - 1) | ((hactive + hsyncOffset + hsyncPulse - 1) << 16);
+    expected->VTotal = (vactive - 1) | ((vactive + vblank - 1) << 16);
+    expected->VBlank = expected->VTotal;
+    expected->VSync = (vactive + vsyncOffset - 1) | ((vactive + vsyncOffset + vsyncPulse - 1) << 16);
+    expected->PipeSrc = ((hactive - 1) << 16) | (vactive - 1);
+}
+
+STATIC BOOLEAN i915FastbootTimingsMatch(CONST I915_HW_STATE *state, CONST I915_HW_STATE *expected)
+{
+    return ((state->HTotal ^ expected->HTotal) & I915_FASTBOOT_TIMING_MASK) == 0 &&
+           ((state->HBlank ^ expected->HBlank) & I915_FASTBOOT_TIMING_MASK) == 0 &&
+           ((state->HSync ^ expected->HSync) & I915_FASTBOOT_TIMING_MASK) == 0 &&
+           ((state->VTotal ^ expected->VTotal) & I915_FASTBOOT_TIMING_MASK) == 0 &&
+           ((state->VBlank ^ expected->VBlank) & I915_FASTBOOT_TIMING_MASK) == 0 &&
+           ((state->VSync ^ expected->VSync) & I915_FASTBOOT_TIMING_MASK) == 0 &&
+           ((state->PipeSrc ^ expected->PipeSrc) & I915_FASTBOOT_TIMING_MASK) == 0;
+}
+
+//Returns why the state read back cannot carry mode on the output path, or
+//NULL if it already does.
+STATIC CONST CHAR8 *i915FastbootMismatch(i915_CONTROLLER *controller, CONST I915_HW_STATE *state,
+                                         CONST I915_MODE *mode)
+{
+    UINT32 port = controller->OutputPath.Port;
+    ConnectorType conType = controller->OutputPath.ConType;
+    BOOLEAN dp = conType == eDP || conType == DPSST;
+    UINT32 ddiMode = dp ? TRANS_DDI_MODE_SELECT_DP_SST
+                        : conType == DVI ? TRANS_DDI_MODE_SELECT_DVI : TRANS_DDI_MODE_SELECT_HDMI;
+    UINT32 edpInput = state->DdiFunc & TRANS_DDI_EDP_INPUT_MASK;
+    I915_HW_STATE expected;
+
+    if ((state->PipeConf & (PIPECONF_ENABLE | I965_PIPECONF_ACTIVE)) != (PIPECONF_ENABLE | I965_PIPECONF_ACTIVE))
+    {
+        return "pipe off";
+    }
+    if (!(state->DdiFunc & TRANS_DDI_FUNC_ENABLE) ||
+        (state->DdiFunc & TRANS_DDI_PORT_MASK) != TRANS_DDI_SELECT_PORT(port))
+    {
+        return "transcoder drives another port";
+    }
+    if ((state->DdiFunc & TRANS_DDI_MODE_SELECT_MASK) != ddiMode ||
+        (state->DdiFunc & TRANS_DDI_BPC_MASK) != TRANS_DDI_BPC_8)
+    {
+        return "transcoder in another mode";
+    }
+    if ((state->DdiFunc & (TRANS_DDI_PHSYNC | TRANS_DDI_PVSYNC)) != TransDDISyncFlags(&mode->timing))
+    {
+        return "sync polarity differs";
+    }
+    if (conType == eDP ? edpInput != TRANS_DDI_EDP_INPUT_A_ON && edpInput != TRANS_DDI_EDP_INPUT_A_ONOFF
+                       : state->ClockSel != TRANS_CLK_SEL_PORT(port))
+    {
+        return "transcoder not on pipe A";
+    }
+    if (!(state->DdiBuf & DDI_BUF_CTL_ENABLE) || (state->DdiBuf & DDI_BUF_IS_IDLE))
+    {
+        return "port off";
+    }
+    if (state->Dpll < 0 || !state->DpllLocked)
+    {
+        return "port clock off";
+    }
+    if (dp && (!(state->DpTpCtl & DP_TP_CTL_ENABLE) ||
+               (state->DpTpCtl & DP_TP_CTL_LINK_TRAIN_MASK) != DP_TP_CTL_LINK_TRAIN_NORMAL))
+    {
+        return "link not sending pixels";
+    }
+    if (conType == eDP && !(state->PpStatus & PP_STATUS_ON))
+    {
+        return "panel off";
+    }
+    i915FastbootTimings(&mode->timing, &expected);
+    if (!i915FastbootTimingsMatch(state, &expected))
+    {
+        return "other timing";
+    }
+    if (!i915FastbootClockMatches(state->DotClock, (UINT32)mode->timing.pixelClock * 10))
+    {
+        return "other pixel clock";
+    }
+    return NULL;
+}
+#endif
+
+//Takes over the output if the host firmware or an earlier boot left it
+//driving mode's timing, so the caller only has to point the plane at the
+//framebuffer. Anything short of a complete match needs the full modeset.
+EFI_STATUS i915FastbootAdopt(i915_CONTROLLER *controller, CONST I915_MODE *mode)
+{
+#if I915_FASTBOOT
+    I915_HW_STATE state;
+    CONST CHAR8 *mismatch;
+    int lanes = 0;
+
+    i915ReadHwState(controller, &state);
+    mismatch = i915FastbootMismatch(controller, &state, mode);
+    if (mismatch == NULL && (controller->OutputPath.ConType == eDP || controller->OutputPath.ConType == DPSST))
+    {
+        //the sink has the last word on whether the link still runs
+        lanes = intel_dp_readout_lane_count(controller);
+        if (lanes == 0)
+        {
+            mismatch = "sink lost the link";
+        }
+        else if ((UINT32)lanes != state.LaneCount)
+        {
+            mismatch = "sink trained another lane count";
+        }
+    }
+    if (mismatch != NULL)
+    {
+        PRINT_DEBUG(EFI_D_ERROR, "fastboot: %a, full modeset\n", mismatch);
+        return EFI_NOT_FOUND;
+    }
+    if (lanes != 0)
+    {
+        controller->OutputPath.LinkRate = state.PortClock;
+        controller->OutputPath.LaneCount = (UINT8)lanes;
+    }
+    PRINT_DEBUG(EFI_D_ERROR, "fastboot: adopting the running pipe, %u kHz from DPLL %d\n", state.DotClock,
+                state.Dpll);
+    return EFI_SUCCESS;
+#else
+    return EFI_UNSUPPORTED;
+#endif
+}
@@ -0,0 +1,45 @@
+#ifndef i915_FASTBOOTH
+#define i915_FASTBOOTH
+#include <Uefi.h>
+#include "i915_controller.h"
+
+//What the registers of the output path hold: transcoder A and pipe A, or
+//the eDP transcoder feeding pipe A, the DDI port, the DPLL it runs from, the
+//panel power sequencer and the primary plane.
+typedef struct
+{
+    UINT32 PipeConf;
+    UINT32 DdiFunc;  //TRANS_DDI_FUNC_CTL
+    UINT32 ClockSel; //TRANS_CLK_SEL, unused by the eDP transcoder
+    UINT32 DdiBuf;
+    UINT32 DpTpCtl;
+    INT32 Dpll;      //DPLL the port clock comes from, -1 if the clock is off
+    BOOLEAN DpllLocked;
+    UINT32 DpllCtrl1; //the DPLL's six bits of DPLL_CTRL1
+    UINT32 DpllCfgcr1;
+    UINT32 DpllCfgcr2;
+    UINT32 PortClock; //kHz, the DP link rate or the HDMI TMDS clock
+    UINT32 DotClock;  //kHz, the pixel clock the transcoder runs at
+    UINT32 LaneCount; //DP port width
+    UINT32 HTotal;
+    UINT32 HBlank;
+    UINT32 HSync;
+    UINT32 VTotal;
+    UINT32 VBlank;
+    UINT32 VSync;
+    UINT32 PipeSrc;
+    UINT32 LinkM;
+    UINT32 LinkN;
+    UINT32 PpStatus;
+    UINT32 PpControl;
+    struct edp_power_seq Pps; //eDP only
+    UINT32 PlaneCtl;
+    UINT32 PlaneSurf;
+    UINT32 PlaneStride;
+    UINT32 PlaneSize;
+    UINT32 PlanePos;
+} I915_HW_STATE;
+
+VOID i915ReadHwState(i915_CONTROLLER *controller, I915_HW_STATE *state);
+EFI_STATUS i915FastbootAdopt(i915_CONTROLLER *controller, CONST I915_MODE *mode);
+#endif
@@ -0,0 +1,141 @@
+#include "i915_ggtt.h"
+#include "i915_blt.h"
+#include "i915_debug.h"
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+//PTEs are built here and streamed out a batch at a time
+#define I915_GGTT_BATCH 512
+
+STATIC i915_CONTROLLER *g_ggtt_controller = NULL;
+STATIC volatile UINT64 *g_ggtt = NULL;
+STATIC UINTN g_ggtt_entries = 0;
+STATIC EFI_PHYSICAL_ADDRESS g_ggtt_scratch = 0;
+
+//cache is whatever cache used by the linux driver on my host
+STATIC UINT64 i915GgttPte(EFI_PHYSICAL_ADDRESS addr)
+{
+    return ((UINT32)(addr >> 32) & 0x7F0u) | ((UINT32)addr & 0xFFFFF000u) | 11;
+}
+
+//Writes PTEs for count pages starting at GGTT index first. Unmapped pages
+//(phys 0) point at the scratch page.
+STATIC VOID i915GgttFill(UINTN first, UINTN count, EFI_PHYSICAL_ADDRESS phys)
+{
+    UINT64 batch[I915_GGTT_BATCH];
+    UINTN i, n;
+
+    while (count > 0)
+    {
+        n = MIN(count, (UINTN)I915_GGTT_BATCH);
+        for (i = 0; i < n; i++)
+        {
+            batch[i] = i915GgttPte(phys ? phys + i * I915_GGTT_PAGE_SIZE : g_ggtt_scratch);
+        }
+        i915BltCopyToVideo((VOID *)(g_ggtt + first), batch, n * sizeof(UINT64));
+        first += n;
+        count -= n;
+        if (phys)
+        {
+            phys += n * I915_GGTT_PAGE_SIZE;
+        }
+    }
+}
+
+//Whether the count PTEs from first already point at phys, cache bits
+//included. The firmware on the host or an earlier boot may have left the
+//framebuffer mapped. Every entry is compared, since a range that is only
+//partly stale must still be rewritten; the first mismatch ends the check.
+STATIC BOOLEAN i915GgttMapped(UINTN first, UINTN count, EFI_PHYSICAL_ADDRESS phys)
+{
+    for (UINTN i = 0; i < count; i++)
+    {
+        if (g_ggtt[first + i] != i915GgttPte(phys + i * I915_GGTT_PAGE_SIZE))
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+//One flush for a whole update: drain the write-combining buffers, read an
+//entry back so the PTE writes have landed, then invalidate the GGTT TLBs.
+STATIC VOID i915GgttFlush(UINTN last)
+{
+    i915BltFlushStores();
+    (VOID) g_ggtt[last];
+    g_ggtt_controller->write32(GFX_FLSH_CNTL_GEN6, GFX_FLSH_CNTL_EN);
+    g_ggtt_controller->read32(GFX_FLSH_CNTL_GEN6);
+}
+
+//base and size describe the PTE array, the upper half of BAR0.
+EFI_STATUS i915GgttInit(i915_CONTROLLER *controller, EFI_PHYSICAL_ADDRESS base, UINTN size)
+{
+    VOID *scratch;
+
+    g_ggtt_controller = controller;
+    g_ggtt = (volatile UINT64 *)(UINTN)base;
+    g_ggtt_entries = size / sizeof(UINT64);
+    if (g_ggtt_scratch == 0)
+    {
+        scratch = AllocateReservedPages(1);
+        if (scratch == NULL)
+        {
+            return EFI_OUT_OF_RESOURCES;
+        }
+        ZeroMem(scratch, EFI_PAGE_SIZE);
+        g_ggtt_scratch = (EFI_PHYSICAL_ADDRESS)(UINTN)scratch;
+    }
+    PRINT_DEBUG(EFI_D_ERROR, "ggtt at %p, %u entries, scratch page %lx\n",
+                base, g_ggtt_entries, g_ggtt_scratch);
+    return EFI_SUCCESS;
+}
+
+//Points the graphics addresses [gmadr, gmadr + size) at the physically
+//contiguous memory at phys. A range whose PTEs already hold those addresses is
+//left alone.
+EFI_STATUS i915GgttMap(UINT32 gmadr, EFI_PHYSICAL_ADDRESS phys, UINTN size)
+{
+    UINTN first, count;
+
+    if (g_ggtt == NULL || phys == 0 || (gmadr | phys) & (I915_GGTT_PAGE_SIZE - 1))
+    {
+        return EFI_INVALID_PARAMETER;
+    }
+    size = ALIGN_VALUE(size, I915_GGTT_PAGE_SIZE);
+    first = gmadr / I915_GGTT_PAGE_SIZE;
+    count = size / I915_GGTT_PAGE_SIZE;
+    if (count == 0 || first + count > g_ggtt_entries)
+    {
+        return EFI_INVALID_PARAMETER;
+    }
+    if (i915GgttMapped(first, count, phys))
+    {
+        PRINT_DEBUG(EFI_D_ERROR, "ggtt: %u PTEs at %x already mapped\n", count, gmadr);
+        return EFI_SUCCESS;
+    }
+    i915GgttFill(first, count, phys);
+    i915GgttFlush(first + count - 1);
+    return EFI_SUCCESS;
+}
+
+//Points the graphics addresses [gmadr, gmadr + size) back at the scratch page.
+EFI_STATUS i915GgttUnmap(UINT32 gmadr, UINTN size)
+{
+    UINTN first, count;
+
+    if (g_ggtt == NULL || gmadr & (I915_GGTT_PAGE_SIZE - 1))
+    {
+        return EFI_INVALID_PARAMETER;
+    }
+    size = ALIGN_VALUE(size, I915_GGTT_PAGE_SIZE);
+    first = gmadr / I915_GGTT_PAGE_SIZE;
+    count = size / I915_GGTT_PAGE_SIZE;
+    if (count == 0 || first + count > g_ggtt_entries)
+    {
+        return EFI_INVALID_PARAMETER;
+    }
+    i915GgttFill(first, count, 0);
+    i915GgttFlush(first + count - 1);
+    return EFI_SUCCESS;
+}
@@ -0,0 +1,14 @@
+#ifndef i915_GGTTH
+#define i915_GGTTH
+#include <Uefi.h>
+#include "i915_controller.h"
+
+#define GFX_FLSH_CNTL_GEN6 0x101008
+#define GFX_FLSH_CNTL_EN (1 << 0)
+
+#define I915_GGTT_PAGE_SIZE 4096
+
+EFI_STATUS i915GgttInit(i915_CONTROLLER *controller, EFI_PHYSICAL_ADDRESS base, UINTN size);
+EFI_STATUS i915GgttMap(UINT32 gmadr, EFI_PHYSICAL_ADDRESS phys, UINTN size);
+EFI_STATUS i915GgttUnmap(UINT32 gmadr, UINTN size);
+#endif
@@ -1,33 +1,260 @@
+#define I915_LOG_CATEGORY I915_LOG_HDMI
 #include <Uefi.h>
 #include "i915_gmbus.h"
 #include "i915_debug.h"
+#include "i915_wait.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 
+//how long one step of a transaction may take, a byte and its acknowledge at
+//100 kHz take about 100 us
+#define GMBUS_TIMEOUT_US 10000
+
+STATIC EFI_STATUS gmbusWaitResult(EFI_STATUS waitStatus, UINT32 status, UINT32 wanted)
+{
+    if (waitStatus != EFI_SUCCESS)
+    {
+        //failed
+        PRINT_ERROR("gmbus timeout\n");
+        return EFI_DEVICE_ERROR;
+    }
+    if (status & GMBUS_SATOER)
+    {
+        //failed
+        PRINT_ERROR("gmbus error on %d\n", wanted);
+        return EFI_DEVICE_ERROR;
+    }
+    //worked
+    return EFI_SUCCESS;
+}
+
 EFI_STATUS gmbusWait(i915_CONTROLLER *controller, UINT32 wanted)
 {
-    UINTN counter = 0;
+    UINT32 status = 0;
+    EFI_STATUS waitStatus;
 
-    for (;;)
+    waitStatus = i915WaitForRegisterAny(controller, I915_WAIT_GMBUS, gmbusStatus,
+                                        wanted | GMBUS_SATOER, GMBUS_TIMEOUT_US, &status);
+    return gmbusWaitResult(waitStatus, status, wanted);
+}
+//the E-DDC segment pointer, each segment holds two 128 byte EDID blocks
+#define GMBUS_DDC_SEGMENT_ADDR 0x30
+#define GMBUS_DDC_ADDR 0x50
+#define GMBUS_EDID_BLOCK 128
+#define GMBUS_DDC_SEGMENT 256
+
+//bus rates from slowest to fastest, I915_GMBUS_RATE indexes this
+STATIC CONST UINT32 g_gmbus_rates[] = {GMBUS_RATE_100KHZ, GMBUS_RATE_400KHZ, GMBUS_RATE_1MHZ};
+//index into g_gmbus_rates plus one each pin last read a good EDID at
+STATIC UINT8 g_gmbus_rate[16];
+
+//where a read stands between two calls of gmbusReadStep
+enum
+{
+    GMBUS_READ_START,   //select the pin
+    GMBUS_READ_SEGMENT, //point the E-DDC segment pointer
+    GMBUS_READ_INDEX,   //start an index read up to the end of the segment
+    GMBUS_READ_DATA,    //drain the data register, four bytes per HW_RDY
+    GMBUS_READ_END,     //the slave is in its wait phase
+    GMBUS_READ_STOP,    //the stop is on the bus
+    GMBUS_READ_DONE,
+};
+
+STATIC BOOLEAN gmbusEdidChecksumOk(CONST UINT8 *buf, UINT32 count)
+{
+    for (UINT32 i = 0; i < count; i++)
     {
-        UINT32 status = controller->read32(gmbusStatus);
-        counter += 1;
-        if (counter >= 100)
+        if (CalculateSum8(buf + i * GMBUS_EDID_BLOCK, GMBUS_EDID_BLOCK) != 0)
         {
-            //failed
-            PRINT_DEBUG(EFI_D_ERROR, "gmbus timeout\n");
-            return EFI_DEVICE_ERROR;
+            return FALSE;
         }
-        if (status & GMBUS_SATOER)
+    }
+    return TRUE;
+}
+
+STATIC VOID gmbusReadWait(I915_GMBUS_READ *read, I915_WAIT *wait, UINT32 wanted)
+{
+    i915WaitBeginAny(wait, I915_WAIT_GMBUS, gmbusStatus, wanted | GMBUS_SATOER, GMBUS_TIMEOUT_US);
+    read->wanted = wanted;
+}
+
+//Sets read up for len bytes of the DDC slave from offset in E-DDC segment
+//segment, at the rate the pin last read its EDID at or 100 kHz if it has
+//not yet.
+VOID gmbusReadDdcBegin(I915_GMBUS_READ *read, UINT8 pin, UINT8 segment, UINT8 offset, UINT8 *buf,
+                       UINT32 len)
+{
+    ZeroMem(read, sizeof(*read));
+    read->pin = pin;
+    read->start = (UINT32)segment * GMBUS_DDC_SEGMENT + offset;
+    read->buf = buf;
+    read->len = len;
+    if (len == 0 || len > GEN9_GMBUS_BYTE_COUNT_MAX)
+    {
+        read->status = EFI_INVALID_PARAMETER;
+        read->phase = GMBUS_READ_DONE;
+    }
+}
+
+//Sets read up for count EDID blocks from first on, starting at
+//I915_GMBUS_RATE. A read that fails or comes back with a bad checksum is
+//retried one rate lower down to 100 kHz, and the pin keeps the rate that
+//worked. At 100 kHz the blocks are returned as read, the caller checks them
+//like it always did.
+VOID gmbusReadEdidBegin(I915_GMBUS_READ *read, UINT8 pin, UINT32 first, UINT32 count, UINT8 *buf)
+{
+    UINT8 *rate = &g_gmbus_rate[pin & 0xF];
+
+    ZeroMem(read, sizeof(*read));
+    read->pin = pin;
+    read->start = first * GMBUS_EDID_BLOCK;
+    read->buf = buf;
+    read->len = count * GMBUS_EDID_BLOCK;
+    if (count == 0 || first + count > 256)
+    {
+        read->status = EFI_INVALID_PARAMETER;
+        read->phase = GMBUS_READ_DONE;
+        return;
+    }
+    read->edid = TRUE;
+    if (*rate == 0)
+    {
+        *rate = (UINT8)MIN((UINTN)I915_GMBUS_RATE, ARRAY_SIZE(g_gmbus_rates) - 1) + 1;
+    }
+}
+
+//Runs read up to its next GMBUS wait. Returns EFI_NOT_READY with wait armed,
+//the caller polls or completes it and calls again, until the read is over.
+//An index cycle sends the offset, so there is no separate write and restart.
+//A read that runs past the end of a segment goes on in the next one.
+EFI_STATUS gmbusReadStep(i915_CONTROLLER *controller, I915_GMBUS_READ *read, I915_WAIT *wait)
+{
+    UINT8 *rate = &g_gmbus_rate[read->pin & 0xF];
+    UINT32 pos, data;
+
+    if (read->wanted != 0)
+    {
+        read->status = gmbusWaitResult(wait->status, wait->lastValue, read->wanted);
+        read->wanted = 0;
+    }
+    for (;;)
+    {
+        pos = read->start + read->done;
+        if (EFI_ERROR(read->status) && read->phase < GMBUS_READ_STOP)
         {
-            //failed
-            PRINT_DEBUG(EFI_D_ERROR, "gmbus error on %d\n", wanted);
-            return EFI_DEVICE_ERROR;
+            //a NAK leaves the engine stuck until the interrupt is cleared
+            controller->write32(gmbusCommand, GMBUS_SW_CLR_INT);
+            controller->write32(gmbusCommand, 0);
+            controller->write32(gmbusSelect, 0);
+            read->phase = GMBUS_READ_DONE;
         }
-        if (status & wanted)
+        switch (read->phase)
         {
-            //worked
-            return EFI_SUCCESS;
+        case GMBUS_READ_START:
+            controller->write32(gmbusSelect, g_gmbus_rates[*rate > 0 ? *rate - 1 : 0] | read->pin);
+            read->phase = GMBUS_READ_SEGMENT;
+            break;
+        case GMBUS_READ_SEGMENT:
+            read->phase = GMBUS_READ_INDEX;
+            if (pos >= GMBUS_DDC_SEGMENT)
+            {
+                controller->write32(gmbusData, pos / GMBUS_DDC_SEGMENT);
+                controller->write32(gmbusCommand, (GMBUS_DDC_SEGMENT_ADDR << GMBUS_SLAVE_ADDR_SHIFT) |
+                                                      (1 << GMBUS_BYTE_COUNT_SHIFT) |
+                                                      GMBUS_SLAVE_WRITE | GMBUS_CYCLE_WAIT |
+                                                      GMBUS_SW_RDY);
+                gmbusReadWait(read, wait, GMBUS_HW_WAIT_PHASE);
+                return EFI_NOT_READY;
+            }
+            break;
+        case GMBUS_READ_INDEX:
+            read->chunk = MIN(read->len - read->done, GMBUS_DDC_SEGMENT - pos % GMBUS_DDC_SEGMENT);
+            read->drained = 0;
+            controller->write32(gmbusCommand, ((pos % GMBUS_DDC_SEGMENT) << GMBUS_SLAVE_INDEX_SHIFT) |
+                                                  (read->chunk << GMBUS_BYTE_COUNT_SHIFT) |
+                                                  (GMBUS_DDC_ADDR << GMBUS_SLAVE_ADDR_SHIFT) |
+                                                  GMBUS_SLAVE_READ | GMBUS_CYCLE_INDEX |
+                                                  GMBUS_CYCLE_WAIT | GMBUS_SW_RDY);
+            read->phase = GMBUS_READ_DATA;
+            gmbusReadWait(read, wait, GMBUS_HW_RDY);
+            return EFI_NOT_READY;
+        case GMBUS_READ_DATA:
+            data = controller->read32(gmbusData);
+            for (UINT32 j = 0; j < 4 && read->drained + j < read->chunk; j++)
+            {
+                read->buf[read->done + read->drained + j] = (UINT8)(data >> (j * 8));
+            }
+            read->drained += 4;
+            if (read->drained < read->chunk)
+            {
+                gmbusReadWait(read, wait, GMBUS_HW_RDY);
+                return EFI_NOT_READY;
+            }
+            read->phase = GMBUS_READ_END;
+            gmbusReadWait(read, wait, GMBUS_HW_WAIT_PHASE);
+            return EFI_NOT_READY;
+        case GMBUS_READ_END:
+            read->done += read->chunk;
+            if (read->done < read->len)
+            {
+                read->phase = GMBUS_READ_SEGMENT;
+                break;
+            }
+            controller->write32(gmbusCommand, GMBUS_CYCLE_STOP | GMBUS_SW_RDY);
+            read->phase = GMBUS_READ_STOP;
+            i915WaitBegin(wait, I915_WAIT_GMBUS, gmbusStatus, GMBUS_ACTIVE, 0, GMBUS_TIMEOUT_US);
+            return EFI_NOT_READY;
+        case GMBUS_READ_STOP:
+            controller->write32(gmbusSelect, 0);
+            read->phase = GMBUS_READ_DONE;
+            break;
+        default:
+            if (!read->edid || *rate <= 1 ||
+                (!EFI_ERROR(read->status) &&
+                 gmbusEdidChecksumOk(read->buf, read->len / GMBUS_EDID_BLOCK)))
+            {
+                return read->status;
+            }
+            (*rate)--;
+            PRINT_DEBUG(EFI_D_ERROR, "gmbus pin %d: EDID read failed, retrying at rate %d\n",
+                        read->pin, g_gmbus_rates[*rate - 1] >> 8);
+            read->done = 0;
+            read->status = EFI_SUCCESS;
+            read->phase = GMBUS_READ_START;
+            break;
         }
-        gBS->Stall(100);
     }
-}
\ No newline at end of file
+}
+
+//Runs read to the end, sitting out each wait.
+STATIC EFI_STATUS gmbusReadRun(i915_CONTROLLER *controller, I915_GMBUS_READ *read)
+{
+    I915_WAIT wait;
+    EFI_STATUS Status;
+
+    while ((Status = gmbusReadStep(controller, read, &wait)) == EFI_NOT_READY)
+    {
+        i915WaitComplete(controller, &wait);
+    }
+    return Status;
+}
+
+//Reads len bytes of the DDC slave from offset in E-DDC segment segment.
+EFI_STATUS gmbusReadDdc(i915_CONTROLLER *controller, UINT8 pin, UINT8 segment, UINT8 offset, UINT8 *buf,
+                        UINT32 len)
+{
+    I915_GMBUS_READ read;
+
+    gmbusReadDdcBegin(&read, pin, segment, offset, buf, len);
+    return gmbusReadRun(controller, &read);
+}
+
+//Reads count EDID blocks from first on, see gmbusReadEdidBegin.
+EFI_STATUS gmbusReadEdid(i915_CONTROLLER *controller, UINT8 pin, UINT32 first, UINT32 count, UINT8 *buf)
+{
+    I915_GMBUS_READ read;
+
+    gmbusReadEdidBegin(&read, pin, first, count, buf);
+    return gmbusReadRun(controller, &read);
+}
@@ -2,6 +2,7 @@
 #define i915_GMBUSH
 #include "i915_reg.h"
 #include "i915_controller.h"
+#include "i915_wait.h"
 
 #define GMBUS0 (PCH_DISPLAY_BASE+0x5100)
 #define gmbusSelect (PCH_DISPLAY_BASE+0x5100)
@@ -60,5 +61,30 @@
 #define gmbusData (PCH_DISPLAY_BASE+0x510C)
 #define GMBUS4 (PCH_DISPLAY_BASE+0x5110)
 
+//A read of the DDC slave taken apart at its GMBUS waits, so the caller can
+//return in between. start is the byte address in the E-DDC space, segment
+//times 256 plus offset.
+typedef struct
+{
+    UINT8 pin;
+    BOOLEAN edid;
+    UINT8 *buf;
+    UINT32 start;
+    UINT32 len;
+    UINT32 done;
+    UINT32 chunk;
+    UINT32 drained;
+    UINT32 wanted;
+    UINT32 phase;
+    EFI_STATUS status;
+} I915_GMBUS_READ;
+
 EFI_STATUS gmbusWait(i915_CONTROLLER *, UINT32);
+VOID gmbusReadDdcBegin(I915_GMBUS_READ *read, UINT8 pin, UINT8 segment, UINT8 offset, UINT8 *buf,
+                       UINT32 len);
+VOID gmbusReadEdidBegin(I915_GMBUS_READ *read, UINT8 pin, UINT32 first, UINT32 count, UINT8 *buf);
+EFI_STATUS gmbusReadStep(i915_CONTROLLER *controller, I915_GMBUS_READ *read, I915_WAIT *wait);
+EFI_STATUS gmbusReadDdc(i915_CONTROLLER *controller, UINT8 pin, UINT8 segment, UINT8 offset, UINT8 *buf,
+                        UINT32 len);
+EFI_STATUS gmbusReadEdid(i915_CONTROLLER *controller, UINT8 pin, UINT32 first, UINT32 count, UINT8 *buf);
 #endif
\ No newline at end of file
@@ -1,16 +1,16 @@
+#define I915_LOG_CATEGORY I915_LOG_GOP
 #include "i915_gop.h"
+#include "i915_cache.h"
+#include <Library/BaseMemoryLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
 
-STATIC EFI_GRAPHICS_OUTPUT_MODE_INFORMATION
-    g_mode_info[] = {
-        {
-            0,    // Version
-            1024, // HorizontalResolution
-            768,  // VerticalResolution
-        }};
+STATIC I915_MODE g_modes[I915_MAX_MODES];
+STATIC EFI_GRAPHICS_OUTPUT_MODE_INFORMATION g_mode_info[I915_MAX_MODES];
 
 STATIC EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE
     g_mode = {
-        ARRAY_SIZE(g_mode_info),                      // MaxMode
+        1,                                            // MaxMode
         0,                                            // Mode
         g_mode_info,                                  // Info
         sizeof(EFI_GRAPHICS_OUTPUT_MODE_INFORMATION), // SizeOfInfo
@@ -55,6 +55,326 @@ STATIC FRAME_BUFFER_CONFIGURE
         g_i915FrameBufferBltConfigure = NULL;
 STATIC UINTN
     g_i915FrameBufferBltConfigureSize = 0;
+STATIC I915_BLT_SURFACE g_i915BltSurface;
+
+#if I915_PAN_SCROLL && I915_BLT_ENGINE
+STATIC BOOLEAN g_pan_enabled = FALSE;
+STATIC UINTN g_pan_rows = 0;
+STATIC EFI_EVENT g_pan_exit_boot = NULL;
+STATIC EFI_EVENT g_pan_ready_to_boot = NULL;
+//set at ReadyToBoot, the boot loader gets a framebuffer that stays put
+STATIC BOOLEAN g_pan_stopped = FALSE;
+
+//Copies pixels [x0, x1) of framebuffer row src to framebuffer row dst.
+STATIC VOID i915PanCopySpan(UINTN dst, UINTN src, UINTN x0, UINTN x1)
+{
+    I915_BLT_SURFACE *surface = &g_i915BltSurface;
+
+    if (x1 <= x0 || dst == src)
+    {
+        return;
+    }
+    i915BltCopyToVideo(surface->Base + dst * surface->Pitch + x0 * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL),
+                       surface->Base + src * surface->Pitch + x0 * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL),
+                       (x1 - x0) * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
+}
+
+//Moves the visible window back to the top of the framebuffer, which is where
+//anyone writing FrameBufferBase directly expects it.
+STATIC VOID i915PanReset(VOID)
+{
+    I915_BLT_SURFACE *surface = &g_i915BltSurface;
+    UINTN y;
+
+    if (surface->Origin == 0)
+    {
+        return;
+    }
+    //every source row lies below its destination, top-down never clobbers
+    for (y = 0; y < surface->Height; y++)
+    {
+        i915PanCopySpan(y, surface->Origin + y, 0, surface->Width);
+    }
+    i915BltFlushStores();
+    surface->Origin = 0;
+    setDisplayPanOffset(0);
+}
+
+STATIC VOID EFIAPI i915PanExitBootServices(IN EFI_EVENT Event, IN VOID *Context)
+{
+    i915PanReset();
+}
+
+//Boot loaders such as GRUB's gfxterm draw into FrameBufferBase themselves,
+//so from here on the window stays at the top and scrolls are copied.
+STATIC VOID EFIAPI i915PanReadyToBoot(IN EFI_EVENT Event, IN VOID *Context)
+{
+    i915PanReset();
+    g_pan_enabled = FALSE;
+    g_pan_stopped = TRUE;
+}
+
+//Turns an upward VideoToVideo scroll into a plane offset change. The visible
+//window moves down by the scroll distance, so the destination rectangle is
+//already in place and only what lies outside it (rows above and below, side
+//margins of a centered text console) is carried over from the old window.
+//When the window would run off the end of the framebuffer it wraps back to
+//row 0, which costs one ordinary full-screen copy. Returns FALSE if the blit
+//is not a scroll worth panning, the caller then copies as usual.
+STATIC BOOLEAN i915PanScroll(UINTN SourceX, UINTN SourceY, UINTN DestinationX,
+                             UINTN DestinationY, UINTN Width, UINTN Height)
+{
+    I915_BLT_SURFACE *surface = &g_i915BltSurface;
+    UINTN lines, oldOrigin, newOrigin, y, x0, x1;
+
+    if (!g_pan_enabled || SourceX != DestinationX || SourceY <= DestinationY ||
+        Width == 0 || Height == 0 ||
+        DestinationX > surface->Width || Width > surface->Width - DestinationX ||
+        SourceY > surface->Height || Height > surface->Height - SourceY)
+    {
+        return FALSE;
+    }
+    //everything outside the rectangle is copied, so it has to be small
+    if (surface->Height - Height > surface->Height / 4 ||
+        surface->Width - Width > surface->Width / 4)
+    {
+        return FALSE;
+    }
+
+    lines = SourceY - DestinationY;
+    x0 = DestinationX;
+    x1 = DestinationX + Width;
+    oldOrigin = surface->Origin;
+    if (oldOrigin + lines + surface->Height <= g_pan_rows)
+    {
+        //window moves down: sources sit lines rows above their destinations
+        newOrigin = oldOrigin + lines;
+        for (y = surface->Height; y-- > 0;)
+        {
+            if (y >= DestinationY && y < DestinationY + Height)
+            {
+                i915PanCopySpan(newOrigin + y, oldOrigin + y, 0, x0);
+                i915PanCopySpan(newOrigin + y, oldOrigin + y, x1, surface->Width);
+            }
+            else
+            {
+                i915PanCopySpan(newOrigin + y, oldOrigin + y, 0, surface->Width);
+            }
+        }
+    }
+    else
+    {
+        //wrap: rebuild the scrolled screen at row 0, sources are all below
+        newOrigin = 0;
+        for (y = 0; y < surface->Height; y++)
+        {
+            if (y >= DestinationY && y < DestinationY + Height)
+            {
+                i915PanCopySpan(y, oldOrigin + y + lines, x0, x1);
+                i915PanCopySpan(y, oldOrigin + y, 0, x0);
+                i915PanCopySpan(y, oldOrigin + y, x1, surface->Width);
+            }
+            else
+            {
+                i915PanCopySpan(y, oldOrigin + y, 0, surface->Width);
+            }
+        }
+    }
+    i915BltFlushStores();
+    surface->Origin = newOrigin;
+    setDisplayPanOffset((UINT32)newOrigin);
+    return TRUE;
+}
+
+//Panning needs a second screen of GGTT-backed aperture below the visible one
+//and a Blt surface that is the aperture itself rather than a shadow.
+STATIC VOID i915PanConfigure(i915_CONTROLLER *controller)
+{
+    I915_BLT_SURFACE *surface = &g_i915BltSurface;
+
+    g_pan_enabled = FALSE;
+    g_pan_rows = surface->Pitch ? controller->fbBackingSize / surface->Pitch : 0;
+    if (g_pan_stopped || !surface->Streaming || g_pan_rows < 2 * (UINTN)surface->Height)
+    {
+        PRINT_DEBUG(EFI_D_ERROR, "pan scrolling off, %u rows backed\n", g_pan_rows);
+        return;
+    }
+    if (g_pan_exit_boot == NULL)
+    {
+        gBS->CreateEvent(EVT_SIGNAL_EXIT_BOOT_SERVICES, TPL_NOTIFY,
+                         i915PanExitBootServices, NULL, &g_pan_exit_boot);
+    }
+    if (g_pan_ready_to_boot == NULL)
+    {
+        EfiCreateEventReadyToBootEx(TPL_CALLBACK, i915PanReadyToBoot, NULL, &g_pan_ready_to_boot);
+    }
+    g_pan_enabled = TRUE;
+}
+#endif
+
+#if I915_SHADOW_FB
+#define I915_SHADOW_MAX_DIRTY 8
+
+typedef struct
+{
+    UINTN x0;
+    UINTN y0;
+    UINTN x1;
+    UINTN y1;
+} I915_DIRTY_RECT;
+
+STATIC UINT8 *g_shadow_fb = NULL;
+STATIC UINTN g_shadow_pages = 0;
+STATIC UINT8 *g_shadow_target = NULL;
+STATIC I915_DIRTY_RECT g_dirty[I915_SHADOW_MAX_DIRTY];
+STATIC UINTN g_dirty_count = 0;
+#if I915_SHADOW_FB_FLUSH_MS
+STATIC EFI_EVENT g_shadow_timer = NULL;
+STATIC EFI_EVENT g_shadow_exit_boot = NULL;
+#endif
+
+STATIC BOOLEAN i915ShadowRectsTouch(CONST I915_DIRTY_RECT *a, CONST I915_DIRTY_RECT *b)
+{
+    return a->x0 <= b->x1 && b->x0 <= a->x1 &&
+           a->y0 <= b->y1 && b->y0 <= a->y1;
+}
+
+STATIC VOID i915ShadowRectUnion(I915_DIRTY_RECT *a, CONST I915_DIRTY_RECT *b)
+{
+    a->x0 = MIN(a->x0, b->x0);
+    a->y0 = MIN(a->y0, b->y0);
+    a->x1 = MAX(a->x1, b->x1);
+    a->y1 = MAX(a->y1, b->y1);
+}
+
+STATIC VOID i915ShadowMarkDirty(UINTN x, UINTN y, UINTN width, UINTN height)
+{
+    I915_DIRTY_RECT rect;
+    UINTN i;
+
+    if (width == 0 || height == 0)
+    {
+        return;
+    }
+    rect.x0 = x;
+    rect.y0 = y;
+    rect.x1 = x + width;
+    rect.y1 = y + height;
+    for (i = 0; i < g_dirty_count; i++)
+    {
+        if (i915ShadowRectsTouch(&g_dirty[i], &rect))
+        {
+            i915ShadowRectUnion(&g_dirty[i], &rect);
+            return;
+        }
+    }
+    if (g_dirty_count < I915_SHADOW_MAX_DIRTY)
+    {
+        g_dirty[g_dirty_count++] = rect;
+        return;
+    }
+    //out of slots, grow the last rectangle instead of flushing early
+    i915ShadowRectUnion(&g_dirty[g_dirty_count - 1], &rect);
+}
+
+//Copies the dirty rectangles from the shadow to the aperture. Rectangles that
+//cover whole scanlines go out as one contiguous copy, the rest row by row.
+STATIC VOID i915ShadowFlush(VOID)
+{
+    EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *info = g_mode.Info;
+    UINTN pitch = info->PixelsPerScanLine * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+    UINTN i, y, offset, bytes;
+
+    for (i = 0; i < g_dirty_count; i++)
+    {
+        I915_DIRTY_RECT *rect = &g_dirty[i];
+
+        offset = rect->y0 * pitch + rect->x0 * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+        if (rect->x0 == 0 && rect->x1 >= info->HorizontalResolution)
+        {
+            i915BltCopyToVideo(g_shadow_target + offset, g_shadow_fb + offset,
+                               (rect->y1 - rect->y0) * pitch);
+            continue;
+        }
+        bytes = (rect->x1 - rect->x0) * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+        for (y = rect->y0; y < rect->y1; y++)
+        {
+            i915BltCopyToVideo(g_shadow_target + offset, g_shadow_fb + offset, bytes);
+            offset += pitch;
+        }
+    }
+    i915BltFlushStores();
+    g_dirty_count = 0;
+}
+
+#if I915_SHADOW_FB_FLUSH_MS
+STATIC VOID EFIAPI i915ShadowFlushEvent(IN EFI_EVENT Event, IN VOID *Context)
+{
+    if (g_shadow_fb != NULL && g_dirty_count != 0)
+    {
+        i915ShadowFlush();
+    }
+}
+#endif
+
+//(Re)allocates the shadow for the current mode. The shadow starts out black
+//and is pushed to the aperture once so both copies agree.
+STATIC EFI_STATUS i915ShadowConfigure(i915_CONTROLLER *controller)
+{
+    EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *info = g_mode.Info;
+    UINTN size = info->PixelsPerScanLine * info->VerticalResolution *
+                 sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+    UINTN pages = EFI_SIZE_TO_PAGES(size);
+
+    if (g_shadow_fb != NULL && g_shadow_pages < pages)
+    {
+        FreePages(g_shadow_fb, g_shadow_pages);
+        g_shadow_fb = NULL;
+        g_shadow_pages = 0;
+    }
+    if (g_shadow_fb == NULL)
+    {
+        g_shadow_fb = AllocatePages(pages);
+        if (g_shadow_fb == NULL)
+        {
+            PRINT_DEBUG(EFI_D_ERROR, "no memory for a %u byte shadow, blt goes to the aperture\n", size);
+            return EFI_OUT_OF_RESOURCES;
+        }
+        g_shadow_pages = pages;
+    }
+    g_shadow_target = (UINT8 *)controller->FbBase;
+    ZeroMem(g_shadow_fb, size);
+    g_dirty_count = 0;
+    i915ShadowMarkDirty(0, 0, info->HorizontalResolution, info->VerticalResolution);
+    i915ShadowFlush();
+
+#if I915_SHADOW_FB_FLUSH_MS
+    if (g_shadow_timer == NULL)
+    {
+        EFI_STATUS Status = gBS->CreateEvent(EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_NOTIFY,
+                                             i915ShadowFlushEvent, NULL, &g_shadow_timer);
+        if (!EFI_ERROR(Status))
+        {
+            Status = gBS->SetTimer(g_shadow_timer, TimerPeriodic,
+                                   I915_SHADOW_FB_FLUSH_MS * 10000ull);
+        }
+        if (EFI_ERROR(Status))
+        {
+            PRINT_ERROR("failed to start the shadow flush timer: %u\n", Status);
+            FreePages(g_shadow_fb, g_shadow_pages);
+            g_shadow_fb = NULL;
+            g_shadow_pages = 0;
+            return Status;
+        }
+        //whatever is still pending must reach the screen before the OS takes over
+        gBS->CreateEvent(EVT_SIGNAL_EXIT_BOOT_SERVICES, TPL_NOTIFY,
+                         i915ShadowFlushEvent, NULL, &g_shadow_exit_boot);
+    }
+#endif
+    PRINT_DEBUG(EFI_D_ERROR, "shadow framebuffer at %p, %u bytes\n", g_shadow_fb, size);
+    return EFI_SUCCESS;
+}
+#endif
 
 EFI_STATUS i915GraphicsFramebufferConfigure(i915_CONTROLLER *controller)
 {
@@ -91,9 +411,16 @@ EFI_STATUS i915GraphicsFramebufferConfigure(i915_CONTROLLER *controller)
 
     //blt stuff
     EFI_STATUS Status;
+    VOID *BltTarget = (VOID *)controller->FbBase;
+#if I915_SHADOW_FB
+    if (!EFI_ERROR(i915ShadowConfigure(controller)))
+    {
+        BltTarget = g_shadow_fb;
+    }
+#endif
     Status = FrameBufferBltConfigure(
-        (VOID *)controller->FbBase,
-        g_mode_info,
+        BltTarget,
+        g_mode.Info,
         g_i915FrameBufferBltConfigure,
         &g_i915FrameBufferBltConfigureSize);
 
@@ -111,15 +438,21 @@ EFI_STATUS i915GraphicsFramebufferConfigure(i915_CONTROLLER *controller)
         }
 
         Status = FrameBufferBltConfigure(
-            (VOID *)controller->FbBase,
-            g_mode_info,
+            BltTarget,
+            g_mode.Info,
             g_i915FrameBufferBltConfigure,
             &g_i915FrameBufferBltConfigureSize);
     }
     if (EFI_ERROR(Status))
     {
-        PRINT_DEBUG(EFI_D_ERROR, "failed to setup blt\n");
+        PRINT_ERROR("failed to setup blt\n");
     }
+    //the modeset programmed a zero plane offset, so the window starts at row 0
+    i915BltSurfaceInit(&g_i915BltSurface, BltTarget, g_mode.Info,
+                       BltTarget == (VOID *)controller->FbBase);
+#if I915_PAN_SCROLL && I915_BLT_ENGINE
+    i915PanConfigure(controller);
+#endif
     return EFI_SUCCESS;
 }
 
@@ -150,17 +483,49 @@ STATIC EFI_STATUS
         IN
             UINTN Delta)
 {
-    EFI_STATUS Status = FrameBufferBlt(
-        g_i915FrameBufferBltConfigure,
-        BltBuffer,
-        BltOperation,
-        SourceX,
-        SourceY,
-        DestinationX,
-        DestinationY,
-        Width,
-        Height,
-        Delta);
+#if I915_SHADOW_FB && I915_SHADOW_FB_FLUSH_MS
+    //keep the flush timer out while the shadow and the dirty list change
+    EFI_TPL OldTpl = gBS->RaiseTPL(TPL_NOTIFY);
+#endif
+    EFI_STATUS Status = EFI_SUCCESS;
+    BOOLEAN Panned = FALSE;
+#if I915_PAN_SCROLL && I915_BLT_ENGINE
+    //a panned scroll is done, but still has to leave through the TPL restore
+    Panned = BltOperation == EfiBltVideoToVideo &&
+             i915PanScroll(SourceX, SourceY, DestinationX, DestinationY, Width, Height);
+#endif
+    if (!Panned)
+    {
+#if I915_BLT_ENGINE
+        Status = i915Blt(
+            &g_i915BltSurface,
+#else
+        Status = FrameBufferBlt(
+            g_i915FrameBufferBltConfigure,
+#endif
+            BltBuffer,
+            BltOperation,
+            SourceX,
+            SourceY,
+            DestinationX,
+            DestinationY,
+            Width,
+            Height,
+            Delta);
+#if I915_SHADOW_FB
+        if (g_shadow_fb != NULL && !EFI_ERROR(Status) &&
+            BltOperation != EfiBltVideoToBltBuffer)
+        {
+            i915ShadowMarkDirty(DestinationX, DestinationY, Width, Height);
+#if !I915_SHADOW_FB_FLUSH_MS
+            i915ShadowFlush();
+#endif
+        }
+#endif
+    }
+#if I915_SHADOW_FB && I915_SHADOW_FB_FLUSH_MS
+    gBS->RestoreTPL(OldTpl);
+#endif
     //PRINT_DEBUG(EFI_D_ERROR,
     //"i915: blt %d %d,%d %dx%d\n",Status,DestinationX,DestinationY,Width,Height);
     return Status;
@@ -176,22 +541,80 @@ STATIC EFI_STATUS
             ModeNumber)
 
 {
-    return setDisplayGraphicsMode(ModeNumber);
+    EFI_GRAPHICS_OUTPUT_BLT_PIXEL Black = {0};
+    UINT32 OldMode = g_mode.Mode;
+    EFI_STATUS Status;
+
+    if (ModeNumber >= g_mode.MaxMode)
+    {
+        return EFI_UNSUPPORTED;
+    }
+    g_mode.Mode = ModeNumber;
+    g_mode.Info = &g_mode_info[ModeNumber];
+    Status = setDisplayGraphicsMode(&g_modes[ModeNumber]);
+    if (EFI_ERROR(Status))
+    {
+        PRINT_ERROR("mode %u failed: %u\n", ModeNumber, Status);
+        if (OldMode != ModeNumber)
+        {
+            //the outgoing mode was working, try to get the screen back
+            g_mode.Mode = OldMode;
+            g_mode.Info = &g_mode_info[OldMode];
+            setDisplayGraphicsMode(&g_modes[OldMode]);
+        }
+        return Status;
+    }
+    i915CacheStoreMode(g_modes[ModeNumber].width, g_modes[ModeNumber].height);
+    //SetMode is specified to clear the screen
+    return i915GraphicsOutputBlt(This, &Black, EfiBltVideoFill, 0, 0, 0, 0,
+                                 g_mode.Info->HorizontalResolution,
+                                 g_mode.Info->VerticalResolution, 0);
 }
 
-EFI_STATUS i915GraphicsSetupOutput(EFI_GRAPHICS_OUTPUT_PROTOCOL *GraphicsOutput, UINT32 x_active, UINT32 y_active)
+//Fills in the mode list and the protocol, and returns the mode to start in.
+//Setting it is left to the caller, the bring-up does the modeset a step at a
+//time and SetMode then only has the plane left to do.
+CONST I915_MODE *i915GraphicsPrepareOutput(EFI_GRAPHICS_OUTPUT_PROTOCOL *GraphicsOutput, i915_CONTROLLER *controller)
 {
+    UINT32 count = i915BuildModeList(controller, g_modes, I915_MAX_MODES);
+    UINT32 initial = 0;
+    UINT32 width, height;
 
-    g_mode_info[0].HorizontalResolution = x_active;
-    g_mode_info[0].VerticalResolution = y_active;
-    g_mode_info[0].PixelsPerScanLine = ((x_active * 4 + 63) & -64) >> 2;
-    g_mode_info[0].PixelFormat = PixelBlueGreenRedReserved8BitPerColor;
+    for (UINT32 i = 0; i < count; i++)
+    {
+        g_mode_info[i].Version = 0;
+        g_mode_info[i].HorizontalResolution = g_modes[i].width;
+        g_mode_info[i].VerticalResolution = g_modes[i].height;
+        g_mode_info[i].PixelsPerScanLine = ((g_modes[i].width * 4 + 63) & -64) >> 2;
+        g_mode_info[i].PixelFormat = PixelBlueGreenRedReserved8BitPerColor;
+    }
+    //start in the mode the last boot ended in, the loader then finds it set
+    if (i915CacheGetMode(&width, &height))
+    {
+        for (UINT32 i = 0; i < count; i++)
+        {
+            if (g_modes[i].width == width && g_modes[i].height == height)
+            {
+                initial = i;
+                break;
+            }
+        }
+    }
+    g_mode.MaxMode = count;
+    g_mode.Mode = initial;
+    g_mode.Info = &g_mode_info[initial];
 
     GraphicsOutput->QueryMode = i915GraphicsOutputQueryMode;
     GraphicsOutput->SetMode = i915GraphicsOutputSetMode;
     GraphicsOutput->Blt = i915GraphicsOutputBlt;
     GraphicsOutput->Mode = &g_mode;
-    EFI_STATUS stat = GraphicsOutput->SetMode(GraphicsOutput, 0);
+    return &g_modes[initial];
+}
+
+EFI_STATUS i915GraphicsSetupOutput(EFI_GRAPHICS_OUTPUT_PROTOCOL *GraphicsOutput, i915_CONTROLLER *controller)
+{
+    i915GraphicsPrepareOutput(GraphicsOutput, controller);
+    EFI_STATUS stat = GraphicsOutput->SetMode(GraphicsOutput, g_mode.Mode);
     PRINT_DEBUG(EFI_D_ERROR, "progressed to gopline %d, status is %u\n",
                 __LINE__, stat);
     return stat;
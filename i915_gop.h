@@ -7,9 +7,11 @@
 #include "i915_debug.h"
 #include <Library/FrameBufferBltLib.h>
 #include "i915_reg.h"
+#include "i915_blt.h"
 #include <Library/MemoryAllocationLib.h>
 
 EFI_STATUS i915GraphicsFramebufferConfigure(i915_CONTROLLER *controller);
 
-EFI_STATUS i915GraphicsSetupOutput(EFI_GRAPHICS_OUTPUT_PROTOCOL *GraphicsOutput, UINT32 x_active, UINT32 y_active);
+CONST I915_MODE *i915GraphicsPrepareOutput(EFI_GRAPHICS_OUTPUT_PROTOCOL *GraphicsOutput, i915_CONTROLLER *controller);
+EFI_STATUS i915GraphicsSetupOutput(EFI_GRAPHICS_OUTPUT_PROTOCOL *GraphicsOutput, i915_CONTROLLER *controller);
 #endif
\ No newline at end of file
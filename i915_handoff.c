@@ -0,0 +1,100 @@
+#define I915_LOG_CATEGORY I915_LOG_DISPLAY
+#include "i915_handoff.h"
+#include "i915_fastboot.h"
+#include "i915_debug.h"
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#if I915_HANDOFF
+//gen9 linear planes count the stride in 64 byte units
+#define I915_HANDOFF_STRIDE_MASK 0x3FF
+#define I915_HANDOFF_STRIDE_UNIT 64
+#define I915_HANDOFF_SIZE_MASK 0x1FFF
+
+STATIC I915_HANDOFF_TABLE *g_handoff = NULL;
+
+//The table is allocated and installed on the first mode set and rewritten in
+//place after that, the OS finds whatever the last one left.
+STATIC EFI_STATUS i915HandoffInit(VOID)
+{
+    EFI_STATUS Status;
+
+    if (g_handoff != NULL)
+    {
+        return EFI_SUCCESS;
+    }
+    g_handoff = AllocateReservedZeroPool(sizeof(*g_handoff));
+    if (g_handoff == NULL)
+    {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    g_handoff->Signature = I915_HANDOFF_SIGNATURE;
+    g_handoff->Length = sizeof(*g_handoff);
+    g_handoff->Version = I915_HANDOFF_VERSION;
+    Status = gBS->InstallConfigurationTable(&gI915HandoffTableGuid, g_handoff);
+    if (EFI_ERROR(Status))
+    {
+        FreePool(g_handoff);
+        g_handoff = NULL;
+    }
+    return Status;
+}
+#endif
+
+//Records the output the driver drives, read back from the registers the same
+//way the OS driver will. active is FALSE while a modeset has the pipe down.
+VOID i915HandoffUpdate(i915_CONTROLLER *controller, BOOLEAN active)
+{
+#if I915_HANDOFF
+    I915_HW_STATE state;
+    I915_HANDOFF_TABLE *handoff;
+
+    if (EFI_ERROR(i915HandoffInit()))
+    {
+        return;
+    }
+    handoff = g_handoff;
+    ZeroMem((UINT8 *)handoff + OFFSET_OF(I915_HANDOFF_TABLE, Active),
+            sizeof(*handoff) - OFFSET_OF(I915_HANDOFF_TABLE, Active));
+    if (!active)
+    {
+        return;
+    }
+    i915ReadHwState(controller, &state);
+    handoff->Pipe = 0;
+    handoff->TranscoderBase = controller->OutputPath.ConType == eDP ? HTOTAL_EDP : HTOTAL_A;
+    handoff->Port = controller->OutputPath.Port;
+    handoff->ConType = controller->OutputPath.ConType;
+    handoff->Dpll = state.Dpll;
+    handoff->DpllCtrl1 = state.DpllCtrl1;
+    handoff->DpllCfgcr1 = state.DpllCfgcr1;
+    handoff->DpllCfgcr2 = state.DpllCfgcr2;
+    handoff->PortClock = state.PortClock;
+    handoff->DotClock = state.DotClock;
+    handoff->LaneCount = state.LaneCount;
+    handoff->DdiFunc = state.DdiFunc;
+    handoff->PipeConf = state.PipeConf;
+    handoff->HTotal = state.HTotal;
+    handoff->HBlank = state.HBlank;
+    handoff->HSync = state.HSync;
+    handoff->VTotal = state.VTotal;
+    handoff->VBlank = state.VBlank;
+    handoff->VSync = state.VSync;
+    handoff->PipeSrc = state.PipeSrc;
+    handoff->LinkM = state.LinkM;
+    handoff->LinkN = state.LinkN;
+    handoff->PlaneCtl = state.PlaneCtl;
+    handoff->PlaneSurface = state.PlaneSurf;
+    handoff->PlaneStride = (state.PlaneStride & I915_HANDOFF_STRIDE_MASK) * I915_HANDOFF_STRIDE_UNIT;
+    handoff->PlaneWidth = (state.PlaneSize & I915_HANDOFF_SIZE_MASK) + 1;
+    handoff->PlaneHeight = ((state.PlaneSize >> 16) & I915_HANDOFF_SIZE_MASK) + 1;
+    handoff->FramebufferBase = controller->FbBase;
+    handoff->FramebufferSize = controller->fbsize;
+    //written last, a reader that sees it set sees the rest
+    handoff->Active = 1;
+    PRINT_DEBUG(EFI_D_ERROR, "handoff: pipe A on port %c, DPLL %d at %u kHz, %u lanes, plane %ux%u at %08x\n",
+                'A' + handoff->Port, handoff->Dpll, handoff->PortClock, handoff->LaneCount,
+                handoff->PlaneWidth, handoff->PlaneHeight, handoff->PlaneSurface);
+#endif
+}
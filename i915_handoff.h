@@ -0,0 +1,55 @@
+#ifndef i915_HANDOFFH
+#define i915_HANDOFFH
+#include <Uefi.h>
+#include "i915_controller.h"
+
+#define I915_HANDOFF_SIGNATURE SIGNATURE_32('I', 'H', 'N', 'D')
+//bumped whenever I915_HANDOFF_TABLE changes
+#define I915_HANDOFF_VERSION 1
+
+#pragma pack(1)
+//The display state the driver left for the OS, published as a configuration
+//table under gI915HandoffTableGuid. The fields are what the guest i915
+//reads back from the registers for its initial state, so a driver that finds
+//a matching pipe can take it over instead of doing its first modeset. The
+//table stays in reserved memory and is rewritten on every mode set.
+typedef struct
+{
+    UINT32 Signature;
+    UINT32 Length;
+    UINT32 Version;
+    UINT32 Active;         //0 while no pipe runs, the rest is then stale
+    UINT32 Pipe;           //0 = pipe A
+    UINT32 TranscoderBase; //MMIO offset of the transcoder, HTOTAL_A or HTOTAL_EDP
+    UINT32 Port;           //DDI port, 0 = A
+    UINT32 ConType;        //ConnectorType of the output
+    INT32 Dpll;            //DPLL the port clock comes from, -1 if the clock is off
+    UINT32 DpllCtrl1;      //the DPLL's six bits of DPLL_CTRL1
+    UINT32 DpllCfgcr1;
+    UINT32 DpllCfgcr2;
+    UINT32 PortClock;      //kHz, the DP link rate or the HDMI TMDS clock
+    UINT32 DotClock;       //kHz
+    UINT32 LaneCount;      //DP lanes, 0 for HDMI and DVI
+    UINT32 DdiFunc;        //TRANS_DDI_FUNC_CTL
+    UINT32 PipeConf;
+    UINT32 HTotal;
+    UINT32 HBlank;
+    UINT32 HSync;
+    UINT32 VTotal;
+    UINT32 VBlank;
+    UINT32 VSync;
+    UINT32 PipeSrc;
+    UINT32 LinkM;
+    UINT32 LinkN;
+    UINT32 PlaneCtl;
+    UINT32 PlaneSurface;   //GGTT offset the plane scans out of
+    UINT32 PlaneStride;    //bytes
+    UINT32 PlaneWidth;
+    UINT32 PlaneHeight;
+    UINT64 FramebufferBase; //CPU address of the surface through the aperture
+    UINT64 FramebufferSize;
+} I915_HANDOFF_TABLE;
+#pragma pack()
+
+VOID i915HandoffUpdate(i915_CONTROLLER *controller, BOOLEAN active);
+#endif
@@ -1,3 +1,4 @@
+#define I915_LOG_CATEGORY I915_LOG_HDMI
 #include "i915_controller.h"
 #include "i915_debug.h"
 #include "i915_gmbus.h"
@@ -5,6 +6,7 @@
 #include "i915_dp.h"
 #include "i915_hdmi.h"
 #include "i915_reg.h"
+#include "i915_wait.h"
 #include <Uefi.h>
 #include <Library/UefiBootServicesTableLib.h>
 
@@ -41,7 +43,7 @@ INT32 intel_hdmi_link_required(int pixel_clock, int bpp)
     /* pixel_clock is in kHz, divide bpp by 8 for bit to Byte conversion */
     return DIV_ROUND_UP(pixel_clock * bpp, 8);
 }
-static BOOLEAN intel_hdmi_valid_link_rate(UINT32 pixelClock)
+BOOLEAN intel_hdmi_valid_link_rate(UINT32 pixelClock)
 {
     /* const struct drm_display_mode *fixed_mode =
 		intel_dp->attached_connector->panel.fixed_mode; */
@@ -55,145 +57,49 @@ static BOOLEAN intel_hdmi_valid_link_rate(UINT32 pixelClock)
 
     return TRUE;
 }
-EFI_STATUS ConvertFallbackEDIDToHDMIEDID(EDID *result, i915_CONTROLLER *controller, UINT8 *fallback)
+//Makes DETAIL_TIME_SELCTION a detailed timing HDMI can carry, one at half
+//its clock if none fits as it is.
+VOID intel_hdmi_select_timing(EDID *result)
 {
-    UINT32 i = 0;
-
-    // it's an INTEL GPU, there's no way we could be big endian
-    for (i = 0; i < 128; i++)
+    if (intel_hdmi_valid_link_rate(result->detailTimings[DETAIL_TIME_SELCTION].pixelClock))
     {
-        ((UINT8 *)result)[i] = fallback[i];
+        return;
     }
-    UINT32 *p = (UINT32 *)result;
-    // try all the pins on GMBUS
+    for (int j = 0; j < 4; j++)
     {
-        // gmbusWait(controller,GMBUS_HW_WAIT_PHASE);
-
-        for (UINT32 i = 0; i < 16; i++)
+        if (result->detailTimings[j].pixelClock > 0 && intel_hdmi_valid_link_rate(result->detailTimings[j].pixelClock))
         {
-            for (UINT32 j = 0; j < 8; j++)
-            {
-                DebugPrint(EFI_D_ERROR, "%02x ", ((UINT8 *)(p))[i * 8 + j]);
-            }
-            DebugPrint(EFI_D_ERROR, "\n");
+            result->detailTimings[DETAIL_TIME_SELCTION] = result->detailTimings[j];
+            return;
         }
-        if (i >= 128 && *(UINT64 *)result->magic == 0x00FFFFFFFFFFFF00uLL)
-        {
-            if (!intel_hdmi_valid_link_rate(result->detailTimings[DETAIL_TIME_SELCTION].pixelClock))
-            {
-                for (int j = 0; j < 4; j++)
-                {
-                    if (result->detailTimings[j].pixelClock > 0 && intel_hdmi_valid_link_rate(result->detailTimings[j].pixelClock))
-                    {
-                        result->detailTimings[DETAIL_TIME_SELCTION] = result->detailTimings[j];
-                        return EFI_SUCCESS;
-                    }
-                }
-                PRINT_DEBUG(EFI_D_ERROR, "pixelClock: %d\n", result->detailTimings[DETAIL_TIME_SELCTION].pixelClock);
+    }
+    PRINT_DEBUG(EFI_D_ERROR, "pixelClock: %d\n", result->detailTimings[DETAIL_TIME_SELCTION].pixelClock);
 
-                for (int j = 0; j < 4; j++)
-                {
-                    if (result->detailTimings[j].pixelClock >> 1 > 0 && intel_hdmi_valid_link_rate(result->detailTimings[j].pixelClock >> 1))
-                    {
-                        result->detailTimings[j].pixelClock = result->detailTimings[j].pixelClock >> 1;
-                        result->detailTimings[DETAIL_TIME_SELCTION] = result->detailTimings[j];
-                        return EFI_SUCCESS;
-                    }
-                }
-                PRINT_DEBUG(EFI_D_ERROR, "pixelClock: %d\n", result->detailTimings[DETAIL_TIME_SELCTION].pixelClock);
-            }
-            // if (result->detailTimings[DETAIL_TIME_SELCTION].pixelClock > 3) {
-            //     result->detailTimings[DETAIL_TIME_SELCTION].pixelClock >> 1;
-            // }
-            return EFI_SUCCESS;
+    for (int j = 0; j < 4; j++)
+    {
+        if (result->detailTimings[j].pixelClock >> 1 > 0 && intel_hdmi_valid_link_rate(result->detailTimings[j].pixelClock >> 1))
+        {
+            result->detailTimings[j].pixelClock = result->detailTimings[j].pixelClock >> 1;
+            result->detailTimings[DETAIL_TIME_SELCTION] = result->detailTimings[j];
+            return;
         }
     }
-    return EFI_NOT_FOUND;
+    PRINT_DEBUG(EFI_D_ERROR, "pixelClock: %d\n", result->detailTimings[DETAIL_TIME_SELCTION].pixelClock);
 }
-EFI_STATUS ReadEDIDHDMI(EDID *result, i915_CONTROLLER *controller, UINT8 pin)
+EFI_STATUS ConvertFallbackEDIDToHDMIEDID(EDID *result, i915_CONTROLLER *controller, UINT8 *fallback)
 {
     // it's an INTEL GPU, there's no way we could be big endian
-    UINT32 *p = (UINT32 *)result;
-    // try all the pins on GMBUS
+    for (UINT32 i = 0; i < 128; i++)
     {
-        PRINT_DEBUG(EFI_D_ERROR, "trying pin %d\n", pin);
-        controller->write32(gmbusSelect, pin);
-        if (EFI_ERROR(gmbusWait(controller, GMBUS_HW_RDY)))
-        {
-
-            return EFI_NOT_FOUND;
-        }
-        // set read offset: i2cWrite(0x50, &offset, 1);
-        controller->write32(gmbusData, 0);
-        controller->write32(gmbusCommand, (0x50 << GMBUS_SLAVE_ADDR_SHIFT) |
-                                              (1 << GMBUS_BYTE_COUNT_SHIFT) |
-                                              GMBUS_SLAVE_WRITE | GMBUS_CYCLE_WAIT |
-                                              GMBUS_SW_RDY);
-        // gmbusWait(controller,GMBUS_HW_WAIT_PHASE);
-        gmbusWait(controller, GMBUS_HW_RDY);
-        PRINT_DEBUG(EFI_D_ERROR, "trying pin %d\n", pin);
-
-        // read the edid: i2cRead(0x50, &edid, 128);
-        // note that we could fail here!
-        controller->write32(gmbusCommand, (0x50 << GMBUS_SLAVE_ADDR_SHIFT) |
-                                              (128 << GMBUS_BYTE_COUNT_SHIFT) |
-                                              GMBUS_SLAVE_READ | GMBUS_CYCLE_WAIT |
-                                              GMBUS_SW_RDY);
-        UINT32 i = 0;
-        for (i = 0; i < 128; i += 4)
-        {
-            if (EFI_ERROR(gmbusWait(controller, GMBUS_HW_RDY)))
-            {
-                PRINT_DEBUG(EFI_D_ERROR, "trying pin %d\n", pin);
-
-                break;
-            }
-            p[i >> 2] = controller->read32(gmbusData);
-        }
-        // gmbusWait(controller,GMBUS_HW_WAIT_PHASE);
-        gmbusWait(controller, GMBUS_HW_RDY);
-        PRINT_DEBUG(EFI_D_ERROR, "trying pin %d\n", pin);
-
-        for (UINT32 i = 0; i < 16; i++)
-        {
-            for (UINT32 j = 0; j < 8; j++)
-            {
-                DebugPrint(EFI_D_ERROR, "%02x ", ((UINT8 *)(p))[i * 8 + j]);
-            }
-            DebugPrint(EFI_D_ERROR, "\n");
-        }
-        if (i >= 128 && *(UINT64 *)result->magic == 0x00FFFFFFFFFFFF00uLL)
-        {
-            if (!intel_hdmi_valid_link_rate(result->detailTimings[DETAIL_TIME_SELCTION].pixelClock))
-            {
-                for (int j = 0; j < 4; j++)
-                {
-                    if (result->detailTimings[j].pixelClock > 0 && intel_hdmi_valid_link_rate(result->detailTimings[j].pixelClock))
-                    {
-                        result->detailTimings[DETAIL_TIME_SELCTION] = result->detailTimings[j];
-                        return EFI_SUCCESS;
-                    }
-                }
-                PRINT_DEBUG(EFI_D_ERROR, "pixelClock: %d\n", result->detailTimings[DETAIL_TIME_SELCTION].pixelClock);
-
-                for (int j = 0; j < 4; j++)
-                {
-                    if (result->detailTimings[j].pixelClock >> 1 > 0 && intel_hdmi_valid_link_rate(result->detailTimings[j].pixelClock >> 1))
-                    {
-                        result->detailTimings[j].pixelClock = result->detailTimings[j].pixelClock >> 1;
-                        result->detailTimings[DETAIL_TIME_SELCTION] = result->detailTimings[j];
-                        return EFI_SUCCESS;
-                    }
-                }
-                PRINT_DEBUG(EFI_D_ERROR, "pixelClock: %d\n", result->detailTimings[DETAIL_TIME_SELCTION].pixelClock);
-            }
-            // if (result->detailTimings[DETAIL_TIME_SELCTION].pixelClock > 3) {
-            //     result->detailTimings[DETAIL_TIME_SELCTION].pixelClock >> 1;
-            // }
-            return EFI_SUCCESS;
-        }
+        ((UINT8 *)result)[i] = fallback[i];
     }
-    return EFI_NOT_FOUND;
+    i915LogHexDump(I915_LOG_CATEGORY, result, 128);
+    if (*(UINT64 *)result->magic != 0x00FFFFFFFFFFFF00uLL)
+    {
+        return EFI_NOT_FOUND;
+    }
+    intel_hdmi_select_timing(result);
+    return EFI_SUCCESS;
 }
 static void skl_wrpll_get_multipliers(UINT64 p,
                                       UINT64 *p0 /* out */,
@@ -387,7 +293,7 @@ EFI_STATUS SetupClockHDMI(i915_CONTROLLER *controller)
 
     {
         //clock in Hz
-        UINT64 clock = (UINT64)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].pixelClock) * 10000;
+        UINT64 clock = (UINT64)(controller->mode.timing.pixelClock) * 10000;
         UINT64 afe_clock = clock * 5; /* AFE Clock is 5x Pixel clock */
         UINT64 dco_central_freq[3] = {8400000000ULL, 9000000000ULL, 9600000000ULL};
 
@@ -460,7 +366,7 @@ EFI_STATUS SetupClockHDMI(i915_CONTROLLER *controller)
 
     //it's clock id!
     //how's port clock comptued?
-    //UINT64 clock_khz=(UINT64)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].pixelClock)*10;
+    //UINT64 clock_khz=(UINT64)(controller->mode.timing.pixelClock)*10;
     //UINT32 id=DPLL_CTRL1_LINK_RATE_810;
     //if(clock_khz>>1 >=135000){
     //	id=DPLL_CTRL1_LINK_RATE_1350;
@@ -492,19 +398,14 @@ EFI_STATUS SetupClockHDMI(i915_CONTROLLER *controller)
     /* the enable bit is always bit 31 */
     controller->write32(LCPLL2_CTL, controller->read32(LCPLL2_CTL) | LCPLL_PLL_ENABLE);
 
-    for (UINT32 counter = 0;; counter++)
+    if (i915WaitForRegister(controller, I915_WAIT_DPLL, DPLL_STATUS, DPLL_LOCK(1),
+                            DPLL_LOCK(1), 5000, NULL) == EFI_SUCCESS)
     {
-        if (controller->read32(DPLL_STATUS) & DPLL_LOCK(1))
-        {
-            PRINT_DEBUG(EFI_D_ERROR, "DPLL %d locked\n", 1);
-            break;
-        }
-        if (counter > 500)
-        {
-            PRINT_DEBUG(EFI_D_ERROR, "DPLL %d not locked\n", 1);
-            break;
-        }
-        gBS->Stall(10);
+        PRINT_DEBUG(EFI_D_ERROR, "DPLL %d locked\n", 1);
+    }
+    else
+    {
+        PRINT_ERROR("DPLL %d not locked\n", 1);
     }
 
     //intel_encoders_pre_enable(crtc, pipe_config, old_state);
@@ -532,26 +433,26 @@ EFI_STATUS SetupClockHDMI(i915_CONTROLLER *controller)
 }
 EFI_STATUS SetupTranscoderAndPipeHDMI(i915_CONTROLLER *controller)
 {
-    UINT32 horz_active = controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzActive |
-                         ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzActiveBlankMsb >> 4) << 8);
-    UINT32 horz_blank = controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzBlank |
-                        ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzActiveBlankMsb & 0xF) << 8);
-    UINT32 horz_sync_offset = controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzSyncOffset | ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].syncMsb >> 6) << 8);
-    UINT32 horz_sync_pulse = controller->edid.detailTimings[DETAIL_TIME_SELCTION].horzSyncPulse |
-                             (((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].syncMsb >> 4) & 0x3) << 8);
+    UINT32 horz_active = controller->mode.timing.horzActive |
+                         ((UINT32)(controller->mode.timing.horzActiveBlankMsb >> 4) << 8);
+    UINT32 horz_blank = controller->mode.timing.horzBlank |
+                        ((UINT32)(controller->mode.timing.horzActiveBlankMsb & 0xF) << 8);
+    UINT32 horz_sync_offset = controller->mode.timing.horzSyncOffset | ((UINT32)(controller->mode.timing.syncMsb >> 6) << 8);
+    UINT32 horz_sync_pulse = controller->mode.timing.horzSyncPulse |
+                             (((UINT32)(controller->mode.timing.syncMsb >> 4) & 0x3) << 8);
 
     UINT32 horizontal_active = horz_active;
     UINT32 horizontal_syncStart = horz_active + horz_sync_offset;
     UINT32 horizontal_syncEnd = horz_active + horz_sync_offset + horz_sync_pulse;
     UINT32 horizontal_total = horz_active + horz_blank;
 
-    UINT32 vert_active = controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertActive |
-                         ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertActiveBlankMsb >> 4) << 8);
-    UINT32 vert_blank = controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertBlank |
-                        ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertActiveBlankMsb & 0xF) << 8);
-    UINT32 vert_sync_offset = (controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertSync >> 4) | (((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].syncMsb >> 2) & 0x3)
+    UINT32 vert_active = controller->mode.timing.vertActive |
+                         ((UINT32)(controller->mode.timing.vertActiveBlankMsb >> 4) << 8);
+    UINT32 vert_blank = controller->mode.timing.vertBlank |
+                        ((UINT32)(controller->mode.timing.vertActiveBlankMsb & 0xF) << 8);
+    UINT32 vert_sync_offset = (controller->mode.timing.vertSync >> 4) | (((UINT32)(controller->mode.timing.syncMsb >> 2) & 0x3)
                                                                                                       << 4);
-    UINT32 vert_sync_pulse = (controller->edid.detailTimings[DETAIL_TIME_SELCTION].vertSync & 0xF) | ((UINT32)(controller->edid.detailTimings[DETAIL_TIME_SELCTION].syncMsb & 0x3) << 4);
+    UINT32 vert_sync_pulse = (controller->mode.timing.vertSync & 0xF) | ((UINT32)(controller->mode.timing.syncMsb & 0x3) << 4);
 
     UINT32 vertical_active = vert_active;
     UINT32 vertical_syncStart = vert_active + vert_sync_offset;
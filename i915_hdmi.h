@@ -66,6 +66,7 @@ struct skl_wrpll_context
 };
 EFI_STATUS SetupClockHDMI(i915_CONTROLLER *controller);
 EFI_STATUS SetupTranscoderAndPipeHDMI(i915_CONTROLLER *controller);
-EFI_STATUS ReadEDIDHDMI(EDID *result, i915_CONTROLLER *controller, UINT8 pin);
+VOID intel_hdmi_select_timing(EDID *result);
 EFI_STATUS ConvertFallbackEDIDToHDMIEDID(EDID *result, i915_CONTROLLER *controller, UINT8 *fallback);
+BOOLEAN intel_hdmi_valid_link_rate(UINT32 pixelClock);
 #endif
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include "i915_debug.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+//level of the padding entry that fills the end of the ring before a wrap
+#define I915_LOG_PAD 0xFF
+
+#if I915_LOG_DEFERRED
+STATIC I915_LOG_RING *g_log = NULL;
+
+STATIC CONST CHAR8 *CONST g_log_category_names[I915_LOG_CATEGORY_COUNT] = {
+    "", "[driver] ", "[display] ", "[dp] ", "[hdmi] ", "[gop] ", "[vbt] ",
+};
+
+STATIC I915_LOG_ENTRY *i915LogEntryAt(UINT32 position)
+{
+    return (I915_LOG_ENTRY *)((UINT8 *)(g_log + 1) + position % g_log->Size);
+}
+
+//Reserves room for the entry with a compare and swap on Head, so a message
+//logged from an event callback that interrupts another one gets its own
+//slot. If the entry would run past the end of the ring, the rest of the ring
+//is reserved along with it and marked as padding.
+STATIC VOID i915LogAppend(I915_LOG_LEVEL level, I915_LOG_CATEGORY_ID category,
+                          CONST CHAR8 *text, UINTN textLength)
+{
+    UINT32 length = ALIGN_VALUE(sizeof(I915_LOG_ENTRY) + textLength + 1, 8);
+    UINT32 head, pad;
+    I915_LOG_ENTRY *entry;
+
+    do
+    {
+        head = g_log->Head;
+        pad = g_log->Size - head % g_log->Size;
+        if (pad >= length)
+        {
+            pad = 0;
+        }
+    } while (InterlockedCompareExchange32((UINT32 *)&g_log->Head, head, head + pad + length) != head);
+
+    if (pad != 0)
+    {
+        entry = i915LogEntryAt(head);
+        entry->Length = (UINT16)pad;
+        entry->Level = I915_LOG_PAD;
+        entry->Category = 0;
+        MemoryFence();
+        entry->Position = head;
+        head += pad;
+    }
+    entry = i915LogEntryAt(head);
+    entry->Length = (UINT16)length;
+    entry->Level = (UINT8)level;
+    entry->Category = (UINT8)category;
+    CopyMem(entry + 1, text, textLength + 1);
+    MemoryFence();
+    entry->Position = head;
+}
+
+STATIC VOID EFIAPI i915LogFlushEvent(IN EFI_EVENT Event, IN VOID *Context)
+{
+    i915LogFlush();
+}
+#endif
+
+EFI_STATUS i915LogInit(VOID)
+{
+#if I915_LOG_DEFERRED
+    EFI_EVENT Event;
+    EFI_STATUS Status;
+    I915_LOG_RING *ring;
+
+    if (g_log != NULL)
+    {
+        return EFI_SUCCESS;
+    }
+    ring = AllocateReservedZeroPool(sizeof(*ring) + I915_LOG_RING_SIZE);
+    if (ring == NULL)
+    {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    ring->Signature = I915_LOG_SIGNATURE;
+    ring->Size = I915_LOG_RING_SIZE;
+    g_log = ring;
+    Status = gBS->InstallConfigurationTable(&gI915LogRingGuid, ring);
+    if (EFI_ERROR(Status))
+    {
+        PRINT_ERROR("log ring not published: %r\n", Status);
+    }
+    Status = EfiCreateEventReadyToBootEx(TPL_CALLBACK, i915LogFlushEvent, NULL, &Event);
+    if (EFI_ERROR(Status))
+    {
+        PRINT_ERROR("log ring is not flushed at ReadyToBoot: %r\n", Status);
+    }
+    return EFI_SUCCESS;
+#else
+    return EFI_UNSUPPORTED;
+#endif
+}
+
+//Formats one message. Errors also go to the debug port at once, everything
+//goes into the ring once it exists.
+VOID i915LogPrint(I915_LOG_LEVEL level, I915_LOG_CATEGORY_ID category, CONST CHAR8 *func,
+                  UINTN line, CONST CHAR8 *format, ...)
+{
+    CHAR8 text[I915_LOG_LINE];
+    UINTN length = 0;
+    VA_LIST args;
+
+    if (func != NULL)
+    {
+        length = AsciiSPrint(text, sizeof(text), "i915 Message: %a(%u)", func, (UINT32)line);
+    }
+    VA_START(args, format);
+    length += AsciiVSPrint(text + length, sizeof(text) - length, format, args);
+    VA_END(args);
+#if I915_LOG_DEFERRED
+    if (g_log != NULL)
+    {
+        i915LogAppend(level, category, text, length);
+        if (level != I915_LOG_ERROR)
+        {
+            return;
+        }
+    }
+#endif
+    DebugPrint(EFI_D_ERROR, "%a", text);
+}
+
+//Logs size bytes as hex, 16 to a line, at the verbose level.
+VOID i915LogHexDump(I915_LOG_CATEGORY_ID category, CONST VOID *data, UINTN size)
+{
+    CONST UINT8 *bytes = data;
+    CHAR8 line[16 * 3 + 2];
+
+    for (UINTN i = 0; i < size; i += 16)
+    {
+        UINTN length = 0;
+
+        for (UINTN j = i; j < size && j < i + 16; j++)
+        {
+            length += AsciiSPrint(line + length, sizeof(line) - length, "%02x ", bytes[j]);
+        }
+        line[length] = '\n';
+        line[length + 1] = '\0';
+        i915LogPrint(I915_LOG_VERBOSE, category, NULL, 0, "%a", line);
+    }
+}
+
+//Writes what the ring gathered since the last flush to the debug port, up to
+//I915_LOG_FLUSH_LEVEL. Errors were printed when they happened. Messages the
+//ring already overwrote are lost, the flush says how many bytes that was.
+VOID i915LogFlush(VOID)
+{
+#if I915_LOG_DEFERRED
+    UINT32 head, position, oldest;
+
+    if (g_log == NULL)
+    {
+        return;
+    }
+    head = g_log->Head;
+    oldest = head > g_log->Size ? head - g_log->Size : 0;
+    position = MAX(g_log->Flushed, oldest);
+    if (position > g_log->Flushed)
+    {
+        DebugPrint(EFI_D_ERROR, "i915: %u bytes of log overwritten\n", position - g_log->Flushed);
+    }
+    position = ALIGN_VALUE(position, 8);
+    while (position < head)
+    {
+        I915_LOG_ENTRY *entry = i915LogEntryAt(position);
+
+        if (entry->Position != position || entry->Length < sizeof(*entry) ||
+            position + entry->Length > head)
+        {
+            //the middle of an entry that was partly overwritten, or one still
+            //being written
+            position += 8;
+            continue;
+        }
+        if (entry->Level != I915_LOG_PAD && entry->Level != I915_LOG_ERROR &&
+            entry->Level <= I915_LOG_FLUSH_LEVEL && entry->Category < I915_LOG_CATEGORY_COUNT)
+        {
+            DebugPrint(EFI_D_ERROR, "%a%a", g_log_category_names[entry->Category],
+                       (CONST CHAR8 *)(entry + 1));
+        }
+        position += entry->Length;
+    }
+    g_log->Flushed = head;
+#endif
+}
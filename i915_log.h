@@ -0,0 +1,59 @@
+#ifndef i915_LOGH
+#define i915_LOGH
+#include <Uefi.h>
+#include "i915_reg.h"
+
+typedef enum
+{
+    I915_LOG_ERROR,   //printed at once and kept in the ring
+    I915_LOG_INFO,    //PRINT_DEBUG
+    I915_LOG_VERBOSE, //register and EDID dumps
+} I915_LOG_LEVEL;
+
+typedef enum
+{
+    I915_LOG_GENERAL,
+    I915_LOG_DRIVER,
+    I915_LOG_DISPLAY,
+    I915_LOG_DP,
+    I915_LOG_HDMI,
+    I915_LOG_GOP,
+    I915_LOG_VBT,
+    I915_LOG_CATEGORY_COUNT
+} I915_LOG_CATEGORY_ID;
+
+//longest message, longer ones are cut
+#define I915_LOG_LINE 256
+#define I915_LOG_SIGNATURE SIGNATURE_32('I', 'L', 'O', 'G')
+
+//Header of the ring, the entries follow it. Head counts every byte ever
+//reserved, an entry lives at Head % Size. Published as a configuration table
+//under gI915LogRingGuid in reserved memory, so it can be dumped from the
+//shell or the OS.
+typedef struct
+{
+    UINT32 Signature;
+    UINT32 Size;
+    volatile UINT32 Head;
+    UINT32 Flushed;
+} I915_LOG_RING;
+
+//Entries are 8 byte aligned and carry their own position, which is only
+//written once the text is in place. A reader that finds an entry whose
+//Position does not match where it sits is looking at an entry being written
+//or at an older one already overwritten.
+typedef struct
+{
+    UINT32 Position;
+    UINT16 Length;
+    UINT8 Level;
+    UINT8 Category;
+    //NUL terminated text follows
+} I915_LOG_ENTRY;
+
+EFI_STATUS i915LogInit(VOID);
+VOID i915LogPrint(I915_LOG_LEVEL level, I915_LOG_CATEGORY_ID category, CONST CHAR8 *func,
+                  UINTN line, CONST CHAR8 *format, ...);
+VOID i915LogHexDump(I915_LOG_CATEGORY_ID category, CONST VOID *data, UINTN size);
+VOID i915LogFlush(VOID);
+#endif
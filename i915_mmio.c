@@ -0,0 +1,328 @@
+#include "i915_mmio.h"
+#include "i915_bench.h"
+#include "i915_debug.h"
+#include "i915_display.h"
+#include "i915_sim.h"
+#include "i915_trace.h"
+#include <IndustryStandard/Acpi.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+STATIC EFI_PCI_IO_PROTOCOL *g_mmio_pci_io = NULL;
+STATIC volatile UINT8 *g_mmio_base = NULL;
+
+STATIC void i915MmioPciIoWrite32(UINT64 reg, UINT32 data)
+{
+    g_mmio_pci_io->Mem.Write(g_mmio_pci_io, EfiPciIoWidthFillUint32,
+                             PCI_BAR_IDX0, reg, 1, &data);
+}
+
+STATIC UINT32 i915MmioPciIoRead32(UINT64 reg)
+{
+    UINT32 data = 0;
+    g_mmio_pci_io->Mem.Read(g_mmio_pci_io, EfiPciIoWidthFillUint32,
+                            PCI_BAR_IDX0, reg, 1, &data);
+    return data;
+}
+
+STATIC UINT64 i915MmioPciIoRead64(UINT64 reg)
+{
+    UINT64 data = 0;
+    g_mmio_pci_io->Mem.Read(g_mmio_pci_io, EfiPciIoWidthFillUint64,
+                            PCI_BAR_IDX0, reg, 1, &data);
+    return data;
+}
+
+//BAR0 is uncached MMIO, so a volatile access is all the ordering the
+//registers need.
+STATIC void i915MmioDirectWrite32(UINT64 reg, UINT32 data)
+{
+    *(volatile UINT32 *)(g_mmio_base + reg) = data;
+}
+
+STATIC UINT32 i915MmioDirectRead32(UINT64 reg)
+{
+    return *(volatile UINT32 *)(g_mmio_base + reg);
+}
+
+STATIC UINT64 i915MmioDirectRead64(UINT64 reg)
+{
+    return *(volatile UINT64 *)(g_mmio_base + reg);
+}
+
+#if I915_MMIO_SHADOW
+//display registers the shadow cache can hold at once
+#define I915_MMIO_SHADOW_REGS 512
+
+typedef struct
+{
+    UINT32 reg; //off by one so that an empty slot is all zero
+    UINT32 value;
+} I915_MMIO_SHADOW_REG;
+
+//Registers with bits the hardware changes or with writes that act even when
+//the value is unchanged. They always go to the device.
+STATIC CONST struct
+{
+    UINT32 first;
+    UINT32 last;
+} g_mmio_volatile[] = {
+    {HSW_PWR_WELL_CTL1, HSW_PWR_WELL_CTL1 + 0xC}, //request and state, all four wells
+    {DBUF_CTL_S2, DBUF_CTL_S2},
+    {DBUF_CTL_S1, DBUF_CTL_S1},
+    {LCPLL1_CTL, LCPLL2_CTL}, //lock bit
+    {DPLL_STATUS, DPLL_STATUS},
+    {_PIPEACONF, _PIPEACONF},
+    {_PIPEBCONF, _PIPEBCONF},
+    {_PIPEBCONF + 0x1000, _PIPEBCONF + 0x1000},
+    {_PIPEEDPCONF, _PIPEEDPCONF},
+    {_DSPASURF, _DSPASURFLIVE}, //a surface write arms the plane update
+    {_DSPASURF + 0x1000, _DSPASURFLIVE + 0x1000},
+    {_DSPASURF + 0x2000, _DSPASURFLIVE + 0x2000},
+    {0x78000, 0x78FFF}, //GVT-g PV info page, kept by the host
+    {GMBUS0, GMBUS0 + 0x20},
+    {PP_STATUS, PP_STATUS},
+};
+
+//The selected backend sits behind these, which keep the last value of every
+//display register the driver wrote or read.
+STATIC void (*g_shadow_write32)(UINT64 reg, UINT32 data);
+STATIC UINT32 (*g_shadow_read32)(UINT64 reg);
+STATIC I915_MMIO_SHADOW_REG g_shadow_regs[I915_MMIO_SHADOW_REGS];
+STATIC UINT64 g_shadow_hits = 0;
+STATIC UINT64 g_shadow_skipped = 0;
+
+STATIC BOOLEAN i915MmioShadowable(UINT64 reg)
+{
+    if (!(reg >= 0x40000 && reg < 0x80000) &&
+        !(reg >= PCH_DISPLAY_BASE && reg < PCH_DISPLAY_BASE + 0x10000))
+    {
+        return FALSE;
+    }
+    //per port: DDI_BUF_CTL with its idle bit, the AUX channel and DP_TP_STATUS
+    if (reg >= _DDI_BUF_CTL_A && reg < _DDI_BUF_CTL_A + 0x500)
+    {
+        UINT32 offset = (UINT32)reg & 0xFF;
+
+        if (offset == 0 || (offset >= 0x10 && offset <= 0x24) || offset == 0x44)
+        {
+            return FALSE;
+        }
+    }
+    for (UINTN i = 0; i < ARRAY_SIZE(g_mmio_volatile); i++)
+    {
+        if (reg >= g_mmio_volatile[i].first && reg <= g_mmio_volatile[i].last)
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+STATIC I915_MMIO_SHADOW_REG *i915MmioShadowLookup(UINT32 reg, BOOLEAN create)
+{
+    UINT32 slot = (reg >> 2) % I915_MMIO_SHADOW_REGS;
+
+    for (UINT32 i = 0; i < I915_MMIO_SHADOW_REGS; i++)
+    {
+        I915_MMIO_SHADOW_REG *entry = &g_shadow_regs[(slot + i) % I915_MMIO_SHADOW_REGS];
+
+        if (entry->reg == reg + 1)
+        {
+            return entry;
+        }
+        if (entry->reg == 0)
+        {
+            if (create)
+            {
+                entry->reg = reg + 1;
+                return entry;
+            }
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+STATIC void i915MmioShadowWrite32(UINT64 reg, UINT32 data)
+{
+    I915_MMIO_SHADOW_REG *entry;
+
+    if (!i915MmioShadowable(reg))
+    {
+        g_shadow_write32(reg, data);
+        //registers in a well that powers up come back with their defaults
+        if ((reg >= HSW_PWR_WELL_CTL1 && reg <= HSW_PWR_WELL_CTL1 + 0xC) ||
+            reg == DBUF_CTL_S1 || reg == DBUF_CTL_S2)
+        {
+            ZeroMem(g_shadow_regs, sizeof(g_shadow_regs));
+        }
+        return;
+    }
+    entry = i915MmioShadowLookup((UINT32)reg, FALSE);
+    if (entry != NULL && entry->value == data)
+    {
+        g_shadow_skipped++;
+        return;
+    }
+    g_shadow_write32(reg, data);
+    if (entry == NULL)
+    {
+        entry = i915MmioShadowLookup((UINT32)reg, TRUE);
+    }
+    if (entry != NULL)
+    {
+        entry->value = data;
+    }
+}
+
+STATIC UINT32 i915MmioShadowRead32(UINT64 reg)
+{
+    I915_MMIO_SHADOW_REG *entry;
+    UINT32 data;
+
+    if (!i915MmioShadowable(reg))
+    {
+        return g_shadow_read32(reg);
+    }
+    entry = i915MmioShadowLookup((UINT32)reg, FALSE);
+    if (entry != NULL)
+    {
+        g_shadow_hits++;
+        return entry->value;
+    }
+    data = g_shadow_read32(reg);
+    entry = i915MmioShadowLookup((UINT32)reg, TRUE);
+    if (entry != NULL)
+    {
+        entry->value = data;
+    }
+    return data;
+}
+#endif
+
+#if I915_BENCH
+//The selected backend sits behind these, which add up the time spent in
+//register I/O.
+STATIC void (*g_raw_write32)(UINT64 reg, UINT32 data);
+STATIC UINT32 (*g_raw_read32)(UINT64 reg);
+STATIC UINT64 (*g_raw_read64)(UINT64 reg);
+STATIC UINT64 g_io_ns = 0;
+STATIC UINT64 g_io_count = 0;
+
+STATIC void i915MmioTimedWrite32(UINT64 reg, UINT32 data)
+{
+    UINT64 start = i915BenchNow();
+    g_raw_write32(reg, data);
+    g_io_ns += i915BenchElapsedNs(start);
+    g_io_count++;
+}
+
+STATIC UINT32 i915MmioTimedRead32(UINT64 reg)
+{
+    UINT64 start = i915BenchNow();
+    UINT32 data = g_raw_read32(reg);
+    g_io_ns += i915BenchElapsedNs(start);
+    g_io_count++;
+    return data;
+}
+
+STATIC UINT64 i915MmioTimedRead64(UINT64 reg)
+{
+    UINT64 start = i915BenchNow();
+    UINT64 data = g_raw_read64(reg);
+    g_io_ns += i915BenchElapsedNs(start);
+    g_io_count++;
+    return data;
+}
+#endif
+
+//Resolves the BAR0 mapping. PciIo hands out the CPU address, the host bridge
+//maps MMIO 1:1 under UEFI.
+STATIC EFI_STATUS i915MmioMapBar0(EFI_PCI_IO_PROTOCOL *PciIo)
+{
+    EFI_ACPI_ADDRESS_SPACE_DESCRIPTOR *desc = NULL;
+    EFI_STATUS Status;
+
+    Status = PciIo->GetBarAttributes(PciIo, PCI_BAR_IDX0, NULL, (VOID **)&desc);
+    if (EFI_ERROR(Status))
+    {
+        return Status;
+    }
+    if (desc->ResType != ACPI_ADDRESS_SPACE_TYPE_MEM || desc->AddrRangeMin == 0)
+    {
+        FreePool(desc);
+        return EFI_UNSUPPORTED;
+    }
+    g_mmio_base = (volatile UINT8 *)(UINTN)desc->AddrRangeMin;
+    FreePool(desc);
+    return EFI_SUCCESS;
+}
+
+//Installs the register accessors on the controller. The direct backend falls
+//back to PciIo if BAR0 cannot be resolved.
+EFI_STATUS i915MmioInit(i915_CONTROLLER *controller, I915_MMIO_BACKEND backend)
+{
+    g_mmio_pci_io = controller->PciIo;
+    controller->write32 = i915MmioPciIoWrite32;
+    controller->read32 = i915MmioPciIoRead32;
+    controller->read64 = i915MmioPciIoRead64;
+    if (backend == I915_MMIO_BACKEND_DIRECT)
+    {
+        EFI_STATUS Status = i915MmioMapBar0(controller->PciIo);
+        if (EFI_ERROR(Status))
+        {
+            PRINT_ERROR("BAR0 not mappable (%u), registers go through PciIo\n", Status);
+        }
+        else
+        {
+            controller->write32 = i915MmioDirectWrite32;
+            controller->read32 = i915MmioDirectRead32;
+            controller->read64 = i915MmioDirectRead64;
+            PRINT_DEBUG(EFI_D_ERROR, "registers mapped at %p\n", g_mmio_base);
+        }
+    }
+    else if (backend == I915_MMIO_BACKEND_SIM)
+    {
+        i915SimReset();
+        controller->write32 = i915SimWrite32;
+        controller->read32 = i915SimRead32;
+        controller->read64 = i915SimRead64;
+    }
+#if I915_MMIO_TRACE
+    i915TraceAttach(controller);
+#endif
+#if I915_MMIO_SHADOW
+    //above the trace, which then only sees what reaches the device
+    g_shadow_write32 = controller->write32;
+    g_shadow_read32 = controller->read32;
+    controller->write32 = i915MmioShadowWrite32;
+    controller->read32 = i915MmioShadowRead32;
+    ZeroMem(g_shadow_regs, sizeof(g_shadow_regs));
+    g_shadow_hits = 0;
+    g_shadow_skipped = 0;
+#endif
+#if I915_BENCH
+    g_raw_write32 = controller->write32;
+    g_raw_read32 = controller->read32;
+    g_raw_read64 = controller->read64;
+    controller->write32 = i915MmioTimedWrite32;
+    controller->read32 = i915MmioTimedRead32;
+    controller->read64 = i915MmioTimedRead64;
+    g_io_ns = 0;
+    g_io_count = 0;
+#endif
+    return EFI_SUCCESS;
+}
+
+VOID i915MmioLogStats(CONST CHAR8 *label)
+{
+#if I915_MMIO_SHADOW
+    PRINT_DEBUG(EFI_D_ERROR, "shadow %a: %lu reads served from the shadow, %lu unchanged writes skipped\n",
+                label, g_shadow_hits, g_shadow_skipped);
+#endif
+#if I915_BENCH
+    PRINT_DEBUG(EFI_D_ERROR, "bench %a: %lu register accesses, %lu us in register I/O, %lu ns each\n",
+                label, g_io_count, g_io_ns / 1000, g_io_count ? g_io_ns / g_io_count : 0);
+#endif
+}
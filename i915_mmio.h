@@ -0,0 +1,15 @@
+#ifndef i915_MMIOH
+#define i915_MMIOH
+#include <Uefi.h>
+#include "i915_controller.h"
+
+typedef enum
+{
+    I915_MMIO_BACKEND_PCI_IO, //PciIo->Mem.Read/Write per register
+    I915_MMIO_BACKEND_DIRECT, //volatile loads and stores into the mapped BAR0
+    I915_MMIO_BACKEND_SIM,    //simulated display registers, see i915_sim.c
+} I915_MMIO_BACKEND;
+
+EFI_STATUS i915MmioInit(i915_CONTROLLER *controller, I915_MMIO_BACKEND backend);
+VOID i915MmioLogStats(CONST CHAR8 *label);
+#endif
@@ -0,0 +1,329 @@
+#define I915_LOG_CATEGORY I915_LOG_DISPLAY
+#include "i915_modes.h"
+#include "i915_display.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+//highest link symbol clock and lane count the DDI can drive (HBR2 x4), all
+//a DP sink whose DPCD could not be read is held to
+#define I915_DP_MAX_LINK_CLOCK 540000
+#define I915_DP_MAX_LANES 4
+
+//data rate the DP link carries at most, see i915BuildModeList
+STATIC INT32 g_dp_max_data_rate;
+
+//VESA DMT timings for the resolutions the standard and established EDID
+//blocks can name. Clocks are in 10 kHz units like the EDID detailed timing,
+//sync holds the polarity bits of the EDID features byte.
+#define I915_DMT_PHSYNC 0x02
+#define I915_DMT_PVSYNC 0x04
+#define I915_DMT_NHSYNC 0
+#define I915_DMT_NVSYNC 0
+
+typedef struct
+{
+    UINT16 width;
+    UINT16 height;
+    UINT16 clock;
+    UINT16 hfp;
+    UINT16 hsync;
+    UINT16 htotal;
+    UINT16 vfp;
+    UINT16 vsync;
+    UINT16 vtotal;
+    UINT8 sync;
+} I915_DMT_TIMING;
+
+STATIC CONST I915_DMT_TIMING g_dmt_timings[] = {
+    {640, 480, 2518, 16, 96, 800, 10, 2, 525, I915_DMT_NHSYNC | I915_DMT_NVSYNC},
+    {800, 600, 4000, 40, 128, 1056, 1, 4, 628, I915_DMT_PHSYNC | I915_DMT_PVSYNC},
+    {1024, 768, 6500, 24, 136, 1344, 3, 6, 806, I915_DMT_NHSYNC | I915_DMT_NVSYNC},
+    {1280, 720, 7425, 110, 40, 1650, 5, 5, 750, I915_DMT_PHSYNC | I915_DMT_PVSYNC},
+    {1280, 800, 7100, 48, 32, 1440, 3, 6, 823, I915_DMT_PHSYNC | I915_DMT_NVSYNC},
+    {1280, 1024, 10800, 48, 112, 1688, 1, 3, 1066, I915_DMT_PHSYNC | I915_DMT_PVSYNC},
+    {1440, 900, 8875, 48, 32, 1600, 3, 6, 926, I915_DMT_PHSYNC | I915_DMT_NVSYNC},
+    {1600, 900, 10800, 24, 80, 1800, 1, 3, 1000, I915_DMT_PHSYNC | I915_DMT_PVSYNC},
+    {1680, 1050, 11900, 48, 32, 1840, 3, 6, 1080, I915_DMT_PHSYNC | I915_DMT_NVSYNC},
+    {1920, 1080, 14850, 88, 44, 2200, 4, 5, 1125, I915_DMT_PHSYNC | I915_DMT_PVSYNC},
+    {1920, 1200, 15400, 48, 32, 2080, 3, 6, 1235, I915_DMT_PHSYNC | I915_DMT_NVSYNC},
+};
+
+//the 60 Hz entries of the established timings bitmap
+STATIC CONST struct
+{
+    UINT8 byte;
+    UINT8 bit;
+    UINT16 width;
+    UINT16 height;
+} g_established_timings[] = {
+    {0, 5, 640, 480},
+    {0, 0, 800, 600},
+    {1, 3, 1024, 768},
+};
+
+UINT32 i915TimingWidth(CONST EDID_DETAILED_TIMING *timing)
+{
+    return timing->horzActive | ((UINT32)(timing->horzActiveBlankMsb >> 4) << 8);
+}
+
+UINT32 i915TimingHeight(CONST EDID_DETAILED_TIMING *timing)
+{
+    return timing->vertActive | ((UINT32)(timing->vertActiveBlankMsb >> 4) << 8);
+}
+
+STATIC CONST I915_DMT_TIMING *i915FindDmtTiming(UINT32 width, UINT32 height)
+{
+    for (UINTN i = 0; i < ARRAY_SIZE(g_dmt_timings); i++)
+    {
+        if (g_dmt_timings[i].width == width && g_dmt_timings[i].height == height)
+        {
+            return &g_dmt_timings[i];
+        }
+    }
+    return NULL;
+}
+
+//Packs a DMT timing the way the EDID detailed timing block stores it, so the
+//transcoder code decodes it like any timing read from the sink.
+STATIC VOID i915TimingFromDmt(CONST I915_DMT_TIMING *dmt, EDID_DETAILED_TIMING *timing)
+{
+    UINT32 hblank = dmt->htotal - dmt->width;
+    UINT32 vblank = dmt->vtotal - dmt->height;
+
+    ZeroMem(timing, sizeof(*timing));
+    timing->pixelClock = dmt->clock;
+    timing->horzActive = (UINT8)dmt->width;
+    timing->horzBlank = (UINT8)hblank;
+    timing->horzActiveBlankMsb = (UINT8)(((dmt->width >> 8) << 4) | ((hblank >> 8) & 0xF));
+    timing->vertActive = (UINT8)dmt->height;
+    timing->vertBlank = (UINT8)vblank;
+    timing->vertActiveBlankMsb = (UINT8)(((dmt->height >> 8) << 4) | ((vblank >> 8) & 0xF));
+    timing->horzSyncOffset = (UINT8)dmt->hfp;
+    timing->horzSyncPulse = (UINT8)dmt->hsync;
+    timing->vertSync = (UINT8)(((dmt->vfp & 0xF) << 4) | (dmt->vsync & 0xF));
+    timing->syncMsb = (UINT8)((((dmt->hfp >> 8) & 0x3) << 6) | (((dmt->hsync >> 8) & 0x3) << 4) |
+                              (((dmt->vfp >> 4) & 0x3) << 2) | ((dmt->vsync >> 4) & 0x3));
+    timing->features = 0x18 | dmt->sync; //digital separate sync
+}
+
+//Whether the connector can carry the timing at 8 bpc.
+STATIC BOOLEAN i915TimingSupported(i915_CONTROLLER *controller, CONST EDID_DETAILED_TIMING *timing)
+{
+    if (timing->pixelClock == 0 || (timing->features & 0x80))
+    {
+        //a display descriptor, or interlaced which the pipe is never set up for
+        return FALSE;
+    }
+    switch (controller->OutputPath.ConType)
+    {
+    case HDMI:
+    case DVI:
+        return intel_hdmi_valid_link_rate(timing->pixelClock);
+    case eDP:
+    case DPSST:
+    case DPMST:
+        return intel_dp_link_required(timing->pixelClock * 10, 24) <= g_dp_max_data_rate;
+    default:
+        return TRUE;
+    }
+}
+
+//The GGTT only backs fbBackingSize bytes of aperture.
+STATIC BOOLEAN i915ModeFits(i915_CONTROLLER *controller, UINT32 width, UINT32 height)
+{
+    return (UINTN)((width * 4 + 63) & -64) * height <= controller->fbBackingSize;
+}
+
+STATIC UINT32 i915AddMode(I915_MODE *modes, UINT32 count, UINT32 maxModes,
+                          CONST EDID_DETAILED_TIMING *timing, UINT32 width, UINT32 height)
+{
+    for (UINT32 i = 0; i < count; i++)
+    {
+        if (modes[i].width == width && modes[i].height == height)
+        {
+            return count;
+        }
+    }
+    if (count >= maxModes || width == 0 || height == 0)
+    {
+        return count;
+    }
+    modes[count].timing = *timing;
+    modes[count].width = width;
+    modes[count].height = height;
+    return count + 1;
+}
+
+//Adds a resolution named by the standard or established timings. A panel only
+//runs its native timing, so on eDP the resolution becomes a window centered in
+//it; external sinks get the DMT timing.
+STATIC UINT32 i915AddListedMode(i915_CONTROLLER *controller, I915_MODE *modes, UINT32 count,
+                                UINT32 maxModes, UINT32 width, UINT32 height)
+{
+    CONST EDID_DETAILED_TIMING *native = &modes[0].timing;
+    CONST I915_DMT_TIMING *dmt;
+    EDID_DETAILED_TIMING timing;
+
+    if (controller->OutputPath.ConType == eDP)
+    {
+        if (width > i915TimingWidth(native) || height > i915TimingHeight(native))
+        {
+            return count;
+        }
+        return i915AddMode(modes, count, maxModes, native, width, height);
+    }
+    dmt = i915FindDmtTiming(width, height);
+    if (dmt == NULL || !i915ModeFits(controller, width, height))
+    {
+        return count;
+    }
+    i915TimingFromDmt(dmt, &timing);
+    if (!i915TimingSupported(controller, &timing))
+    {
+        return count;
+    }
+    return i915AddMode(modes, count, maxModes, &timing, width, height);
+}
+
+//Adds a detailed timing from the base block or a CEA-861 extension.
+STATIC UINT32 i915AddDetailedMode(i915_CONTROLLER *controller, I915_MODE *modes, UINT32 count,
+                                  UINT32 maxModes, CONST EDID_DETAILED_TIMING *timing)
+{
+    UINT32 width = i915TimingWidth(timing);
+    UINT32 height = i915TimingHeight(timing);
+
+    if (!i915TimingSupported(controller, timing) || !i915ModeFits(controller, width, height))
+    {
+        return count;
+    }
+    if (controller->OutputPath.ConType == eDP)
+    {
+        return i915AddListedMode(controller, modes, count, maxModes, width, height);
+    }
+    return i915AddMode(modes, count, maxModes, timing, width, height);
+}
+
+//Builds the GOP mode list from every timing in the EDID. The preferred
+//timing the driver always used comes first and stays mode 0, the rest are
+//sorted largest first. Returns the number of modes, at least one.
+UINT32 i915BuildModeList(i915_CONTROLLER *controller, I915_MODE *modes, UINT32 maxModes)
+{
+    EDID *edid = &controller->edid;
+    CONST EDID_DETAILED_TIMING *native = &edid->detailTimings[DETAIL_TIME_SELCTION];
+    UINT8 established[2] = {edid->estTimings1, edid->estTimings2};
+    UINT32 count = 0;
+    INT32 sinkRate;
+
+    //the sink's DPCD caps the rate and lanes training can pick
+    g_dp_max_data_rate = intel_dp_max_data_rate(I915_DP_MAX_LINK_CLOCK, I915_DP_MAX_LANES);
+    if (controller->OutputPath.ConType == eDP || controller->OutputPath.ConType == DPSST ||
+        controller->OutputPath.ConType == DPMST)
+    {
+        sinkRate = intel_dp_sink_max_data_rate(controller);
+        if (sinkRate > 0 && sinkRate < g_dp_max_data_rate)
+        {
+            g_dp_max_data_rate = sinkRate;
+        }
+    }
+
+    modes[0].timing = *native;
+    modes[0].width = i915TimingWidth(native);
+    modes[0].height = i915TimingHeight(native);
+    count = 1;
+
+    for (UINT32 i = 0; i < ARRAY_SIZE(edid->detailTimings); i++)
+    {
+        if (i != DETAIL_TIME_SELCTION)
+        {
+            count = i915AddDetailedMode(controller, modes, count, maxModes, &edid->detailTimings[i]);
+        }
+    }
+
+    //CEA-861 extensions: byte 2 is where the detailed timings start, they run
+    //until a zero clock or the checksum byte
+    for (UINT32 i = 0; i < controller->edidExtensionCount; i++)
+    {
+        CONST UINT8 *block = controller->edidExtensions[i];
+
+        if (block[0] != 0x02 || block[2] < 4 || CalculateSum8(block, 128) != 0)
+        {
+            continue;
+        }
+        for (UINT32 offset = block[2]; offset + sizeof(EDID_DETAILED_TIMING) < 128;
+             offset += sizeof(EDID_DETAILED_TIMING))
+        {
+            CONST EDID_DETAILED_TIMING *timing = (CONST EDID_DETAILED_TIMING *)(block + offset);
+
+            if (timing->pixelClock == 0)
+            {
+                break;
+            }
+            count = i915AddDetailedMode(controller, modes, count, maxModes, timing);
+        }
+    }
+
+    for (UINT32 i = 0; i < ARRAY_SIZE(edid->standardTimings); i++)
+    {
+        UINT8 resolution = edid->standardTimings[i].resolution;
+        UINT8 frequency = edid->standardTimings[i].frequency;
+        UINT32 width, height;
+
+        //unused slots read 01 01, the low six bits are the refresh rate - 60
+        if (resolution == 0 || (resolution == 0x01 && frequency == 0x01) ||
+            (frequency & 0x3F) != 0)
+        {
+            continue;
+        }
+        width = (resolution + 31) * 8;
+        switch (frequency >> 6)
+        {
+        case 0:
+            //16:10 since EDID 1.3, 1:1 before
+            height = edid->structRevision >= 3 ? width * 10 / 16 : width;
+            break;
+        case 1:
+            height = width * 3 / 4;
+            break;
+        case 2:
+            height = width * 4 / 5;
+            break;
+        default:
+            height = width * 9 / 16;
+            break;
+        }
+        count = i915AddListedMode(controller, modes, count, maxModes, width, height);
+    }
+
+    for (UINT32 i = 0; i < ARRAY_SIZE(g_established_timings); i++)
+    {
+        if (established[g_established_timings[i].byte] & (1 << g_established_timings[i].bit))
+        {
+            count = i915AddListedMode(controller, modes, count, maxModes,
+                                      g_established_timings[i].width,
+                                      g_established_timings[i].height);
+        }
+    }
+
+    //insertion sort by area, leaving the native mode in front
+    for (UINT32 i = 2; i < count; i++)
+    {
+        I915_MODE mode = modes[i];
+        UINT32 j = i;
+
+        while (j > 1 && (UINT64)modes[j - 1].width * modes[j - 1].height <
+                            (UINT64)mode.width * mode.height)
+        {
+            modes[j] = modes[j - 1];
+            j--;
+        }
+        modes[j] = mode;
+    }
+
+    for (UINT32 i = 0; i < count; i++)
+    {
+        PRINT_DEBUG(EFI_D_ERROR, "mode %u: %ux%u in %ux%u, clock %u0 kHz\n", i,
+                    modes[i].width, modes[i].height, i915TimingWidth(&modes[i].timing),
+                    i915TimingHeight(&modes[i].timing), modes[i].timing.pixelClock);
+    }
+    return count;
+}
@@ -0,0 +1,11 @@
+#ifndef i915_MODESH
+#define i915_MODESH
+#include <Uefi.h>
+#include "i915_controller.h"
+
+#define I915_MAX_MODES 16
+
+UINT32 i915TimingWidth(CONST EDID_DETAILED_TIMING *timing);
+UINT32 i915TimingHeight(CONST EDID_DETAILED_TIMING *timing);
+UINT32 i915BuildModeList(i915_CONTROLLER *controller, I915_MODE *modes, UINT32 maxModes);
+#endif
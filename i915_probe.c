@@ -0,0 +1,206 @@
+#define I915_LOG_CATEGORY I915_LOG_DISPLAY
+#include "i915_probe.h"
+#include "i915_debug.h"
+#include "i915_dp.h"
+#include "i915_gmbus.h"
+#include "i915_wait.h"
+#include <Library/BaseMemoryLib.h>
+
+//an AUX transaction ends by itself after TIME_OUT_MAX, this only guards
+//against a channel that never clears SEND_BUSY
+#define I915_PROBE_AUX_US 5000
+//one byte and its acknowledge at 100 kHz take about 100 us
+#define I915_PROBE_GMBUS_US 5000
+//the DDC address every EDID answers on
+#define I915_PROBE_DDC_ADDR 0x50
+
+STATIC UINT64 i915ProbeAuxCtl(UINT8 auxCh)
+{
+    return _DPA_AUX_CH_CTL + ((UINT64)auxCh << 8);
+}
+
+//Sends an address-only I2C write to the DDC address. It ends with a stop, so
+//the sink's I2C bus is left idle for the EDID read that may follow.
+STATIC VOID i915ProbeAuxStart(i915_CONTROLLER *controller, UINT8 auxCh)
+{
+    controller->write32(_DPA_AUX_CH_DATA1 + ((UINT64)auxCh << 8),
+                        (AUX_I2C_WRITE << 28) | (I915_PROBE_DDC_ADDR << 8));
+    controller->write32(i915ProbeAuxCtl(auxCh),
+                        DP_AUX_CH_CTL_SEND_BUSY | DP_AUX_CH_CTL_DONE |
+                            DP_AUX_CH_CTL_TIME_OUT_ERROR | DP_AUX_CH_CTL_TIME_OUT_MAX |
+                            DP_AUX_CH_CTL_RECEIVE_ERROR | (3 << DP_AUX_CH_CTL_MESSAGE_SIZE_SHIFT) |
+                            DP_AUX_CH_CTL_FW_SYNC_PULSE_SKL(32) |
+                            DP_AUX_CH_CTL_SYNC_PULSE_SKL(32));
+}
+
+//A sink is there if the transaction got a reply that neither the AUX nor
+//the I2C side NACKed. A DEFER still means someone is listening.
+STATIC BOOLEAN i915ProbeAuxFinish(i915_CONTROLLER *controller, UINT8 auxCh, UINT32 status)
+{
+    UINT32 reply;
+
+    controller->write32(i915ProbeAuxCtl(auxCh), status | DP_AUX_CH_CTL_DONE |
+                                                    DP_AUX_CH_CTL_TIME_OUT_ERROR |
+                                                    DP_AUX_CH_CTL_RECEIVE_ERROR);
+    if ((status & DP_AUX_CH_CTL_SEND_BUSY) || !(status & DP_AUX_CH_CTL_DONE) ||
+        (status & (DP_AUX_CH_CTL_TIME_OUT_ERROR | DP_AUX_CH_CTL_RECEIVE_ERROR)))
+    {
+        return FALSE;
+    }
+    reply = controller->read32(_DPA_AUX_CH_DATA1 + ((UINT64)auxCh << 8)) >> 28;
+    return (reply & (DP_AUX_NATIVE_REPLY_NACK | DP_AUX_I2C_REPLY_NACK)) == 0;
+}
+
+//where a probe stands between two calls of i915ProbeStep
+enum
+{
+    I915_PROBE_START,      //put the AUX transactions on the wire
+    I915_PROBE_GMBUS,      //address the DDC slave on the next pin
+    I915_PROBE_GMBUS_ACK,  //the address is on the bus
+    I915_PROBE_GMBUS_STOP, //the stop is on the bus
+    I915_PROBE_AUX,        //collect the next AUX transaction
+    I915_PROBE_AUX_DONE,   //it has ended
+    I915_PROBE_DONE,
+};
+
+VOID i915ProbeBegin(I915_PROBE *probe, I915_PROBE_CANDIDATE *candidates, UINT32 count)
+{
+    ZeroMem(probe, sizeof(*probe));
+    probe->candidates = candidates;
+    probe->count = MIN(count, (UINT32)I915_PROBE_MAX);
+}
+
+//Finds out which sinks answer on the candidates' AUX channels and DDC pins,
+//up to the next register wait. Returns EFI_NOT_READY with wait armed, the
+//caller polls or completes it and calls again. The AUX transactions are all
+//started first and run on their own while the DDC pins are probed, one
+//after another since GMBUS is a single engine, then they are collected.
+//A DDC pin is probed with a one byte write to the DDC slave that looks for
+//the acknowledge. Once done, probe->found counts the candidates with at
+//least one sink.
+EFI_STATUS i915ProbeStep(i915_CONTROLLER *controller, I915_PROBE *probe, I915_WAIT *wait)
+{
+    I915_PROBE_CANDIDATE *candidates = probe->candidates;
+    BOOLEAN present;
+
+    for (;;)
+    {
+        switch (probe->phase)
+        {
+        case I915_PROBE_START:
+            for (UINT32 i = 0; i < probe->count; i++)
+            {
+                BOOLEAN started = FALSE;
+
+                candidates[i].dpPresent = FALSE;
+                candidates[i].hdmiPresent = FALSE;
+                if (!candidates[i].dp)
+                {
+                    continue;
+                }
+                for (UINT32 j = 0; j < probe->auxCount; j++)
+                {
+                    started |= probe->auxCh[j] == candidates[i].auxCh;
+                }
+                if (!started)
+                {
+                    probe->auxCh[probe->auxCount++] = candidates[i].auxCh;
+                    i915ProbeAuxStart(controller, candidates[i].auxCh);
+                }
+            }
+            probe->phase = I915_PROBE_GMBUS;
+            break;
+        case I915_PROBE_GMBUS:
+            while (probe->index < probe->count && !candidates[probe->index].hdmi)
+            {
+                probe->index++;
+            }
+            if (probe->index == probe->count)
+            {
+                probe->index = 0;
+                probe->phase = I915_PROBE_AUX;
+                break;
+            }
+            controller->write32(gmbusSelect, candidates[probe->index].ddcPin);
+            controller->write32(gmbusData, 0);
+            controller->write32(gmbusCommand, (I915_PROBE_DDC_ADDR << GMBUS_SLAVE_ADDR_SHIFT) |
+                                                  (1 << GMBUS_BYTE_COUNT_SHIFT) |
+                                                  GMBUS_SLAVE_WRITE | GMBUS_CYCLE_WAIT |
+                                                  GMBUS_SW_RDY);
+            i915WaitBeginAny(wait, I915_WAIT_GMBUS, gmbusStatus, GMBUS_HW_WAIT_PHASE | GMBUS_SATOER,
+                             I915_PROBE_GMBUS_US);
+            probe->phase = I915_PROBE_GMBUS_ACK;
+            return EFI_NOT_READY;
+        case I915_PROBE_GMBUS_ACK:
+            present = (wait->lastValue & GMBUS_HW_WAIT_PHASE) && !(wait->lastValue & GMBUS_SATOER);
+            candidates[probe->index].hdmiPresent = present;
+            if (present)
+            {
+                controller->write32(gmbusCommand, GMBUS_CYCLE_STOP | GMBUS_SW_RDY);
+                i915WaitBegin(wait, I915_WAIT_GMBUS, gmbusStatus, GMBUS_ACTIVE, 0, I915_PROBE_GMBUS_US);
+                probe->phase = I915_PROBE_GMBUS_STOP;
+                return EFI_NOT_READY;
+            }
+            //a NAK leaves the engine stuck until the interrupt is cleared
+            controller->write32(gmbusCommand, GMBUS_SW_CLR_INT);
+            controller->write32(gmbusCommand, 0);
+            probe->phase = I915_PROBE_GMBUS_STOP;
+            break;
+        case I915_PROBE_GMBUS_STOP:
+            controller->write32(gmbusSelect, 0);
+            probe->index++;
+            probe->phase = I915_PROBE_GMBUS;
+            break;
+        case I915_PROBE_AUX:
+            if (probe->index == probe->auxCount)
+            {
+                probe->phase = I915_PROBE_DONE;
+                break;
+            }
+            i915WaitBegin(wait, I915_WAIT_AUX, i915ProbeAuxCtl(probe->auxCh[probe->index]),
+                          DP_AUX_CH_CTL_SEND_BUSY, 0, I915_PROBE_AUX_US);
+            probe->phase = I915_PROBE_AUX_DONE;
+            return EFI_NOT_READY;
+        case I915_PROBE_AUX_DONE:
+            present = i915ProbeAuxFinish(controller, probe->auxCh[probe->index], wait->lastValue);
+            for (UINT32 i = 0; i < probe->count; i++)
+            {
+                if (candidates[i].dp && candidates[i].auxCh == probe->auxCh[probe->index])
+                {
+                    candidates[i].dpPresent = present;
+                }
+            }
+            probe->index++;
+            probe->phase = I915_PROBE_AUX;
+            break;
+        default:
+            probe->found = 0;
+            for (UINT32 i = 0; i < probe->count; i++)
+            {
+                PRINT_DEBUG(EFI_D_ERROR, "probe: port %c, DP sink on aux %d: %d, HDMI sink on pin %d: %d\n",
+                            'A' + candidates[i].port, candidates[i].auxCh, candidates[i].dpPresent,
+                            candidates[i].ddcPin, candidates[i].hdmiPresent);
+                if (candidates[i].dpPresent || candidates[i].hdmiPresent)
+                {
+                    probe->found++;
+                }
+            }
+            return EFI_SUCCESS;
+        }
+    }
+}
+
+//Runs a whole probe, see i915ProbeStep. Returns the number of candidates
+//with at least one sink.
+UINT32 i915ProbeConnectors(i915_CONTROLLER *controller, I915_PROBE_CANDIDATE *candidates, UINT32 count)
+{
+    I915_PROBE probe;
+    I915_WAIT wait;
+
+    i915ProbeBegin(&probe, candidates, count);
+    while (i915ProbeStep(controller, &probe, &wait) == EFI_NOT_READY)
+    {
+        i915WaitComplete(controller, &wait);
+    }
+    return probe.found;
+}
@@ -0,0 +1,40 @@
+#ifndef i915_PROBEH
+#define i915_PROBEH
+#include <Uefi.h>
+#include "i915_controller.h"
+#include "i915_wait.h"
+
+//connectors the VBT can list, one per child device
+#define I915_PROBE_MAX 8
+
+//One connector to probe. The caller fills in what the VBT says about the
+//port, i915ProbeConnectors fills in which of its sinks answered.
+typedef struct
+{
+    UINT32 port;
+    BOOLEAN dp;
+    BOOLEAN edp;
+    UINT8 auxCh;
+    BOOLEAN hdmi;
+    UINT8 ddcPin;
+    BOOLEAN dpPresent;
+    BOOLEAN hdmiPresent;
+} I915_PROBE_CANDIDATE;
+
+//A probe of the candidates taken apart at its register waits, see
+//i915ProbeStep.
+typedef struct
+{
+    I915_PROBE_CANDIDATE *candidates;
+    UINT32 count;
+    UINT8 auxCh[I915_PROBE_MAX];
+    UINT32 auxCount;
+    UINT32 index;
+    UINT32 phase;
+    UINT32 found;
+} I915_PROBE;
+
+VOID i915ProbeBegin(I915_PROBE *probe, I915_PROBE_CANDIDATE *candidates, UINT32 count);
+EFI_STATUS i915ProbeStep(i915_CONTROLLER *controller, I915_PROBE *probe, I915_WAIT *wait);
+UINT32 i915ProbeConnectors(i915_CONTROLLER *controller, I915_PROBE_CANDIDATE *candidates, UINT32 count);
+#endif
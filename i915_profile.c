@@ -0,0 +1,98 @@
+#include "i915_profile.h"
+#include "i915_debug.h"
+#include "i915_wait.h"
+#include <Library/BaseLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#if I915_PROFILE
+STATIC I915_PROFILE_TABLE *g_profile = NULL;
+STATIC EFI_HANDLE g_profile_handle = NULL;
+#endif
+
+EFI_STATUS i915ProfileInit(VOID)
+{
+#if I915_PROFILE
+    if (g_profile != NULL)
+    {
+        return EFI_SUCCESS;
+    }
+    g_profile = AllocateReservedZeroPool(sizeof(*g_profile));
+    if (g_profile == NULL)
+    {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    g_profile->Signature = I915_PROFILE_SIGNATURE;
+    g_profile->Length = sizeof(*g_profile);
+    //calibrate now rather than inside the first stage that gets recorded
+    i915TscFrequency();
+    return EFI_SUCCESS;
+#else
+    return EFI_UNSUPPORTED;
+#endif
+}
+
+UINT64 i915ProfileStart(VOID)
+{
+#if I915_PROFILE
+    return g_profile != NULL ? AsmReadTsc() : 0;
+#else
+    return 0;
+#endif
+}
+
+//Appends a record for the stage that began at start, a TSC value from
+//i915ProfileStart. Once the table is full later stages are only counted.
+VOID i915ProfileRecord(CONST CHAR8 *name, UINT64 start)
+{
+#if I915_PROFILE
+    UINT64 now;
+    I915_PROFILE_RECORD *record;
+
+    if (g_profile == NULL)
+    {
+        return;
+    }
+    if (g_profile->Count >= I915_PROFILE_MAX_RECORDS)
+    {
+        g_profile->Dropped++;
+        return;
+    }
+    now = AsmReadTsc();
+    record = &g_profile->Records[g_profile->Count++];
+    record->Type = I915_PROFILE_RECORD_TYPE;
+    record->Length = sizeof(*record);
+    record->Revision = 1;
+    record->StartNs = i915TscToNs(start);
+    record->DurationNs = i915TscToNs(now - start);
+    AsciiStrnCpyS(record->Name, I915_PROFILE_NAME_LENGTH, name, I915_PROFILE_NAME_LENGTH - 1);
+    PRINT_DEBUG(EFI_D_ERROR, "profile %a: %lu us\n", record->Name, record->DurationNs / 1000);
+#endif
+}
+
+//Makes the table reachable from the shell and the OS. Stages recorded later,
+//like modesets from SetMode, still land in the same table.
+EFI_STATUS i915ProfilePublish(VOID)
+{
+#if I915_PROFILE
+    EFI_STATUS Status;
+
+    if (g_profile == NULL || g_profile_handle != NULL)
+    {
+        return EFI_SUCCESS;
+    }
+    Status = gBS->InstallConfigurationTable(&gI915ProfileTableGuid, g_profile);
+    if (EFI_ERROR(Status))
+    {
+        return Status;
+    }
+    Status = gBS->InstallProtocolInterface(&g_profile_handle, &gI915ProfileTableGuid,
+                                           EFI_NATIVE_INTERFACE, g_profile);
+    if (EFI_ERROR(Status))
+    {
+        return Status;
+    }
+    PRINT_DEBUG(EFI_D_ERROR, "profile table at %p, %u records\n", g_profile, g_profile->Count);
+#endif
+    return EFI_SUCCESS;
+}
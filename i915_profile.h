@@ -0,0 +1,52 @@
+#ifndef i915_PROFILEH
+#define i915_PROFILEH
+#include <Uefi.h>
+#include "i915_reg.h"
+
+#define I915_PROFILE_MAX_RECORDS 64
+#define I915_PROFILE_NAME_LENGTH 32
+#define I915_PROFILE_SIGNATURE SIGNATURE_32('I', 'P', 'R', 'F')
+//record type in the FPDT range reserved for platform firmware
+#define I915_PROFILE_RECORD_TYPE 0x3000
+
+#pragma pack(1)
+//Laid out like an FPDT performance record so the same tools can walk it.
+//Times are ns of the TSC, which runs from reset.
+typedef struct
+{
+    UINT16 Type;
+    UINT8 Length;
+    UINT8 Revision;
+    UINT32 Reserved;
+    UINT64 StartNs;
+    UINT64 DurationNs;
+    CHAR8 Name[I915_PROFILE_NAME_LENGTH];
+} I915_PROFILE_RECORD;
+
+//Published as a configuration table and as a protocol on a handle of its
+//own, both under gI915ProfileTableGuid. It lives in reserved memory so the OS
+//can still read it.
+typedef struct
+{
+    UINT32 Signature;
+    UINT32 Length;
+    UINT32 Count;
+    UINT32 Dropped;
+    I915_PROFILE_RECORD Records[I915_PROFILE_MAX_RECORDS];
+} I915_PROFILE_TABLE;
+#pragma pack()
+
+EFI_STATUS i915ProfileInit(VOID);
+UINT64 i915ProfileStart(VOID);
+VOID i915ProfileRecord(CONST CHAR8 *name, UINT64 start);
+EFI_STATUS i915ProfilePublish(VOID);
+
+//status = fn(...), recorded under the function's name
+#define I915_PROFILE_CALL(status, fn, ...)          \
+    do                                              \
+    {                                               \
+        UINT64 ProfileStart = i915ProfileStart();   \
+        (status) = fn(__VA_ARGS__);                 \
+        i915ProfileRecord(#fn, ProfileStart);       \
+    } while (0)
+#endif
@@ -2,6 +2,151 @@
 #define i915_REGH
 #define PCH_DISPLAY_BASE 0xc0000u
 #define DETAIL_TIME_SELCTION 0
+// Run GOP Blt against a system-RAM copy of the framebuffer and flush only the
+// dirty rectangles to the GTT aperture. Clients that write FrameBufferBase
+// directly bypass the shadow, so this is off unless asked for.
+#ifndef I915_SHADOW_FB
+#define I915_SHADOW_FB 0
+#endif
+// 0 flushes at the end of every Blt call, otherwise dirty rectangles are
+// coalesced and flushed from a timer with this period in milliseconds.
+#ifndef I915_SHADOW_FB_FLUSH_MS
+#define I915_SHADOW_FB_FLUSH_MS 0
+#endif
+// Map the scanout range of the GTT aperture write-combining. Falls back to
+// the uncached default if the GCD refuses the attribute change.
+#ifndef I915_FB_WRITE_COMBINING
+#define I915_FB_WRITE_COMBINING 1
+#endif
+// Back the framebuffer with twice the visible height so console scrolls can
+// move the plane offset instead of copying the screen. Clients that write
+// FrameBufferBase directly only see the right picture at pan offset 0, which
+// SetMode and ExitBootServices restore. ReadyToBoot restores it too and stops
+// panning, so a boot loader drawing into the framebuffer finds it in place.
+#ifndef I915_PAN_SCROLL
+#define I915_PAN_SCROLL 0
+#endif
+// Place the framebuffer at the start of BDSM stolen memory when an assigned
+// IGD has it, instead of allocating separate reserved pages. Off by default:
+// it relies on the guest OS keeping that range reserved until its own driver
+// has taken over the display.
+#ifndef I915_FB_FROM_STOLEN
+#define I915_FB_FROM_STOLEN 0
+#endif
+// How BDSM stolen memory is cleared. 0 zeroes all of it while it is set up,
+// 1 only the part the driver uses for the framebuffer, 2 and 3 clear that part
+// at start and the rest from a ReadyToBoot (2) or ExitBootServices (3)
+// callback, off the path to the first picture.
+#ifndef I915_STOLEN_ZERO
+#define I915_STOLEN_ZERO 2
+#endif
+// Clear stolen memory with non-temporal stores, which keeps tens of MiB of
+// zeroes out of the CPU caches.
+#ifndef I915_STOLEN_ZERO_STREAMING
+#define I915_STOLEN_ZERO_STREAMING 1
+#endif
+// Map the GGTT page table write-combining so the framebuffer PTEs go out in
+// bursts. Falls back to uncached like I915_FB_WRITE_COMBINING.
+#ifndef I915_GGTT_WRITE_COMBINING
+#define I915_GGTT_WRITE_COMBINING 1
+#endif
+// Use the driver's own Blt engine instead of FrameBufferBltLib.
+#ifndef I915_BLT_ENGINE
+#define I915_BLT_ENGINE 1
+#endif
+// Access BAR0 registers through a pointer into the mapped BAR instead of a
+// PciIo Mem.Read/Write call per register.
+#ifndef I915_MMIO_DIRECT
+#define I915_MMIO_DIRECT 1
+#endif
+// Run the display code against a simulated register file instead of the
+// device, to exercise and time modesets without a connected display.
+#ifndef I915_MMIO_SIM
+#define I915_MMIO_SIM 0
+#endif
+// 1 = the simulated register file also has a DP sink on AUX channel B, see
+// I915_SIM_DP_SINK in i915_sim.h
+#ifndef I915_SIM_DP
+#define I915_SIM_DP 0
+#endif
+// Serve reads of display registers the hardware does not change from a
+// shadow of the last value, and skip writes that would not change it.
+#ifndef I915_MMIO_SHADOW
+#define I915_MMIO_SHADOW 0
+#endif
+// Time framebuffer fills and other hot paths at start and log the results.
+#ifndef I915_BENCH
+#define I915_BENCH 0
+#endif
+// Time each modeset and driver start stage into a table published for the
+// shell and the OS, see i915_profile.h.
+#ifndef I915_PROFILE
+#define I915_PROFILE 1
+#endif
+// Record every register access into a trace published for the shell and the
+// OS, and log an analysis of it once the GOP is up, see i915_trace.h.
+#ifndef I915_MMIO_TRACE
+#define I915_MMIO_TRACE 0
+#endif
+// accesses the trace holds, 12 bytes each
+#ifndef I915_MMIO_TRACE_RECORDS
+#define I915_MMIO_TRACE_RECORDS 0x20000
+#endif
+// Return from DriverStart once the device is set up and bring the display
+// up from a timer, so BDS can start other drivers meanwhile. A register
+// wait or delay that is still pending ends a tick. Whatever is left at
+// EndOfDxe runs there, before BDS connects the consoles. Off by default,
+// DriverStart then brings the display up before it returns.
+#ifndef I915_ASYNC_START
+#define I915_ASYNC_START 0
+#endif
+// period of the bring-up timer where the platform timer period can't be
+// read, OVMF's own default
+#ifndef I915_ASYNC_START_TICK_MS
+#define I915_ASYNC_START_TICK_MS 10
+#endif
+// Format PRINT_DEBUG messages into an in-memory ring and write them to the
+// debug port at ReadyToBoot instead of one slow serial write each. Errors are
+// still printed at once.
+#ifndef I915_LOG_DEFERRED
+#define I915_LOG_DEFERRED 1
+#endif
+// bytes of message text the ring holds before the oldest is overwritten
+#ifndef I915_LOG_RING_SIZE
+#define I915_LOG_RING_SIZE 0x10000
+#endif
+// highest I915_LOG_LEVEL the ReadyToBoot flush writes out, 1 skips the dumps
+#ifndef I915_LOG_FLUSH_LEVEL
+#define I915_LOG_FLUSH_LEVEL 2
+#endif
+// 1 = probe the AUX channels and DDC pins of all ports together and read the
+// EDID only from sinks that answered, 0 = read the EDID port by port
+#ifndef I915_PROBE_PARALLEL
+#define I915_PROBE_PARALLEL 1
+#endif
+// GMBUS rate EDID reads start at: 0 = 100 kHz, 1 = 400 kHz, 2 = 1 MHz. A pin
+// that fails at one rate steps down towards 100 kHz. DDC only has to support
+// 100 kHz, so that is the default.
+#ifndef I915_GMBUS_RATE
+#define I915_GMBUS_RATE 0
+#endif
+// 1 = keep the probed output and EDID in a non-volatile variable and skip the
+// probe while the sink still matches it. Off by default, it writes flash
+// whenever the output or the sink changes.
+#ifndef I915_EDID_CACHE
+#define I915_EDID_CACHE 0
+#endif
+// 1 = take over a pipe that the host firmware or an earlier boot left driving
+// the requested timing on the probed port, programming only the plane. Off
+// by default, it trusts register state the driver did not program itself.
+#ifndef I915_FASTBOOT
+#define I915_FASTBOOT 0
+#endif
+// Publish the display state left for the OS as a configuration table, see
+// i915_handoff.h.
+#ifndef I915_HANDOFF
+#define I915_HANDOFF 1
+#endif
 #define DPLL_CTRL1 (0x6C058)
 #define DPLL_CTRL1_SSC(id) (1 << ((id)*6 + 4))
 #define DPLL_CTRL1_LINK_RATE_MASK(id) (7 << ((id)*6 + 1))
@@ -107,6 +252,8 @@
 
 #define LCPLL1_CTL (0x46010)
 #define LCPLL2_CTL (0x46014)
+#define WRPLL_CTL1 (0x46040)
+#define WRPLL_CTL2 (0x46060)
 #define LCPLL_PLL_ENABLE (1 << 31)
 #define PLL_REF_SDVO_HDMI_MULTIPLIER_SHIFT 9
 #define PLL_REF_SDVO_HDMI_MULTIPLIER_MASK (7 << 9)
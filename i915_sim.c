@@ -0,0 +1,711 @@
+#include "i915_sim.h"
+#include "i915_display.h"
+#include "intel_opregion.h"
+#include <Library/BaseMemoryLib.h>
+
+//GVT-g PV info page, the simulated device presents itself as a vGPU
+#define I915_SIM_VGT_MAGIC 0x78000
+#define I915_SIM_VGT_APERTURE_SIZE 0x78044
+//PP_STATUS power on bit and the idle state of a powered panel
+#define I915_SIM_PP_STATUS_ON (1u << 31)
+#define I915_SIM_PP_STATE_ON_IDLE 0x8
+
+typedef struct
+{
+    UINT32 reg;
+    UINT32 value;
+} I915_SIM_REG;
+
+//Register file for running the display code without display hardware. It
+//models what the driver polls or reads back: power well and DBUF
+//acknowledges, DDI buffer idle, pipe active, DPLL lock, a panel power
+//sequencer that finishes at once, a GMBUS with an HDMI sink on
+//I915_SIM_HDMI_PIN or the pin i915SimGmbusAttach gave it and, once attached,
+//a DP sink behind one AUX channel.
+//Every other register reads back what was last written to it.
+STATIC I915_SIM_REG g_sim_regs[I915_SIM_REGS];
+STATIC BOOLEAN g_sim_full_logged = FALSE;
+
+STATIC struct
+{
+    I915_SIM_GMBUS_SINK sink;
+    I915_SIM_GMBUS_STATS stats;
+    UINT32 pin;
+    UINT32 rateKhz;
+    UINT32 segment;
+    UINT32 offset;
+    UINT32 remaining;
+    BOOLEAN failed;
+} g_sim_gmbus;
+
+//GMBUS0 rate selects in kHz
+STATIC CONST UINT32 g_sim_gmbus_rates[] = {100, 50, 400, 1000};
+
+//EDID of the simulated sink: 1920x1080 at 60 Hz, standard and established
+//timings down to 640x480, and an extension block
+STATIC CONST UINT8 g_sim_edid[256] = {
+    0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x06, 0xb3, 0xc0, 0x27, 0x8d, 0x1e, 0x00, 0x00,
+    0x31, 0x1a, 0x01, 0x03, 0x80, 0x3c, 0x22, 0x78, 0x2a, 0x53, 0xa5, 0xa7, 0x56, 0x52, 0x9c, 0x26,
+    0x11, 0x50, 0x54, 0xbf, 0xef, 0x00, 0xd1, 0xc0, 0xb3, 0x00, 0x95, 0x00, 0x81, 0x80, 0x81, 0x40,
+    0x81, 0xc0, 0x71, 0x4f, 0x01, 0x01, 0x02, 0x3a, 0x80, 0x18, 0x71, 0x38, 0x2d, 0x40, 0x58, 0x2c,
+    0x45, 0x00, 0x56, 0x50, 0x21, 0x00, 0x00, 0x1e, 0x00, 0x00, 0x00, 0xff, 0x00, 0x47, 0x43, 0x4c,
+    0x4d, 0x54, 0x4a, 0x30, 0x30, 0x37, 0x38, 0x32, 0x31, 0x0a, 0x00, 0x00, 0x00, 0xfd, 0x00, 0x32,
+    0x4b, 0x18, 0x53, 0x11, 0x00, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0xfc,
+    0x00, 0x41, 0x53, 0x55, 0x53, 0x20, 0x56, 0x5a, 0x32, 0x37, 0x39, 0x0a, 0x20, 0x20, 0x01, 0x99,
+    //CEA-861 extension with a 1366x768 detailed timing
+    0x02, 0x03, 0x04, 0x00, 0x66, 0x21, 0x56, 0xaa, 0x51, 0x00, 0x1e, 0x30, 0x46, 0x8f, 0x33, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x1e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xab,
+};
+//the EDID both sinks return, see i915SimSetEdid
+STATIC CONST UINT8 *g_sim_sink_edid = g_sim_edid;
+
+//The DP sink: its DPCD link configuration as the source wrote it, the lane
+//status and adjust requests training produced, and the I2C-over-AUX state
+//of its DDC bus
+STATIC struct
+{
+    BOOLEAN attached;
+    I915_SIM_DP_SINK sink;
+    I915_SIM_DP_STATS stats;
+    UINT8 linkConfig[0x100];
+    UINT8 laneStatus[4];
+    UINT8 adjust[4];
+    BOOLEAN aligned;
+    BOOLEAN fastTps1;
+    UINT32 segment;
+    UINT32 offset;
+} g_sim_dp;
+
+#if I915_SIM_DP
+//HBR2 on four lanes at the lowest levels, the sink the I915_SIM_DP knob attaches
+STATIC CONST I915_SIM_DP_SINK g_sim_dp_default = {
+    .AuxCh = AUX_CH_B,
+    .DpcdRev = DP_DPCD_REV_12,
+    .MaxLinkBw = DP_LINK_BW_5_4,
+    .MaxLanes = 4,
+    .Oui = {0x00, 0xaa, 0x01},
+};
+#endif
+
+STATIC I915_SIM_REG *i915SimLookup(UINT32 reg, BOOLEAN create)
+{
+    UINT32 slot = (reg >> 2) % I915_SIM_REGS;
+
+    for (UINT32 i = 0; i < I915_SIM_REGS; i++)
+    {
+        I915_SIM_REG *entry = &g_sim_regs[(slot + i) % I915_SIM_REGS];
+
+        //the key is stored off by one so that an empty slot is all zero
+        if (entry->reg == reg + 1)
+        {
+            return entry;
+        }
+        if (entry->reg == 0)
+        {
+            if (!create)
+            {
+                return NULL;
+            }
+            entry->reg = reg + 1;
+            return entry;
+        }
+    }
+    if (!g_sim_full_logged)
+    {
+        PRINT_ERROR("sim: register file full, dropping %x\n", reg);
+        g_sim_full_logged = TRUE;
+    }
+    return NULL;
+}
+
+STATIC UINT32 i915SimGet(UINT32 reg)
+{
+    I915_SIM_REG *entry = i915SimLookup(reg, FALSE);
+
+    return entry ? entry->value : 0;
+}
+
+STATIC VOID i915SimSet(UINT32 reg, UINT32 value)
+{
+    I915_SIM_REG *entry = i915SimLookup(reg, TRUE);
+
+    if (entry != NULL)
+    {
+        entry->value = value;
+    }
+}
+
+STATIC BOOLEAN i915SimIsPipeConf(UINT32 reg)
+{
+    return reg == _PIPEACONF || reg == _PIPEBCONF || reg == _PIPEBCONF + 0x1000 ||
+           reg == _PIPEEDPCONF;
+}
+
+STATIC BOOLEAN i915SimIsDdiBufCtl(UINT32 reg)
+{
+    return reg >= DDI_BUF_CTL(PORT_A) && reg <= DDI_BUF_CTL(PORT_E) &&
+           (reg & 0xFF) == (DDI_BUF_CTL(PORT_A) & 0xFF);
+}
+
+//AUX channels A to D
+STATIC BOOLEAN i915SimIsAuxCtl(UINT32 reg)
+{
+    return reg >= _DPA_AUX_CH_CTL && reg <= _DPA_AUX_CH_CTL + (3 << 8) &&
+           (reg & 0xFF) == (_DPA_AUX_CH_CTL & 0xFF);
+}
+
+//DPLL_STATUS follows the enables: LCPLL1/2 are DPLL 0/1 on Skylake
+STATIC UINT32 i915SimDpllStatus(VOID)
+{
+    UINT32 status = 0;
+
+    if (i915SimGet(LCPLL1_CTL) & LCPLL_PLL_ENABLE)
+    {
+        status |= DPLL_LOCK(0);
+    }
+    if (i915SimGet(LCPLL2_CTL) & LCPLL_PLL_ENABLE)
+    {
+        status |= DPLL_LOCK(1);
+    }
+    return status;
+}
+
+STATIC UINT32 i915SimPanelStatus(VOID)
+{
+    return (i915SimGet(PP_CONTROL) & PANEL_POWER_ON) ? I915_SIM_PP_STATUS_ON | I915_SIM_PP_STATE_ON_IDLE : 0;
+}
+
+STATIC UINT32 i915SimGmbusStatus(VOID)
+{
+    UINT32 status = GMBUS_HW_RDY;
+
+    if (g_sim_gmbus.failed && g_sim_gmbus.sink.Stall)
+    {
+        //the sink holds the clock low, nothing ever completes
+        return 0;
+    }
+    if (g_sim_gmbus.pin != g_sim_gmbus.sink.Pin || g_sim_gmbus.failed)
+    {
+        //nobody acknowledges the address
+        status |= GMBUS_SATOER;
+    }
+    else if (g_sim_gmbus.remaining == 0)
+    {
+        status |= GMBUS_HW_WAIT_PHASE;
+    }
+    return status;
+}
+
+STATIC VOID i915SimGmbusCommand(UINT32 command)
+{
+    UINT32 address = (command >> GMBUS_SLAVE_ADDR_SHIFT) & 0x7F;
+    UINT32 count = (command >> GMBUS_BYTE_COUNT_SHIFT) & 0x1FF;
+
+    if ((command & GMBUS_CYCLE_STOP) == GMBUS_CYCLE_STOP)
+    {
+        g_sim_gmbus.segment = 0;
+    }
+    if ((command & GMBUS_SW_RDY) && (address == 0x30 || address == 0x50) &&
+        g_sim_gmbus.pin == g_sim_gmbus.sink.Pin && g_sim_gmbus.sink.MaxRateKhz != 0 &&
+        g_sim_gmbus.rateKhz > g_sim_gmbus.sink.MaxRateKhz)
+    {
+        g_sim_gmbus.failed = TRUE;
+        g_sim_gmbus.stats.Failures++;
+    }
+    if ((command & GMBUS_SW_RDY) && address == 0x30 && !(command & GMBUS_SLAVE_READ))
+    {
+        //E-DDC segment pointer
+        g_sim_gmbus.segment = i915SimGet(gmbusData) & 0xFF;
+        g_sim_gmbus.remaining = 0;
+        g_sim_gmbus.stats.SegmentWrites++;
+        return;
+    }
+    if (!(command & GMBUS_SW_RDY) || address != 0x50)
+    {
+        g_sim_gmbus.remaining = 0;
+        return;
+    }
+    if (command & GMBUS_SLAVE_READ)
+    {
+        if ((command & GMBUS_CYCLE_INDEX) == GMBUS_CYCLE_INDEX)
+        {
+            g_sim_gmbus.offset = (command >> GMBUS_SLAVE_INDEX_SHIFT) & 0xFF;
+        }
+        g_sim_gmbus.remaining = count;
+        g_sim_gmbus.stats.Reads++;
+    }
+    else
+    {
+        //the one byte written is the EDID offset, already in GMBUS3
+        g_sim_gmbus.offset = i915SimGet(gmbusData) & 0xFF;
+        g_sim_gmbus.remaining = 0;
+    }
+}
+
+STATIC UINT32 i915SimGmbusData(VOID)
+{
+    UINT32 data = 0;
+
+    for (UINT32 i = 0; i < 4 && g_sim_gmbus.remaining > 0; i++)
+    {
+        UINT32 byte = 0xFF;
+
+        if (g_sim_gmbus.sink.Edid == NULL ? g_sim_gmbus.segment == 0
+                                          : g_sim_gmbus.segment < g_sim_gmbus.sink.Segments)
+        {
+            byte = g_sim_gmbus.sink.Edid == NULL
+                       ? g_sim_sink_edid[g_sim_gmbus.offset & 0xFF]
+                       : g_sim_gmbus.sink.Edid[g_sim_gmbus.segment * 256 + (g_sim_gmbus.offset & 0xFF)];
+        }
+
+        data |= byte << (i * 8);
+        g_sim_gmbus.offset++;
+        g_sim_gmbus.remaining--;
+    }
+    return data;
+}
+
+//Whether the lanes can lock at all at the configured rate and lane count
+STATIC BOOLEAN i915SimDpLinkUsable(UINT32 lane)
+{
+    UINT32 rate = g_sim_dp.linkConfig[DP_LINK_BW_SET - DP_LINK_BW_SET] * 27000;
+    UINT32 lanes = g_sim_dp.linkConfig[DP_LANE_COUNT_SET - DP_LINK_BW_SET] & DP_LANE_COUNT_MASK;
+
+    return lane < lanes && lanes <= g_sim_dp.sink.MaxLanes &&
+           g_sim_dp.linkConfig[DP_LINK_BW_SET - DP_LINK_BW_SET] <= g_sim_dp.sink.MaxLinkBw &&
+           (g_sim_dp.sink.MaxWorkingRate == 0 || rate <= g_sim_dp.sink.MaxWorkingRate) &&
+           !(g_sim_dp.sink.DeadLanes & (1 << lane));
+}
+
+STATIC VOID i915SimDpUpdateAlignment(VOID)
+{
+    UINT32 lanes = g_sim_dp.linkConfig[DP_LANE_COUNT_SET - DP_LINK_BW_SET] & DP_LANE_COUNT_MASK;
+
+    g_sim_dp.aligned = lanes > 0;
+    for (UINT32 lane = 0; lane < lanes && lane < 4; lane++)
+    {
+        g_sim_dp.aligned &= (g_sim_dp.laneStatus[lane] & DP_CHANNEL_EQ_BITS) == DP_CHANNEL_EQ_BITS;
+    }
+}
+
+//Runs the sink side of link training after the source changed the pattern
+//or the levels: a lane recovers the clock at the sink's voltage swing and
+//equalizes at its pre-emphasis, otherwise it asks for them.
+STATIC VOID i915SimDpTrain(VOID)
+{
+    UINT8 pattern = g_sim_dp.linkConfig[DP_TRAINING_PATTERN_SET - DP_LINK_BW_SET] & DP_TRAINING_PATTERN_MASK;
+
+    if (pattern == DP_TRAINING_PATTERN_DISABLE)
+    {
+        return;
+    }
+    for (UINT32 lane = 0; lane < 4; lane++)
+    {
+        UINT8 set = g_sim_dp.linkConfig[DP_TRAINING_LANE0_SET - DP_LINK_BW_SET + lane];
+        UINT8 v = set & DP_TRAIN_VOLTAGE_SWING_MASK;
+        UINT8 p = (set & DP_TRAIN_PRE_EMPHASIS_MASK) >> DP_TRAIN_PRE_EMPHASIS_SHIFT;
+        UINT8 wantV = g_sim_dp.sink.Vswing;
+        UINT8 wantP = g_sim_dp.sink.PreEmphasis;
+        UINT8 status = 0;
+
+        if (i915SimDpLinkUsable(lane) && v >= g_sim_dp.sink.Vswing)
+        {
+            status = DP_LANE_CR_DONE;
+            if (pattern != DP_TRAINING_PATTERN_1 && p >= g_sim_dp.sink.PreEmphasis)
+            {
+                status = DP_CHANNEL_EQ_BITS;
+            }
+        }
+        if (g_sim_dp.sink.AdjustStep)
+        {
+            wantV = v < wantV ? v + 1 : v;
+            wantP = p < wantP ? p + 1 : p;
+        }
+        g_sim_dp.laneStatus[lane] = status;
+        g_sim_dp.adjust[lane] = (wantV & 3) | ((wantP & 3) << 2);
+    }
+    i915SimDpUpdateAlignment();
+}
+
+//Fast link training: TPS1 and then TPS2 on DP_TP_CTL while the DPCD pattern
+//stays disabled. The sink locks if the link itself works, whatever the levels.
+STATIC VOID i915SimDpTpCtl(UINT32 data)
+{
+    UINT32 pattern = data & DP_TP_CTL_LINK_TRAIN_MASK;
+
+    if (!g_sim_dp.sink.NoAuxHandshake || !(data & DP_TP_CTL_ENABLE) ||
+        (g_sim_dp.linkConfig[DP_TRAINING_PATTERN_SET - DP_LINK_BW_SET] & DP_TRAINING_PATTERN_MASK) !=
+            DP_TRAINING_PATTERN_DISABLE)
+    {
+        g_sim_dp.fastTps1 = FALSE;
+        return;
+    }
+    if (pattern == DP_TP_CTL_LINK_TRAIN_PAT1)
+    {
+        g_sim_dp.fastTps1 = TRUE;
+        return;
+    }
+    if (pattern == DP_TP_CTL_LINK_TRAIN_PAT2 && g_sim_dp.fastTps1)
+    {
+        for (UINT32 lane = 0; lane < 4; lane++)
+        {
+            g_sim_dp.laneStatus[lane] = i915SimDpLinkUsable(lane) ? DP_CHANNEL_EQ_BITS : 0;
+        }
+        i915SimDpUpdateAlignment();
+        g_sim_dp.stats.FastTrains++;
+    }
+    g_sim_dp.fastTps1 = FALSE;
+}
+
+STATIC UINT8 i915SimDpcdRead(UINT32 address)
+{
+    switch (address)
+    {
+    case DP_DPCD_REV:
+        return g_sim_dp.sink.DpcdRev;
+    case DP_MAX_LINK_RATE:
+        return g_sim_dp.sink.MaxLinkBw;
+    case DP_MAX_LANE_COUNT:
+        return g_sim_dp.sink.MaxLanes | DP_ENHANCED_FRAME_CAP;
+    case DP_MAX_DOWNSPREAD:
+        return DP_MAX_DOWNSPREAD_0_5 | (g_sim_dp.sink.NoAuxHandshake ? DP_NO_AUX_HANDSHAKE_LINK_TRAINING : 0);
+    case DP_MAIN_LINK_CHANNEL_CODING:
+        return DP_CAP_ANSI_8B10B;
+    case DP_DOWN_STREAM_PORT_COUNT:
+        return DP_OUI_SUPPORT;
+    case DP_LANE0_1_STATUS:
+        g_sim_dp.stats.StatusReads++;
+        return g_sim_dp.laneStatus[0] | (g_sim_dp.laneStatus[1] << 4);
+    case DP_LANE0_1_STATUS + 1:
+        return g_sim_dp.laneStatus[2] | (g_sim_dp.laneStatus[3] << 4);
+    case DP_LANE_ALIGN_STATUS_UPDATED:
+        return g_sim_dp.aligned ? DP_INTERLANE_ALIGN_DONE : 0;
+    case DP_ADJUST_REQUEST_LANE0_1:
+        return g_sim_dp.adjust[0] | (g_sim_dp.adjust[1] << 4);
+    case DP_ADJUST_REQUEST_LANE0_1 + 1:
+        return g_sim_dp.adjust[2] | (g_sim_dp.adjust[3] << 4);
+    }
+    if (address >= DP_LINK_BW_SET && address < DP_LINK_BW_SET + sizeof(g_sim_dp.linkConfig))
+    {
+        return g_sim_dp.linkConfig[address - DP_LINK_BW_SET];
+    }
+    if (address >= DP_SINK_OUI && address < DP_SINK_OUI + sizeof(g_sim_dp.sink.Oui))
+    {
+        return g_sim_dp.sink.Oui[address - DP_SINK_OUI];
+    }
+    return 0;
+}
+
+STATIC VOID i915SimDpcdWrite(UINT32 address, CONST UINT8 *data, UINT32 len)
+{
+    for (UINT32 i = 0; i < len; i++, address++)
+    {
+        if (address < DP_LINK_BW_SET || address >= DP_LINK_BW_SET + sizeof(g_sim_dp.linkConfig))
+        {
+            continue;
+        }
+        g_sim_dp.linkConfig[address - DP_LINK_BW_SET] = data[i];
+        if (address == DP_LINK_BW_SET || address == DP_LANE_COUNT_SET ||
+            (address == DP_TRAINING_PATTERN_SET &&
+             (data[i] & DP_TRAINING_PATTERN_MASK) == DP_TRAINING_PATTERN_1))
+        {
+            //a new link or a new training, the lanes start over
+            ZeroMem(g_sim_dp.laneStatus, sizeof(g_sim_dp.laneStatus));
+            g_sim_dp.aligned = FALSE;
+        }
+        if (address == DP_TRAINING_PATTERN_SET &&
+            (data[i] & DP_TRAINING_PATTERN_MASK) == DP_TRAINING_PATTERN_1)
+        {
+            g_sim_dp.stats.TrainingStarts++;
+        }
+        if (address == DP_TRAINING_PATTERN_SET &&
+            (data[i] & DP_TRAINING_PATTERN_MASK) == DP_TRAINING_PATTERN_DISABLE)
+        {
+            g_sim_dp.stats.PatternClears++;
+        }
+        if (address == DP_TRAINING_LANE0_SET)
+        {
+            g_sim_dp.stats.LaneAdjusts++;
+        }
+    }
+    i915SimDpTrain();
+}
+
+//I2C-over-AUX to the sink's DDC bus: the E-DDC segment pointer at 0x30 and
+//the EDID at 0x50. A transaction without MOT ends with a stop.
+STATIC UINT8 i915SimDpI2c(UINT8 request, UINT32 address, CONST UINT8 *data, UINT32 len,
+                          UINT8 *reply, UINT32 *replyLen)
+{
+    UINT8 code = DP_AUX_I2C_REPLY_ACK;
+
+    if (address == 0x50 && (request & AUX_I2C_READ))
+    {
+        for (UINT32 i = 0; i < len; i++)
+        {
+            UINT8 byte = 0xFF;
+
+            if (g_sim_dp.sink.Edid == NULL ? g_sim_dp.segment == 0 : g_sim_dp.segment < g_sim_dp.sink.Segments)
+            {
+                byte = g_sim_dp.sink.Edid == NULL
+                           ? g_sim_sink_edid[g_sim_dp.offset & 0xFF]
+                           : g_sim_dp.sink.Edid[g_sim_dp.segment * 256 + (g_sim_dp.offset & 0xFF)];
+            }
+            reply[1 + i] = byte;
+            g_sim_dp.offset++;
+        }
+        *replyLen += len;
+    }
+    else if (address == 0x50 && len > 0)
+    {
+        g_sim_dp.offset = data[0];
+    }
+    else if (address == 0x30 && len > 0)
+    {
+        g_sim_dp.segment = data[0];
+    }
+    else if (address != 0x50 && address != 0x30)
+    {
+        code = DP_AUX_I2C_REPLY_NACK;
+    }
+    if (!(request & AUX_I2C_MOT))
+    {
+        g_sim_dp.segment = 0;
+        g_sim_dp.stats.I2cStops++;
+    }
+    return code << 4;
+}
+
+//Completes an AUX transaction at once. Only the DP sink's channel answers,
+//every other request times out the way an unconnected port does.
+STATIC UINT32 i915SimAuxTransfer(UINT32 reg, UINT32 ctl)
+{
+    UINT32 dataReg = reg - _DPA_AUX_CH_CTL + _DPA_AUX_CH_DATA1;
+    UINT32 size = (ctl & DP_AUX_CH_CTL_MESSAGE_SIZE_MASK) >> DP_AUX_CH_CTL_MESSAGE_SIZE_SHIFT;
+    UINT8 msg[20], reply[20];
+    UINT32 replyLen = 1;
+    UINT32 address, len;
+    UINT8 request;
+
+    if (!g_sim_dp.attached || (reg - _DPA_AUX_CH_CTL) >> 8 != g_sim_dp.sink.AuxCh || size < 3 || size > 20)
+    {
+        return (ctl & ~DP_AUX_CH_CTL_SEND_BUSY) | DP_AUX_CH_CTL_DONE | DP_AUX_CH_CTL_TIME_OUT_ERROR;
+    }
+    for (UINT32 i = 0; i < size; i++)
+    {
+        msg[i] = (UINT8)(i915SimGet(dataReg + (i & ~3)) >> ((3 - (i & 3)) * 8));
+    }
+    request = msg[0] >> 4;
+    address = ((msg[0] & 0xF) << 16) | (msg[1] << 8) | msg[2];
+    len = size > 3 ? msg[3] + 1 : 0;
+    ZeroMem(reply, sizeof(reply));
+
+    g_sim_dp.stats.AuxTransactions++;
+    if (g_sim_dp.sink.DeferEvery && g_sim_dp.stats.AuxTransactions % g_sim_dp.sink.DeferEvery == 0)
+    {
+        g_sim_dp.stats.Defers++;
+        reply[0] = ((request & DP_AUX_NATIVE_WRITE) ? DP_AUX_NATIVE_REPLY_DEFER : DP_AUX_I2C_REPLY_DEFER) << 4;
+    }
+    else if (g_sim_dp.sink.NackEvery && g_sim_dp.stats.AuxTransactions % g_sim_dp.sink.NackEvery == 0)
+    {
+        g_sim_dp.stats.Nacks++;
+        reply[0] = ((request & DP_AUX_NATIVE_WRITE) ? DP_AUX_NATIVE_REPLY_NACK : DP_AUX_I2C_REPLY_NACK) << 4;
+    }
+    else if (request == DP_AUX_NATIVE_READ)
+    {
+        len = MIN(len, 16u);
+        for (UINT32 i = 0; i < len; i++)
+        {
+            reply[1 + i] = i915SimDpcdRead(address + i);
+        }
+        replyLen += len;
+    }
+    else if (request == DP_AUX_NATIVE_WRITE)
+    {
+        i915SimDpcdWrite(address, msg + 4, MIN(len, size - 4));
+    }
+    else if (!(request & DP_AUX_NATIVE_WRITE))
+    {
+        reply[0] = i915SimDpI2c(request, address, msg + 4, size > 4 && !(request & AUX_I2C_READ) ? MIN(len, size - 4) : len,
+                                reply, &replyLen);
+    }
+    else
+    {
+        reply[0] = DP_AUX_NATIVE_REPLY_NACK << 4;
+    }
+
+    for (UINT32 i = 0; i < replyLen; i += 4)
+    {
+        UINT32 value = 0;
+
+        for (UINT32 j = 0; j < 4 && i + j < replyLen; j++)
+        {
+            value |= (UINT32)reply[i + j] << ((3 - j) * 8);
+        }
+        i915SimSet(dataReg + i, value);
+    }
+    return (ctl & ~(DP_AUX_CH_CTL_SEND_BUSY | DP_AUX_CH_CTL_TIME_OUT_ERROR | DP_AUX_CH_CTL_RECEIVE_ERROR |
+                    DP_AUX_CH_CTL_MESSAGE_SIZE_MASK)) |
+           DP_AUX_CH_CTL_DONE | (replyLen << DP_AUX_CH_CTL_MESSAGE_SIZE_SHIFT);
+}
+
+//Connects a DP sink, or with NULL disconnects it. The sink starts untrained
+//and with zeroed statistics.
+VOID i915SimDpAttach(CONST I915_SIM_DP_SINK *sink)
+{
+    ZeroMem(&g_sim_dp, sizeof(g_sim_dp));
+    if (sink != NULL)
+    {
+        g_sim_dp.sink = *sink;
+        g_sim_dp.attached = TRUE;
+    }
+}
+
+//Returns FALSE if no DP sink is attached
+BOOLEAN i915SimDpGetSink(I915_SIM_DP_SINK *sink)
+{
+    *sink = g_sim_dp.sink;
+    return g_sim_dp.attached;
+}
+
+VOID i915SimDpGetStats(I915_SIM_DP_STATS *stats)
+{
+    *stats = g_sim_dp.stats;
+}
+
+//Plugs in another monitor: the HDMI and DP sinks return the 256 bytes at
+//edid as their EDID from now on, NULL goes back to the built-in one.
+VOID i915SimSetEdid(CONST UINT8 *edid)
+{
+    g_sim_sink_edid = edid != NULL ? edid : g_sim_edid;
+}
+
+//Plugs another sink into the GMBUS, NULL for the plain HDMI sink
+VOID i915SimGmbusAttach(CONST I915_SIM_GMBUS_SINK *sink)
+{
+    ZeroMem(&g_sim_gmbus, sizeof(g_sim_gmbus));
+    if (sink != NULL)
+    {
+        g_sim_gmbus.sink = *sink;
+    }
+    if (g_sim_gmbus.sink.Pin == 0)
+    {
+        g_sim_gmbus.sink.Pin = I915_SIM_HDMI_PIN;
+    }
+}
+
+VOID i915SimGmbusGetStats(I915_SIM_GMBUS_STATS *stats)
+{
+    *stats = g_sim_gmbus.stats;
+}
+
+VOID i915SimReset(VOID)
+{
+    ZeroMem(g_sim_regs, sizeof(g_sim_regs));
+    i915SimGmbusAttach(NULL);
+    g_sim_full_logged = FALSE;
+    for (UINT32 port = PORT_A; port <= PORT_E; port++)
+    {
+        i915SimSet(DDI_BUF_CTL(port), DDI_BUF_IS_IDLE);
+    }
+    i915SimSet(SFUSE_STRAP, SFUSE_STRAP_DDIB_DETECTED);
+    i915SimSet(I915_SIM_VGT_APERTURE_SIZE, 256 << 20);
+    i915SimSetEdid(NULL);
+#if I915_SIM_DP
+    i915SimDpAttach(&g_sim_dp_default);
+#else
+    i915SimDpAttach(NULL);
+#endif
+    PRINT_DEBUG(EFI_D_ERROR, "sim: display registers are simulated\n");
+}
+
+void i915SimWrite32(UINT64 reg, UINT32 data)
+{
+    UINT32 offset = (UINT32)reg;
+
+    if (offset == HSW_PWR_WELL_CTL1)
+    {
+        //every requested well reports enabled in the bit below its request
+        data = (data & 0xAAAAAAAAu) | ((data & 0xAAAAAAAAu) >> 1);
+    }
+    else if (offset == DBUF_CTL_S1 || offset == DBUF_CTL_S2)
+    {
+        data = (data & ~DBUF_POWER_STATE) | ((data & DBUF_POWER_REQUEST) ? DBUF_POWER_STATE : 0);
+    }
+    else if (i915SimIsPipeConf(offset))
+    {
+        data = (data & ~I965_PIPECONF_ACTIVE) | ((data & PIPECONF_ENABLE) ? I965_PIPECONF_ACTIVE : 0);
+    }
+    else if (i915SimIsDdiBufCtl(offset))
+    {
+        data = (data & ~DDI_BUF_IS_IDLE) | ((data & DDI_BUF_CTL_ENABLE) ? 0 : DDI_BUF_IS_IDLE);
+    }
+    else if (i915SimIsAuxCtl(offset))
+    {
+        if (data & DP_AUX_CH_CTL_SEND_BUSY)
+        {
+            data = i915SimAuxTransfer(offset, data);
+        }
+        else
+        {
+            //the status bits are write one to clear
+            data = i915SimGet(offset) & ~(data & (DP_AUX_CH_CTL_DONE |
+                                                  DP_AUX_CH_CTL_TIME_OUT_ERROR |
+                                                  DP_AUX_CH_CTL_RECEIVE_ERROR));
+        }
+    }
+    else if (g_sim_dp.attached && offset == DP_TP_CTL(g_sim_dp.sink.AuxCh))
+    {
+        i915SimDpTpCtl(data);
+    }
+    else if (offset == gmbusSelect)
+    {
+        g_sim_gmbus.pin = data & 0x7;
+        g_sim_gmbus.rateKhz = g_sim_gmbus_rates[(data >> 8) & 3];
+        g_sim_gmbus.segment = 0;
+        g_sim_gmbus.remaining = 0;
+        g_sim_gmbus.failed = FALSE;
+    }
+    else if (offset == gmbusCommand)
+    {
+        i915SimGmbusCommand(data);
+    }
+    i915SimSet(offset, data);
+}
+
+UINT32 i915SimRead32(UINT64 reg)
+{
+    UINT32 offset = (UINT32)reg;
+
+    if (offset == DPLL_STATUS)
+    {
+        return i915SimDpllStatus();
+    }
+    if (offset == PP_STATUS)
+    {
+        return i915SimPanelStatus();
+    }
+    if (offset == gmbusStatus)
+    {
+        return i915SimGmbusStatus();
+    }
+    if (offset == gmbusData && g_sim_gmbus.remaining > 0)
+    {
+        return i915SimGmbusData();
+    }
+    return i915SimGet(offset);
+}
+
+UINT64 i915SimRead64(UINT64 reg)
+{
+    if (reg == I915_SIM_VGT_MAGIC)
+    {
+        return 0x4776544776544776ULL;
+    }
+    return i915SimRead32(reg) | ((UINT64)i915SimRead32(reg + 4) << 32);
+}
@@ -0,0 +1,75 @@
+#ifndef i915_SIMH
+#define i915_SIMH
+#include <Uefi.h>
+#include "i915_controller.h"
+
+//registers the simulated register file can hold at once
+#define I915_SIM_REGS 512
+//the GMBUS pin the simulated HDMI sink answers on
+#define I915_SIM_HDMI_PIN 1
+
+//A DP sink behind one AUX channel. Its DPCD reports the capabilities below
+//and its lanes lock once the source drives them at the levels it asks for.
+typedef struct
+{
+    UINT8 AuxCh;             //AUX channel and port the sink is on
+    UINT8 DpcdRev;           //DP_DPCD_REV
+    UINT8 MaxLinkBw;         //DP_MAX_LINK_RATE, DP_LINK_BW_5_4 for HBR2
+    UINT8 MaxLanes;          //DP_MAX_LANE_COUNT
+    BOOLEAN NoAuxHandshake;  //DP_NO_AUX_HANDSHAKE_LINK_TRAINING
+    UINT8 Oui[3];            //DP_SINK_OUI
+    UINT8 Vswing;            //voltage swing every lane needs for clock recovery
+    UINT8 PreEmphasis;       //pre-emphasis every lane needs for channel equalization
+    BOOLEAN AdjustStep;      //ask for one level more per adjust request instead of the final one
+    UINT8 DeadLanes;         //bit per lane that never recovers the clock
+    UINT32 MaxWorkingRate;   //link rates above this, in kHz, never lock, 0 for no limit
+    UINT32 DeferEvery;       //every Nth AUX transaction is deferred, 0 for never
+    UINT32 NackEvery;        //every Nth AUX transaction is NACKed, 0 for never
+    CONST UINT8 *Edid;       //Segments times 256 bytes, NULL for the EDID i915SimSetEdid set
+    UINT32 Segments;         //E-DDC segments Edid holds
+} I915_SIM_DP_SINK;
+
+//What the DP sink saw since it was attached
+typedef struct
+{
+    UINT32 AuxTransactions;
+    UINT32 Defers;
+    UINT32 Nacks;
+    UINT32 TrainingStarts; //TPS1 written to DP_TRAINING_PATTERN_SET
+    UINT32 LaneAdjusts;    //writes to DP_TRAINING_LANEx_SET
+    UINT32 StatusReads;    //reads of DP_LANE0_1_STATUS
+    UINT32 FastTrains;     //links locked from TPS1 and TPS2 without a handshake
+    UINT32 PatternClears;  //DP_TRAINING_PATTERN_DISABLE written to DP_TRAINING_PATTERN_SET
+    UINT32 I2cStops;       //I2C-over-AUX requests without MOT, each one ends a DDC transaction
+} I915_SIM_DP_STATS;
+
+//The HDMI sink on the GMBUS. The E-DDC segment pointer selects which 256
+//bytes of its EDID the DDC address reads, and goes back to 0 at each stop.
+typedef struct
+{
+    UINT8 Pin;        //GMBUS pin it answers on, 0 for I915_SIM_HDMI_PIN
+    CONST UINT8 *Edid; //Segments times 256 bytes, NULL for the EDID i915SimSetEdid set
+    UINT32 Segments;  //E-DDC segments Edid holds
+    UINT32 MaxRateKhz; //transfers above this bus rate fail, 0 for no limit
+    BOOLEAN Stall;    //too fast a transfer times out instead of being NAKed
+} I915_SIM_GMBUS_SINK;
+
+//What the GMBUS sink saw since it was attached
+typedef struct
+{
+    UINT32 SegmentWrites; //writes of the E-DDC segment pointer
+    UINT32 Reads;         //reads started at the DDC address
+    UINT32 Failures;      //transfers NAKed or stalled for the bus rate
+} I915_SIM_GMBUS_STATS;
+
+VOID i915SimReset(VOID);
+void i915SimWrite32(UINT64 reg, UINT32 data);
+UINT32 i915SimRead32(UINT64 reg);
+UINT64 i915SimRead64(UINT64 reg);
+VOID i915SimDpAttach(CONST I915_SIM_DP_SINK *sink);
+BOOLEAN i915SimDpGetSink(I915_SIM_DP_SINK *sink);
+VOID i915SimDpGetStats(I915_SIM_DP_STATS *stats);
+VOID i915SimGmbusAttach(CONST I915_SIM_GMBUS_SINK *sink);
+VOID i915SimGmbusGetStats(I915_SIM_GMBUS_STATS *stats);
+VOID i915SimSetEdid(CONST UINT8 *edid);
+#endif
@@ -0,0 +1,357 @@
+#include "i915_trace.h"
+#include "i915_debug.h"
+#include "i915_sim.h"
+#include "i915_wait.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+//distinct registers and 4 KiB register blocks the report tells apart
+#define I915_TRACE_REGS 1024
+#define I915_TRACE_BLOCKS 64
+//back-to-back reads of one register that make a poll worth reporting
+#define I915_TRACE_POLL_READS 16
+//accesses and registers the replay names before only counting
+#define I915_TRACE_MISMATCHES 8
+
+typedef struct
+{
+    UINT32 reg; //off by one so that an empty slot is all zero
+    UINT32 value;
+    BOOLEAN known;
+    UINT32 redundant;
+    UINT32 mismatches;
+    UINT32 firstMismatch;
+} I915_TRACE_REG_STATE;
+
+typedef struct
+{
+    UINT32 block; //off by one like I915_TRACE_REG_STATE
+    UINT32 count;
+    UINT64 ticks;
+} I915_TRACE_BLOCK;
+
+STATIC I915_TRACE_REG_STATE g_trace_regs[I915_TRACE_REGS];
+STATIC I915_TRACE_BLOCK g_trace_blocks[I915_TRACE_BLOCKS];
+
+#if I915_MMIO_TRACE
+STATIC I915_TRACE *g_trace = NULL;
+STATIC UINT32 g_trace_capacity = 0;
+STATIC UINT64 g_trace_last = 0;
+STATIC void (*g_raw_write32)(UINT64 reg, UINT32 data);
+STATIC UINT32 (*g_raw_read32)(UINT64 reg);
+STATIC UINT64 (*g_raw_read64)(UINT64 reg);
+
+STATIC VOID i915TraceAppend(I915_TRACE_OP op, UINT64 reg, UINT32 value, UINT64 now)
+{
+    I915_TRACE_RECORD *record;
+
+    if (g_trace->Count >= g_trace_capacity)
+    {
+        g_trace->Dropped++;
+        return;
+    }
+    record = &g_trace->Records[g_trace->Count++];
+    record->RegOp = I915_TRACE_REG((UINT32)reg) | ((UINT32)op << 24);
+    record->Delta = (UINT32)MIN(now - g_trace_last, (UINT64)MAX_UINT32);
+    record->Value = value;
+    g_trace_last = now;
+}
+
+STATIC void i915TraceWrite32(UINT64 reg, UINT32 data)
+{
+    g_raw_write32(reg, data);
+    i915TraceAppend(I915_TRACE_WRITE32, reg, data, AsmReadTsc());
+}
+
+STATIC UINT32 i915TraceRead32(UINT64 reg)
+{
+    UINT32 data = g_raw_read32(reg);
+
+    i915TraceAppend(I915_TRACE_READ32, reg, data, AsmReadTsc());
+    return data;
+}
+
+STATIC UINT64 i915TraceRead64(UINT64 reg)
+{
+    UINT64 data = g_raw_read64(reg);
+
+    i915TraceAppend(I915_TRACE_READ64, reg, (UINT32)data, AsmReadTsc());
+    i915TraceAppend(I915_TRACE_READ64_HIGH, reg, (UINT32)RShiftU64(data, 32), g_trace_last);
+    return data;
+}
+#endif
+
+STATIC UINT64 i915TraceTicksToUs(CONST I915_TRACE *trace, UINT64 ticks)
+{
+    return trace->TscFrequency ? DivU64x64Remainder(MultU64x32(ticks, 1000000), trace->TscFrequency, NULL) : 0;
+}
+
+STATIC I915_TRACE_REG_STATE *i915TraceRegState(UINT32 reg)
+{
+    UINT32 slot = (reg >> 2) % I915_TRACE_REGS;
+
+    for (UINT32 i = 0; i < I915_TRACE_REGS; i++)
+    {
+        I915_TRACE_REG_STATE *state = &g_trace_regs[(slot + i) % I915_TRACE_REGS];
+
+        if (state->reg == reg + 1)
+        {
+            return state;
+        }
+        if (state->reg == 0)
+        {
+            state->reg = reg + 1;
+            return state;
+        }
+    }
+    return NULL;
+}
+
+STATIC VOID i915TraceAddBlockTime(UINT32 reg, UINT32 ticks)
+{
+    for (UINT32 i = 0; i < I915_TRACE_BLOCKS; i++)
+    {
+        I915_TRACE_BLOCK *block = &g_trace_blocks[i];
+
+        if (block->block == 0)
+        {
+            block->block = (reg >> 12) + 1;
+        }
+        if (block->block == (reg >> 12) + 1)
+        {
+            block->count++;
+            block->ticks += ticks;
+            return;
+        }
+    }
+}
+
+STATIC VOID i915TraceEndPoll(CONST I915_TRACE *trace, UINT32 reg, UINT32 reads, UINT64 ticks)
+{
+    if (reads >= I915_TRACE_POLL_READS)
+    {
+        PRINT_DEBUG(EFI_D_ERROR, "trace: polled %x %u times for %lu us\n",
+                    reg, reads, i915TraceTicksToUs(trace, ticks));
+    }
+}
+
+//Wraps the register accessors installed on the controller so that every
+//access lands in the trace. Call it once the backend is in place.
+EFI_STATUS i915TraceAttach(i915_CONTROLLER *controller)
+{
+#if I915_MMIO_TRACE
+    UINTN size = sizeof(I915_TRACE) + (UINTN)I915_MMIO_TRACE_RECORDS * sizeof(I915_TRACE_RECORD);
+
+    if (g_trace == NULL)
+    {
+        g_trace = AllocateReservedPages(EFI_SIZE_TO_PAGES(size));
+        if (g_trace == NULL)
+        {
+            PRINT_ERROR("no memory for a %lu byte register trace\n", (UINT64)size);
+            return EFI_OUT_OF_RESOURCES;
+        }
+        g_trace_capacity = I915_MMIO_TRACE_RECORDS;
+    }
+    g_trace->Signature = I915_TRACE_SIGNATURE;
+    g_trace->Length = (UINT32)size;
+    g_trace->Count = 0;
+    g_trace->Dropped = 0;
+    g_trace->TscFrequency = i915TscFrequency();
+    g_trace->StartTsc = AsmReadTsc();
+    g_trace_last = g_trace->StartTsc;
+
+    g_raw_write32 = controller->write32;
+    g_raw_read32 = controller->read32;
+    g_raw_read64 = controller->read64;
+    controller->write32 = i915TraceWrite32;
+    controller->read32 = i915TraceRead32;
+    controller->read64 = i915TraceRead64;
+    return EFI_SUCCESS;
+#else
+    return EFI_UNSUPPORTED;
+#endif
+}
+
+//Logs what a trace says about the driver: writes that stored the value the
+//register already held, polls of I915_TRACE_POLL_READS or more reads, and the
+//time spent per 4 KiB register block. Works on a table dumped from another
+//machine as well as on the one being recorded.
+VOID i915TraceAnalyse(CONST I915_TRACE *trace)
+{
+    UINT32 pollReg = 0, pollReads = 0, redundant = 0;
+    UINT64 pollTicks = 0, ticks = 0;
+
+    ZeroMem(g_trace_regs, sizeof(g_trace_regs));
+    ZeroMem(g_trace_blocks, sizeof(g_trace_blocks));
+    for (UINT32 i = 0; i < trace->Count; i++)
+    {
+        ticks += trace->Records[i].Delta;
+    }
+    PRINT_DEBUG(EFI_D_ERROR, "trace: %u accesses over %lu us, %u dropped\n", trace->Count,
+                i915TraceTicksToUs(trace, ticks), trace->Dropped);
+
+    for (UINT32 i = 0; i < trace->Count; i++)
+    {
+        CONST I915_TRACE_RECORD *record = &trace->Records[i];
+        UINT32 reg = I915_TRACE_REG(record->RegOp);
+        UINT32 op = I915_TRACE_OPCODE(record->RegOp);
+        I915_TRACE_REG_STATE *state;
+
+        if (op == I915_TRACE_READ64_HIGH)
+        {
+            continue;
+        }
+        i915TraceAddBlockTime(reg, record->Delta);
+        if (op == I915_TRACE_READ32 && reg == pollReg && pollReads > 0)
+        {
+            pollReads++;
+            pollTicks += record->Delta;
+        }
+        else
+        {
+            i915TraceEndPoll(trace, pollReg, pollReads, pollTicks);
+            pollReg = reg;
+            pollReads = op == I915_TRACE_READ32 ? 1 : 0;
+            pollTicks = 0;
+        }
+
+        state = i915TraceRegState(reg);
+        if (state == NULL || op == I915_TRACE_READ64)
+        {
+            continue;
+        }
+        if (op == I915_TRACE_WRITE32 && state->known && state->value == record->Value)
+        {
+            state->redundant++;
+            redundant++;
+        }
+        state->value = record->Value;
+        state->known = TRUE;
+    }
+    i915TraceEndPoll(trace, pollReg, pollReads, pollTicks);
+
+    PRINT_DEBUG(EFI_D_ERROR, "trace: %u writes stored the value already there\n", redundant);
+    for (UINT32 i = 0; i < I915_TRACE_REGS; i++)
+    {
+        if (g_trace_regs[i].redundant > 0)
+        {
+            PRINT_VERBOSE("trace: %u redundant writes to %x\n",
+                          g_trace_regs[i].redundant, g_trace_regs[i].reg - 1);
+        }
+    }
+    for (UINT32 i = 0; i < I915_TRACE_BLOCKS && g_trace_blocks[i].block != 0; i++)
+    {
+        PRINT_DEBUG(EFI_D_ERROR, "trace: block %x: %u accesses, %lu us\n",
+                    (g_trace_blocks[i].block - 1) << 12, g_trace_blocks[i].count,
+                    i915TraceTicksToUs(trace, g_trace_blocks[i].ticks));
+    }
+}
+
+//Feeds a trace to the simulator, reset and given its sinks by the caller, and
+//compares what the simulator returns with what the device did. A mismatch is
+//either a register the simulator does not model or a device that behaved
+//unexpectedly; the report names the registers so the two can be told apart.
+//Returns the number of reads that differed. This drives the simulator, so it
+//is for host/trace_replay and the tests, not for a driver running on it.
+UINT32 i915TraceReplay(CONST I915_TRACE *trace)
+{
+    UINT32 mismatches = 0, named = 0;
+
+    ZeroMem(g_trace_regs, sizeof(g_trace_regs));
+    for (UINT32 i = 0; i < trace->Count; i++)
+    {
+        CONST I915_TRACE_RECORD *record = &trace->Records[i];
+        UINT32 reg = I915_TRACE_REG(record->RegOp);
+        I915_TRACE_REG_STATE *state;
+        UINT64 expected, value;
+
+        switch (I915_TRACE_OPCODE(record->RegOp))
+        {
+        case I915_TRACE_WRITE32:
+            i915SimWrite32(reg, record->Value);
+            continue;
+        case I915_TRACE_READ32:
+            expected = record->Value;
+            value = i915SimRead32(reg);
+            break;
+        case I915_TRACE_READ64:
+            expected = record->Value;
+            if (i + 1 < trace->Count &&
+                I915_TRACE_OPCODE(trace->Records[i + 1].RegOp) == I915_TRACE_READ64_HIGH)
+            {
+                expected |= LShiftU64(trace->Records[++i].Value, 32);
+            }
+            value = i915SimRead64(reg);
+            break;
+        default:
+            continue;
+        }
+        if (value == expected)
+        {
+            continue;
+        }
+        if (mismatches < I915_TRACE_MISMATCHES)
+        {
+            PRINT_DEBUG(EFI_D_ERROR, "trace: replay of access %u read %lx from %x, device had %lx\n",
+                        i, value, reg, expected);
+        }
+        mismatches++;
+        state = i915TraceRegState(reg);
+        if (state != NULL && state->mismatches++ == 0)
+        {
+            state->firstMismatch = i;
+        }
+    }
+    for (UINT32 i = 0; i < I915_TRACE_REGS; i++)
+    {
+        if (g_trace_regs[i].mismatches == 0)
+        {
+            continue;
+        }
+        if (named++ < I915_TRACE_MISMATCHES)
+        {
+            PRINT_DEBUG(EFI_D_ERROR, "trace: %x read differently %u times, first at access %u\n",
+                        g_trace_regs[i].reg - 1, g_trace_regs[i].mismatches,
+                        g_trace_regs[i].firstMismatch);
+        }
+    }
+    PRINT_DEBUG(EFI_D_ERROR, "trace: replay against the simulator, %u of %u accesses in %u registers read differently\n",
+                mismatches, trace->Count, named);
+    return mismatches;
+}
+
+//Logs the analysis of the trace recorded so far, see i915TraceAnalyse.
+VOID i915TraceReport(VOID)
+{
+#if I915_MMIO_TRACE
+    if (g_trace != NULL)
+    {
+        i915TraceAnalyse(g_trace);
+    }
+#endif
+}
+
+//Makes the trace reachable from the shell and the OS. Accesses made later
+//keep landing in it until it is full.
+EFI_STATUS i915TracePublish(VOID)
+{
+#if I915_MMIO_TRACE
+    EFI_STATUS Status;
+
+    if (g_trace == NULL)
+    {
+        return EFI_NOT_READY;
+    }
+    Status = gBS->InstallConfigurationTable(&gI915MmioTraceGuid, g_trace);
+    if (EFI_ERROR(Status))
+    {
+        return Status;
+    }
+    PRINT_DEBUG(EFI_D_ERROR, "register trace at %p, %u accesses\n", g_trace, g_trace->Count);
+    return EFI_SUCCESS;
+#else
+    return EFI_UNSUPPORTED;
+#endif
+}
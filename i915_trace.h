@@ -0,0 +1,50 @@
+#ifndef i915_TRACEH
+#define i915_TRACEH
+#include <Uefi.h>
+#include "i915_controller.h"
+
+#define I915_TRACE_SIGNATURE SIGNATURE_32('I', 'T', 'R', 'C')
+
+typedef enum
+{
+    I915_TRACE_WRITE32,
+    I915_TRACE_READ32,
+    I915_TRACE_READ64,      //Value is the low half
+    I915_TRACE_READ64_HIGH, //follows a READ64 with the high half, Delta 0
+} I915_TRACE_OP;
+
+//register offset in the low 24 bits, I915_TRACE_OP above them
+#define I915_TRACE_REG(regOp) ((regOp)&0xFFFFFF)
+#define I915_TRACE_OPCODE(regOp) ((regOp) >> 24)
+
+#pragma pack(1)
+//One register access. Delta is TSC ticks since the previous access, capped
+//at 0xFFFFFFFF.
+typedef struct
+{
+    UINT32 RegOp;
+    UINT32 Delta;
+    UINT32 Value;
+} I915_TRACE_RECORD;
+
+//Published as a configuration table under gI915MmioTraceGuid in reserved
+//memory, so it can be dumped from the shell or the OS. TscFrequency is
+//measured against the performance counter before the trace starts.
+typedef struct
+{
+    UINT32 Signature;
+    UINT32 Length;
+    UINT32 Count;
+    UINT32 Dropped;
+    UINT64 TscFrequency;
+    UINT64 StartTsc;
+    I915_TRACE_RECORD Records[];
+} I915_TRACE;
+#pragma pack()
+
+EFI_STATUS i915TraceAttach(i915_CONTROLLER *controller);
+VOID i915TraceReport(VOID);
+EFI_STATUS i915TracePublish(VOID);
+VOID i915TraceAnalyse(CONST I915_TRACE *trace);
+UINT32 i915TraceReplay(CONST I915_TRACE *trace);
+#endif
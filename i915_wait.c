@@ -0,0 +1,339 @@
+#include "i915_wait.h"
+#include "i915_debug.h"
+#include <Library/BaseLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+typedef struct
+{
+    UINT32 count;
+    UINT32 timeouts;
+    UINT64 maxUs;
+    UINT32 buckets[I915_WAIT_BUCKETS];
+} I915_WAIT_STATS;
+
+STATIC CONST CHAR8 *CONST g_wait_site_names[I915_WAIT_SITE_COUNT] = {
+    "gmbus", "aux", "dpll", "pipe", "ddi idle", "power well", "dbuf", "panel",
+};
+
+STATIC I915_WAIT_STATS g_wait_stats[I915_WAIT_SITE_COUNT];
+STATIC UINT64 g_counter_start = 0;
+STATIC UINT64 g_counter_end = 0;
+STATIC UINT64 g_counter_hz = 0;
+STATIC UINT64 g_counter_ticks_per_ms = 0;
+
+STATIC VOID i915CounterInit(VOID)
+{
+    if (g_counter_ticks_per_ms != 0)
+    {
+        return;
+    }
+    g_counter_hz = GetPerformanceCounterProperties(&g_counter_start, &g_counter_end);
+    g_counter_ticks_per_ms = DivU64x32(g_counter_hz, 1000);
+    if (g_counter_ticks_per_ms == 0)
+    {
+        g_counter_ticks_per_ms = 1;
+    }
+}
+
+UINT64 i915CounterTicksPerMs(VOID)
+{
+    i915CounterInit();
+    return g_counter_ticks_per_ms;
+}
+
+UINT64 i915CounterTicks(UINT64 start, UINT64 now)
+{
+    i915CounterInit();
+    if (g_counter_end >= g_counter_start)
+    {
+        //counts up from g_counter_start to g_counter_end, then starts over
+        return now >= start ? now - start : (g_counter_end - start) + (now - g_counter_start) + 1;
+    }
+    //counts down from g_counter_start to g_counter_end
+    return start >= now ? start - now : (start - g_counter_end) + (g_counter_start - now) + 1;
+}
+
+//Measured against the performance counter over about 1 ms, the first time
+//a caller needs it.
+UINT64 i915TscFrequency(VOID)
+{
+    STATIC UINT64 frequency = 0;
+    UINT64 counter, tsc, ticks;
+
+    if (frequency != 0)
+    {
+        return frequency;
+    }
+    //start on a tick edge, a PM timer tick is 280 ns
+    ticks = GetPerformanceCounter();
+    do
+    {
+        CpuPause();
+        counter = GetPerformanceCounter();
+    } while (counter == ticks);
+    tsc = AsmReadTsc();
+    do
+    {
+        CpuPause();
+        ticks = i915CounterTicks(counter, GetPerformanceCounter());
+    } while (ticks < i915CounterTicksPerMs());
+    frequency = DivU64x64Remainder(MultU64x64(AsmReadTsc() - tsc, g_counter_hz), ticks, NULL);
+    if (frequency == 0)
+    {
+        frequency = 1;
+    }
+    return frequency;
+}
+
+UINT64 i915TscToNs(UINT64 tsc)
+{
+    UINT64 frequency = i915TscFrequency();
+    UINT64 remainder;
+    UINT64 seconds = DivU64x64Remainder(tsc, frequency, &remainder);
+
+    return MultU64x32(seconds, 1000000000) +
+           DivU64x64Remainder(MultU64x32(remainder, 1000000000), frequency, NULL);
+}
+
+STATIC VOID i915WaitRecord(I915_WAIT_SITE site, UINT64 tsc, BOOLEAN timedOut)
+{
+    I915_WAIT_STATS *stats = &g_wait_stats[site];
+    UINT64 us = DivU64x32(i915TscToNs(tsc), 1000);
+    UINTN bucket = 0;
+
+    while (bucket < I915_WAIT_BUCKETS - 1 && (1ull << bucket) <= us)
+    {
+        bucket++;
+    }
+    stats->count++;
+    stats->buckets[bucket]++;
+    stats->maxUs = MAX(stats->maxUs, us);
+    if (timedOut)
+    {
+        stats->timeouts++;
+    }
+}
+
+STATIC BOOLEAN i915WaitMet(UINT32 val, UINT32 mask, UINT32 value, BOOLEAN anyBit)
+{
+    return anyBit ? (val & mask) != 0 : (val & mask) == value;
+}
+
+STATIC UINT64 i915WaitTicks(UINT32 timeoutUs)
+{
+    return DivU64x32(MultU64x32(i915TscFrequency(), timeoutUs), 1000000);
+}
+
+//Polls the count registers in regs until each one has met
+//anyBit ? (val & mask) != 0 : (val & mask) == value, or until deadline TSC
+//ticks have passed since start. The first rounds of reads go back to back
+//since most conditions are already met or take a few us, after that the
+//stall doubles up to I915_WAIT_MAX_STALL_US. The deadline is taken from the
+//TSC, so the time spent in register reads and Stall overshoot counts against
+//it. The performance counter is the ACPI PM timer on OVMF, an I/O port read
+//that exits to the VMM, which the spin phase cannot afford.
+STATIC EFI_STATUS i915WaitFor(i915_CONTROLLER *controller, I915_WAIT_SITE site, CONST UINT64 *regs,
+                              UINT32 count, UINT32 mask, UINT32 value, BOOLEAN anyBit,
+                              UINT64 start, UINT64 deadline, UINT32 *lastValues)
+{
+    UINT64 elapsed = 0;
+    UINT32 stall = 1;
+    UINT32 val;
+    UINT32 pending = count;
+    UINT32 done = 0;
+    UINTN spin = 0;
+
+    for (;;)
+    {
+        for (UINT32 i = 0; i < count; i++)
+        {
+            if (done & (1u << i))
+            {
+                continue;
+            }
+            val = controller->read32(regs[i]);
+            if (lastValues != NULL)
+            {
+                lastValues[i] = val;
+            }
+            if (i915WaitMet(val, mask, value, anyBit))
+            {
+                done |= 1u << i;
+                pending--;
+            }
+        }
+        elapsed = AsmReadTsc() - start;
+        if (pending == 0)
+        {
+            break;
+        }
+        if (elapsed >= deadline)
+        {
+            i915WaitRecord(site, elapsed, TRUE);
+            return EFI_TIMEOUT;
+        }
+        if (spin < I915_WAIT_SPIN)
+        {
+            spin++;
+            CpuPause();
+            continue;
+        }
+        gBS->Stall(stall);
+        stall = MIN(stall * 2, (UINT32)I915_WAIT_MAX_STALL_US);
+    }
+    i915WaitRecord(site, elapsed, FALSE);
+    return EFI_SUCCESS;
+}
+
+//Waits until (reg & mask) == value. lastValue, if not NULL, gets the final
+//read either way so callers can decode an error or log the state.
+EFI_STATUS i915WaitForRegister(i915_CONTROLLER *controller, I915_WAIT_SITE site, UINT64 reg,
+                               UINT32 mask, UINT32 value, UINT32 timeoutUs, UINT32 *lastValue)
+{
+    UINT64 deadline = i915WaitTicks(timeoutUs);
+
+    return i915WaitFor(controller, site, &reg, 1, mask, value, FALSE, AsmReadTsc(), deadline,
+                       lastValue);
+}
+
+//Waits until any bit of mask is set, for status registers that report
+//completion and failure in different bits.
+EFI_STATUS i915WaitForRegisterAny(i915_CONTROLLER *controller, I915_WAIT_SITE site, UINT64 reg,
+                                  UINT32 mask, UINT32 timeoutUs, UINT32 *lastValue)
+{
+    UINT64 deadline = i915WaitTicks(timeoutUs);
+
+    return i915WaitFor(controller, site, &reg, 1, mask, 0, TRUE, AsmReadTsc(), deadline,
+                       lastValue);
+}
+
+//Waits until (reg & mask) == value holds for all count registers, for
+//transactions started on several channels at once. lastValues, if not NULL,
+//gets the final read of each register. At most 32 registers.
+EFI_STATUS i915WaitForRegisters(i915_CONTROLLER *controller, I915_WAIT_SITE site, CONST UINT64 *regs,
+                                UINT32 count, UINT32 mask, UINT32 value, UINT32 timeoutUs,
+                                UINT32 *lastValues)
+{
+    UINT64 deadline;
+
+    if (count == 0 || count > 32)
+    {
+        return EFI_INVALID_PARAMETER;
+    }
+    deadline = i915WaitTicks(timeoutUs);
+    return i915WaitFor(controller, site, regs, count, mask, value, FALSE, AsmReadTsc(), deadline,
+                       lastValues);
+}
+
+//Arms wait for (reg & mask) == value within timeoutUs from now. Nothing is
+//read until the first i915WaitPoll or i915WaitComplete.
+VOID i915WaitBegin(I915_WAIT *wait, I915_WAIT_SITE site, UINT64 reg, UINT32 mask, UINT32 value,
+                   UINT32 timeoutUs)
+{
+    wait->site = site;
+    wait->reg = reg;
+    wait->mask = mask;
+    wait->value = value;
+    wait->anyBit = FALSE;
+    wait->ticks = i915WaitTicks(timeoutUs);
+    wait->start = AsmReadTsc();
+    wait->lastValue = 0;
+    wait->status = EFI_NOT_READY;
+}
+
+//Like i915WaitBegin, met once any bit of mask is set.
+VOID i915WaitBeginAny(I915_WAIT *wait, I915_WAIT_SITE site, UINT64 reg, UINT32 mask, UINT32 timeoutUs)
+{
+    i915WaitBegin(wait, site, reg, mask, 0, timeoutUs);
+    wait->anyBit = TRUE;
+}
+
+//Arms wait to be met us from now, for the fixed delays between steps.
+VOID i915WaitDelay(I915_WAIT *wait, UINT32 us)
+{
+    i915WaitBegin(wait, I915_WAIT_SITE_COUNT, 0, 0, 0, us);
+}
+
+//Reads the register once. Returns EFI_NOT_READY while the condition is
+//unmet and there is time left, then EFI_SUCCESS or EFI_TIMEOUT, which
+//further calls keep returning.
+EFI_STATUS i915WaitPoll(i915_CONTROLLER *controller, I915_WAIT *wait)
+{
+    UINT64 elapsed;
+    BOOLEAN met = FALSE;
+
+    if (wait->status != EFI_NOT_READY)
+    {
+        return wait->status;
+    }
+    if (wait->mask != 0)
+    {
+        wait->lastValue = controller->read32(wait->reg);
+        met = i915WaitMet(wait->lastValue, wait->mask, wait->value, wait->anyBit);
+    }
+    elapsed = AsmReadTsc() - wait->start;
+    if (met || elapsed >= wait->ticks)
+    {
+        wait->status = met || wait->mask == 0 ? EFI_SUCCESS : EFI_TIMEOUT;
+        if (wait->mask != 0)
+        {
+            i915WaitRecord(wait->site, elapsed, !met);
+        }
+    }
+    return wait->status;
+}
+
+//Sits out whatever is left of the wait, polling like i915WaitForRegister.
+EFI_STATUS i915WaitComplete(i915_CONTROLLER *controller, I915_WAIT *wait)
+{
+    UINT64 elapsed;
+
+    if (wait->status != EFI_NOT_READY)
+    {
+        return wait->status;
+    }
+    if (wait->mask != 0)
+    {
+        wait->status = i915WaitFor(controller, wait->site, &wait->reg, 1, wait->mask, wait->value,
+                                   wait->anyBit, wait->start, wait->ticks, &wait->lastValue);
+        return wait->status;
+    }
+    elapsed = AsmReadTsc() - wait->start;
+    if (elapsed < wait->ticks)
+    {
+        gBS->Stall(DivU64x32(i915TscToNs(wait->ticks - elapsed) + 999, 1000));
+    }
+    wait->status = EFI_SUCCESS;
+    return wait->status;
+}
+
+VOID i915WaitLogStats(VOID)
+{
+    for (UINTN site = 0; site < I915_WAIT_SITE_COUNT; site++)
+    {
+        I915_WAIT_STATS *stats = &g_wait_stats[site];
+
+        if (stats->count == 0)
+        {
+            continue;
+        }
+        PRINT_DEBUG(EFI_D_ERROR, "wait %a: %u waits, %u timeouts, max %lu us\n",
+                    g_wait_site_names[site], stats->count, stats->timeouts, stats->maxUs);
+        for (UINTN bucket = 0; bucket < I915_WAIT_BUCKETS; bucket++)
+        {
+            if (stats->buckets[bucket] == 0)
+            {
+                continue;
+            }
+            if (bucket == I915_WAIT_BUCKETS - 1)
+            {
+                PRINT_DEBUG(EFI_D_ERROR, "  >= %u us: %u\n", 1u << (bucket - 1), stats->buckets[bucket]);
+            }
+            else
+            {
+                PRINT_DEBUG(EFI_D_ERROR, "  < %u us: %u\n", 1u << bucket, stats->buckets[bucket]);
+            }
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef i915_WAITH
+#define i915_WAITH
+#include <Uefi.h>
+#include "i915_controller.h"
+
+//call sites that keep their own wait histogram
+typedef enum
+{
+    I915_WAIT_GMBUS,
+    I915_WAIT_AUX,
+    I915_WAIT_DPLL,
+    I915_WAIT_PIPE,
+    I915_WAIT_DDI_IDLE,
+    I915_WAIT_POWER_WELL,
+    I915_WAIT_DBUF,
+    I915_WAIT_PANEL,
+    I915_WAIT_SITE_COUNT
+} I915_WAIT_SITE;
+
+//reads taken back to back before the first stall
+#define I915_WAIT_SPIN 16
+//longest single stall once the backoff has grown
+#define I915_WAIT_MAX_STALL_US 1000
+//histogram buckets are powers of two in us, the last one takes the rest
+#define I915_WAIT_BUCKETS 16
+
+//A wait that is polled instead of sat out, so the caller can return and come
+//back for it, see i915WaitPoll. A wait with mask 0 is only a delay.
+typedef struct
+{
+    I915_WAIT_SITE site;
+    UINT64 reg;
+    UINT32 mask;
+    UINT32 value;
+    BOOLEAN anyBit;
+    UINT64 start;
+    UINT64 ticks;
+    UINT32 lastValue;
+    EFI_STATUS status;
+} I915_WAIT;
+
+EFI_STATUS i915WaitForRegister(i915_CONTROLLER *controller, I915_WAIT_SITE site, UINT64 reg,
+                               UINT32 mask, UINT32 value, UINT32 timeoutUs, UINT32 *lastValue);
+EFI_STATUS i915WaitForRegisterAny(i915_CONTROLLER *controller, I915_WAIT_SITE site, UINT64 reg,
+                                  UINT32 mask, UINT32 timeoutUs, UINT32 *lastValue);
+EFI_STATUS i915WaitForRegisters(i915_CONTROLLER *controller, I915_WAIT_SITE site, CONST UINT64 *regs,
+                                UINT32 count, UINT32 mask, UINT32 value, UINT32 timeoutUs,
+                                UINT32 *lastValues);
+VOID i915WaitBegin(I915_WAIT *wait, I915_WAIT_SITE site, UINT64 reg, UINT32 mask, UINT32 value,
+                   UINT32 timeoutUs);
+VOID i915WaitBeginAny(I915_WAIT *wait, I915_WAIT_SITE site, UINT64 reg, UINT32 mask, UINT32 timeoutUs);
+VOID i915WaitDelay(I915_WAIT *wait, UINT32 us);
+EFI_STATUS i915WaitPoll(i915_CONTROLLER *controller, I915_WAIT *wait);
+EFI_STATUS i915WaitComplete(i915_CONTROLLER *controller, I915_WAIT *wait);
+VOID i915WaitLogStats(VOID);
+//Performance counter ticks from start to now. The counter can be narrow, the
+//24 bit ACPI PM timer wraps every 4.7 s, so the difference is taken modulo
+//its range: right as long as less than one full period lies in between.
+UINT64 i915CounterTicks(UINT64 start, UINT64 now);
+UINT64 i915CounterTicksPerMs(VOID);
+//TSC ticks per second, and a TSC value in ns. Unlike the performance counter
+//the TSC is 64 bits wide and counts from reset, so it never wraps in a boot.
+UINT64 i915TscFrequency(VOID);
+UINT64 i915TscToNs(UINT64 tsc);
+#endif
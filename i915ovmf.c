@@ -1,8 +1,11 @@
+#define I915_LOG_CATEGORY I915_LOG_DRIVER
+#include <Guid/EventGroup.h>
 #include <Protocol/DevicePath.h>
 #include <Protocol/DriverBinding.h>
 #include <Protocol/DriverSupportedEfiVersion.h>
 #include <Protocol/GraphicsOutput.h>
 #include <Protocol/PciIo.h>
+#include <Protocol/Timer.h>
 #include <Uefi.h>
 
 #include "QemuFwCfgLib.h"
@@ -14,7 +17,14 @@
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include "i915_debug.h"
+#include "i915_bench.h"
+#include "i915_mmio.h"
+#include "i915_wait.h"
+#include "i915_ggtt.h"
+#include "i915_profile.h"
+#include "i915_trace.h"
 #include <Library/DevicePathLib.h>
+#include <Library/DxeServicesTableLib.h>
 #include <Library/FrameBufferBltLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/PcdLib.h>
@@ -25,28 +35,6 @@
 
 i915_CONTROLLER g_private = {SIGNATURE_32('i', '9', '1', '5')};
 
-static void write32(UINT64 reg, UINT32 data)
-{
-  g_private.PciIo->Mem.Write(g_private.PciIo, EfiPciIoWidthFillUint32,
-                             PCI_BAR_IDX0, reg, 1, &data);
-}
-
-static UINT32 read32(UINT64 reg)
-{
-  UINT32 data = 0;
-  g_private.PciIo->Mem.Read(g_private.PciIo, EfiPciIoWidthFillUint32,
-                            PCI_BAR_IDX0, reg, 1, &data);
-  return data;
-}
-
-static UINT64 read64(UINT64 reg)
-{
-  UINT64 data = 0;
-  g_private.PciIo->Mem.Read(g_private.PciIo, EfiPciIoWidthFillUint64,
-                            PCI_BAR_IDX0, reg, 1, &data);
-  return data;
-}
-
 //
 // selector and size of ASSIGNED_IGD_FW_CFG_OPREGION
 //
@@ -56,6 +44,16 @@ STATIC UINTN mOpRegionSize;
 // value read from ASSIGNED_IGD_FW_CFG_BDSM_SIZE, converted to UINTN
 //
 STATIC UINTN mBdsmSize;
+//
+// guest-physical base of the stolen memory SetupStolenMemory() programmed into
+// BDSM, 0 if there is none
+//
+STATIC EFI_PHYSICAL_ADDRESS mBdsmBase;
+//
+// bytes from the start of stolen memory that are known to be zero
+//
+STATIC UINTN mBdsmCleared;
+STATIC EFI_EVENT mBdsmClearEvent;
 
 /**
   Allocate memory in the 32-bit address space, with the requested UEFI memory
@@ -288,7 +286,7 @@ SetupOpRegion(IN EFI_PCI_IO_PROTOCOL *PciIo,
                                              &Address);
   if (EFI_ERROR(Status))
   {
-    PRINT_DEBUG(EFI_D_ERROR, "%a: %a: failed to allocate OpRegion: %r\n",
+    PRINT_ERROR("%a: %a: failed to allocate OpRegion: %r\n",
                 __FUNCTION__, GetPciName(PciInfo), Status);
     return Status;
   }
@@ -312,7 +310,7 @@ SetupOpRegion(IN EFI_PCI_IO_PROTOCOL *PciIo,
   g_private.opRegion = &OpRegion;
   if (EFI_ERROR(Status))
   {
-    PRINT_DEBUG(EFI_D_ERROR, "%a: %a: failed to decode OpRegion: %r\n",
+    PRINT_ERROR("%a: %a: failed to decode OpRegion: %r\n",
                 __FUNCTION__, GetPciName(PciInfo), Status);
     return Status;
   }
@@ -331,7 +329,7 @@ SetupOpRegion(IN EFI_PCI_IO_PROTOCOL *PciIo,
                        &Address);
   if (EFI_ERROR(Status))
   {
-    PRINT_DEBUG(EFI_D_ERROR, "%a: %a: failed to write OpRegion address: %r\n",
+    PRINT_ERROR("%a: %a: failed to write OpRegion address: %r\n",
                 __FUNCTION__, GetPciName(PciInfo), Status);
     goto FreeOpRegion;
   }
@@ -345,6 +343,104 @@ FreeOpRegion:
   return Status;
 }
 
+/**
+  Zero stolen memory up to Limit bytes from its start, skipping what is
+  already known to be zero.
+
+  @param[in] Limit  End of the range to clear, as an offset into stolen memory.
+**/
+STATIC
+VOID
+ClearStolenMemory(IN UINTN Limit)
+{
+  VOID *Start;
+  UINTN Size;
+
+  if (mBdsmBase == 0 || Limit <= mBdsmCleared)
+  {
+    return;
+  }
+#if I915_BENCH
+  UINT64 StartTicks = i915BenchNow();
+#endif
+  Start = (VOID *)(UINTN)(mBdsmBase + mBdsmCleared);
+  Size = Limit - mBdsmCleared;
+#if I915_STOLEN_ZERO_STREAMING
+  i915BltFillVideo(Start, Size, 0);
+  i915BltFlushStores();
+#else
+  ZeroMem(Start, Size);
+#endif
+  mBdsmCleared = Limit;
+#if I915_BENCH
+  PRINT_DEBUG(EFI_D_ERROR, "bench stolen clear: %x bytes in %lu us\n", Size,
+              i915BenchElapsedNs(StartTicks) / 1000);
+#endif
+}
+
+#if I915_STOLEN_ZERO >= 2
+/**
+  Clear whatever stolen memory DriverStart left alone, before the OS loader
+  can look at it.
+
+  @param[in] Event    The ReadyToBoot or ExitBootServices event.
+  @param[in] Context  Unused.
+**/
+STATIC
+VOID
+EFIAPI
+ClearStolenMemoryEvent(IN EFI_EVENT Event, IN VOID *Context)
+{
+  ClearStolenMemory(mBdsmSize);
+}
+#endif
+
+/**
+  Apply I915_STOLEN_ZERO to the part of stolen memory past the framebuffer,
+  once DriverStart knows how much of it the framebuffer takes.
+**/
+STATIC
+VOID
+ScheduleStolenMemoryClear(VOID)
+{
+  EFI_STATUS Status = EFI_SUCCESS;
+
+  if (mBdsmBase == 0 || mBdsmCleared >= mBdsmSize || mBdsmClearEvent != NULL)
+  {
+    return;
+  }
+#if I915_STOLEN_ZERO == 2
+  Status = EfiCreateEventReadyToBootEx(TPL_CALLBACK, ClearStolenMemoryEvent,
+                                       NULL, &mBdsmClearEvent);
+#elif I915_STOLEN_ZERO == 3
+  Status = gBS->CreateEvent(EVT_SIGNAL_EXIT_BOOT_SERVICES, TPL_NOTIFY,
+                            ClearStolenMemoryEvent, NULL, &mBdsmClearEvent);
+#endif
+  if (EFI_ERROR(Status))
+  {
+    PRINT_ERROR("cannot defer stolen memory clear: %u\n", Status);
+    ClearStolenMemory(mBdsmSize);
+  }
+}
+
+/**
+  Close the event ScheduleStolenMemoryClear created, for a bring-up that ends
+  in failure or in DriverStop. Stolen memory stays reserved and assigned to
+  the device, so what the event would have cleared is cleared now.
+**/
+STATIC
+VOID
+CancelStolenMemoryClear(VOID)
+{
+  if (mBdsmClearEvent == NULL)
+  {
+    return;
+  }
+  gBS->CloseEvent(mBdsmClearEvent);
+  mBdsmClearEvent = NULL;
+  ClearStolenMemory(mBdsmSize);
+}
+
 /**
   Set up stolen memory for the device identified by PciIo.
 
@@ -381,15 +477,19 @@ SetupStolenMemory(IN EFI_PCI_IO_PROTOCOL *PciIo,
       BdsmPages, EFI_SIZE_TO_PAGES((UINTN)ASSIGNED_IGD_BDSM_ALIGN), &Address);
   if (EFI_ERROR(Status))
   {
-    PRINT_DEBUG(EFI_D_ERROR, "%a: %a: failed to allocate stolen memory: %r\n",
+    PRINT_ERROR("%a: %a: failed to allocate stolen memory: %r\n",
                 __FUNCTION__, GetPciName(PciInfo), Status);
     return Status;
   }
 
+  mBdsmBase = Address;
+  mBdsmCleared = 0;
+#if I915_STOLEN_ZERO == 0
   //
   // Zero out stolen memory.
   //
-  ZeroMem((VOID *)(UINTN)Address, EFI_PAGES_TO_SIZE(BdsmPages));
+  ClearStolenMemory(EFI_PAGES_TO_SIZE(BdsmPages));
+#endif
 
   //
   // Write address of stolen memory to PCI config space.
@@ -400,7 +500,7 @@ SetupStolenMemory(IN EFI_PCI_IO_PROTOCOL *PciIo,
                        &Address);
   if (EFI_ERROR(Status))
   {
-    PRINT_DEBUG(EFI_D_ERROR, "%a: %a: failed to write stolen memory address: %r\n",
+    PRINT_ERROR("%a: %a: failed to write stolen memory address: %r\n",
                 __FUNCTION__, GetPciName(PciInfo), Status);
     goto FreeStolenMemory;
   }
@@ -411,9 +511,42 @@ SetupStolenMemory(IN EFI_PCI_IO_PROTOCOL *PciIo,
 
 FreeStolenMemory:
   gBS->FreePages(Address, BdsmPages);
+  mBdsmBase = 0;
   return Status;
 }
 
+#if I915_FB_FROM_STOLEN
+/**
+  Carve the scanout buffer out of the start of the stolen memory set up by
+  SetupStolenMemory(). That is where the hardware and Linux i915 expect a
+  firmware framebuffer, and it saves a second reserved allocation of the same
+  size.
+
+  @param[in] Size  Size of the framebuffer in bytes.
+
+  @return  Physical address of the framebuffer, or 0 if there is no stolen
+           memory or it is too small.
+**/
+STATIC
+EFI_PHYSICAL_ADDRESS
+StolenMemoryFramebuffer(IN UINTN Size)
+{
+  if (mBdsmBase == 0)
+  {
+    return 0;
+  }
+  if (Size > mBdsmSize)
+  {
+    PRINT_ERROR("stolen memory too small for a %x byte framebuffer\n",
+                Size);
+    return 0;
+  }
+  // the framebuffer is on screen right away, it cannot wait for a callback
+  ClearStolenMemory(Size);
+  return mBdsmBase;
+}
+#endif
+
 STATIC EFI_STATUS SetupFwcfgStuff(EFI_PCI_IO_PROTOCOL *PciIo)
 {
   EFI_STATUS OpRegionStatus = QemuFwCfgFindFile(ASSIGNED_IGD_FW_CFG_OPREGION,
@@ -449,7 +582,7 @@ STATIC EFI_STATUS SetupFwcfgStuff(EFI_PCI_IO_PROTOCOL *PciIo)
 
     if (BdsmItemSize != sizeof BdsmSize)
     {
-      PRINT_DEBUG(EFI_D_ERROR, "%a: %a: invalid fw_cfg size: %Lu\n", __FUNCTION__,
+      PRINT_ERROR("%a: %a: invalid fw_cfg size: %Lu\n", __FUNCTION__,
                   ASSIGNED_IGD_FW_CFG_BDSM_SIZE, (UINT64)BdsmItemSize);
       return EFI_PROTOCOL_ERROR;
     }
@@ -458,7 +591,7 @@ STATIC EFI_STATUS SetupFwcfgStuff(EFI_PCI_IO_PROTOCOL *PciIo)
 
     if (BdsmSize == 0 || BdsmSize > MAX_UINTN)
     {
-      PRINT_DEBUG(EFI_D_ERROR, "%a: %a: invalid value: %Lu\n", __FUNCTION__,
+      PRINT_ERROR("%a: %a: invalid value: %Lu\n", __FUNCTION__,
                   ASSIGNED_IGD_FW_CFG_BDSM_SIZE, BdsmSize);
       return EFI_PROTOCOL_ERROR;
     }
@@ -485,137 +618,149 @@ STATIC EFI_STATUS SetupFwcfgStuff(EFI_PCI_IO_PROTOCOL *PciIo)
   return EFI_SUCCESS;
 }
 ////POWER EDP
-EFI_STATUS EFIAPI i915ControllerDriverStart(
-    IN EFI_DRIVER_BINDING_PROTOCOL *This, IN EFI_HANDLE Controller,
-    IN EFI_DEVICE_PATH_PROTOCOL *RemainingDevicePath)
-{
-  EFI_TPL OldTpl;
-  EFI_STATUS Status;
-  i915_CONTROLLER *Private;
-  PCI_TYPE00 Pci;
-  // SANITY CHECKS AND INTIALIZATION OF Driver
-  OldTpl = gBS->RaiseTPL(TPL_CALLBACK);
-  PRINT_DEBUG(EFI_D_ERROR, "start\n");
+#if I915_FB_WRITE_COMBINING || I915_GGTT_WRITE_COMBINING
+/**
+  Mark an MMIO range write-combining, so stores to it are merged into bursts
+  instead of going out one uncached write at a time. Used for the framebuffer
+  range of the GTT aperture and for the GGTT page table in the upper half of
+  BAR0.
 
-  Private = &g_private;
+  The PCI host bridge adds its BARs to the GCD as uncached MMIO, so WC is
+  usually missing from the capabilities and gets added first.
 
-  Private->Signature = SIGNATURE_32('i', '9', '1', '5');
+  @param[in] Base  Start of the range.
+  @param[in] Size  Size of the range in bytes.
 
-  Status = gBS->OpenProtocol(
-      Controller, &gEfiPciIoProtocolGuid, (VOID **)&Private->PciIo,
-      This->DriverBindingHandle, Controller, EFI_OPEN_PROTOCOL_BY_DRIVER);
-  if (EFI_ERROR(Status))
-  {
-    goto RestoreTpl;
-  }
+  @retval EFI_SUCCESS  The range is write-combining.
 
-  Status = Private->PciIo->Pci.Read(Private->PciIo, EfiPciIoWidthUint32, 0,
-                                    sizeof(Pci) / sizeof(UINT32), &Pci);
-  if (EFI_ERROR(Status))
-  {
-    goto ClosePciIo;
-  }
+  @return              Error codes from the GCD services. The range keeps its
+                       previous capabilities and attributes in that case.
+**/
+STATIC
+EFI_STATUS
+SetupWriteCombining(IN EFI_PHYSICAL_ADDRESS Base, IN UINTN Size)
+{
+  EFI_STATUS Status;
+  EFI_GCD_MEMORY_SPACE_DESCRIPTOR Desc;
 
-  Status = Private->PciIo->Attributes(
-      Private->PciIo, EfiPciIoAttributeOperationEnable,
-      EFI_PCI_DEVICE_ENABLE, // | EFI_PCI_IO_ATTRIBUTE_VGA_MEMORY,
-      NULL);
+  Size = ALIGN_VALUE(Size, EFI_PAGE_SIZE);
+  Status = gDS->GetMemorySpaceDescriptor(Base, &Desc);
   if (EFI_ERROR(Status))
   {
-    goto ClosePciIo;
+    return Status;
   }
-
-  PRINT_DEBUG(EFI_D_ERROR, "set pci attrs\n");
-
-  //
-  // Get ParentDevicePath
-  //
-  EFI_DEVICE_PATH_PROTOCOL *ParentDevicePath;
-  Status = gBS->HandleProtocol(Controller, &gEfiDevicePathProtocolGuid,
-                               (VOID **)&ParentDevicePath);
-  if (EFI_ERROR(Status))
+  if ((Desc.Attributes & EFI_MEMORY_CACHETYPE_MASK) == EFI_MEMORY_WC)
   {
-    goto ClosePciIo;
+    return EFI_SUCCESS;
   }
 
-  //
-  // Set Gop Device Path
-  //
-  ACPI_ADR_DEVICE_PATH AcpiDeviceNode;
-  ZeroMem(&AcpiDeviceNode, sizeof(ACPI_ADR_DEVICE_PATH));
-  AcpiDeviceNode.Header.Type = ACPI_DEVICE_PATH;
-  AcpiDeviceNode.Header.SubType = ACPI_ADR_DP;
-  AcpiDeviceNode.ADR =
-      ACPI_DISPLAY_ADR(1, 0, 0, 1, 0, ACPI_ADR_DISPLAY_TYPE_VGA, 0, 0);
-  SetDevicePathNodeLength(&AcpiDeviceNode.Header, sizeof(ACPI_ADR_DEVICE_PATH));
-
-  Private->GopDevicePath = AppendDevicePathNode(
-      ParentDevicePath, (EFI_DEVICE_PATH_PROTOCOL *)&AcpiDeviceNode);
-  if (Private->GopDevicePath == NULL)
+  if ((Desc.Capabilities & EFI_MEMORY_WC) == 0)
   {
-    Status = EFI_OUT_OF_RESOURCES;
-    goto ClosePciIo;
+    Status = gDS->SetMemorySpaceCapabilities(Base, Size,
+                                             Desc.Capabilities | EFI_MEMORY_WC);
+    if (EFI_ERROR(Status))
+    {
+      PRINT_ERROR("cannot add WC capability at %lx: %u\n", Base,
+                  Status);
+      return Status;
+    }
   }
-  PRINT_DEBUG(EFI_D_ERROR, "made gop path\n");
 
-  //
-  // Create new child handle and install the device path protocol on it.
-  //
-  Status = gBS->InstallMultipleProtocolInterfaces(&Private->Handle,
-                                                  &gEfiDevicePathProtocolGuid,
-                                                  Private->GopDevicePath, NULL);
+  Status = gDS->SetMemorySpaceAttributes(
+      Base, Size,
+      (Desc.Attributes & ~EFI_MEMORY_CACHETYPE_MASK) | EFI_MEMORY_WC);
   if (EFI_ERROR(Status))
   {
-    goto FreeGopDevicePath;
+    PRINT_ERROR("cannot map %lx+%lx WC: %u\n", Base, Size,
+                Status);
+    if ((Desc.Capabilities & EFI_MEMORY_WC) == 0)
+    {
+      gDS->SetMemorySpaceCapabilities(Base, Size, Desc.Capabilities);
+    }
+    return Status;
   }
-  PRINT_DEBUG(EFI_D_ERROR, "installed child handle\n");
-
-  g_private.write32 = write32;
-  g_private.read32 = read32;
-  g_private.read64 = read64;
-  g_private.rawclk_freq = 24000; //Should be the same for all compatible
-
-  // setup OpRegion from fw_cfg (IgdAssignmentDxe)
-  PRINT_DEBUG(EFI_D_ERROR, "before QEMU shenanigans\n");
-
-  QemuFwCfgInitialize();
-
-  if (
+  PRINT_DEBUG(EFI_D_ERROR, "%lx+%lx is write-combining\n", Base, Size);
+  return EFI_SUCCESS;
+}
+#endif
 
-      QemuFwCfgIsAvailable()
+typedef enum
+{
+  I915_START_DISPLAY,     // power wells and output probing
+  I915_START_FRAMEBUFFER, // framebuffer backing, GGTT and caching
+  I915_START_MODESET,     // first modeset, DP link training included
+  I915_START_GOP,         // GOP install
+  I915_START_DONE,
+  I915_START_FAILED,
+} I915_START_STATE;
+
+// What DriverStart leaves to the stages of the bring-up, which run from a
+// timer with I915_ASYNC_START. A stage returns EFI_NOT_READY at each register
+// wait or delay it has armed in Wait and picks up from there on its next
+// call. A stage that fails after DriverStart returned only records it here,
+// DriverStop releases the device.
+STATIC struct
+{
+  I915_START_STATE State;
+  EFI_STATUS Status;
+  EFI_DRIVER_BINDING_PROTOCOL *This;
+  EFI_HANDLE Controller;
+  EFI_EVENT Timer;
+  BOOLEAN Waiting;
+  I915_WAIT Wait;
+  I915_DISPLAY_INIT Display;
+  I915_MODESET Modeset;
+  UINT64 StageStart;
+  UINT64 ProfileStart;
+#if I915_BENCH
+  UINT64 StartTicks;
+#endif
+} g_start;
+
+// Set once EndOfDxe is signalled. BDS connects the consoles after it, so a
+// bring-up started from then on does not wait for the timer.
+STATIC BOOLEAN mEndOfDxe = FALSE;
+
+STATIC EFI_STATUS i915StartDisplay(VOID)
+{
+  EFI_STATUS Status;
 
-  )
+  if (!g_start.Waiting)
   {
-    // setup opregion
-    Status = SetupFwcfgStuff(Private->PciIo);
-    if (EFI_ERROR(Status))
+    g_private.gmadr = 0;
+    g_private.is_gvt = 0;
+    if (g_private.read64(0x78000) == 0x4776544776544776ULL)
     {
-      PRINT_DEBUG(EFI_D_ERROR, "SetupFwcfgStuff Error %d. Please see https://github.com/RotatingFans/i915ovmfPkg/wiki/Qemu-FwCFG-Workaround for more information\n", Status);
-
-      return Status; //TODO Better cleanup
+      PRINT_DEBUG(EFI_D_ERROR, "GVT-G Enabled\n");
+      g_private.gmadr = g_private.read32(0x78040);
+      g_private.is_gvt = 1;
+      // apertureSize=read32(0x78044);
     }
-    PRINT_DEBUG(EFI_D_ERROR, "SetupFwcfgStuff returns %d\n", Status);
+    // BEGIN IG AND DISPLAY CONFIG
+    g_start.StageStart = i915ProfileStart();
+    DisplayInitBegin(&g_private, &g_start.Display);
   }
-  PRINT_DEBUG(EFI_D_ERROR, "after QEMU shenanigans\n");
-
-  intel_bios_init(&g_private);
-  g_private.gmadr = 0;
-  g_private.is_gvt = 0;
-  if (read64(0x78000) == 0x4776544776544776ULL)
+  Status = DisplayInitStep(&g_start.Display, &g_start.Wait);
+  if (Status == EFI_NOT_READY)
   {
-    PRINT_DEBUG(EFI_D_ERROR, "GVT-G Enabled\n");
-    g_private.gmadr = read32(0x78040);
-    g_private.is_gvt = 1;
-    // apertureSize=read32(0x78044);
+    return Status;
   }
-  // BEGIN IG AND DISPLAY CONFIG
-  Status = DisplayInit(&g_private);
+  i915ProfileRecord("DisplayInit", g_start.StageStart);
   if (EFI_ERROR(Status))
   {
-    PRINT_DEBUG(EFI_D_ERROR, "DisplayInit Error. %d\n", Status);
+    PRINT_ERROR("DisplayInit Error. %d\n", Status);
 
-    return Status; //TODO Better cleanup
+    return Status;
   }
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS i915StartFramebuffer(VOID)
+{
+  EFI_STATUS Status;
+  i915_CONTROLLER *Private = &g_private;
+  UINT64 StageStart;
+
   // get BAR 0 address and size
   EFI_ACPI_ADDRESS_SPACE_DESCRIPTOR *bar0Desc;
   Private->PciIo->GetBarAttributes(Private->PciIo, PCI_BAR_IDX0, NULL,
@@ -641,8 +786,8 @@ EFI_STATUS EFIAPI i915ControllerDriverStart(
 
   PRINT_DEBUG(EFI_D_ERROR,
               "i915: gmadr = %08x, size = %08x, hgmadr = %08x, hsize = %08x\n",
-              g_private.gmadr, read32(0x78044), read32(0x78048),
-              read32(0x7804c));
+              g_private.gmadr, g_private.read32(0x78044),
+              g_private.read32(0x78048), g_private.read32(0x7804c));
 
   UINT32 x_active =
       g_private.edid.detailTimings[DETAIL_TIME_SELCTION].horzActive |
@@ -666,28 +811,86 @@ EFI_STATUS EFIAPI i915ControllerDriverStart(
   // create Global GTT entries to actually back the framebuffer
   g_private.FbBase = aperture_base + (UINT64)(g_private.gmadr);
   UINTN MaxFbSize = ((x_active * 4 + 64) & -64) * y_active;
+#if I915_PAN_SCROLL
+  // a second screen below the visible one lets console scrolls pan the plane
+  UINT64 ApertureLeft = g_private.is_gvt ? g_private.read32(0x78044)
+                                         : bar2Desc->AddrLen - g_private.gmadr;
+  if (MaxFbSize * 2 <= ApertureLeft)
+  {
+    MaxFbSize *= 2;
+  }
+  else
+  {
+    PRINT_ERROR("aperture too small for pan scrolling\n");
+  }
+#endif
+  g_private.fbBackingSize = MaxFbSize;
   UINTN Pages = EFI_SIZE_TO_PAGES((MaxFbSize + 65535) & -65536);
-  EFI_PHYSICAL_ADDRESS fb_backing =
-      (EFI_PHYSICAL_ADDRESS)AllocateReservedPages(Pages);
+  EFI_PHYSICAL_ADDRESS fb_backing = 0;
+#if I915_FB_FROM_STOLEN
+  fb_backing = StolenMemoryFramebuffer(EFI_PAGES_TO_SIZE(Pages));
+#endif
+  if (!fb_backing)
+  {
+    fb_backing = (EFI_PHYSICAL_ADDRESS)AllocateReservedPages(Pages);
+  }
   if (!fb_backing)
   {
-    PRINT_DEBUG(EFI_D_ERROR, "failed to allocate framebuffer\n");
+    PRINT_ERROR("failed to allocate framebuffer\n");
     Status = EFI_OUT_OF_RESOURCES;
-    goto FreeGopDevicePath;
+    return Status;
   }
+  ScheduleStolenMemoryClear();
   EFI_PHYSICAL_ADDRESS ggtt_base = mmio_base + (bar0Size >> 1);
-  UINT64 *ggtt = (UINT64 *)ggtt_base;
   PRINT_DEBUG(EFI_D_ERROR,
-              "i915: ggtt_base at %p, entries: %08x %08x, backing fb: %p, %x bytes\n",
-              ggtt_base, ggtt[0], ggtt[g_private.gmadr >> 12], fb_backing, MaxFbSize);
-  for (UINTN i = 0; i < MaxFbSize; i += 4096)
+              "i915: ggtt_base at %p, backing fb: %p, %x bytes\n",
+              ggtt_base, fb_backing, MaxFbSize);
+#if I915_GGTT_WRITE_COMBINING
+  // PTE stores merge into bursts, the flush after the fill drains them
+  if (EFI_ERROR(SetupWriteCombining(ggtt_base, bar0Size >> 1)))
+  {
+    PRINT_ERROR("ggtt stays uncached\n");
+  }
+#endif
+#if I915_BENCH
+  UINT64 GgttTicks = i915BenchNow();
+#endif
+  StageStart = i915ProfileStart();
+  Status = i915GgttInit(&g_private, ggtt_base, bar0Size >> 1);
+  if (!EFI_ERROR(Status))
   {
-    // create one PTE entry for each page
-    // cache is whatever cache used by the linux driver on my host
-    EFI_PHYSICAL_ADDRESS addr = fb_backing + i;
-    ggtt[(g_private.gmadr + i) >> 12] =
-        ((UINT32)(addr >> 32) & 0x7F0u) | ((UINT32)addr & 0xFFFFF000u) | 11;
+    // create Global GTT entries to actually back the framebuffer
+    Status = i915GgttMap(g_private.gmadr, fb_backing, MaxFbSize);
   }
+  i915ProfileRecord("GGTT", StageStart);
+  if (EFI_ERROR(Status))
+  {
+    PRINT_ERROR("failed to map the framebuffer: %u\n", Status);
+    return Status;
+  }
+#if I915_BENCH
+  PRINT_DEBUG(EFI_D_ERROR, "bench ggtt: %u PTEs in %lu us\n",
+              MaxFbSize >> 12, i915BenchElapsedNs(GgttTicks) / 1000);
+#endif
+
+#if I915_BENCH
+  i915BenchFill("uncached", g_private.FbBase, (x_active * 4 + 63) & -64,
+                x_active, y_active, 4);
+#endif
+#if I915_FB_WRITE_COMBINING
+  if (EFI_ERROR(SetupWriteCombining(g_private.FbBase, MaxFbSize)))
+  {
+    PRINT_ERROR("framebuffer stays uncached\n");
+  }
+#endif
+#if I915_BENCH
+  i915BenchFill("after caching setup", g_private.FbBase,
+                (x_active * 4 + 63) & -64, x_active, y_active, 4);
+  if (EFI_ERROR(i915BenchBlt()))
+  {
+    PRINT_ERROR("bench blt: the engine drew wrong pixels\n");
+  }
+#endif
 
   /*   // setup OpRegion from fw_cfg (IgdAssignmentDxe)
   PRINT_DEBUG(EFI_D_ERROR,"before QEMU shenanigans\n");
@@ -707,6 +910,33 @@ EFI_STATUS EFIAPI i915ControllerDriverStart(
 
   // TODO: turn on backlight if found in OpRegion, need eDP initialization
   // first...
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS i915StartModeset(VOID)
+{
+  EFI_STATUS Status;
+
+  if (!g_start.Waiting)
+  {
+    g_start.StageStart = i915ProfileStart();
+    setDisplayGraphicsModeBegin(
+        &g_start.Modeset,
+        i915GraphicsPrepareOutput(&g_private.GraphicsOutput, &g_private));
+  }
+  Status = setDisplayGraphicsModeStep(&g_start.Modeset, &g_start.Wait);
+  if (Status == EFI_NOT_READY)
+  {
+    return Status;
+  }
+  i915ProfileRecord("first modeset", g_start.StageStart);
+  return Status;
+}
+
+STATIC EFI_STATUS i915StartGop(VOID)
+{
+  EFI_STATUS Status = EFI_SUCCESS;
+  i915_CONTROLLER *Private = &g_private;
 
   //
   // Start the GOP software stack.
@@ -715,12 +945,16 @@ EFI_STATUS EFIAPI i915ControllerDriverStart(
   GraphicsOutput = &g_private.GraphicsOutput;
   PRINT_DEBUG(EFI_D_ERROR, "progressed to mline %d, status is %u\n",
               __LINE__, Status);
-  Status = i915GraphicsSetupOutput(GraphicsOutput, x_active, y_active);
+  // the pipe already runs the mode, this only points the plane at the
+  // framebuffer and clears it
+  g_start.StageStart = i915ProfileStart();
+  Status = GraphicsOutput->SetMode(GraphicsOutput, GraphicsOutput->Mode->Mode);
+  i915ProfileRecord("SetMode", g_start.StageStart);
   PRINT_DEBUG(EFI_D_ERROR, "progressed to mline %d, status is %u\n",
               __LINE__, Status);
   if (EFI_ERROR(Status))
   {
-    goto FreeGopDevicePath;
+    return Status;
   }
 
   Status = gBS->InstallMultipleProtocolInterfaces(
@@ -728,7 +962,7 @@ EFI_STATUS EFIAPI i915ControllerDriverStart(
       &Private->GraphicsOutput, NULL);
   if (EFI_ERROR(Status))
   {
-    goto Destructi915Graphics;
+    return Status;
   }
 
   //
@@ -736,25 +970,348 @@ EFI_STATUS EFIAPI i915ControllerDriverStart(
   //
   EFI_PCI_IO_PROTOCOL *ChildPciIo;
   Status =
-      gBS->OpenProtocol(Controller, &gEfiPciIoProtocolGuid,
-                        (VOID **)&ChildPciIo, This->DriverBindingHandle,
+      gBS->OpenProtocol(g_start.Controller, &gEfiPciIoProtocolGuid,
+                        (VOID **)&ChildPciIo, g_start.This->DriverBindingHandle,
                         Private->Handle, EFI_OPEN_PROTOCOL_BY_CHILD_CONTROLLER);
   if (EFI_ERROR(Status))
   {
-    goto UninstallGop;
+    gBS->UninstallProtocolInterface(Private->Handle,
+                                    &gEfiGraphicsOutputProtocolGuid,
+                                    &Private->GraphicsOutput);
+    return Status;
   }
 
   PRINT_DEBUG(EFI_D_ERROR, "gop ready\n");
+  if (g_start.Timer != NULL)
+  {
+    // BDS may have looked for the GOP before it existed
+    gBS->ConnectController(Private->Handle, NULL, NULL, TRUE);
+  }
+  i915ProfileRecord("DriverStart", g_start.ProfileStart);
+  if (EFI_ERROR(i915ProfilePublish()))
+  {
+    PRINT_ERROR("profile table not published\n");
+  }
+#if I915_MMIO_TRACE
+  //replaying against the simulator is left to host/trace_replay
+  i915TraceReport();
+  if (EFI_ERROR(i915TracePublish()))
+  {
+    PRINT_ERROR("register trace not published\n");
+  }
+#endif
+#if I915_BENCH
+  PRINT_DEBUG(EFI_D_ERROR, "bench DriverStart: %lu us\n",
+              i915BenchElapsedNs(g_start.StartTicks) / 1000);
+  i915WaitLogStats();
+#if I915_MMIO_SIM
+  if (EFI_ERROR(i915BenchLinkTraining(&g_private)))
+  {
+    PRINT_ERROR("bench dp: a link trained short of what the sink allows\n");
+  }
+#endif
+#endif
+  i915MmioLogStats("DriverStart");
+  return EFI_SUCCESS;
+}
+
+// Undoes what DriverStart set up, once the bring-up has stopped short.
+STATIC VOID i915StartRelease(VOID)
+{
+  CancelStolenMemoryClear();
+  gBS->UninstallMultipleProtocolInterfaces(g_private.Handle,
+                                           &gEfiDevicePathProtocolGuid,
+                                           g_private.GopDevicePath, NULL);
+  g_private.Handle = NULL;
+  gBS->CloseProtocol(g_start.Controller, &gEfiPciIoProtocolGuid,
+                     g_start.This->DriverBindingHandle, g_start.Controller);
+  FreePool(g_private.GopDevicePath);
+  g_private.GopDevicePath = NULL;
+}
+
+STATIC VOID i915StartFail(EFI_STATUS Status)
+{
+  PRINT_ERROR("bring-up stage %u failed: %u\n", g_start.State, Status);
+  g_start.Status = Status;
+  g_start.State = I915_START_FAILED;
+}
+
+// Runs the current stage up to its next wait, or to its end and on to the
+// next stage. Returns FALSE once there is none left.
+STATIC BOOLEAN i915StartStep(VOID)
+{
+  EFI_STATUS Status;
+
+  switch (g_start.State)
+  {
+  case I915_START_DISPLAY:
+    Status = i915StartDisplay();
+    break;
+  case I915_START_FRAMEBUFFER:
+    Status = i915StartFramebuffer();
+    break;
+  case I915_START_MODESET:
+    Status = i915StartModeset();
+    break;
+  case I915_START_GOP:
+    Status = i915StartGop();
+    break;
+  default:
+    return FALSE;
+  }
+  g_start.Waiting = Status == EFI_NOT_READY;
+  if (g_start.Waiting)
+  {
+    return TRUE;
+  }
+  if (EFI_ERROR(Status))
+  {
+    i915StartFail(Status);
+    return FALSE;
+  }
+  g_start.State++;
+  return g_start.State != I915_START_DONE;
+}
+
+STATIC VOID i915StartStopTimer(VOID)
+{
+  if (g_start.Timer != NULL)
+  {
+    gBS->SetTimer(g_start.Timer, TimerCancel, 0);
+    gBS->CloseEvent(g_start.Timer);
+    g_start.Timer = NULL;
+  }
+}
+
+#if I915_ASYNC_START
+// A tick runs the bring-up on for as long as the waits it arms are already
+// over, which a GMBUS or AUX transaction mostly is by the time it is polled,
+// and returns at the first one that is still pending. BDS starts other
+// drivers between ticks.
+STATIC VOID EFIAPI i915StartTick(IN EFI_EVENT Event, IN VOID *Context)
+{
+  while (!g_start.Waiting ||
+         i915WaitPoll(&g_private, &g_start.Wait) != EFI_NOT_READY)
+  {
+    if (!i915StartStep())
+    {
+      i915StartStopTimer();
+      break;
+    }
+  }
+}
+
+// The period of the platform timer, a shorter tick only fires as often.
+STATIC UINT64 i915StartTickPeriod(VOID)
+{
+  EFI_TIMER_ARCH_PROTOCOL *Timer;
+  UINT64 Period;
 
+  if (!EFI_ERROR(gBS->LocateProtocol(&gEfiTimerArchProtocolGuid, NULL,
+                                     (VOID **)&Timer)) &&
+      !EFI_ERROR(Timer->GetTimerPeriod(Timer, &Period)) && Period != 0)
+  {
+    return Period;
+  }
+  return I915_ASYNC_START_TICK_MS * 10000ull;
+}
+#endif
+
+// Runs whatever is left of the bring-up before returning, sitting out the
+// waits.
+STATIC VOID i915StartFinish(VOID)
+{
+  EFI_TPL OldTpl = gBS->RaiseTPL(TPL_CALLBACK);
+
+  do
+  {
+    if (g_start.Waiting)
+    {
+      i915WaitComplete(&g_private, &g_start.Wait);
+    }
+  } while (i915StartStep());
+  i915StartStopTimer();
   gBS->RestoreTPL(OldTpl);
-  return EFI_SUCCESS;
+}
+
+// BDS signals EndOfDxe before it connects the consoles, a bring-up the timer
+// has not finished by then is finished here, so the console finds the GOP.
+STATIC VOID EFIAPI i915EndOfDxe(IN EFI_EVENT Event, IN VOID *Context)
+{
+  gBS->CloseEvent(Event);
+  mEndOfDxe = TRUE;
+  if (g_start.Timer != NULL)
+  {
+    PRINT_DEBUG(EFI_D_ERROR, "EndOfDxe, finishing bring-up stage %u\n",
+                g_start.State);
+    i915StartFinish();
+  }
+}
+
+EFI_STATUS EFIAPI i915ControllerDriverStart(
+    IN EFI_DRIVER_BINDING_PROTOCOL *This, IN EFI_HANDLE Controller,
+    IN EFI_DEVICE_PATH_PROTOCOL *RemainingDevicePath)
+{
+  EFI_TPL OldTpl;
+  EFI_STATUS Status;
+  i915_CONTROLLER *Private;
+  PCI_TYPE00 Pci;
+#if I915_BENCH
+  g_start.StartTicks = i915BenchNow();
+#endif
+  // SANITY CHECKS AND INTIALIZATION OF Driver
+  OldTpl = gBS->RaiseTPL(TPL_CALLBACK);
+  PRINT_DEBUG(EFI_D_ERROR, "start\n");
+  // picks the store kernels for stolen memory, the GGTT and the framebuffer
+  i915BltInit();
+  i915ProfileInit();
+  g_start.ProfileStart = i915ProfileStart();
+  UINT64 StageStart;
+
+  Private = &g_private;
+
+  Private->Signature = SIGNATURE_32('i', '9', '1', '5');
+
+  Status = gBS->OpenProtocol(
+      Controller, &gEfiPciIoProtocolGuid, (VOID **)&Private->PciIo,
+      This->DriverBindingHandle, Controller, EFI_OPEN_PROTOCOL_BY_DRIVER);
+  if (EFI_ERROR(Status))
+  {
+    goto RestoreTpl;
+  }
+
+  Status = Private->PciIo->Pci.Read(Private->PciIo, EfiPciIoWidthUint32, 0,
+                                    sizeof(Pci) / sizeof(UINT32), &Pci);
+  if (EFI_ERROR(Status))
+  {
+    goto ClosePciIo;
+  }
 
-UninstallGop:
-  gBS->UninstallProtocolInterface(Private->Handle,
-                                  &gEfiGraphicsOutputProtocolGuid,
-                                  &Private->GraphicsOutput);
+  Status = Private->PciIo->Attributes(
+      Private->PciIo, EfiPciIoAttributeOperationEnable,
+      EFI_PCI_DEVICE_ENABLE, // | EFI_PCI_IO_ATTRIBUTE_VGA_MEMORY,
+      NULL);
+  if (EFI_ERROR(Status))
+  {
+    goto ClosePciIo;
+  }
+
+  PRINT_DEBUG(EFI_D_ERROR, "set pci attrs\n");
+
+  //
+  // Get ParentDevicePath
+  //
+  EFI_DEVICE_PATH_PROTOCOL *ParentDevicePath;
+  Status = gBS->HandleProtocol(Controller, &gEfiDevicePathProtocolGuid,
+                               (VOID **)&ParentDevicePath);
+  if (EFI_ERROR(Status))
+  {
+    goto ClosePciIo;
+  }
+
+  //
+  // Set Gop Device Path
+  //
+  ACPI_ADR_DEVICE_PATH AcpiDeviceNode;
+  ZeroMem(&AcpiDeviceNode, sizeof(ACPI_ADR_DEVICE_PATH));
+  AcpiDeviceNode.Header.Type = ACPI_DEVICE_PATH;
+  AcpiDeviceNode.Header.SubType = ACPI_ADR_DP;
+  AcpiDeviceNode.ADR =
+      ACPI_DISPLAY_ADR(1, 0, 0, 1, 0, ACPI_ADR_DISPLAY_TYPE_VGA, 0, 0);
+  SetDevicePathNodeLength(&AcpiDeviceNode.Header, sizeof(ACPI_ADR_DEVICE_PATH));
+
+  Private->GopDevicePath = AppendDevicePathNode(
+      ParentDevicePath, (EFI_DEVICE_PATH_PROTOCOL *)&AcpiDeviceNode);
+  if (Private->GopDevicePath == NULL)
+  {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto ClosePciIo;
+  }
+  PRINT_DEBUG(EFI_D_ERROR, "made gop path\n");
+
+  //
+  // Create new child handle and install the device path protocol on it.
+  //
+  Status = gBS->InstallMultipleProtocolInterfaces(&Private->Handle,
+                                                  &gEfiDevicePathProtocolGuid,
+                                                  Private->GopDevicePath, NULL);
+  if (EFI_ERROR(Status))
+  {
+    goto FreeGopDevicePath;
+  }
+  PRINT_DEBUG(EFI_D_ERROR, "installed child handle\n");
+
+  i915MmioInit(&g_private, I915_MMIO_SIM      ? I915_MMIO_BACKEND_SIM
+                           : I915_MMIO_DIRECT ? I915_MMIO_BACKEND_DIRECT
+                                              : I915_MMIO_BACKEND_PCI_IO);
+  g_private.rawclk_freq = 24000; //Should be the same for all compatible
+
+  // setup OpRegion from fw_cfg (IgdAssignmentDxe)
+  PRINT_DEBUG(EFI_D_ERROR, "before QEMU shenanigans\n");
+
+  StageStart = i915ProfileStart();
+  QemuFwCfgInitialize();
+
+  if (
+
+      QemuFwCfgIsAvailable()
 
-Destructi915Graphics:
+  )
+  {
+    // setup opregion
+    Status = SetupFwcfgStuff(Private->PciIo);
+    if (EFI_ERROR(Status))
+    {
+      PRINT_ERROR("SetupFwcfgStuff Error %d. Please see https://github.com/RotatingFans/i915ovmfPkg/wiki/Qemu-FwCFG-Workaround for more information\n", Status);
+
+      return Status; //TODO Better cleanup
+    }
+    PRINT_DEBUG(EFI_D_ERROR, "SetupFwcfgStuff returns %d\n", Status);
+  }
+  PRINT_DEBUG(EFI_D_ERROR, "after QEMU shenanigans\n");
+  i915ProfileRecord("fw_cfg", StageStart);
+
+  StageStart = i915ProfileStart();
+  intel_bios_init(&g_private);
+  i915ProfileRecord("VBT", StageStart);
+
+  // the display itself is brought up in stages, see i915StartStep
+  g_start.This = This;
+  g_start.Controller = Controller;
+  g_start.State = I915_START_DISPLAY;
+  g_start.Waiting = FALSE;
+#if I915_ASYNC_START
+  // past EndOfDxe BDS is connecting the consoles, most likely through this
+  // very call, and the GOP has to be there when it returns
+  if (!mEndOfDxe)
+  {
+    Status = gBS->CreateEvent(EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+                              i915StartTick, NULL, &g_start.Timer);
+    if (!EFI_ERROR(Status))
+    {
+      Status = gBS->SetTimer(g_start.Timer, TimerPeriodic,
+                             i915StartTickPeriod());
+    }
+    if (!EFI_ERROR(Status))
+    {
+      gBS->RestoreTPL(OldTpl);
+      return EFI_SUCCESS;
+    }
+    i915StartStopTimer();
+    PRINT_ERROR("no timer for the bring-up: %u\n", Status);
+  }
+#endif
+  i915StartFinish();
+  if (g_start.State != I915_START_DONE)
+  {
+    // the caller sees the failure, nothing stays open for DriverStop
+    i915StartRelease();
+    g_start.Controller = NULL;
+    gBS->RestoreTPL(OldTpl);
+    return g_start.Status;
+  }
+  gBS->RestoreTPL(OldTpl);
+  return EFI_SUCCESS;
 
 ClosePciIo:
   gBS->CloseProtocol(Controller, &gEfiPciIoProtocolGuid,
@@ -773,9 +1330,27 @@ EFI_STATUS EFIAPI i915ControllerDriverStop(IN EFI_DRIVER_BINDING_PROTOCOL *This,
                                            IN UINTN NumberOfChildren,
                                            IN EFI_HANDLE *ChildHandleBuffer)
 {
+  EFI_TPL OldTpl;
+
   PRINT_DEBUG(EFI_D_ERROR, "ControllerDriverStop\n");
-  // we don't support this, Windows can clean up our mess without this anyway
-  return EFI_UNSUPPORTED;
+  if (Controller != g_start.Controller || g_start.State == I915_START_DONE)
+  {
+    // we don't support tearing down a running display, Windows can clean up
+    // our mess without this anyway
+    return EFI_UNSUPPORTED;
+  }
+  // a bring-up that failed after DriverStart returned, or one still running
+  OldTpl = gBS->RaiseTPL(TPL_CALLBACK);
+  i915StartStopTimer();
+  if (g_start.State != I915_START_FAILED)
+  {
+    g_start.Status = EFI_ABORTED;
+    g_start.State = I915_START_FAILED;
+  }
+  i915StartRelease();
+  g_start.Controller = NULL;
+  gBS->RestoreTPL(OldTpl);
+  return EFI_SUCCESS;
 }
 
 EFI_STATUS EFIAPI i915ControllerDriverSupported(
@@ -935,6 +1510,7 @@ EFI_STATUS EFIAPI efi_main(IN EFI_HANDLE ImageHandle,
 {
   ////////////
   g_SystemTable = SystemTable;
+  i915LogInit();
   PRINT_DEBUG(EFI_D_ERROR, "Driver starts!\n");
   EFI_STATUS Status;
   Status = EfiLibInstallDriverBindingComponentName2(
@@ -949,5 +1525,16 @@ EFI_STATUS EFIAPI efi_main(IN EFI_HANDLE ImageHandle,
       &gi915SupportedEfiVersion, NULL);
   ASSERT_EFI_ERROR(Status);
 
+  EFI_EVENT EndOfDxe;
+  Status = gBS->CreateEventEx(EVT_NOTIFY_SIGNAL, TPL_CALLBACK, i915EndOfDxe,
+                              NULL, &gEfiEndOfDxeEventGroupGuid, &EndOfDxe);
+  if (EFI_ERROR(Status))
+  {
+    // without the hook nothing may be left for later, DriverStart finishes
+    // the bring-up itself
+    PRINT_ERROR("no EndOfDxe event: %u\n", Status);
+    mEndOfDxe = TRUE;
+  }
+
   return EFI_SUCCESS;
 }
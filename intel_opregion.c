@@ -1,3 +1,4 @@
+#define I915_LOG_CATEGORY I915_LOG_VBT
 
 #include "intel_opregion.h"
 //TODO CONVVERT to EFI_STATUS RETURN TYPEs
@@ -997,7 +998,7 @@ void intel_bios_init(i915_CONTROLLER *controller)
 
 	if (!vbt)
 	{
-		PRINT_DEBUG(EFI_D_ERROR, "Failed to find VBIOS tables");
+		PRINT_ERROR("Failed to find VBIOS tables");
 	}
 	// if (!vbt)
 	// {